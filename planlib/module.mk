@@ -7,14 +7,20 @@ PLAN_SRC := $(DIR)/plan_comm.c \
 	$(DIR)/plan_dstream.c \
 	$(DIR)/plan_dstride.c \
 	$(DIR)/plan_gups.c \
+	$(DIR)/plan_sgups.c \
 	$(DIR)/plan_lstream.c \
 	$(DIR)/plan_lstride.c \
+	$(DIR)/plan_memory.c \
 	$(DIR)/plan_misc.c \
 	$(DIR)/plan_pv1.c \
 	$(DIR)/plan_pv2.c \
 	$(DIR)/plan_pv3.c \
 	$(DIR)/plan_pv4.c \
+	$(DIR)/plan_pvfma.c \
+	$(DIR)/plan_pvtune.c \
+	$(DIR)/plan_simd.c \
 	$(DIR)/plan_sleep.c \
+	$(DIR)/plan_team.c \
 	$(DIR)/plan_write.c \
 	$(DIR)/plan_cba.c \
 	$(DIR)/plan_tilt.c \
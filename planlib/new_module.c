@@ -112,13 +112,14 @@ int initYOUR_NAMEPlan(void *plan){   // <- Replace YOUR_NAME with the name of yo
         #endif     //HAVE_PAPI
     }
     if(d){
-        // Initialize plan specific data here.
+        // Initialize plan specific data here. Allocate large buffers with plan_alloc(p, bytes) so they land on the worker's NUMA node.
     }
     return ERR_CLEAN;     // <- This indicates a clean run with no errors. Does not need to be changed.
 } /* initYOUR_NAMEPlan */
 
 /************************
  * This is where everything gets cleaned up. Be sure to free() your data types (free the members first) in addition to the ones included below.
+ * Buffers from plan_alloc() are released with plan_free().
  ***********************/
 /**
  * \brief Frees the memory used in the plan
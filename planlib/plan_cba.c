@@ -22,6 +22,9 @@
 #include <systemburn.h>
 #include <planheaders.h>
 #include <brand.h>
+#ifdef PLAN_X86_SIMD
+  #include <immintrin.h>
+#endif
 
 #ifdef HAVE_PAPI
   #define NUM_PAPI_EVENTS 1
@@ -29,6 +32,43 @@
   #define PAPI_UNITS { "FLOPS" }
 #endif //HAVE_PAPI
 
+static char *cba_kernels[] = {
+    "SWAR", "POPCNT", "AVX2", "AVX512"
+};
+
+/**
+ * \brief Checks whether the CPU we are running on can run a popcount kernel.
+ * \param [in] kernel One of CBA_SWAR ... CBA_AVX512.
+ * \returns 1 if it can, 0 otherwise.
+ */
+static int cba_supported(int kernel){
+    #ifdef PLAN_X86_SIMD
+    __builtin_cpu_init();
+    switch(kernel){
+        case CBA_POPCNT:
+            return __builtin_cpu_supports("popcnt");
+        case CBA_AVX2:
+            return __builtin_cpu_supports("avx2");
+        case CBA_AVX512:
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq");
+    }
+    #endif
+    return (kernel == CBA_SWAR);
+} /* cba_supported */
+
+/**
+ * \brief Picks the popcount kernel for a plan.
+ * \param [in] requested The kernel named on the PLAN line, or -1.
+ * \returns The requested kernel, or the best one below it that the CPU supports (the best supported one if none was named).
+ */
+static int cba_pick_kernel(int requested){
+    int k = (requested >= 0) ? requested : CBA_AVX512;
+    while((k > CBA_SWAR) && !cba_supported(k)){
+        k--;
+    }
+    return k;
+} /* cba_pick_kernel */
+
 /**
  * \brief Allocates and returns the data struct for the plan
  * \param [in] i The struct that holds the input data.
@@ -42,6 +82,8 @@
 void *makeCBAPlan(data *i){
     Plan *p;
     CBA_data *ip;
+    char *value;
+    int k;
     p = (Plan *)malloc(sizeof(Plan));
     assert(p);
     if(p){      // <- Checking the Plan pointer was allocated. Do not change.
@@ -62,9 +104,45 @@ void *makeCBAPlan(data *i){
             } else {
                 ip->nrows = (sqrt(i->d[0] / (2 * sizeof(uint64_t))));
             }
-            // ensure correct blocking:
-            ip->nrows -= ip->nrows % BLOCKSIZE;
+            /* BLOCKSIZE=n, rounded down to a power of 2 in 4 ... 64 */
+            ip->blocksize = BLOCKSIZE;
+            if((value = plan_token_value(i, "BLOCKSIZE")) != NULL){
+                ip->blocksize = atol(value);
+                if(ip->blocksize < CBA_MIN_BLOCKSIZE){
+                    ip->blocksize = CBA_MIN_BLOCKSIZE;
+                } else if(ip->blocksize > CBA_MAX_BLOCKSIZE){
+                    ip->blocksize = CBA_MAX_BLOCKSIZE;
+                }
+                while(ip->blocksize & (ip->blocksize - 1)){
+                    ip->blocksize &= ip->blocksize - 1;
+                }
+            }
+            /* NITERS=n, rounded up to a multiple of 64 */
+            ip->batch = NITERS;
+            if((value = plan_token_value(i, "NITERS")) != NULL){
+                ip->batch = ((atol(value) + 63) / 64) * 64;
+                if(ip->batch < 64){
+                    ip->batch = 64;
+                }
+            }
+            /* PREFETCH[=distance], a distance below 1 fails initCBAPlan */
+            ip->prefetch = 0;
+            if((value = plan_token_value(i, "PREFETCH")) != NULL){
+                ip->prefetch = (*value != '\0') ? atoi(value) : CBA_PF_DIST;
+                if(ip->prefetch < 1){
+                    ip->prefetch = -1;
+                }
+            }
+            ip->sweep = plan_has_token(i, "SWEEP");
+            // ensure correct blocking (for every block size when sweeping):
+            ip->nrows -= ip->nrows % (ip->sweep ? CBA_MAX_BLOCKSIZE : ip->blocksize);
             ip->ncols = ip->nrows;
+            ip->kernel = -1;
+            for(k = 0; k < CBA_KERNELS; k++){
+                if(plan_has_token(i, cba_kernels[k])){
+                    ip->kernel = k;
+                }
+            }
         }
         (p->vptr) = (void *)ip;
     }
@@ -129,52 +207,51 @@ int initCBAPlan(void *plan){
             #endif //HAVE_PAPI
         }         //DO_PERF
     }
+    if(ci && (ci->prefetch < 0)){
+        EmitLog(MyRank, 9999, "CBA PREFETCH distance must be at least 1.", -1, PRINT_ALWAYS);
+        return make_error(1,specific_err);
+    }
     if(ci){
         brand_init(&(ci->br), ci->seed);
+        ci->kernel = cba_pick_kernel(ci->kernel);
 
         nrow = ci->nrows;
         ncol = ci->ncols;
 
         ci->niter *= 64;          /* we'll do iterations in blocks of 64 */
 
-        if((ci->ncols % BLOCKSIZE) != 0){
+        if((ci->ncols % ci->blocksize) != 0){
             return make_error(0,specific_err);
             //fprintf(stderr, "ERROR (plan_cba): BLOCKSIZE (%ld) must divide"
             //" ncol (%ld)\n", BLOCKSIZE, ncol);
         }
-        assert ((NITERS % 64) == 0);
+        assert ((ci->batch % 64) == 0);
 
-        ci->work = (uint64_t *)calloc((size_t)((nrow * ncol + PAD + NITERS) * 2),
-                                      sizeof(uint64_t));
+        ci->work = (uint64_t *)plan_alloc(p, (size_t)((nrow * ncol + PAD + ci->batch) * 2) *
+                                          sizeof(uint64_t));
         ret = (ci->work == NULL) ? make_error(ALLOC,generic_err) : ERR_CLEAN;
 
         ci->out = &(ci->work[nrow * ncol + PAD]);
-        ci->data = &(ci->out[NITERS]);
+        ci->data = &(ci->out[ci->batch]);
         ci->chk = &(ci->data[nrow * ncol + PAD]);
 
         for(i = 0; i < (nrow * ncol); i++){
             ci->data[i] = brand(&(ci->br));
         }
 
-        blockit (ci->data, nrow, ncol, ci->work);
+        blockit (ci->data, nrow, ncol, ci->work, ci->blocksize);
     }
     return ret;
 } /* initCBAPlan */
 
-/************************
- * This is where the plan gets executed. Place all operations here.
- ***********************/
 /**
- * \brief A bit-twiddling load which will run within the given bytes of memory.
- * \param [in] plan The struct that holds the plan's data values.
- * \return int Error flag value
- * \sa parseCBAPlan
- * \sa makeCBAPlan
- * \sa initCBAPlan
- * \sa perfCBAPlan
- * \sa killCBAPlan
+ * \brief Runs one pass of the plan's iterations over the blocked data, in batches of random rows.
+ * \param [in] p The plan.
+ * \param [in] ci The plan's data.
+ * \param [in] bs The block size the data is currently laid out with.
+ * \param [in] timer The timer to accumulate the batches' run time in.
  */
-int execCBAPlan(void *plan){
+static void cba_pass(Plan *p, CBA_data *ci, int64_t bs, int timer){
     #ifdef HAVE_PAPI
     int k;
     long long start, end;
@@ -183,23 +260,15 @@ int execCBAPlan(void *plan){
     int i, j;
     int niters;
     ORB_t t1, t2;
-    Plan *p;
-    CBA_data *ci;
-
-    p = (Plan *)plan;
-    ci = (CBA_data *)p->vptr;
 
-    /* update execution count */
-    p->exec_count++;
-
-    for(i = 0; i < ci->niter; i += NITERS){
+    for(i = 0; i < ci->niter; i += ci->batch){
         niters = ci->niter - i;
-        if(niters > NITERS){
-            niters = NITERS;
+        if(niters > ci->batch){
+            niters = ci->batch;
         }
 
         for(j = 0; j < niters; j++){
-            /* pick NITERS random rows in the range 1..(nrow-1) */
+            /* pick a batch of random rows in the range 1..(nrow-1) */
             ci->out[j] = 1 + (brand(&(ci->br)) % (ci->nrows - 1));
             ci->out[j] <<= 48;              /* store index in high 16 bits */
         }
@@ -213,7 +282,7 @@ int execCBAPlan(void *plan){
 
             ORB_read(t1);
         }         //DO_PERF
-        cnt_bit_arr (ci->work, ci->nrows, ci->ncols, ci->out, niters);
+        cnt_bit_arr (ci->work, ci->nrows, ci->ncols, ci->out, niters, ci->kernel, bs, ci->prefetch);
         if(DO_PERF){
             ORB_read(t2);
 
@@ -227,9 +296,47 @@ int execCBAPlan(void *plan){
             }
             #endif //HAVE_PAPI
 
-            perftimer_accumulate(&p->timers, TIMER0, ORB_cycles_a(t2, t1));
+            perftimer_accumulate(&p->timers, timer, ORB_cycles_a(t2, t1));
         }         //DO_PERF
     }
+} /* cba_pass */
+
+/************************
+ * This is where the plan gets executed. Place all operations here.
+ ***********************/
+/**
+ * \brief A bit-twiddling load which will run within the given bytes of memory.
+ * With SWEEP, each pass is run once for every block size from 4 to 64, re-blocking the data (untimed) in between,
+ * and each block size is timed in its own timer.
+ * \param [in] plan The struct that holds the plan's data values.
+ * \return int Error flag value
+ * \sa parseCBAPlan
+ * \sa makeCBAPlan
+ * \sa initCBAPlan
+ * \sa perfCBAPlan
+ * \sa killCBAPlan
+ */
+int execCBAPlan(void *plan){
+    int t;
+    int64_t bs;
+    Plan *p;
+    CBA_data *ci;
+
+    p = (Plan *)plan;
+    ci = (CBA_data *)p->vptr;
+
+    /* update execution count */
+    p->exec_count++;
+
+    if(ci->sweep){
+        for(t = 0; t < CBA_SWEEP_SIZES; t++){
+            bs = CBA_MIN_BLOCKSIZE << t;
+            blockit (ci->data, ci->nrows, ci->ncols, ci->work, bs);
+            cba_pass(p, ci, bs, TIMER0 + t);
+        }
+    } else {
+        cba_pass(p, ci, ci->blocksize, TIMER0);
+    }
 
     return ERR_CLEAN;
 } /* execCBAPlan */
@@ -246,23 +353,40 @@ int execCBAPlan(void *plan){
  */
 int perfCBAPlan(void *plan){
     int ret = ~ERR_CLEAN;
-    uint64_t opcounts[NUM_TIMERS];
+    uint64_t opcounts[NUM_TIMERS], bytes;
+    char buffer[MSG_SIZE];
+    int t;
     Plan *p;
     CBA_data *d;
     p = (Plan *)plan;
     d = (CBA_data *)p->vptr;
     if(p->exec_count > 0){
-        opcounts[TIMER0] = ((uint64_t)d->ncols * (uint64_t)d->niter * 8ULL) * p->exec_count;         // count # of bytes processed
-        opcounts[TIMER1] = 0;
-        opcounts[TIMER2] = 0;
+        bytes = ((uint64_t)d->ncols * (uint64_t)d->niter * 8ULL) * p->exec_count;         // count # of bytes processed
+        for(t = 0; t < NUM_TIMERS; t++){
+            opcounts[t] = (d->sweep && (t < CBA_SWEEP_SIZES)) ? bytes : 0;
+        }
+        opcounts[TIMER0] = bytes;
 
         perf_table_update(&p->timers, opcounts, p->name);
         #ifdef HAVE_PAPI
         PAPI_table_update(p->name, p->PAPI_Results, p->PAPI_Times, p->PAPI_Num_Events);
         #endif //HAVE_PAPI
 
-        double ips = ((double)opcounts[TIMER0] / perftimer_gettime(&p->timers, TIMER0)) / 1e9;
-        EmitLogfs(MyRank, 9999, "CBA plan performance:", ips, "GB/s", PRINT_SOME);
+        snprintf(buffer, MSG_SIZE, "CBA popcount kernel : %s", cba_kernels[d->kernel]);
+        EmitLog  (MyRank, 9999, buffer, -1, PRINT_SOME);
+        if(d->prefetch){
+            EmitLog(MyRank, 9999, "CBA prefetch distance (rows):", 4 * d->prefetch, PRINT_SOME);
+        }
+        if(d->sweep){
+            for(t = 0; t < CBA_SWEEP_SIZES; t++){
+                snprintf(buffer, MSG_SIZE, "CBA block size %2ld   :", CBA_MIN_BLOCKSIZE << t);
+                EmitLogfs(MyRank, 9999, buffer, ((double)bytes / perftimer_gettime(&p->timers, TIMER0 + t)) / 1e9, "GB/s", PRINT_SOME);
+            }
+        } else {
+            EmitLog(MyRank, 9999, "CBA block size      :", d->blocksize, PRINT_SOME);
+            double ips = ((double)opcounts[TIMER0] / perftimer_gettime(&p->timers, TIMER0)) / 1e9;
+            EmitLogfs(MyRank, 9999, "CBA plan performance:", ips, "GB/s", PRINT_SOME);
+        }
         EmitLog  (MyRank, 9999, "CBA execution count :", p->exec_count, PRINT_SOME);
         ret = ERR_CLEAN;
     }
@@ -293,7 +417,7 @@ void *killCBAPlan(void *plan){
         #endif //HAVE_PAPI
     }     //DO_PERF
 
-    free((void *)(ci->work));
+    plan_free((void *)(ci->work));
     free((void *)(p->vptr));
     free((void *)(plan));
     return (void *)NULL;
@@ -323,32 +447,56 @@ int parseCBAPlan(char *line, LoadPlan *output){
  * \brief Holds the custom error messages for the plan
  */
 char *cba_errs[] = {
-    " blocking failed:"
+    " blocking failed:",
+    " invalid PREFETCH distance:"
 };
 
 plan_info CBA_info = {
     "CBA",
     cba_errs,
-    1,
+    2,
     makeCBAPlan,
     parseCBAPlan,
     execCBAPlan,
     initCBAPlan,
     killCBAPlan,
     perfCBAPlan,
-    { "B/s", NULL, NULL }
+    { "B/s", "B/s", "B/s", "B/s", "B/s", NULL }
 };
 
+/**
+ * \brief Prefetches the next group of four random rows of a block.
+ * \param [in] arr The block.
+ * \param [in] out The entries of out[] holding the row indices.
+ * \param [in] bs The block size (row length) in words.
+ */
+static inline void cba_prefetch(uint64_t *arr, uint64_t *out, int64_t bs){
+    int64_t r, j;
+    uint64_t *row;
+
+    for(r = 0; r < 4; r++){
+        row = &arr[(out[r] >> 48) * bs];
+        for(j = 0; j < bs; j += 8){
+            __builtin_prefetch(row + j, 0, 3);
+        }
+    }
+} /* cba_prefetch */
+
 /**
  * \brief the main operating function for CBA
+ * \param bs The block size, a power of 2 no larger than 64.
+ * \param pf Prefetch the rows this many groups of four iterations ahead, 0 for none.
  */
 static
 void block_iter(uint64_t *RESTRICT accum, uint64_t *RESTRICT arr,
-                uint64_t *RESTRICT out, int64_t niters){
+                uint64_t *RESTRICT out, int64_t niters, int64_t bs, int pf){
     int64_t i, j;
     uint64_t ind0, ind1, ind2, ind3, s0, s1, s2, s3;
 
     for(i = 0; i < niters; i += 4){
+        if(pf && (i + 4 * pf < niters)){
+            cba_prefetch(arr, out + i + 4 * pf, bs);
+        }
         s0 = out[i + 0];
         ind0 = s0 >> 48;
         s1 = out[i + 1];
@@ -360,34 +508,34 @@ void block_iter(uint64_t *RESTRICT accum, uint64_t *RESTRICT arr,
 
         j = 0;
         #ifdef USE_POP3
-        for(; j < (BLOCKSIZE - 2); j += 3){
+        for(; j < (bs - 2); j += 3){
             uint64_t x, y, z, popc;
 
             x = accum[j + 0];
             y = accum[j + 1];
             z = accum[j + 2];
 
-            x ^= arr[ind0 * BLOCKSIZE + j + 0];
-            y ^= arr[ind0 * BLOCKSIZE + j + 1];
-            z ^= arr[ind0 * BLOCKSIZE + j + 2];
+            x ^= arr[ind0 * bs + j + 0];
+            y ^= arr[ind0 * bs + j + 1];
+            z ^= arr[ind0 * bs + j + 2];
             POPCNT3(x,y,z,popc);
             s0 += popc;
 
-            x ^= arr[ind1 * BLOCKSIZE + j + 0];
-            y ^= arr[ind1 * BLOCKSIZE + j + 1];
-            z ^= arr[ind1 * BLOCKSIZE + j + 2];
+            x ^= arr[ind1 * bs + j + 0];
+            y ^= arr[ind1 * bs + j + 1];
+            z ^= arr[ind1 * bs + j + 2];
             POPCNT3(x,y,z,popc);
             s1 += popc;
 
-            x ^= arr[ind2 * BLOCKSIZE + j + 0];
-            y ^= arr[ind2 * BLOCKSIZE + j + 1];
-            z ^= arr[ind2 * BLOCKSIZE + j + 2];
+            x ^= arr[ind2 * bs + j + 0];
+            y ^= arr[ind2 * bs + j + 1];
+            z ^= arr[ind2 * bs + j + 2];
             POPCNT3(x,y,z,popc);
             s2 += popc;
 
-            x ^= arr[ind3 * BLOCKSIZE + j + 0];
-            y ^= arr[ind3 * BLOCKSIZE + j + 1];
-            z ^= arr[ind3 * BLOCKSIZE + j + 2];
+            x ^= arr[ind3 * bs + j + 0];
+            y ^= arr[ind3 * bs + j + 1];
+            z ^= arr[ind3 * bs + j + 2];
             POPCNT3(x,y,z,popc);
             s3 += popc;
 
@@ -396,16 +544,16 @@ void block_iter(uint64_t *RESTRICT accum, uint64_t *RESTRICT arr,
             accum[j + 2] = z;
         }
         #endif /* ifdef USE_POP3 */
-        for(; j < BLOCKSIZE; j++){
+        for(; j < bs; j++){
             uint64_t x = accum[j];
 
-            x ^= arr[ind0 * BLOCKSIZE + j];
+            x ^= arr[ind0 * bs + j];
             s0 += _popcnt(x);
-            x ^= arr[ind1 * BLOCKSIZE + j];
+            x ^= arr[ind1 * bs + j];
             s1 += _popcnt(x);
-            x ^= arr[ind2 * BLOCKSIZE + j];
+            x ^= arr[ind2 * bs + j];
             s2 += _popcnt(x);
-            x ^= arr[ind3 * BLOCKSIZE + j];
+            x ^= arr[ind3 * bs + j];
             s3 += _popcnt(x);
             accum[j] = x;
         }
@@ -416,12 +564,185 @@ void block_iter(uint64_t *RESTRICT accum, uint64_t *RESTRICT arr,
     }
 } /* block_iter */
 
+#ifdef PLAN_X86_SIMD
+/*
+ * The vector kernels xor and count W columns of the block at a time, keeping
+ * per-lane bit counts for the four rows and summing the lanes once per block.
+ */
+  #define CBA_VECTOR_ITER(W, VEC, ZERO, LOAD, STORE, XOR, ADD, POPC, HSUM)     \
+    for(i = 0; i < niters; i += 4){                                           \
+        VEC x, c0 = ZERO, c1 = ZERO, c2 = ZERO, c3 = ZERO;                    \
+        if(pf && (i + 4 * pf < niters)){                                      \
+            cba_prefetch(arr, out + i + 4 * pf, bs);                          \
+        }                                                                     \
+        s0 = out[i + 0];                                                      \
+        ind0 = s0 >> 48;                                                      \
+        s1 = out[i + 1];                                                      \
+        ind1 = s1 >> 48;                                                      \
+        s2 = out[i + 2];                                                      \
+        ind2 = s2 >> 48;                                                      \
+        s3 = out[i + 3];                                                      \
+        ind3 = s3 >> 48;                                                      \
+        for(j = 0; j + W <= bs; j += W){                               \
+            x = LOAD(accum + j);                                              \
+            x = XOR(x, LOAD(arr + ind0 * bs + j));                     \
+            c0 = ADD(c0, POPC(x));                                            \
+            x = XOR(x, LOAD(arr + ind1 * bs + j));                     \
+            c1 = ADD(c1, POPC(x));                                            \
+            x = XOR(x, LOAD(arr + ind2 * bs + j));                     \
+            c2 = ADD(c2, POPC(x));                                            \
+            x = XOR(x, LOAD(arr + ind3 * bs + j));                     \
+            c3 = ADD(c3, POPC(x));                                            \
+            STORE(accum + j, x);                                              \
+        }                                                                     \
+        s0 += HSUM(c0);                                                       \
+        s1 += HSUM(c1);                                                       \
+        s2 += HSUM(c2);                                                       \
+        s3 += HSUM(c3);                                                       \
+        for(; j < bs; j++){                                            \
+            uint64_t y = accum[j];                                            \
+            y ^= arr[ind0 * bs + j];                                   \
+            s0 += _popcnt(y);                                                 \
+            y ^= arr[ind1 * bs + j];                                   \
+            s1 += _popcnt(y);                                                 \
+            y ^= arr[ind2 * bs + j];                                   \
+            s2 += _popcnt(y);                                                 \
+            y ^= arr[ind3 * bs + j];                                   \
+            s3 += _popcnt(y);                                                 \
+            accum[j] = y;                                                     \
+        }                                                                     \
+        out[i + 0] = s0;                                                      \
+        out[i + 1] = s1;                                                      \
+        out[i + 2] = s2;                                                      \
+        out[i + 3] = s3;                                                      \
+    }
+
+/**
+ * \brief block_iter using the POPCNT instruction.
+ */
+__attribute__((target("popcnt")))
+static
+void block_iter_popcnt(uint64_t *RESTRICT accum, uint64_t *RESTRICT arr,
+                       uint64_t *RESTRICT out, int64_t niters, int64_t bs, int pf){
+    int64_t i, j;
+    uint64_t ind0, ind1, ind2, ind3, s0, s1, s2, s3;
+
+    for(i = 0; i < niters; i += 4){
+        if(pf && (i + 4 * pf < niters)){
+            cba_prefetch(arr, out + i + 4 * pf, bs);
+        }
+        s0 = out[i + 0];
+        ind0 = s0 >> 48;
+        s1 = out[i + 1];
+        ind1 = s1 >> 48;
+        s2 = out[i + 2];
+        ind2 = s2 >> 48;
+        s3 = out[i + 3];
+        ind3 = s3 >> 48;
+
+        for(j = 0; j < bs; j++){
+            uint64_t x = accum[j];
+
+            x ^= arr[ind0 * bs + j];
+            s0 += __builtin_popcountll(x);
+            x ^= arr[ind1 * bs + j];
+            s1 += __builtin_popcountll(x);
+            x ^= arr[ind2 * bs + j];
+            s2 += __builtin_popcountll(x);
+            x ^= arr[ind3 * bs + j];
+            s3 += __builtin_popcountll(x);
+            accum[j] = x;
+        }
+        out[i + 0] = s0;
+        out[i + 1] = s1;
+        out[i + 2] = s2;
+        out[i + 3] = s3;
+    }
+} /* block_iter_popcnt */
+
+/**
+ * \brief Counts the bits in each 64 bit lane with two 16 entry table lookups per byte.
+ */
+__attribute__((target("avx2")))
+static inline __m256i cba_popcnt256(__m256i v){
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i lo, hi;
+
+    lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, nibble));
+    hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+} /* cba_popcnt256 */
+
+/**
+ * \brief Adds the four 64 bit lanes of a vector.
+ */
+__attribute__((target("avx2")))
+static inline uint64_t cba_hsum256(__m256i v){
+    __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return (uint64_t)_mm_cvtsi128_si64(s) + (uint64_t)_mm_extract_epi64(s, 1);
+} /* cba_hsum256 */
+
+  #define CBA_LOAD256(a)     _mm256_loadu_si256((__m256i *)(a))
+  #define CBA_STORE256(a, v) _mm256_storeu_si256((__m256i *)(a), (v))
+
+/**
+ * \brief block_iter for AVX2, 4 columns at a time.
+ */
+__attribute__((target("avx2")))
+static
+void block_iter_avx2(uint64_t *RESTRICT accum, uint64_t *RESTRICT arr,
+                     uint64_t *RESTRICT out, int64_t niters, int64_t bs, int pf){
+    int64_t i, j;
+    uint64_t ind0, ind1, ind2, ind3, s0, s1, s2, s3;
+
+    CBA_VECTOR_ITER(4, __m256i, _mm256_setzero_si256(), CBA_LOAD256, CBA_STORE256,
+                    _mm256_xor_si256, _mm256_add_epi64, cba_popcnt256, cba_hsum256);
+} /* block_iter_avx2 */
+
+  #define CBA_LOAD512(a)     _mm512_loadu_si512((void *)(a))
+  #define CBA_STORE512(a, v) _mm512_storeu_si512((void *)(a), (v))
+
+/**
+ * \brief block_iter for AVX-512 with VPOPCNTQ, 8 columns at a time.
+ */
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static
+void block_iter_avx512(uint64_t *RESTRICT accum, uint64_t *RESTRICT arr,
+                       uint64_t *RESTRICT out, int64_t niters, int64_t bs, int pf){
+    int64_t i, j;
+    uint64_t ind0, ind1, ind2, ind3, s0, s1, s2, s3;
+
+    CBA_VECTOR_ITER(8, __m512i, _mm512_setzero_si512(), CBA_LOAD512, CBA_STORE512,
+                    _mm512_xor_si512, _mm512_add_epi64, _mm512_popcnt_epi64, (uint64_t)_mm512_reduce_add_epi64);
+} /* block_iter_avx512 */
+#endif /* PLAN_X86_SIMD */
+
 /**
  * \brief Operates on the blocked data
+ * \param kernel The popcount kernel to use, see cba_pick_kernel.
+ * \param bs The block size the data was laid out with by blockit.
+ * \param pf The prefetch distance, see block_iter.
  */
 int64_t cnt_bit_arr(uint64_t *arr, int64_t nrow, int64_t ncol, uint64_t *out,
-                    int64_t niters){
+                    int64_t niters, int kernel, int64_t bs, int pf){
     int64_t i;
+    void (*iter)(uint64_t *, uint64_t *, uint64_t *, int64_t, int64_t, int) = block_iter;
+
+    #ifdef PLAN_X86_SIMD
+    switch(kernel){
+        case CBA_POPCNT:
+            iter = block_iter_popcnt;
+            break;
+        case CBA_AVX2:
+            iter = block_iter_avx2;
+            break;
+        case CBA_AVX512:
+            iter = block_iter_avx512;
+            break;
+    }
+    #endif
 
     /* call the rows of the matrix r(0) ... r(ncol-1)
      * let the random row indices (stored in out[])
@@ -430,8 +751,8 @@ int64_t cnt_bit_arr(uint64_t *arr, int64_t nrow, int64_t ncol, uint64_t *out,
      *    and return the number of ones in the result
      */
 
-    for(i = 0; i < ncol; i += BLOCKSIZE){
-        block_iter (&arr[i * nrow], &arr[i * nrow], out, niters);
+    for(i = 0; i < ncol; i += bs){
+        iter (&arr[i * nrow], &arr[i * nrow], out, niters, bs, pf);
     }
 
     for(i = 0; i < niters; i++){
@@ -476,16 +797,17 @@ int64_t cnt_bit_arr_nb(uint64_t *arr, int64_t nrow, int64_t ncol, uint64_t *out,
 /* convert data into blocked format */
 /**
  * \brief Converts the data into a block format
+ * \param bs The block size, which must divide ncol.
  */
-void blockit(uint64_t *data, int64_t nrow, int64_t ncol, uint64_t *work){
+void blockit(uint64_t *data, int64_t nrow, int64_t ncol, uint64_t *work, int64_t bs){
     int64_t b, i, j;
 
     /* loop over blocks */
-    for(b = 0; b < (ncol / BLOCKSIZE); b++){
+    for(b = 0; b < (ncol / bs); b++){
         /* loop over rows in block */
         for(i = 0; i < nrow; i++){
-            for(j = 0; j < BLOCKSIZE; j++){
-                *work++ = data[b * BLOCKSIZE + i * ncol + j];
+            for(j = 0; j < bs; j++){
+                *work++ = data[b * bs + i * ncol + j];
             }
         }
     }
@@ -24,9 +24,13 @@
 #include <brand.h>
 
 /**** From cpu_suite cba.h **********/
-#define BLOCKSIZE    32L            /* MUST be a power of 2
+#define BLOCKSIZE    32L            /* default; MUST be a power of 2
                                      * and <= 64 due to our test params */
-#define NITERS       60 * 64L         /* should be a multiple of 64 */
+#define CBA_MIN_BLOCKSIZE 4L
+#define CBA_MAX_BLOCKSIZE 64L
+#define CBA_SWEEP_SIZES   5         /* SWEEP times block sizes 4, 8, ... 64 */
+#define NITERS       60 * 64L         /* default; should be a multiple of 64 */
+#define CBA_PF_DIST  2              /* default PREFETCH distance, in groups of 4 rows */
 #define PAD          16L
 
 /* restricted pointers */
@@ -71,21 +75,30 @@ static int64_t _popcnt(uint64_t x){
     return x & 0xff;
 }
 
-//#else /* undef USE_POP3 */
-
-/* #define your _popcnt() macro here */
+#endif // ifdef USE_POP3
 
-//#include <nmmintrin.h>
-//#include <x86intrin.h>
-//#define _popcnt(x) _mm_popcnt_u64(x);
+/*
+ * The SWAR code above is the portable kernel. Kernels using the POPCNT
+ * instruction, an AVX2 nibble lookup popcount and the AVX-512 VPOPCNTQ
+ * instruction are built alongside it and one is picked at plan init.
+ */
 
-#endif // ifdef USE_POP3
+/**
+ * \brief Popcount kernels of the CBA plan, in order of preference (a PLAN line may name one).
+ */
+enum {
+    CBA_SWAR,           /**< Portable shift-and-mask popcount (POPCNT3 with USE_POP3).     */
+    CBA_POPCNT,         /**< Scalar POPCNT instruction.                                     */
+    CBA_AVX2,           /**< 4 columns at a time, popcount by nibble table lookup.          */
+    CBA_AVX512,         /**< 8 columns at a time, VPOPCNTQ.                                 */
+    CBA_KERNELS
+};
 
 int64_t cnt_bit_arr(uint64_t *arr, int64_t nrow, int64_t ncol, uint64_t *out,
-                    int64_t niters);
+                    int64_t niters, int kernel, int64_t bs, int pf);
 int64_t cnt_bit_arr_nb(uint64_t *arr, int64_t nrow, int64_t ncol, uint64_t *out,
                        int64_t niters);
-void blockit(uint64_t *data, int64_t nrow, int64_t ncol, uint64_t *work);
+void blockit(uint64_t *data, int64_t nrow, int64_t ncol, uint64_t *work, int64_t bs);
 
 extern void *makeCBAPlan(data *i);
 extern int initCBAPlan(void *p);
@@ -106,6 +119,11 @@ typedef struct {
     int seed;
     int nrows;
     int ncols;
+    int kernel;                 /**< One of CBA_SWAR ... CBA_AVX512, or -1 until init picks the best. */
+    int64_t blocksize;          /**< Columns per block (BLOCKSIZE=).                                 */
+    int64_t batch;              /**< Random rows drawn and processed per timed call (NITERS=).       */
+    int prefetch;               /**< Prefetch distance in groups of 4 rows, 0 for none (PREFETCH=).  */
+    int sweep;                  /**< Time every block size from 4 to 64 on each pass (SWEEP).        */
     brand_t br;
     uint64_t *data, *chk, *work, *out;
 } CBA_data;
@@ -33,6 +33,7 @@
 #else
   #include <mpi.h>
 #endif
+#include <comm.h>
 
 #ifdef HAVE_PAPI
   #define NUM_PAPI_EVENTS 1
@@ -44,9 +45,42 @@
  * \brief Holds the custom error messages for the plan
  */
 char *comm_errs[] = {
-    " MPI error:"
+    " MPI error:",
+    " No communicator for the plan on this thread:",
+    " One-sided transfers need MPI-3 and a thread that may call MPI:"
 };
 
+/**
+ * \brief PLAN line keywords of the message patterns, in the order of the COMM_* pattern enum.
+ */
+static char *comm_patterns[] = {
+    "XOR", "RING", "ALLTOALL", "RANDOM", "HALO"
+};
+
+/**
+ * \brief The timer, and so the performance table column, of each pattern, whichever patterns the plan runs.
+ */
+static const perf_time_index comm_timers[COMM_PATTERNS] = {
+    TIMER0, TIMER1, TIMER2, TIMER3, TIMER4
+};
+
+/**
+ * \brief Names of the transfers, in the order of the COMM_SENDRECV, COMM_PUT and COMM_GET enum.
+ */
+static char *comm_transfers[] = {
+    "SEND", "PUT", "GET"
+};
+
+#ifdef HAVE_SHMEM
+  #if defined(SHMEM_MAJOR_VERSION) && ((SHMEM_MAJOR_VERSION > 1) || (SHMEM_MINOR_VERSION >= 3))
+    #define COMM_SHMEM_PUT shmem_putmem_nbi       /* OpenSHMEM 1.3: completed by shmem_quiet */
+    #define COMM_SHMEM_GET shmem_getmem_nbi
+  #else
+    #define COMM_SHMEM_PUT shmem_putmem
+    #define COMM_SHMEM_GET shmem_getmem
+  #endif
+#endif
+
 /**
  * \brief Finds the next higher power of 2.
  * \param n The limit for the search.
@@ -60,8 +94,239 @@ int comm_ceil2(int n){
     return c;
 }
 
+/**
+ * \brief Steps a xorshift64 generator.
+ * \param x The generator state, which must not be 0.
+ * \returns The next value.
+ */
+static uint64_t comm_random(uint64_t *x){
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+    return *x;
+}
+
+/**
+ * \brief Shapes the ranks into a 3D grid for the HALO pattern, as evenly as their prime factors allow.
+ * \param n The number of ranks.
+ * \param dims Receives the sizes of the grid, whose product is n.
+ */
+static void comm_dims3(int n, int *dims){
+    int f, k, m, factors[32];
+    int nf = 0;
+
+    for(f = 2; (f * f <= n) && (nf < 31); f++){
+        while((n % f == 0) && (nf < 31)){
+            factors[nf++] = f;
+            n /= f;
+        }
+    }
+    if(n > 1){
+        factors[nf++] = n;
+    }
+    dims[0] = dims[1] = dims[2] = 1;
+    for(k = nf - 1; k >= 0; k--){         // largest factors first, each to the smallest side
+        m = (dims[1] < dims[0]) ? 1 : 0;
+        m = (dims[2] < dims[m]) ? 2 : m;
+        dims[m] *= factors[k];
+    }
+} /* comm_dims3 */
+
+/**
+ * \brief Lists the partners of this rank for one execution of a pattern.
+ * Every rank builds the lists the same way, so message j from a rank is received as message j by its partner.
+ * \param d The plan data, whose sendto, recvfrom and npairs are set.
+ * \param pattern One of the COMM_* patterns.
+ */
+static void comm_partners(COMMdata *d, int pattern){
+    int i, j, t, axis, dir, step, c[3], x[3];
+    int n = d->NumRanks;
+    int me = d->ThisRankID;
+
+    d->npairs = 0;
+    switch(pattern){
+    case COMM_XOR:
+        d->istage = (d->NumStages > 1) ? (d->istage % (d->NumStages - 1)) + 1 : 0;
+        if(((me ^ d->istage) < n) && ((me ^ d->istage) != me)){
+            d->sendto[0] = d->recvfrom[0] = me ^ d->istage;
+            d->npairs = 1;
+        }
+        break;
+    case COMM_RING:
+        if(n > 1){
+            d->sendto[0] = (me + 1) % n;
+            d->recvfrom[0] = (me + n - 1) % n;
+            d->npairs = 1;
+        }
+        break;
+    case COMM_ALLTOALL:
+        for(j = 1; j < n; j++){
+            d->sendto[d->npairs] = (me + j) % n;
+            d->recvfrom[d->npairs] = (me + n - j) % n;
+            d->npairs++;
+        }
+        break;
+    case COMM_RANDOM:
+        for(i = 0; i < n; i++){
+            d->perm[i] = i;
+        }
+        for(i = n - 1; i > 0; i--){
+            j = comm_random(&(d->perm_seed)) % (i + 1);
+            t = d->perm[i];
+            d->perm[i] = d->perm[j];
+            d->perm[j] = t;
+        }
+        if(d->perm[me] != me){
+            d->sendto[0] = d->perm[me];
+            for(i = 0; d->perm[i] != me; i++){
+            }
+            d->recvfrom[0] = i;
+            d->npairs = 1;
+        }
+        break;
+    case COMM_HALO:
+        c[0] = me % d->dims[0];
+        c[1] = (me / d->dims[0]) % d->dims[1];
+        c[2] = me / (d->dims[0] * d->dims[1]);
+        for(axis = 0; axis < 3; axis++){
+            if(d->dims[axis] < 2){
+                continue;
+            }
+            for(dir = 0; dir < 2; dir++){           // one face each way, both to the same neighbour if the side is 2
+                step = dir ? d->dims[axis] - 1 : 1;
+                memcpy(x, c, sizeof(x));
+                x[axis] = (c[axis] + step) % d->dims[axis];
+                d->sendto[d->npairs] = x[0] + d->dims[0] * (x[1] + d->dims[1] * x[2]);
+                x[axis] = (c[axis] + d->dims[axis] - step) % d->dims[axis];
+                d->recvfrom[d->npairs] = x[0] + d->dims[0] * (x[1] + d->dims[1] * x[2]);
+                d->npairs++;
+            }
+        }
+        break;
+    }
+} /* comm_partners */
+
+/**
+ * \brief Keeps a latency in the reservoir of a pattern and message size.
+ * \param d The plan data.
+ * \param s The statistics of the pattern and size.
+ * \param seconds The latency.
+ */
+static void comm_sample(COMMdata *d, COMMstats *s, double seconds){
+    uint64_t r;
+    if(s->nsamples < COMM_SAMPLES){
+        s->sample[s->nsamples] = seconds;
+    } else {
+        r = comm_random(&(d->sample_seed)) % (s->nsamples + 1);
+        if(r < COMM_SAMPLES){
+            s->sample[r] = seconds;
+        }
+    }
+    s->nsamples++;
+} /* comm_sample */
+
+#ifndef HAVE_SHMEM
+/*
+ * A plan on a funnelled lane (a worker, when MPI does not grant MPI_THREAD_MULTIPLE) may not call MPI, so these
+ * hand its operations to the scheduler instead; see comm_funnel_post in comm.c.
+ * d->requests holds 2 * window CommOps, then as many MPI_Requests, then the indices for Waitsome.
+ */
+
+/**
+ * \brief Sums a vote of every rank's plan over the lane.
+ * \param d The plan data.
+ * \param vote This rank's vote.
+ * \param sum Receives the sum of the votes.
+ * \returns An MPI error code.
+ */
+static int comm_vote(COMMdata *d, int vote, int *sum){
+    CommLane *lane = (CommLane *)d->comm;
+    CommOp op;
+    int index;
+    if(lane->funnel){
+        op.kind = COMM_OP_SUM;
+        op.buf = &vote;
+        op.result = sum;
+        op.count = SINGLE;
+        op.lane = lane;
+        comm_funnel_post(&op);
+        comm_funnel_waitsome(&op, SINGLE, &index);
+        return MPI_SUCCESS;
+    }
+    return MPI_Allreduce(&vote, sum, SINGLE, MPI_INT, MPI_SUM, lane->comm);
+} /* comm_vote */
+
+/**
+ * \brief Starts a message of a window.
+ * \param d The plan data.
+ * \param i The request slot: the receives take 0 to window-1, the sends window to 2*window-1.
+ * \param kind COMM_OP_SEND or COMM_OP_RECV.
+ * \param buf The message.
+ * \param len Its length in bytes.
+ * \param peer The rank sent to or received from.
+ * \param tag The message tag.
+ * \returns An MPI error code.
+ */
+static int comm_start(COMMdata *d, int i, int kind, char *buf, size_t len, int peer, int tag){
+    CommLane *lane = (CommLane *)d->comm;
+    CommOp *op = (CommOp *)d->requests + i;
+    MPI_Request *req = (MPI_Request *)((CommOp *)d->requests + 2 * d->window);
+    if(lane->funnel){
+        op->kind = kind;
+        op->buf = buf;
+        op->count = len;
+        op->peer = peer;
+        op->tag = tag;
+        op->lane = lane;
+        comm_funnel_post(op);
+        return MPI_SUCCESS;
+    }
+    if(kind == COMM_OP_RECV){
+        return MPI_Irecv(buf, len, MPI_BYTE, peer, tag, lane->comm, &req[i]);
+    }
+    return MPI_Isend(buf, len, MPI_BYTE, peer, tag, lane->comm, &req[i]);
+} /* comm_start */
+
+/**
+ * \brief Waits for some of the messages of a window, like MPI_Waitsome.
+ * \param d The plan data.
+ * \param done Receives the number of messages completed, MPI_UNDEFINED once all are.
+ * \param index Receives their request slots.
+ * \returns An MPI error code.
+ */
+static int comm_waitsome(COMMdata *d, int *done, int *index){
+    MPI_Request *req = (MPI_Request *)((CommOp *)d->requests + 2 * d->window);
+    int err;
+    if(((CommLane *)d->comm)->funnel){
+        *done = comm_funnel_waitsome((CommOp *)d->requests, 2 * d->window, index);
+        return MPI_SUCCESS;
+    }
+    /* the -c plan runs on the scheduler, which the workers' funnelled plans wait on */
+    while(d->poll && comm_funnel_poll()){
+        err = MPI_Testsome(2 * d->window, req, done, index, MPI_STATUSES_IGNORE);
+        if((err != MPI_SUCCESS) || (*done != 0)){
+            return err;
+        }
+    }
+    return MPI_Waitsome(2 * d->window, req, done, index, MPI_STATUSES_IGNORE);
+} /* comm_waitsome */
+#endif /* ifndef HAVE_SHMEM */
+
+/**
+ * \brief Sorts latencies, for qsort.
+ */
+static int comm_compare(const void *a, const void *b){
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
 /**
  * \brief Allocates and returns the data struct for the plan
+ * The PLAN line (or the -c option) gives the largest message size, then optionally the patterns to take turns
+ * (XOR, RING, ALLTOALL, RANDOM, HALO; XOR by default), WINDOW=n messages in flight, MESSAGES=n per execution,
+ * SWEEP to run every power of 2 message size from COMM_MIN_SIZE up to the largest, and PUT or GET to move the
+ * messages one-sided (with MPI, through an MPI-3 window under a passive target lock) instead of sending them.
  * \param dp The input data for the plan.
  * \return void* Data struct
  * \sa parseCommPlan
@@ -73,6 +338,9 @@ int comm_ceil2(int n){
 void *makeCommPlan(data *dp){
     Plan *p;
     COMMdata *ip;
+    char *value;
+    size_t len;
+    int k;
     p = (Plan *)malloc(sizeof(Plan));
     assert(p);
     if(p){
@@ -84,7 +352,42 @@ void *makeCommPlan(data *dp){
         ip = (COMMdata *)malloc(sizeof(COMMdata));
         assert(ip);
         if(ip){
-            ip->buflen = dp->i[0] / 2;
+            memset(ip, 0, sizeof(COMMdata));
+            if(dp->dsize > 0){
+                ip->buflen = dp->d[0];
+            } else if(dp->isize > 0){
+                ip->buflen = dp->i[0];
+            }
+            if(ip->buflen < 1){
+                ip->buflen = 1;
+            }
+            for(k = 0; k < COMM_PATTERNS; k++){
+                if(plan_has_token(dp, comm_patterns[k])){
+                    ip->pattern[ip->npatterns++] = k;
+                }
+            }
+            if(ip->npatterns == 0){
+                ip->pattern[ip->npatterns++] = COMM_XOR;
+            }
+            ip->window = COMM_WINDOW;
+            if((value = plan_token_value(dp, "WINDOW")) != NULL && atoi(value) > 0){
+                ip->window = atoi(value);
+            }
+            ip->NumMessages = COMM_MESSAGES;
+            if((value = plan_token_value(dp, "MESSAGES")) != NULL && atoi(value) > 0){
+                ip->NumMessages = atoi(value);
+            }
+            #ifdef HAVE_SHMEM
+            ip->transfer = plan_has_token(dp, "GET") ? COMM_GET : COMM_PUT;
+            #else
+            ip->transfer = plan_has_token(dp, "PUT") ? COMM_PUT : (plan_has_token(dp, "GET") ? COMM_GET : COMM_SENDRECV);
+            #endif
+            if(plan_has_token(dp, "SWEEP")){
+                for(len = COMM_MIN_SIZE; (len < ip->buflen) && (ip->nsizes < COMM_SIZES - 1); len *= 2){
+                    ip->size[ip->nsizes++] = len;
+                }
+            }
+            ip->size[ip->nsizes++] = ip->buflen;
             (p->vptr) = (void *)ip;
         }
     }
@@ -105,7 +408,7 @@ void *makeCommPlan(data *dp){
  * \sa killCommPlan
  */
 int initCommPlan(void *plan){
-    int i, ierr, NumRanks, ThisRankID;
+    int i, j, ierr, NumRanks, ThisRankID;
     size_t buflen;
     int ret = make_error(ALLOC,generic_err);
     Plan *p;
@@ -154,11 +457,41 @@ int initCommPlan(void *plan){
     buflen = d->buflen;
     ierr = 0;
     #ifdef HAVE_SHMEM
+    if(p->worker != SCHEDULER_THREAD){
+        EmitLog(MyRank, p->worker, "COMM plans only run on workers with MPI, use -c with SHMEM.", -1, PRINT_ALWAYS);
+        return make_error(1,specific_err);
+    }
     NumRanks = SHMEM_NUM_PES;
     ThisRankID = SHMEM_MY_PE;
     #else // MPI
-    ierr += MPI_Comm_size(MPI_COMM_WORLD, &NumRanks);
-    ierr += MPI_Comm_rank(MPI_COMM_WORLD, &ThisRankID);
+    d->comm = comm_lane_open(p->worker);
+    if(d->comm == NULL){
+        return make_error(1,specific_err);                // no lane for this worker
+    }
+    NumRanks = ((CommLane *)d->comm)->size;
+    ThisRankID = ((CommLane *)d->comm)->rank;
+    d->poll = (p->worker == SCHEDULER_THREAD);
+    if(d->transfer != COMM_SENDRECV){
+        /* collective over the lane: every rank gets here, as all or none of them are funnelled */
+        #if MPI_VERSION >= 3
+        if(((CommLane *)d->comm)->funnel){
+            return make_error(2,specific_err);            // only the scheduler may call MPI
+        }
+        d->win = malloc(sizeof(MPI_Win));
+        if(d->win == NULL){
+            return ret;
+        }
+        ierr += MPI_Win_allocate(buflen * d->window, 1, MPI_INFO_NULL, ((CommLane *)d->comm)->comm, &(d->recvbufptr), (MPI_Win *)d->win);
+        if(ierr != 0){
+            free(d->win);
+            d->win = NULL;
+            return make_error(0,specific_err);            // MPI error
+        }
+        ierr += MPI_Win_lock_all(MPI_MODE_NOCHECK, *(MPI_Win *)d->win);
+        #else
+        return make_error(2,specific_err);                // no MPI-3 RMA
+        #endif
+    }
     #endif
     if(ierr != 0){
         return make_error(0,specific_err);                // MPI error
@@ -166,19 +499,44 @@ int initCommPlan(void *plan){
     d->NumRanks = NumRanks;
     d->ThisRankID = ThisRankID;
     d->NumStages = comm_ceil2(NumRanks);
-    d->NumMessages = 50000;
+    d->done = 0;
     d->istage = 0;
+    d->ipattern = 0;
+    d->isize = 0;
+    d->perm_seed = 0x9E3779B97F4A7C15ULL;
+    d->sample_seed = 0x9E3779B97F4A7C15ULL * (ThisRankID + 1);
+    comm_dims3(NumRanks, d->dims);
+
+    /* partners: all other ranks for ALLTOALL, at most 6 for HALO */
+    d->sendto = (int *)malloc((NumRanks + 6) * sizeof(int));
+    d->recvfrom = (int *)malloc((NumRanks + 6) * sizeof(int));
+    d->perm = (int *)malloc(NumRanks * sizeof(int));
+    d->sendbufptr = (char *)malloc(buflen * d->window);
     #ifdef HAVE_SHMEM
-    d->sendbufptr = (char *)shmalloc(buflen);
+    d->requests = NULL;
+    d->recvbufptr = (char *)shmalloc(buflen * d->window);
     #else // MPI
-    d->sendbufptr = (char *)malloc(buflen);
+    d->requests = calloc(2 * d->window, sizeof(CommOp) + sizeof(MPI_Request) + sizeof(int));
+    if(d->win == NULL){
+        d->recvbufptr = (char *)malloc(buflen * d->window);
+    }
     #endif
-    d->recvbufptr = (char *)malloc(buflen);
-    if( d->sendbufptr  && d->recvbufptr ){
-        for(i = 0; i < buflen; i++){
-            (d->sendbufptr)[i] = 0;
-            (d->recvbufptr)[i] = 0;
+    for(i = 0; i < d->npatterns; i++){
+        for(j = 0; j < d->nsizes; j++){
+            d->stats[d->pattern[i]][j].sample = (float *)malloc(COMM_SAMPLES * sizeof(float));
+            if(d->stats[d->pattern[i]][j].sample == NULL){
+                return ret;
+            }
         }
+    }
+    if( d->sendbufptr  && d->recvbufptr && d->sendto && d->recvfrom && d->perm ){
+        #ifndef HAVE_SHMEM
+        if(d->requests == NULL){
+            return ret;
+        }
+        #endif
+        memset(d->sendbufptr, 0, buflen * d->window);
+        memset(d->recvbufptr, 0, buflen * d->window);
         ret = ERR_CLEAN;
     }
     return ret;
@@ -189,6 +547,11 @@ int initCommPlan(void *plan){
  ***********************/
 /**
  * \brief Where the plan is executed
+ * Each execution runs one pattern at one message size, the next size (then the next pattern) on the next execution.
+ * The messages go out in windows of d->window in flight; the latency of a message is the time from posting its
+ * window to its arrival, or for one-sided transfers (and SHMEM) to the completion of its window.
+ * The plans of all ranks on the same lane pair their messages; each pass starts by checking that all of them are
+ * still running, and once one has been killed the others stop (see killCommPlan).
  * \param [in] plan The data and memory location for the plan.
  * \return int Error flag value
  * \sa parseCommPlan
@@ -203,82 +566,119 @@ int execCommPlan(void *plan){
     long long start, end;
     #endif //HAVE_PAPI
 
-    int thatRankID, i;
-    ORB_t t1, t2;
+    int i, j, n, pattern, messages, total, sent;
+    size_t len;
+    ORB_t t1, t2, tw;
     Plan *p;
     COMMdata *d;
+    COMMstats *s;
     p = (Plan *)plan;
     d = (COMMdata *)p->vptr;
-    thatRankID = d->ThisRankID ^ d->istage;
+
+    pattern = d->pattern[d->ipattern];
+    len = d->size[d->isize];
+    s = &(d->stats[pattern][d->isize]);
+    d->isize++;
+    if(d->isize == d->nsizes){
+        d->isize = 0;
+        d->ipattern = (d->ipattern + 1) % d->npatterns;
+    }
+    comm_partners(d, pattern);
+    messages = (d->npairs > 0) ? d->NumMessages / d->npairs : 0;
+    if((d->npairs > 0) && (messages < 1)){
+        messages = 1;
+    }
+    total = messages * d->npairs;
+
     #ifdef HAVE_SHMEM
-    static int sync;
-    int other;
-    sync = MyRank;
     shmem_barrier_all();
-    if((thatRankID < d->NumRanks) && (thatRankID != d->ThisRankID)){
+    #else
+    int ierr = 0;
+    int done, live;
+    MPI_Request *req = (MPI_Request *)((CommOp *)d->requests + 2 * d->window);
+    int *index = (int *)(req + 2 * d->window);
+
+    /* The plans of all ranks agree to run this pass, or stop for good if any of them has been killed. */
+    if(d->done){
+        return ERR_CLEAN;
+    }
+    ierr += comm_vote(d, 1, &live);
+    if(live < d->NumRanks){
+        d->done = 1;
+        return ERR_CLEAN;
+    }
+    #endif
+    if(total > 0){
         /* update execution count */
         p->exec_count++;
 
+        #ifdef HAVE_PAPI
         if(DO_PERF){
-            #ifdef HAVE_PAPI
             /* Start PAPI counters and time */
             TEST_PAPI(PAPI_reset(p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
             start = PAPI_get_real_usec();
-            #endif //HAVE_PAPI
-
-            ORB_read(t1);
-        }         //DO_PERF
-        for(i = 0; i < d->NumMessages; i++){
-            shmem_getmem(d->recvbufptr, d->sendbufptr, d->buflen, thatRankID);
         }
+        #endif //HAVE_PAPI
 
-        //shmem_int_p(&sync, d->ThisRankID, thatRankID);
-        other = shmem_int_swap(&sync, d->ThisRankID, thatRankID);         // Replaced because swap is atomic.
-        // If wanted to check, could compare other to thatRankID (should be equal).
-        shmem_int_wait_until(&sync, SHMEM_CMP_EQ, thatRankID);
-        sync = d->ThisRankID;
-        if(DO_PERF){
+        ORB_read(t1);
+        for(sent = 0; sent < total; sent += n){
+            n = (total - sent < d->window) ? total - sent : d->window;
+            ORB_read(tw);
+            #ifdef HAVE_SHMEM
+            for(i = 0; i < n; i++){
+                j = (sent + i) / messages;
+                if(d->transfer == COMM_GET){
+                    COMM_SHMEM_GET(d->sendbufptr + i * len, d->recvbufptr + i * len, len, d->recvfrom[j]);
+                } else {
+                    COMM_SHMEM_PUT(d->recvbufptr + i * len, d->sendbufptr + i * len, len, d->sendto[j]);
+                }
+            }
+            shmem_quiet();
             ORB_read(t2);
-
-            #ifdef HAVE_PAPI
-            end = PAPI_get_real_usec();             //PAPI time
-
-            /* Collect PAPI counters and store time elapsed */
-            TEST_PAPI(PAPI_accum(p->PAPI_EventSet, p->PAPI_Results), PAPI_OK, MyRank, 9999, PRINT_SOME);
-            for(k = 0; k < p->PAPI_Num_Events && k < TOTAL_PAPI_EVENTS; k++){
-                p->PAPI_Times[k] += (end - start);
+            comm_sample(d, s, ORB_seconds(t2, tw));
+            #else // MPI
+            #if MPI_VERSION >= 3
+            if(d->win != NULL){
+                for(i = 0; i < n; i++){
+                    j = (sent + i) / messages;
+                    if(d->transfer == COMM_GET){
+                        ierr += MPI_Get(d->sendbufptr + i * len, len, MPI_BYTE, d->recvfrom[j], i * len, len, MPI_BYTE, *(MPI_Win *)d->win);
+                    } else {
+                        ierr += MPI_Put(d->sendbufptr + i * len, len, MPI_BYTE, d->sendto[j], i * len, len, MPI_BYTE, *(MPI_Win *)d->win);
+                    }
+                }
+                ierr += MPI_Win_flush_all(*(MPI_Win *)d->win);
+                ORB_read(t2);
+                comm_sample(d, s, ORB_seconds(t2, tw));
+                continue;
             }
-            #endif //HAVE_PAPI
-
-            perftimer_accumulate(&p->timers, TIMER0, ORB_cycles_a(t2, t1));
-        }         //DO_PERF
-    }
-    shmem_barrier_all();
-    #else // MPI
-    int ierr;
-    MPI_Status mpistatus;
-    if((thatRankID < d->NumRanks) && (thatRankID != d->ThisRankID)){
-        ierr = 0;
-        /* update execution count */
-        p->exec_count++;
-
-        if(DO_PERF){
-            #ifdef HAVE_PAPI
-            /* Start PAPI counters and time */
-            TEST_PAPI(PAPI_reset(p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
-            start = PAPI_get_real_usec();
-            #endif //HAVE_PAPI
-
-            ORB_read(t1);
-        }         //DO_PERF
-        for(i = 0; i < d->NumMessages; i++){
-            ierr += MPI_Sendrecv(d->sendbufptr, d->buflen, MPI_BYTE, thatRankID, 0,
-                                 d->recvbufptr, d->buflen, MPI_BYTE, thatRankID, 0,
-                                 MPI_COMM_WORLD, &mpistatus);
+            #endif
+            for(i = 0; i < 2 * d->window; i++){
+                req[i] = MPI_REQUEST_NULL;
+            }
+            for(i = 0; i < n; i++){
+                j = (sent + i) / messages;
+                ierr += comm_start(d, i, COMM_OP_RECV, d->recvbufptr + i * len, len, d->recvfrom[j], j & 0x7fff);
+                ierr += comm_start(d, d->window + i, COMM_OP_SEND, d->sendbufptr + i * len, len, d->sendto[j], j & 0x7fff);
+            }
+            do {
+                ierr += comm_waitsome(d, &done, index);
+                if(done == MPI_UNDEFINED){
+                    break;
+                }
+                ORB_read(t2);
+                for(i = 0; i < done; i++){
+                    if(index[i] < d->window){
+                        comm_sample(d, s, ORB_seconds(t2, tw));
+                    }
+                }
+            } while(1);
+            #endif /* ifdef HAVE_SHMEM */
         }
+        ORB_read(t2);
+        s->bytes += (uint64_t)total * len;
+        s->seconds += ORB_seconds(t2, t1);
         if(DO_PERF){
-            ORB_read(t2);
-
             #ifdef HAVE_PAPI
             end = PAPI_get_real_usec();     //PAPI time
 
@@ -289,19 +689,23 @@ int execCommPlan(void *plan){
             }
             #endif //HAVE_PAPI
 
-            perftimer_accumulate(&p->timers, TIMER0, ORB_cycles_a(t2,t1));
+            perftimer_accumulate(&p->timers, comm_timers[pattern], ORB_cycles_a(t2, t1));
         }         //DO_PERF
-        if(ierr != 0){
-            return make_error(0,specific_err);                    // MPI error
-        }
     }
-    #endif /* ifdef HAVE_SHMEM */
-    d->istage = (d->istage + 1) % d->NumStages;
+    #ifdef HAVE_SHMEM
+    shmem_barrier_all();
+    #else
+    if(ierr != 0){
+        return make_error(0,specific_err);                    // MPI error
+    }
+    #endif
     return ERR_CLEAN;
 } /* execCommPlan */
 
 /**
  * \brief Calculates (and optionally displays) performance data for the plan.
+ * Each pattern's bandwidth goes under its own timer; the log also has the bandwidth and the median, 90th and 99th
+ * percentile latency of each pattern at each message size.
  * \param [in] plan The Plan structure that contains all the plan data.
  * \returns An integer error code.
  * \sa parseCommPlan
@@ -312,15 +716,40 @@ int execCommPlan(void *plan){
  */
 int perfCommPlan(void *plan){
     int ret = ~ERR_CLEAN;
+    int i, k, pattern, n;
     uint64_t opcounts[NUM_TIMERS];
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+    char buffer[MSG_SIZE];
+    float *q;
     Plan *p;
     COMMdata *d;
+    COMMstats *s;
     p = (Plan *)plan;
     d = (COMMdata *)p->vptr;
     if(p->exec_count > 0){
-        opcounts[TIMER0] = (uint64_t)d->NumMessages * (uint64_t)d->buflen * p->exec_count;         // Count # of bits transferred.
-        opcounts[TIMER1] = 0;
-        opcounts[TIMER2] = 0;
+        memset(opcounts, 0, sizeof(opcounts));
+        for(i = 0; i < d->npatterns; i++){
+            pattern = d->pattern[i];
+            for(k = 0; k < d->nsizes; k++){
+                s = &(d->stats[pattern][k]);
+                opcounts[comm_timers[pattern]] += s->bytes;
+                bytes += s->bytes;
+                seconds += s->seconds;
+                if(s->seconds <= 0.0){
+                    continue;
+                }
+                snprintf(buffer, MSG_SIZE, "COMM %-4s %-8s %9zu B bandwidth:", comm_transfers[d->transfer], comm_patterns[pattern], d->size[k]);
+                EmitLogfs(MyRank, 9999, buffer, ((double)s->bytes / s->seconds) / 1e6, "MB/s", PRINT_SOME);
+                n = (s->nsamples < COMM_SAMPLES) ? s->nsamples : COMM_SAMPLES;
+                if(n > 0){
+                    q = s->sample;
+                    qsort(q, n, sizeof(float), comm_compare);
+                    snprintf(buffer, MSG_SIZE, "COMM %-4s %-8s %9zu B latency p50/p90/p99 (us):", comm_transfers[d->transfer], comm_patterns[pattern], d->size[k]);
+                    EmitLog3f(MyRank, 9999, buffer, 1e6 * q[(n - 1) / 2], 1e6 * q[(9 * (n - 1)) / 10], 1e6 * q[(99 * (n - 1)) / 100], PRINT_SOME);
+                }
+            }
+        }
 
         perf_table_update(&p->timers, opcounts, p->name);
 
@@ -328,8 +757,7 @@ int perfCommPlan(void *plan){
         PAPI_table_update(p->name, p->PAPI_Results, p->PAPI_Times, p->PAPI_Num_Events);
         #endif //HAVE_PAPI
 
-        double mbps = (((double)opcounts[TIMER0]) / perftimer_gettime(&p->timers, TIMER0)) / 1e6;
-        EmitLogfs(MyRank, 9999, "COMM plan performance:", mbps, "MB/s", PRINT_SOME);
+        EmitLogfs(MyRank, 9999, "COMM plan performance:", ((double)bytes / seconds) / 1e6, "MB/s", PRINT_SOME);
         EmitLog  (MyRank, 9999, "COMM execution count :", p->exec_count, PRINT_SOME);
         ret = ERR_CLEAN;
     }
@@ -349,6 +777,7 @@ int perfCommPlan(void *plan){
  * \sa perfCommPlan
  */
 void *killCommPlan(void *plan){
+    int i, k;
     Plan *p;
     COMMdata *d;
     p = (Plan *)plan;
@@ -361,17 +790,41 @@ void *killCommPlan(void *plan){
     }     //DO_PERF
 
     #ifdef HAVE_SHMEM
-    if(d->sendbufptr){
-        shfree((void *)(d->sendbufptr));
+    if(d->recvbufptr){
+        shfree((void *)(d->recvbufptr));
     }
     #else // MPI
-    if(d->sendbufptr){
-        free((void *)(d->sendbufptr));
+    int live;
+    if(d->comm != NULL){
+        if(!(d->done)){                                 // tell the other ranks' plans, in the pass they are about to run
+            comm_vote(d, 0, &live);
+        }
+        comm_lane_close(d->comm);
+    }
+    #if MPI_VERSION >= 3
+    if(d->win != NULL){                                 // collective, frees recvbufptr too
+        MPI_Win_unlock_all(*(MPI_Win *)d->win);
+        MPI_Win_free((MPI_Win *)d->win);
+        free(d->win);
+        d->recvbufptr = NULL;
     }
     #endif
     if(d->recvbufptr){
         free((void *)(d->recvbufptr));
     }
+    #endif
+    if(d->sendbufptr){
+        free((void *)(d->sendbufptr));
+    }
+    for(i = 0; i < COMM_PATTERNS; i++){
+        for(k = 0; k < COMM_SIZES; k++){
+            free(d->stats[i][k].sample);
+        }
+    }
+    free(d->requests);
+    free(d->sendto);
+    free(d->recvfrom);
+    free(d->perm);
     free((void *)(d));
     free((void *)(p));
     return (void *)NULL;
@@ -403,12 +856,12 @@ int parseCommPlan(char *line, LoadPlan *output){
 plan_info COMM_info = {
     "COMM",
     comm_errs,
-    1,
+    3,
     makeCommPlan,
     parseCommPlan,
     execCommPlan,
     initCommPlan,
     killCommPlan,
     perfCommPlan,
-    { "B/s", NULL, NULL }
+    { "B/s XOR", "B/s Ring", "B/s A2A", "B/s Rand", "B/s Halo", NULL }
 };
@@ -29,18 +29,71 @@ extern void *killCommPlan(void *p);                     // <- Change Comm to you
 extern int parseCommPlan(char *line, LoadPlan *output);         // <- Change Comm to your module's name.
 extern plan_info COMM_info;
 
+/* message patterns, each reported under its own timer */
+enum {
+    COMM_XOR,           /**< Pairwise exchange with rank ^ stage, the stage moving on each execution.   */
+    COMM_RING,          /**< Send to the next rank, receive from the previous one.                   */
+    COMM_ALLTOALL,      /**< Exchange with every other rank.                                         */
+    COMM_RANDOM,        /**< Send along a random permutation of the ranks, new on each execution.    */
+    COMM_HALO,          /**< Exchange with the six neighbours in a periodic 3D grid of the ranks.    */
+    COMM_PATTERNS
+};
+
+/* how the messages are moved */
+enum {
+    COMM_SENDRECV,      /**< Nonblocking send and receive (MPI only, the MPI default).                */
+    COMM_PUT,           /**< One-sided put into the partner's message slots (the SHMEM default).     */
+    COMM_GET            /**< One-sided get from the partner's message slots.                         */
+};
+
+#define COMM_MESSAGES 50000     /* default messages per execution, shared among the partners   */
+#define COMM_WINDOW   16        /* default messages in flight                                   */
+#define COMM_SIZES    32        /* most message sizes in a SWEEP                                */
+#define COMM_MIN_SIZE 8         /* smallest message of a SWEEP                                  */
+#define COMM_SAMPLES  1024      /* latency samples kept for each pattern and message size       */
+
+/**
+ * \brief Traffic of one pattern at one message size.
+ */
+typedef struct {
+    uint64_t bytes;             /**< Bytes sent.                                                */
+    double   seconds;           /**< Time spent sending them.                                   */
+    uint64_t nsamples;          /**< Latencies seen, of which up to COMM_SAMPLES are kept.      */
+    float   *sample;            /**< Reservoir of latencies in seconds.                         */
+} COMMstats;
+
 /**
  * \brief The data structure for the plan. Holds the input and all used info.
  */
 typedef struct {
-    size_t   buflen;
+    size_t   buflen;            /**< Largest message size.                                      */
     int   NumRanks;
     int   ThisRankID;
     int   NumStages;
-    int   NumMessages;
+    int   NumMessages;          /**< Messages per execution, shared among the partners.         */
     int   istage;
-    char *sendbufptr;
-    char *recvbufptr;
+    int   window;               /**< Messages in flight.                                        */
+    int   npatterns;            /**< Patterns to take turns, each for one execution per size.   */
+    int   pattern[COMM_PATTERNS];
+    int   ipattern;
+    int   nsizes;               /**< Message sizes, buflen alone unless SWEEP.                  */
+    size_t size[COMM_SIZES];
+    int   isize;
+    int   dims[3];              /**< Shape of the HALO grid.                                    */
+    int   npairs;               /**< Partners of the current execution: message j goes to       */
+    int  *sendto, *recvfrom;    /**< sendto[j] while the one from recvfrom[j] comes in.         */
+    int  *perm;                 /**< Permutation of the ranks for RANDOM.                       */
+    uint64_t perm_seed;         /**< Same on all ranks, so they agree on the permutation.      */
+    uint64_t sample_seed;
+    void *comm;                 /**< The CommLane of the plan, see comm_lane_open.              */
+    int   poll;                 /**< Set for the -c plan, which carries funnelled plans on as it waits. */
+    int   done;                 /**< Set once the plan of some rank has been killed.            */
+    void *requests;             /**< Window slots: CommOps, MPI_Requests, then indices (MPI only). */
+    int   transfer;             /**< COMM_SENDRECV, COMM_PUT or COMM_GET.                       */
+    void *win;                  /**< MPI_Win exposing recvbufptr, for COMM_PUT and COMM_GET (MPI only). */
+    char *sendbufptr;           /**< Local message slots, one per message in flight.            */
+    char *recvbufptr;           /**< Message slots the partners send, put to or get from.       */
+    COMMstats stats[COMM_PATTERNS][COMM_SIZES];
 } COMMdata;
 
 extern char *comm_errs[];
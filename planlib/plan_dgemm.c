@@ -144,11 +144,11 @@ int initDGEMMPlan(void *plan){
 
 //		EmitLog(MyRank,11,"Allocating 1000*",((sizeof(double)*M)*M*3)/1000,0);
 
-        d->A = (double *)malloc((sizeof(double) * M) * M);
+        d->A = (double *)plan_alloc(p, (sizeof(double) * M) * M);
         assert(d->A);
-        d->B = (double *)malloc((sizeof(double) * M) * M);
+        d->B = (double *)plan_alloc(p, (sizeof(double) * M) * M);
         assert(d->B);
-        d->C = (double *)malloc((sizeof(double) * M) * M);
+        d->C = (double *)plan_alloc(p, (sizeof(double) * M) * M);
         assert(d->C);
 
         if(d->A && d->B && d->C){
@@ -187,13 +187,13 @@ void *killDGEMMPlan(void *plan){
     }     //DO_PERF
 
     if(d->C){
-        free((void *)(d->C));
+        plan_free((void *)(d->C));
     }
     if(d->B){
-        free((void *)(d->B));
+        plan_free((void *)(d->B));
     }
     if(d->A){
-        free((void *)(d->A));
+        plan_free((void *)(d->A));
     }
 
     free((void *)(d));
@@ -21,6 +21,16 @@
 #include <systemheaders.h>
 #include <systemburn.h>
 #include <planheaders.h>
+#ifdef PLAN_X86_SIMD
+  #include <immintrin.h>
+#endif
+
+/* chosen so that a = b + s * c, with b = s * a and c = a + b, leaves a unchanged: s * (2 + s) = 1 */
+#define DSTREAM_SCALAR 0.41421356237309504880
+
+static char *dstream_kernels[] = {
+    "Copy", "Scale", "Add", "Triad"
+};
 
 #ifdef HAVE_PAPI
   #define NUM_PAPI_EVENTS 4
@@ -28,6 +38,173 @@
   #define PAPI_UNITS { "FLOPS", "CYCS", "FLIPS", "TEST" }
 #endif //HAVE_PAPI
 
+/**
+ * \brief Runs one STREAM kernel in plain C.
+ * \param k The kernel, STREAM_COPY, STREAM_SCALE, STREAM_ADD or STREAM_TRIAD.
+ * \param dst The array written.
+ * \param x The first array read.
+ * \param y The second array read (Add and Triad only).
+ * \param s The scalar.
+ * \param n The number of elements.
+ */
+static void DStreamKernel(int k, double *dst, double *x, double *y, double s, size_t n){
+    size_t i;
+    switch(k){
+    case STREAM_COPY:
+        for(i = 0; i < n; i++){
+            dst[i] = x[i];
+        }
+        break;
+    case STREAM_SCALE:
+        for(i = 0; i < n; i++){
+            dst[i] = s * x[i];
+        }
+        break;
+    case STREAM_ADD:
+        for(i = 0; i < n; i++){
+            dst[i] = x[i] + y[i];
+        }
+        break;
+    case STREAM_TRIAD:
+        for(i = 0; i < n; i++){
+            dst[i] = x[i] + s * y[i];
+        }
+        break;
+    }
+} /* DStreamKernel */
+
+#ifdef PLAN_X86_SIMD
+/*
+ * The vector versions run the scalar kernel up to the first element of dst
+ * on a vector boundary (streaming stores need it), then whole vectors, then
+ * the scalar kernel again for the tail.
+ */
+  #define DSTREAM_HEAD(W)                                                     \
+    i = ((W * sizeof(double)) - ((uintptr_t)dst % (W * sizeof(double)))) % (W * sizeof(double)) / sizeof(double); \
+    if(i > n){                                                                \
+        i = n;                                                                \
+    }                                                                         \
+    DStreamKernel(k, dst, x, y, s, i);
+
+  #define DSTREAM_BODY(W, LOAD, STORE, MUL, FMA)                              \
+    switch(k){                                                                \
+    case STREAM_COPY:                                                         \
+        for(; i + W <= n; i += W){                                            \
+            STORE(dst + i, LOAD(x + i));                                      \
+        }                                                                     \
+        break;                                                                \
+    case STREAM_SCALE:                                                        \
+        for(; i + W <= n; i += W){                                            \
+            STORE(dst + i, MUL(vs, LOAD(x + i)));                             \
+        }                                                                     \
+        break;                                                                \
+    case STREAM_ADD:                                                          \
+        for(; i + W <= n; i += W){                                            \
+            STORE(dst + i, FMA(one, LOAD(x + i), LOAD(y + i)));               \
+        }                                                                     \
+        break;                                                                \
+    case STREAM_TRIAD:                                                        \
+        for(; i + W <= n; i += W){                                            \
+            STORE(dst + i, FMA(vs, LOAD(y + i), LOAD(x + i)));                \
+        }                                                                     \
+        break;                                                                \
+    }
+
+  #define SSE2_FMA(a, b, c) _mm_add_pd(_mm_mul_pd((a), (b)), (c))
+
+/**
+ * \brief Runs one STREAM kernel with SSE2, see DStreamKernel.
+ * \param nt Use streaming stores.
+ */
+__attribute__((target("sse2")))
+static void DStreamKernelSSE2(int k, double *dst, double *x, double *y, double s, size_t n, int nt){
+    size_t i;
+    __m128d vs = _mm_set1_pd(s), one = _mm_set1_pd(1.0);
+    DSTREAM_HEAD(2);
+    if(nt){
+        DSTREAM_BODY(2, _mm_loadu_pd, _mm_stream_pd, _mm_mul_pd, SSE2_FMA);
+        _mm_sfence();
+    } else {
+        DSTREAM_BODY(2, _mm_loadu_pd, _mm_store_pd, _mm_mul_pd, SSE2_FMA);
+    }
+    DStreamKernel(k, dst + i, x + i, (y != NULL) ? y + i : NULL, s, n - i);
+} /* DStreamKernelSSE2 */
+
+/**
+ * \brief Runs one STREAM kernel with AVX2 and FMA, see DStreamKernel.
+ * \param nt Use streaming stores.
+ */
+__attribute__((target("avx2,fma")))
+static void DStreamKernelAVX2(int k, double *dst, double *x, double *y, double s, size_t n, int nt){
+    size_t i;
+    __m256d vs = _mm256_set1_pd(s), one = _mm256_set1_pd(1.0);
+    DSTREAM_HEAD(4);
+    if(nt){
+        DSTREAM_BODY(4, _mm256_loadu_pd, _mm256_stream_pd, _mm256_mul_pd, _mm256_fmadd_pd);
+        _mm_sfence();
+    } else {
+        DSTREAM_BODY(4, _mm256_loadu_pd, _mm256_store_pd, _mm256_mul_pd, _mm256_fmadd_pd);
+    }
+    DStreamKernel(k, dst + i, x + i, (y != NULL) ? y + i : NULL, s, n - i);
+} /* DStreamKernelAVX2 */
+
+/**
+ * \brief Runs one STREAM kernel with AVX-512, see DStreamKernel.
+ * \param nt Use streaming stores.
+ */
+__attribute__((target("avx512f")))
+static void DStreamKernelAVX512(int k, double *dst, double *x, double *y, double s, size_t n, int nt){
+    size_t i;
+    __m512d vs = _mm512_set1_pd(s), one = _mm512_set1_pd(1.0);
+    DSTREAM_HEAD(8);
+    if(nt){
+        DSTREAM_BODY(8, _mm512_loadu_pd, _mm512_stream_pd, _mm512_mul_pd, _mm512_fmadd_pd);
+        _mm_sfence();
+    } else {
+        DSTREAM_BODY(8, _mm512_loadu_pd, _mm512_store_pd, _mm512_mul_pd, _mm512_fmadd_pd);
+    }
+    DStreamKernel(k, dst + i, x + i, (y != NULL) ? y + i : NULL, s, n - i);
+} /* DStreamKernelAVX512 */
+#endif /* PLAN_X86_SIMD */
+
+/**
+ * \brief Runs one STREAM kernel with the instruction set chosen for the plan.
+ * \param d The plan data.
+ * \param k The kernel, STREAM_COPY, STREAM_SCALE, STREAM_ADD or STREAM_TRIAD.
+ */
+static void DStreamRun(DStreamdata *d, int k){
+    double *dst, *x, *y = NULL;
+
+    switch(k){
+    case STREAM_COPY:
+        dst = d->three; x = d->one;
+        break;
+    case STREAM_SCALE:
+        dst = d->two; x = d->three;
+        break;
+    case STREAM_ADD:
+        dst = d->three; x = d->one; y = d->two;
+        break;
+    default:
+        dst = d->one; x = d->two; y = d->three;
+        break;
+    }
+    #ifdef PLAN_X86_SIMD
+    switch(d->simd){
+    case SIMD_AVX512:
+        DStreamKernelAVX512(k, dst, x, y, d->scalar, d->M, d->nt);
+        return;
+    case SIMD_AVX2:
+        DStreamKernelAVX2(k, dst, x, y, d->scalar, d->M, d->nt);
+        return;
+    case SIMD_SSE2:
+        DStreamKernelSSE2(k, dst, x, y, d->scalar, d->M, d->nt);
+        return;
+    }
+    #endif
+    DStreamKernel(k, dst, x, y, d->scalar, d->M);
+} /* DStreamRun */
+
 /**
  * \brief Checks the results of execDStreamPlan for errors.
  * \param [in] vptr Holds the data used to calculate the values used for error checking.
@@ -37,35 +214,29 @@
 int StreamCheck(void *vptr){
     DStreamdata *d;
     d = (DStreamdata *)vptr;
-    double cutoff,asum,bsum,csum;
-    double a = 1, b = 2, c = 0;
-    register int j;
+    double cutoff,asum,bsum,csum,s;
+    register size_t j;
     int ret = ERR_CLEAN;
-    c = a;
-    b = c * d->random;
-    c = a + b;
-    a = b + d->random * c;
-    a *= (double) d->M;
-    b *= (double) d->M;
-    c *= (double) d->M;
 
+    /* after one pass b = s * a0, c = a0 + b and a = b + s * c, for the a0 the pass started from */
     asum = bsum = csum = 0.0;
     for(j = 0; j < d->M; j++){
         asum += d->one[j];
         bsum += d->two[j];
         csum += d->three[j];
     }
+    s = d->scalar;
 
     #ifndef abs
   #define abs(a) ((a) >= 0 ? (a) : -(a))
     #endif
 
     cutoff = 1.e-8;
-    if(abs(a - asum) / asum > cutoff){
+    if(!(asum > 0.0) || !(csum > 0.0)){
         ret = make_error(CALC,generic_err);
-    } else if(abs(b - bsum) / bsum > cutoff){
+    } else if(abs(bsum - s * (csum - bsum)) / bsum > cutoff){
         ret = make_error(CALC,generic_err);
-    } else if(abs(c - csum) / csum > cutoff){
+    } else if(abs(asum - (bsum + s * csum)) / asum > cutoff){
         ret = make_error(CALC,generic_err);
     }
     return ret;
@@ -100,6 +271,11 @@ void *makeDStreamPlan(data *m){
             } else {
                 d->M = m->d[0] / (5 * sizeof(double));
             }
+            d->scalar = DSTREAM_SCALAR;
+            d->simd = plan_simd_select(m);
+            d->nt = plan_has_token(m, "NT");
+            d->team_mode = plan_has_token(m, "TEAM");
+            d->M_total = d->M;
         }
         (p->vptr) = (void *)d;
     }
@@ -117,7 +293,7 @@ void *makeDStreamPlan(data *m){
  * \sa killDStreamPlan
  */
 int initDStreamPlan(void *plan){
-    size_t M;
+    size_t M, j;
     int ret = make_error(ALLOC,generic_err);
     Plan *p;
     DStreamdata *d = NULL;
@@ -160,21 +336,33 @@ int initDStreamPlan(void *plan){
         }         //DO_PERF
     }
     if(d){
+        /* in TEAM mode each member allocates, and so places, only its own page aligned share of the arrays */
+        if(d->team_mode){
+            d->M = plan_team_share(p->team, p->team_rank, d->M_total, sysconf(_SC_PAGESIZE) / sizeof(double));
+        }
         M = d->M;
 
         //EmitLog(MyRank,101,"Allocating",sizeof(double)*M*3,0);
 
-        d->one = (double *)  malloc(sizeof(double) * M);
+        d->one = (double *)  plan_alloc(p, sizeof(double) * ((M > 0) ? M : 1));
         assert(d->one);
-        d->two = (double *)  malloc(sizeof(double) * M);
+        d->two = (double *)  plan_alloc(p, sizeof(double) * ((M > 0) ? M : 1));
         assert(d->two);
-        d->three = (double *)  malloc(sizeof(double) * M);
+        d->three = (double *)  plan_alloc(p, sizeof(double) * ((M > 0) ? M : 1));
         assert(d->three);
-        d->four = (double *)  malloc(sizeof(double) * M);
+        d->four = (double *)  plan_alloc(p, sizeof(double) * ((M > 0) ? M : 1));
         assert(d->four);
-        d->five = (double *)  malloc(sizeof(double) * M);
+        d->five = (double *)  plan_alloc(p, sizeof(double) * ((M > 0) ? M : 1));
         assert(d->five);
         if(d->one && d->two && d->three && d->four && d->five){
+            /* the scalar keeps the arrays at these values, so this is only done once */
+            for(j = 0; j < M; j++){
+                d->one[j] = 1.0;
+                d->two[j] = 2.0;
+                d->three[j] = 0.0;
+                d->four[j] = 1.0;
+                d->five[j] = 0.0;
+            }
             ret = ERR_CLEAN;
         }
     }
@@ -201,19 +389,19 @@ void *killDStreamPlan(void *plan){
     //EmitLog(MyRank,101,"Freeing   ",sizeof(double)*d->M*3,0);
 
     if(d->one){
-        free(d->one);
+        plan_free(d->one);
     }
     if(d->two){
-        free(d->two);
+        plan_free(d->two);
     }
     if(d->three){
-        free(d->three);
+        plan_free(d->three);
     }
     if(d->four){
-        free(d->four);
+        plan_free(d->four);
     }
     if(d->five){
-        free(d->five);
+        plan_free(d->five);
     }
 
     if(DO_PERF){
@@ -239,12 +427,14 @@ void *killDStreamPlan(void *plan){
  */
 int execDStreamPlan(void *plan){
     #ifdef HAVE_PAPI
-    int k;
+    int pk;
     long long start, end;
     #endif //HAVE_PAPI
 
-    register int i;
+    int k, timed;
     int ret = ERR_CLEAN;
+    ORB_tick_t ticks[NUM_TIMERS];
+    PlanTeam *team;
     ORB_t t1,t2;
     Plan *p;
     DStreamdata *d;
@@ -252,16 +442,11 @@ int execDStreamPlan(void *plan){
     d = (DStreamdata *)p->vptr;
     assert(d);
 
-    /* update execution count */
-    p->exec_count++;
-
-    for(i = 0; i < d->M; i++){
-        d->one[i] = 1.0;
-        d->two[i] = 2.0;
-        d->three[i] = 0.0;
-        d->four[i] = 1.0;
-        d->five[i] = 0.0;
-        d->random = rand();
+    /* in TEAM mode the members run each kernel together; the first one times the whole team */
+    team = d->team_mode ? p->team : NULL;
+    timed = DO_PERF && ((team == NULL) || (p->team_rank == 0));
+    if(plan_team_barrier(team) != 0){
+        return ERR_CLEAN;
     }
 
     if(DO_PERF){
@@ -270,45 +455,41 @@ int execDStreamPlan(void *plan){
         TEST_PAPI(PAPI_reset(p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
         start = PAPI_get_real_usec();
         #endif //HAVE_PAPI
-
-        ORB_read(t1);
     }     //DO_PERF
-          //
-          //Copy
-    for(i = 0; i < d->M; i++){
-        d->three[i] = d->one[i];
-    }
 
-    //Scale
-    for(i = 0; i < d->M; i++){
-        d->two[i] = d->three[i] * d->random;
+    /* Copy, Scale, Add, Triad */
+    for(k = STREAM_COPY; k <= STREAM_TRIAD; k++){
+        if(timed){
+            ORB_read(t1);
+        }
+        DStreamRun(d, k);
+        if(plan_team_barrier(team) != 0){
+            return ERR_CLEAN;       /* a member left, the scheduler is switching plans */
+        }
+        if(timed){
+            ORB_read(t2);
+            ticks[k] = ORB_cycles_a(t2, t1);
+        }
     }
-
-    //Add
-    for(i = 0; i < d->M; i++){
-        d->three[i] = d->one[i] + d->two[i];
+    if(timed){
+        for(k = STREAM_COPY; k <= STREAM_TRIAD; k++){
+            perftimer_accumulate(&p->timers, (perf_time_index)k, ticks[k]);
+        }
     }
 
-    //Triad
-    for(i = 0; i < d->M; i++){
-        d->one[i] = d->two[i] + d->random * d->three[i];
-    }
+    /* update execution count */
+    p->exec_count++;
 
     if(DO_PERF){
-        ORB_read(t2);
-
         #ifdef HAVE_PAPI
         end = PAPI_get_real_usec();         //PAPI time
 
         /* Collect PAPI counters and store time elapsed */
         TEST_PAPI(PAPI_accum(p->PAPI_EventSet, p->PAPI_Results), PAPI_OK, MyRank, 9999, PRINT_SOME);
-        for(k = 0; k < p->PAPI_Num_Events && k < TOTAL_PAPI_EVENTS; k++){
-            p->PAPI_Times[k] += (end - start);
+        for(pk = 0; pk < p->PAPI_Num_Events && pk < TOTAL_PAPI_EVENTS; pk++){
+            p->PAPI_Times[pk] += (end - start);
         }
         #endif //HAVE_PAPI
-
-        perftimer_accumulate(&p->timers, TIMER0, ORB_cycles_a(t2, t1));
-        perftimer_accumulate(&p->timers, TIMER1, ORB_cycles_a(t2, t1));
     }     //DO_PERF
 
     //TODO: put PAPI in here as well(?)
@@ -316,10 +497,12 @@ int execDStreamPlan(void *plan){
         if(DO_PERF){
             ORB_read(t1);
         }         //DO_PERF
-        ret = StreamCheck(d);
+        if(d->M > 0){
+            ret = StreamCheck(d);
+        }
         if(DO_PERF){
             ORB_read(t2);
-            perftimer_accumulate(&p->timers, TIMER2, ORB_cycles_a(t2, t1));
+            perftimer_accumulate(&p->timers, (perf_time_index)STREAM_CHECK, ORB_cycles_a(t2, t1));
         }         //DO_PERF
     }
     return ret;
@@ -337,27 +520,46 @@ int execDStreamPlan(void *plan){
  */
 int perfDStreamPlan(void *plan){
     int ret = ~ERR_CLEAN;
+    int k;
     uint64_t opcounts[NUM_TIMERS];
+    double time, total = 0.0;
+    size_t M;
+    char buffer[MSG_SIZE];
     Plan *p;
     DStreamdata *d;
     p = (Plan *)plan;
     d = (DStreamdata *)p->vptr;
+    /* a TEAM mode run is reported once, by the member that timed it, for the arrays of the whole team */
+    if(d->team_mode && (p->team != NULL) && (p->team_rank != 0)){
+        return ERR_CLEAN;
+    }
+    M = d->team_mode ? d->M_total : d->M;
     if(p->exec_count > 0){
         // Reference: http://www.cs.virginia.edu/stream/ref.html "Counting Bytes and FLOPS"
-        opcounts[TIMER0] = (0 + 1 + 1 + 2) * d->M * p->exec_count;                          // Count # of floating point operations for each execution loop.
-        opcounts[TIMER1] = (2 + 2 + 3 + 3) * sizeof(double) * d->M * p->exec_count;         // Count # of bytes transferred to and from memory
-        opcounts[TIMER2] = (3 * d->M + 7) * p->exec_count;                                  // FLOPs count for checking stage (needs work...)
+        opcounts[STREAM_COPY]  = 2 * sizeof(double) * M * p->exec_count;     // Count # of bytes transferred to and from memory by each kernel
+        opcounts[STREAM_SCALE] = 2 * sizeof(double) * M * p->exec_count;
+        opcounts[STREAM_ADD]   = 3 * sizeof(double) * M * p->exec_count;
+        opcounts[STREAM_TRIAD] = 3 * sizeof(double) * M * p->exec_count;
+        opcounts[STREAM_SHIFT] = 0;
+        opcounts[STREAM_CHECK] = (3 * d->M + 7) * p->exec_count;                 // FLOPs count for checking stage (needs work...)
 
         perf_table_update(&p->timers, opcounts, p->name);
         #ifdef HAVE_PAPI
         PAPI_table_update(p->name, p->PAPI_Results, p->PAPI_Times, p->PAPI_Num_Events);
         #endif //HAVE_PAPI
 
-        //TODO: Insert some PAPI info here as well
-        double flops = ((double)opcounts[TIMER0] / perftimer_gettime(&p->timers, TIMER0)) / 1e6;
-        double mbps = ((double)opcounts[TIMER1] / perftimer_gettime(&p->timers, TIMER1)) / 1e6;
-        EmitLogfs(MyRank, 9999, "DSTREAM plan performance:", flops, "MFLOPS", PRINT_SOME);
-        EmitLogfs(MyRank, 9999, "DSTREAM plan performance:", mbps, "MB/s", PRINT_SOME);
+        snprintf(buffer, MSG_SIZE, "DSTREAM kernels         : %s%s", plan_simd_name(d->simd), d->nt ? ", streaming stores" : "");
+        EmitLog  (MyRank, 9999, buffer, -1, PRINT_SOME);
+        if(d->team_mode && (p->team != NULL)){
+            EmitLog(MyRank, 9999, "DSTREAM team of workers       :", p->team->size, PRINT_SOME);
+        }
+        for(k = STREAM_COPY; k <= STREAM_TRIAD; k++){
+            time = perftimer_gettime(&p->timers, (perf_time_index)k);
+            total += time;
+            snprintf(buffer, MSG_SIZE, "DSTREAM %-5s performance:", dstream_kernels[k]);
+            EmitLogfs(MyRank, 9999, buffer, ((double)opcounts[k] / time) / 1e6, "MB/s", PRINT_SOME);
+        }
+        EmitLogfs(MyRank, 9999, "DSTREAM plan performance:", ((double)((0 + 1 + 1 + 2) * M * p->exec_count) / total) / 1e6, "MFLOPS", PRINT_SOME);
         EmitLog  (MyRank, 9999, "DSTREAM execution count :", p->exec_count, PRINT_SOME);
         ret = ERR_CLEAN;
     }
@@ -394,6 +596,6 @@ plan_info DSTREAM_info = {
     initDStreamPlan,
     killDStreamPlan,
     perfDStreamPlan,
-    { "FLOPS", "B/s", NULL }
+    { "B/s Copy", "B/s Scale", "B/s Add", "B/s Triad", NULL, "FLOPS Check" }
 };
 
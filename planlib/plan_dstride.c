@@ -42,16 +42,213 @@ void Set(double *a, double *b, int m){
 }
 
 /**
- * \brief Fills the indices of a with random numbers
+ * \brief Fills the indices of a with random numbers, pushing the strided arrays out of the caches.
  * \param a Array to be initialized.
+ * \param n Size of a.
  */
-void Fill(double *a){
-    int i;
-    for(i = 0; i < CACHE; i++){
-        a[i] = rand();
+void Fill(double *a, size_t n){
+    size_t i;
+    double seed = rand();
+    for(i = 0; i < n; i++){
+        a[i] = seed + i;
     }
 }
 
+/**
+ * \brief Reads a list of sizes such as "1,8,64" or "32K,1M" from a PLAN line keyword value.
+ * \param text The keyword value.
+ * \param list Receives the sizes.
+ * \param max Most sizes to read.
+ * \returns The number of sizes read.
+ */
+static int stride_list(char *text, size_t *list, int max){
+    int n = 0;
+    char *end;
+    while((n < max) && (*text != '\0')){
+        list[n] = plan_parse_size(text, &end);
+        if(end == text){
+            break;
+        }
+        if(list[n] > 0){
+            n++;
+        }
+        text = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+} /* stride_list */
+
+/**
+ * \brief Reads the options DSTRIDE and LSTRIDE share from the PLAN line.
+ * \param m The parsed PLAN line.
+ * \param o Receives the options.
+ * \param bytes Memory given to the plan.
+ * \param elem Size of the plan's array elements.
+ */
+void StrideOptions(data *m, StrideOpts *o, size_t bytes, size_t elem){
+    static size_t Inc[] = {
+        1,2,8,64,512,4112
+    };
+    char *value;
+    int k;
+
+    memset(o, 0, sizeof(StrideOpts));
+    o->latency = plan_has_token(m, "LATENCY");
+    o->repeat = o->latency ? 1 : REPEAT;
+    if((value = plan_token_value(m, "REPEAT")) != NULL && atoi(value) > 0){
+        o->repeat = atoi(value);
+    }
+    o->flush = CACHE;
+    if((value = plan_token_value(m, "FLUSH")) != NULL){
+        o->flush = plan_parse_size(value, NULL) / elem;
+    }
+
+    if((value = plan_token_value(m, "STRIDES")) != NULL){
+        o->nstrides = stride_list(value, o->stride, STRIDE_MAX);
+    }
+    if(o->nstrides == 0){
+        o->nstrides = STRIDE_MAX;
+        memcpy(o->stride, Inc, sizeof(Inc));
+    }
+
+    /* LATENCY footprints: by default every factor of 8 below the plan's memory, e.g. 32K up to 1G */
+    if((value = plan_token_value(m, "FOOTPRINTS")) != NULL){
+        o->nfoot = stride_list(value, o->footprint, STRIDE_MAX);
+    } else {
+        for(k = 0; k < STRIDE_MAX; k++){
+            o->footprint[o->nfoot++] = bytes >> (3 * (STRIDE_MAX - 1 - k));
+        }
+    }
+    for(k = 0; k < o->nfoot; k++){
+        if(o->footprint[k] > bytes){
+            o->footprint[k] = bytes;
+        }
+        if(o->footprint[k] < STRIDE_MIN_FOOT){
+            memmove(&o->footprint[k], &o->footprint[k + 1], (o->nfoot - k - 1) * sizeof(size_t));
+            o->nfoot--;
+            k--;
+        }
+    }
+} /* StrideOptions */
+
+/**
+ * \brief Allocates and links the LATENCY pointer chain.
+ * Footprint k owns word k of every cache line; in the first footprint/STRIDE_LINE lines that word
+ * holds the index of the next line's word k, in a single random cycle (Sattolo's shuffle). Each
+ * load then depends on the one before, and the prefetchers cannot guess the next line.
+ * \param plan The plan, for plan_alloc.
+ * \param o The options from StrideOptions.
+ * \param bytes Memory given to the plan.
+ * \returns ERR_CLEAN, or an allocation error.
+ */
+int StrideChainInit(void *plan, StrideOpts *o, size_t bytes){
+    const uint64_t words = STRIDE_LINE / sizeof(uint64_t);
+    uint64_t lines = bytes / STRIDE_LINE;
+    uint64_t i, j, n, t, x;
+    int k;
+
+    if(o->nfoot > (int)words){
+        o->nfoot = words;
+    }
+    o->chain = (uint64_t *)plan_alloc((Plan *)plan, lines * STRIDE_LINE);
+    if(o->chain == NULL){
+        return make_error(ALLOC,generic_err);
+    }
+    for(k = 0; k < o->nfoot; k++){
+        n = o->footprint[k] / STRIDE_LINE;
+        if(n > lines){
+            n = lines;
+        }
+        x = 0x9E3779B97F4A7C15ULL * (k + 1);
+        for(i = 0; i < n; i++){
+            o->chain[i * words + k] = i;
+        }
+        for(i = n - 1; i > 0; i--){
+            /* xorshift64 */
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            j = x % i;
+            t = o->chain[i * words + k];
+            o->chain[i * words + k] = o->chain[j * words + k];
+            o->chain[j * words + k] = t;
+        }
+        for(i = 0; i < n; i++){
+            o->chain[i * words + k] = o->chain[i * words + k] * words + k;
+        }
+        o->loads[k] = (uint64_t)o->repeat * ((n > STRIDE_LAT_LOADS) ? n : STRIDE_LAT_LOADS);
+    }
+    return ERR_CLEAN;
+} /* StrideChainInit */
+
+/**
+ * \brief Follows a pointer chain.
+ * \param chain The chain.
+ * \param idx Where to start.
+ * \param loads Number of loads to make.
+ * \returns Where the chase ended.
+ */
+static uint64_t stride_chase(const uint64_t *chain, uint64_t idx, uint64_t loads){
+    uint64_t i;
+    for(i = 0; i + 4 <= loads; i += 4){
+        idx = chain[idx];
+        idx = chain[idx];
+        idx = chain[idx];
+        idx = chain[idx];
+    }
+    for(; i < loads; i++){
+        idx = chain[idx];
+    }
+    return idx;
+} /* stride_chase */
+
+/**
+ * \brief Runs the LATENCY chase once for every footprint, timing footprint k under timer k.
+ * \param plan The plan.
+ * \param o The options and chain from StrideChainInit.
+ */
+void StrideLatency(void *plan, StrideOpts *o){
+    Plan *p = (Plan *)plan;
+    ORB_t t1, t2;
+    int k;
+
+    for(k = 0; k < o->nfoot; k++){
+        if(DO_PERF){
+            ORB_read(t1);
+        }
+        o->sink += stride_chase(o->chain, k, o->loads[k]);
+        if(DO_PERF){
+            ORB_read(t2);
+            perftimer_accumulate(&p->timers, (perf_time_index)k, ORB_cycles_a(t2, t1));
+        }
+    }
+} /* StrideLatency */
+
+/**
+ * \brief Reports the LATENCY results: the lines touched per second under each footprint's timer in the
+ * performance table, and the time per load in the log.
+ * \param plan The plan.
+ * \param o The options.
+ * \param name The plan name for the log.
+ */
+void StrideLatencyPerf(void *plan, StrideOpts *o, char *name){
+    Plan *p = (Plan *)plan;
+    uint64_t opcounts[NUM_TIMERS];
+    char buffer[MSG_SIZE];
+    double ns;
+    int k;
+
+    memset(opcounts, 0, sizeof(opcounts));
+    for(k = 0; k < o->nfoot; k++){
+        opcounts[k] = o->loads[k] * STRIDE_LINE * p->exec_count;
+    }
+    perf_table_update(&p->timers, opcounts, p->name);
+    for(k = 0; k < o->nfoot; k++){
+        ns = perftimer_gettime(&p->timers, (perf_time_index)k) * 1e9 / ((double)o->loads[k] * p->exec_count);
+        snprintf(buffer, MSG_SIZE, "%s latency %8zu kB :", name, o->footprint[k] / 1024);
+        EmitLogfs(MyRank, 9999, buffer, ns, "ns/load", PRINT_SOME);
+    }
+} /* StrideLatencyPerf */
+
 /**
  * \brief Allocates and returns the data struct for the plan
  * \param [in] m Holds the input data for the plan.
@@ -81,6 +278,7 @@ void *makeDStridePlan(data *m){
             } else {
                 d->M = m->d[0] / (2 * sizeof(double));
             }
+            StrideOptions(m, &d->o, d->M * 2 * sizeof(double), sizeof(double));
         }
         (p->vptr) = (void *)d;
     }
@@ -140,15 +338,19 @@ int initDStridePlan(void *plan){
             #endif //HAVE_PAPI
         }        //DO_PERF
     }
-    if(d){
+    if(d && d->o.latency){
+        d->one = d->two = d->three = NULL;
+        ret = StrideChainInit(p, &d->o, d->M * 2 * sizeof(double));
+    } else if(d){
         M = d->M;
-        d->one = (double *) malloc(sizeof(double) * M);
+        d->one = (double *) plan_alloc(p, sizeof(double) * M);
         assert(d->one);
-        d->two = (double *) malloc(sizeof(double) * M);
+        d->two = (double *) plan_alloc(p, sizeof(double) * M);
         assert(d->two);
-        d->three = (double *) malloc(sizeof(double) * CACHE);
+        d->three = (double *) plan_alloc(p, sizeof(double) * (d->o.flush ? d->o.flush : 1));
         assert(d->three);
         if(d->one && d->two && d->three){
+            d->three[0] = 1.0;
             ret = ERR_CLEAN;
         }
     }
@@ -178,13 +380,16 @@ void *killDStridePlan(void *plan){
     }     //DO_PERF
 
     if(d->one){
-        free(d->one);
+        plan_free(d->one);
     }
     if(d->two){
-        free(d->two);
+        plan_free(d->two);
     }
     if(d->three){
-        free(d->three);
+        plan_free(d->three);
+    }
+    if(d->o.chain){
+        plan_free(d->o.chain);
     }
     free(d);
     free(p);
@@ -211,53 +416,58 @@ int execDStridePlan(void *plan){
     DStridedata *d;
     p = (Plan *)plan;
     d = (DStridedata *)p->vptr;
-    int i,k,r, Inc[] = {
-        1,2,8,64,512,1028,2056,4112,16448,32896
-    };
-    double sum = 0;
+    size_t i, s;
+    int k, r;
+    double sum = 0, expected = 0;
     int ret = ERR_CLEAN;
     ORB_t t1, t2;
     /* update execution count */
     p->exec_count++;
 
+    if(d->o.latency){
+        StrideLatency(p, &d->o);
+        return ret;
+    }
+
     Set(d->one,d->two,d->M);
-    Fill(d->three);
 
-    if(DO_PERF){
-        #ifdef HAVE_PAPI
-        /* Start PAPI counters and time */
-        TEST_PAPI(PAPI_reset(p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
-        start = PAPI_get_real_usec();
-        #endif //HAVE_PAPI
-        ORB_read(t1);
-    }     //DO_PERF
-    for(k = 0; k < REPEAT; k++){
-        for(r = 0; r < 10; r++){
-            for(i = 0; i < d->M; i += Inc[r]){
+    /* each stride starts from flushed caches and is timed on its own */
+    for(r = 0; r < d->o.nstrides; r++){
+        s = d->o.stride[r];
+        Fill(d->three, d->o.flush);
+        if(DO_PERF){
+            #ifdef HAVE_PAPI
+            /* Start PAPI counters and time */
+            TEST_PAPI(PAPI_reset(p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
+            start = PAPI_get_real_usec();
+            #endif //HAVE_PAPI
+            ORB_read(t1);
+        }     //DO_PERF
+        for(k = 0; k < d->o.repeat; k++){
+            for(i = 0; i < d->M; i += s){
                 sum += d->one[i] * d->two[i];
             }
             sum += d->three[0];
         }
-        sum++;
-    }
+        if(DO_PERF){
+            ORB_read(t2);
+            #ifdef HAVE_PAPI
+            end = PAPI_get_real_usec();         //PAPI time
 
-    if(DO_PERF){
-        ORB_read(t2);
-        #ifdef HAVE_PAPI
-        end = PAPI_get_real_usec();         //PAPI time
+            /* Collect PAPI counters and store time elapsed */
+            TEST_PAPI(PAPI_accum(p->PAPI_EventSet, p->PAPI_Results), PAPI_OK, MyRank, 9999, PRINT_SOME);
+            for(j = 0; j < p->PAPI_Num_Events && j < TOTAL_PAPI_EVENTS; j++){
+                p->PAPI_Times[j] += (end - start);
+            }
+            #endif //HAVE_PAPI
 
-        /* Collect PAPI counters and store time elapsed */
-        TEST_PAPI(PAPI_accum(p->PAPI_EventSet, p->PAPI_Results), PAPI_OK, MyRank, 9999, PRINT_SOME);
-        for(j = 0; j < p->PAPI_Num_Events && j < TOTAL_PAPI_EVENTS; j++){
-            p->PAPI_Times[j] += (end - start);
-        }
-        #endif //HAVE_PAPI
+            perftimer_accumulate(&p->timers, (perf_time_index)r, ORB_cycles_a(t2, t1));
+        }     //DO_PERF
+        expected += d->o.repeat * d->three[0];
+    }
 
-        perftimer_accumulate(&p->timers, TIMER0, ORB_cycles_a(t2, t1));
-        perftimer_accumulate(&p->timers, TIMER1, ORB_cycles_a(t2, t1));
-    }     //DO_PERF
     if(CHECK_CALC){
-        ret = (sum == (REPEAT * (1.0 + 10.0 * d->three[0]))) ? ERR_CLEAN : make_error(CALC,generic_err);
+        ret = (sum == expected) ? ERR_CLEAN : make_error(CALC,generic_err);
     }
     return ret;
 } /* execDStridePlan */
@@ -274,33 +484,42 @@ int execDStridePlan(void *plan){
  */
 int perfDStridePlan(void *plan){
     int ret = ~ERR_CLEAN;
-    int i, Inc[] = {
-        1,2,8,64,512,1028,2056,4112,16448,32896
-    };
+    int r;
     uint64_t opcounts[NUM_TIMERS];
+    uint64_t flops = 0;
+    double time = 0;
     Plan *p;
     DStridedata *d;
     p = (Plan *)plan;
     d = (DStridedata *)p->vptr;
     if(p->exec_count > 0){
-        uint64_t count = 0;
-        for(i = 0; i < 10; i++){
-            count += d->M / Inc[i];
+        if(d->o.latency){
+            StrideLatencyPerf(p, &d->o, "DSTRIDE");
+            EmitLog  (MyRank, 9999, "DSTRIDE execution count :", p->exec_count, PRINT_SOME);
+            return ERR_CLEAN;
         }
 
-        opcounts[TIMER0] = (2 * count + 10 + 1) * REPEAT * p->exec_count;             // Count # of floating point operations
-        opcounts[TIMER1] = ((2 * count * REPEAT) + (1 * 10 * REPEAT)) * p->exec_count;         // Count memory accesses.
-        opcounts[TIMER2] = 0;
+        /* Count memory accesses for each stride, and floating point operations over all of them */
+        memset(opcounts, 0, sizeof(opcounts));
+        for(r = 0; r < d->o.nstrides; r++){
+            uint64_t count = (d->M + d->o.stride[r] - 1) / d->o.stride[r];
+            opcounts[r] = ((2 * count + 1) * sizeof(double)) * d->o.repeat * p->exec_count;
+            flops += (2 * count + 1) * d->o.repeat * p->exec_count;
+            time += perftimer_gettime(&p->timers, (perf_time_index)r);
+        }
 
         perf_table_update(&p->timers, opcounts, p->name);
         #ifdef HAVE_PAPI
         PAPI_table_update(p->name, p->PAPI_Results, p->PAPI_Times, p->PAPI_Num_Events);
         #endif //HAVE_PAPI
 
-        double flops = ((double)opcounts[TIMER0] / perftimer_gettime(&p->timers, TIMER0)) / 1e6;
-        double mbps = ((double)opcounts[TIMER1] / perftimer_gettime(&p->timers, TIMER1)) / 1e6;
-        EmitLogfs(MyRank, 9999, "DSTRIDE plan performance:", flops, "MFLOPS", PRINT_SOME);
-        EmitLogfs(MyRank, 9999, "DSTRIDE plan performance:", mbps, "MB/s", PRINT_SOME);
+        for(r = 0; r < d->o.nstrides; r++){
+            char buffer[MSG_SIZE];
+            double mbps = ((double)opcounts[r] / perftimer_gettime(&p->timers, (perf_time_index)r)) / 1e6;
+            snprintf(buffer, MSG_SIZE, "DSTRIDE stride %8zu    :", d->o.stride[r]);
+            EmitLogfs(MyRank, 9999, buffer, mbps, "MB/s", PRINT_SOME);
+        }
+        EmitLogfs(MyRank, 9999, "DSTRIDE plan performance:", ((double)flops / time) / 1e6, "MFLOPS", PRINT_SOME);
         EmitLog  (MyRank, 9999, "DSTRIDE execution count :", p->exec_count, PRINT_SOME);
         ret = ERR_CLEAN;
     }
@@ -337,6 +556,6 @@ plan_info DSTRIDE_info = {
     initDStridePlan,
     killDStridePlan,
     perfDStridePlan,
-    { "FLOPS", "B/s", NULL }
+    { "B/s", "B/s", "B/s", "B/s", "B/s", "B/s" }
 };
 
@@ -22,9 +22,9 @@
 #include <planheaders.h>
 
 /* size of random array */
-#define RSIZE 128
+#define RSIZE GUPS_RSIZE
 /* used by random number generator */
-#define POLY 0x0000000000000007ULL
+#define POLY GUPS_POLY
 #define PERIOD 1317624576693539401LL
 
 #ifdef HAVE_PAPI
@@ -33,6 +33,13 @@
   #define PAPI_UNITS { "FLOPS", "CYCS" }
 #endif //HAVE_PAPI
 
+/**
+ * \brief Holds the custom error messages for the plan
+ */
+char *gups_errs[] = {
+    " invalid PREFETCH depth:"
+};
+
 // binary logarithm -- slow but only called once per GUPS plan.
 /**
  * \brief Binary logarithm (n=2^i)
@@ -50,6 +57,42 @@ uint64_t GUPSlog2(uint64_t n){
     return i;
 }
 
+/**
+ * \brief Performs the same updates as the direct kernel, but with d->depth updates in flight.
+ * Each new index is prefetched as it is generated and parked in a ring; the update generated d->depth steps
+ * earlier is applied in its place, by which time its table line should have arrived.
+ * \param [in] d The plan data, with d->random already started.
+ */
+static void GUPS_prefetchUpdate(GUPSdata *d){
+    uint64_t i, j, n, v;
+    uint64_t *tbl = d->tbl;
+    uint64_t *sub = d->sub;
+    uint64_t *ran = d->random;
+    uint64_t *stage = d->stage;
+    uint64_t mask = d->tbl_size - 1;
+    uint64_t rmask = (uint64_t)d->depth - 1;
+    int lsubsize = d->sub_log_size;
+
+    n = 0;
+    for(i = 0; i < d->num_updates / RSIZE; i++){
+        for(j = 0; j < RSIZE; j++){
+            ran[j] = (ran[j] << 1) ^ ((int64_t)ran[j] < 0 ? POLY : 0);
+            __builtin_prefetch(&(tbl[ran[j] & mask]), 1, 3);
+            if(n > rmask){
+                v = stage[n & rmask];
+                tbl[v & mask] ^= sub[v >> (64 - lsubsize)];
+            }
+            stage[n & rmask] = ran[j];
+            n++;
+        }
+    }
+    /* drain the updates still in the ring */
+    for(i = (n > rmask) ? (n - rmask - 1) : 0; i < n; i++){
+        v = stage[i & rmask];
+        tbl[v & mask] ^= sub[v >> (64 - lsubsize)];
+    }
+} /* GUPS_prefetchUpdate */
+
 /**
  * \brief Allocates and returns the data struct for the plan
  * \param [in] m Holds the input data for the plan.
@@ -63,6 +106,7 @@ uint64_t GUPSlog2(uint64_t n){
 void *makeGUPSPlan(data *m){
     Plan *p;
     GUPSdata *d;
+    char *value;
     p = (Plan *)malloc(sizeof(Plan));
     assert(p);
     if(p){
@@ -74,11 +118,29 @@ void *makeGUPSPlan(data *m){
         d = (GUPSdata *)malloc(sizeof(GUPSdata));
         assert(d);
         if(d){
+            memset(d, 0, sizeof(GUPSdata));
             if(m->isize == 1){
                 d->tbl_log_size = GUPSlog2((uint64_t)(m->i[0]) / sizeof(uint64_t));
             } else {
                 d->tbl_log_size = GUPSlog2((uint64_t)(m->d[0]) / sizeof(uint64_t));
             }
+            /* PREFETCH[=depth] selects the prefetching kernel, a depth below 1 fails initGUPSPlan */
+            d->depth = 0;
+            d->stage = NULL;
+            if((value = plan_token_value(m, "PREFETCH")) != NULL){
+                d->depth = (*value != '\0') ? atoi(value) : GUPS_PF_DEPTH;
+                if(d->depth < 1){
+                    d->depth = -1;
+                } else {
+                    if(d->depth > GUPS_PF_MAX_DEPTH){
+                        d->depth = GUPS_PF_MAX_DEPTH;
+                    }
+                    /* round up to a power of 2 so the ring can be indexed with a mask */
+                    while(d->depth & (d->depth - 1)){
+                        d->depth += d->depth & -(d->depth);
+                    }
+                }
+            }
         }
         (p->vptr) = (void *)d;
     }
@@ -143,6 +205,10 @@ int initGUPSPlan(void *plan){
         }         //DO_PERF
     }
     // If the GUPS heap is valid, initialize GUPS variables.
+    if(d && (d->depth < 0)){
+        EmitLog(MyRank, 9999, "GUPS PREFETCH depth must be at least 1.", -1, PRINT_ALWAYS);
+        return make_error(0,specific_err);
+    }
     if(d){
         d->tbl_size = (1L << d->tbl_log_size);
         d->sub_log_size = (d->tbl_log_size / 3);
@@ -151,13 +217,17 @@ int initGUPSPlan(void *plan){
 
         //EmitLog(MyRank, 10, "Allocating",sizeof(uint64_t)*(d->tbl_size +d->sub_size+RSIZE),0);
 
-        d->tbl = (uint64_t *)malloc(sizeof(uint64_t) * d->tbl_size);
+        d->tbl = (uint64_t *)plan_alloc(p, sizeof(uint64_t) * d->tbl_size);
         assert(d->tbl);
-        d->sub = (uint64_t *)malloc(sizeof(uint64_t) * d->sub_size);
+        d->sub = (uint64_t *)plan_alloc(p, sizeof(uint64_t) * d->sub_size);
         assert(d->sub);
-        d->random = (uint64_t *)malloc(sizeof(uint64_t) * RSIZE);
+        d->random = (uint64_t *)plan_alloc(p, sizeof(uint64_t) * RSIZE);
         assert(d->random);
-        if(d->tbl && d->sub && d->random){
+        if(d->depth > 0){
+            d->stage = (uint64_t *)plan_alloc(p, sizeof(uint64_t) * d->depth);
+            assert(d->stage);
+        }
+        if(d->tbl && d->sub && d->random && ((d->depth == 0) || d->stage)){
             /* initialize substitution table */
             d->sub[0] = 0;
             for(i = 1; i < d->sub_size; i++){
@@ -193,13 +263,16 @@ void *killGUPSPlan(void *plan){
     //EmitLog(MyRank,10, "Freeing   ",sizeof(uint64_t)*(d->tbl_size+d->sub_size+RSIZE),0);
 
     if(d->tbl){
-        free((void *)(d->tbl));
+        plan_free((void *)(d->tbl));
     }
     if(d->sub){
-        free((void *)(d->sub));
+        plan_free((void *)(d->sub));
     }
     if(d->random){
-        free((void *)(d->random));
+        plan_free((void *)(d->random));
+    }
+    if(d->stage){
+        plan_free((void *)(d->stage));
     }
 
     if(DO_PERF){
@@ -267,11 +340,15 @@ int execGUPSPlan(void *plan){
     }     //DO_PERF
 
     /* perform updates to main table */
-    for(i = 0; i < nupdates / RSIZE; i++){
-        for(j = 0; j < RSIZE; j++){
-            ran[j] = (ran[j] << 1) ^ ((int64_t)ran[j] < 0 ? POLY : 0);
-            tbl[ran[j] & (tblsize - 1)] ^= sub[ran[j] >> (64 - lsubsize)];
+    if(d->depth == 0){
+        for(i = 0; i < nupdates / RSIZE; i++){
+            for(j = 0; j < RSIZE; j++){
+                ran[j] = (ran[j] << 1) ^ ((int64_t)ran[j] < 0 ? POLY : 0);
+                tbl[ran[j] & (tblsize - 1)] ^= sub[ran[j] >> (64 - lsubsize)];
+            }
         }
+    } else {
+        GUPS_prefetchUpdate(d);
     }
 
     if(DO_PERF){
@@ -286,7 +363,8 @@ int execGUPSPlan(void *plan){
             p->PAPI_Times[k] += (end - start);
         }
         #endif //HAVE_PAPI
-        perftimer_accumulate(&p->timers, TIMER0, ORB_cycles_a(t2, t1));
+        /* the two kernels are kept apart in the perf table: direct in TIMER0, prefetched in TIMER2 */
+        perftimer_accumulate(&p->timers, (d->depth == 0) ? TIMER0 : TIMER2, ORB_cycles_a(t2, t1));
     }     //DO_PERF
 
     /* verify results */
@@ -342,15 +420,18 @@ int perfGUPSPlan(void *plan){
     char *buffer;
 
     int ret = ~ERR_CLEAN;
+    int timer;
     uint64_t opcounts[NUM_TIMERS];
     Plan *p;
     GUPSdata *d;
     p = (Plan *)plan;
     d = (GUPSdata *)p->vptr;
     if(p->exec_count > 0){
-        opcounts[TIMER0] = (uint64_t)d->num_updates * p->exec_count;
+        timer = (d->depth == 0) ? TIMER0 : TIMER2;
+        opcounts[TIMER0] = 0;
         opcounts[TIMER1] = 0;
         opcounts[TIMER2] = 0;
+        opcounts[timer] = (uint64_t)d->num_updates * p->exec_count;
 
         /* Additionally, passing PAPI_Results to be collected */
         perf_table_update(&p->timers, opcounts, p->name);
@@ -359,8 +440,13 @@ int perfGUPSPlan(void *plan){
         #endif     //HAVE_PAPI
 
         //TODO: add place to present PAPI data
-        double gups = ((double)opcounts[TIMER0] / perftimer_gettime(&p->timers, TIMER0)) / (1e9);
-        EmitLogfs(MyRank, 9999, "GUPS plan performance:", gups, "GUPS", PRINT_SOME);
+        double gups = ((double)opcounts[timer] / perftimer_gettime(&p->timers, timer)) / (1e9);
+        if(d->depth == 0){
+            EmitLogfs(MyRank, 9999, "GUPS plan performance:", gups, "GUPS", PRINT_SOME);
+        } else {
+            EmitLogfs(MyRank, 9999, "GUPS plan performance (prefetch):", gups, "GUPS", PRINT_SOME);
+            EmitLog  (MyRank, 9999, "GUPS prefetch depth  :", d->depth, PRINT_SOME);
+        }
         EmitLog  (MyRank, 9999, "GUPS execution count :", p->exec_count, PRINT_SOME);
 
         //sprintf(buffer, "GUPS PAPI data : ES = %d\t R1 = %llu\t R2 = %llu\t\n", p->PAPI_EventSet, p->PAPI_Results[0], p->PAPI_Results[1]);
@@ -394,15 +480,15 @@ int parseGUPSPlan(char *line, LoadPlan *output){
  */
 plan_info GUPS_info = {
     "GUPS",
-    NULL,
-    0,
+    gups_errs,
+    1,
     makeGUPSPlan,
     parseGUPSPlan,
     execGUPSPlan,
     initGUPSPlan,
     killGUPSPlan,
     perfGUPSPlan,
-    { "UPS", NULL, NULL }
+    { "UPS", NULL, "UPS" }
 };
 
 /**
@@ -31,6 +31,23 @@ extern int perfGUPSPlan(void *p);
 extern int parseGUPSPlan(char *line, LoadPlan *output);
 extern plan_info GUPS_info;
 extern uint64_t GUPS_startRNG(int64_t n);
+extern char *gups_errs[];
+
+extern void *makeSGUPSPlan(data *m);
+extern int initSGUPSPlan(void *p);
+extern int execSGUPSPlan(void *p);
+extern void *killSGUPSPlan(void *p);
+extern int perfSGUPSPlan(void *p);
+extern int parseSGUPSPlan(char *line, LoadPlan *output);
+extern plan_info SGUPS_info;
+
+/* size of the random (LFSR lane) array */
+#define GUPS_RSIZE 128
+/* used by random number generator */
+#define GUPS_POLY 0x0000000000000007ULL
+/* default and largest number of updates kept in flight by the PREFETCH kernel */
+#define GUPS_PF_DEPTH 32
+#define GUPS_PF_MAX_DEPTH 4096
 
 /**
  * \brief The data structure for the plan. Holds the input and all used info.
@@ -39,7 +56,44 @@ typedef struct {
     int tbl_log_size, sub_log_size;
     uint64_t tbl_size, sub_size, num_updates;
     uint64_t *tbl, *sub, *random;
+    int depth;                  /**< Prefetch distance in updates, 0 for the direct kernel.    */
+    uint64_t *stage;            /**< Ring of depth pending updates for the PREFETCH kernel.    */
 } GUPSdata;
 
+/**
+ * \brief Update modes for the shared-table SGUPS plan.
+ */
+enum {
+    SGUPS_RACY,         /**< Plain read-xor-write, updates may be lost (HPCC rules allow 1%).  */
+    SGUPS_ATOMIC,       /**< Atomic xor, no lost updates.                                      */
+    SGUPS_BUCKET        /**< Batches of updates sorted into table regions, then atomic xor.    */
+};
+
+/**
+ * \brief The table shared by all workers of an SGUPS team.
+ */
+typedef struct {
+    int tbl_log_size, sub_log_size;
+    uint64_t tbl_size, sub_size;
+    uint64_t *tbl, *sub;
+    int members;                /**< Size of the team, used to split the update stream.        */
+    int joined;                 /**< Members that initialized against this table.              */
+    int reported;               /**< Members that have reported performance.                   */
+    uint64_t *passes;           /**< Update passes made by each member (for the error check).  */
+    uint64_t member_updates;    /**< Updates per member per pass.                              */
+    double rate;                /**< Sum of the members' update rates.                         */
+} SGUPSshared;
+
+/**
+ * \brief The data structure for the SGUPS plan. Each worker has one, the table itself lives in SGUPSshared.
+ */
+typedef struct {
+    int tbl_log_size;
+    int mode;
+    SGUPSshared *s;
+    uint64_t *random;
+    uint64_t *bidx, *bval;      /**< Staging buffers for SGUPS_BUCKET.                         */
+} SGUPSdata;
+
 #endif /* __PLAN_GUPS_H */
 
@@ -30,103 +30,387 @@
   #define PAPI_UNITS { "FLOPS" }
 #endif //HAVE_PAPI
 
+/*
+ * ISORT sorts an array of random 64 bit keys, regenerating nothing in the
+ * timed region: the keys are drawn once at init and copied back into the
+ * work array before each pass. The PLAN line picks the algorithm:
+ *   LSD    (default) least significant digit radix sort, one counting pass
+ *          for all digits, then one scatter pass per digit that varies.
+ *   MSD    in-place most significant digit radix sort, no scratch array.
+ *   SAMPLE all copies of the PLAN line sort one array together: samples
+ *          pick splitters, every member scatters its keys to the members'
+ *          buckets, then each member radix sorts its own bucket.
+ */
+
+static char *isort_algorithms[] = {
+    "LSD", "MSD", "SAMPLE"
+};
+
 /**
- * \brief Swap two elements of an array
- * \param [in] array holds an array of integers
- * \param [in] idx1 is the first array index to swap
- * \param [in] idx2 is the second array index to swap
+ * \brief Fills an array with random keys.
+ * nrand48 keeps its state in the caller, so workers drawing keys at the same time do not share (or race on) the lrand48 state.
+ * \param [out] keys The array to fill.
+ * \param [in] n The number of keys.
+ * \param [in] seed Selects the key sequence.
+ * \returns The sum of the keys, modulo 2^64.
  */
-void isort_swap(uint64_t *array, int idx1, int idx2){
-    uint64_t t;
-    t = array[idx1];
-    array[idx1] = array[idx2];
-    array[idx2] = t;
-}
+static uint64_t isort_fill(uint64_t *keys, int64_t n, int seed){
+    unsigned short xsubi[3];
+    uint64_t key, sum = 0;
+    int64_t i;
+
+    xsubi[0] = 0x330e;
+    xsubi[1] = seed & 0xffff;
+    xsubi[2] = (seed >> 16) & 0xffff;
+    for(i = 0; i < n; i++){
+        /* nrand48 gives 31 bits, three draws cover all 8 digits */
+        key = ((uint64_t)nrand48(xsubi) << 33) ^ ((uint64_t)nrand48(xsubi) << 2) ^ (uint64_t)nrand48(xsubi);
+        keys[i] = key;
+        sum += key;
+    }
+    return sum;
+} /* isort_fill */
 
 /**
- * \brief partition an array
- * \param [in] array holds an array of integers
- * \param [in] left is the index of the leftmost element of the partition
- * \param [in] right is the index of the rightmost element of the partition
- * \param [in] pivot_index is the index of the element you wish to pivot on
+ * \brief Insertion sort, for the small buckets left by the MSD radix sort.
+ * \param [in,out] keys The keys to sort.
+ * \param [in] n The number of keys.
+ * \returns The bytes read and written, counting each key once each way.
  */
-int isort_partition(uint64_t *array, int left, int right, int pivot_index){
-    int i, st_index;
-    uint64_t pivot_val;
-    pivot_val = array[pivot_index];
-    isort_swap (array, pivot_index, right);     // move pivot to end of partition
-    st_index = left;
-    for(i = left; i <= (right - 1); i++){
-        if(array[i] < pivot_val){
-            isort_swap (array, i, st_index);
-            st_index++;
+static uint64_t isort_insertion(uint64_t *keys, int64_t n){
+    int64_t i, j;
+    uint64_t key;
+
+    for(i = 1; i < n; i++){
+        key = keys[i];
+        for(j = i; (j > 0) && (keys[j - 1] > key); j--){
+            keys[j] = keys[j - 1];
         }
+        keys[j] = key;
     }
-    isort_swap (array, st_index, right);
-    return st_index;
-}
+    return 2 * sizeof(uint64_t) * n;
+} /* isort_insertion */
 
 /**
- * \brief run the quicksort algorithm on an array of integers
- * \param [in] array holds an array of integers
- * \param [in] left is the index of the leftmost partition of the array you want to sort
- * \param [in] right is the index of the rightmost partition of the array you want to sort
+ * \brief LSD radix sort. The histograms of all digits are built in one pass over the keys, then each digit
+ *        that is not the same for every key gets one stable scatter pass, alternating between keys and tmp.
+ * \param [in,out] keys The keys to sort.
+ * \param [in] tmp Scratch space for n keys.
+ * \param [in] n The number of keys.
+ * \param [out] sorted Set to keys or tmp, whichever holds the sorted keys.
+ * \returns The bytes read and written.
  */
-int isort_quicksort(uint64_t *array, int left, int right){
-    int pivot_index, new_pivot_index;
-    if(left < right){           // len(list) > 2
-        pivot_index = (left + right) / 2;
-        new_pivot_index = isort_partition (array, left, right, pivot_index);
-        isort_quicksort (array, left, new_pivot_index - 1);
-        isort_quicksort (array, new_pivot_index + 1, right);
+static uint64_t isort_lsd(uint64_t *keys, uint64_t *tmp, int64_t n, uint64_t **sorted){
+    int64_t hist[ISORT_DIGITS][ISORT_RADIX];
+    int64_t i, sum, c;
+    uint64_t key, bytes, *src, *dst, *t;
+    int k, b, shift;
+
+    *sorted = keys;
+    if(n < 2){
+        return 0;
     }
-}
+    memset(hist, 0, sizeof(hist));
+    for(i = 0; i < n; i++){
+        key = keys[i];
+        for(k = 0; k < ISORT_DIGITS; k++){
+            hist[k][(key >> (k * ISORT_DIGIT_BITS)) & (ISORT_RADIX - 1)]++;
+        }
+    }
+    bytes = sizeof(uint64_t) * n;
+
+    src = keys;
+    dst = tmp;
+    for(k = 0; k < ISORT_DIGITS; k++){
+        shift = k * ISORT_DIGIT_BITS;
+        if(hist[k][(src[0] >> shift) & (ISORT_RADIX - 1)] == n){
+            continue;           /* every key has this digit, the pass would not move anything */
+        }
+        sum = 0;
+        for(b = 0; b < ISORT_RADIX; b++){
+            c = hist[k][b];
+            hist[k][b] = sum;
+            sum += c;
+        }
+        for(i = 0; i < n; i++){
+            key = src[i];
+            dst[hist[k][(key >> shift) & (ISORT_RADIX - 1)]++] = key;
+        }
+        bytes += 2 * sizeof(uint64_t) * n;
+        t = src;
+        src = dst;
+        dst = t;
+    }
+    *sorted = src;
+    return bytes;
+} /* isort_lsd */
+
+/**
+ * \brief In-place MSD radix sort (American flag sort). Keys are permuted into their buckets for one digit by
+ *        following cycles, then each bucket is sorted on the next digit. Recursion is at most ISORT_DIGITS deep.
+ * \param [in,out] keys The keys to sort.
+ * \param [in] n The number of keys.
+ * \param [in] shift The position of the digit to sort on.
+ * \returns The bytes read and written.
+ */
+static uint64_t isort_msd(uint64_t *keys, int64_t n, int shift){
+    int64_t count[ISORT_RADIX], next[ISORT_RADIX], end[ISORT_RADIX];
+    int64_t i, sum;
+    uint64_t key, tmp, bytes;
+    int b, db;
+
+    if(n <= ISORT_SMALL){
+        return isort_insertion(keys, n);
+    }
+    memset(count, 0, sizeof(count));
+    for(i = 0; i < n; i++){
+        count[(keys[i] >> shift) & (ISORT_RADIX - 1)]++;
+    }
+    bytes = sizeof(uint64_t) * n;
+
+    sum = 0;
+    for(b = 0; b < ISORT_RADIX; b++){
+        next[b] = sum;
+        sum += count[b];
+        end[b] = sum;
+    }
+    for(b = 0; b < ISORT_RADIX; b++){
+        while(next[b] < end[b]){
+            key = keys[next[b]];
+            db = (key >> shift) & (ISORT_RADIX - 1);
+            while(db != b){
+                tmp = keys[next[db]];
+                keys[next[db]++] = key;
+                key = tmp;
+                db = (key >> shift) & (ISORT_RADIX - 1);
+            }
+            keys[next[b]++] = key;
+        }
+    }
+    bytes += 2 * sizeof(uint64_t) * n;
+
+    if(shift > 0){
+        sum = 0;
+        for(b = 0; b < ISORT_RADIX; b++){
+            if(count[b] > 1){
+                bytes += isort_msd(keys + sum, count[b], shift - ISORT_DIGIT_BITS);
+            }
+            sum += count[b];
+        }
+    }
+    return bytes;
+} /* isort_msd */
+
+/**
+ * \brief Checks that keys are in order.
+ * \param [in] keys The keys.
+ * \param [in] n The number of keys.
+ * \param [out] sum The sum of the keys, modulo 2^64, to compare with the keys that went in.
+ * \returns The number of keys smaller than the one before them.
+ */
+static int64_t isort_check(uint64_t *keys, int64_t n, uint64_t *sum){
+    int64_t i, errors = 0;
+    uint64_t total = 0;
+
+    for(i = 0; i < n; i++){
+        total += keys[i];
+        if((i > 0) && (keys[i - 1] > keys[i])){
+            errors++;
+        }
+    }
+    *sum = total;
+    return errors;
+} /* isort_check */
+
+/**
+ * \brief Finds the SAMPLE sort bucket of a key.
+ * \param [in] splitters The sorted bucket boundaries.
+ * \param [in] nsplit The number of splitters.
+ * \param [in] key The key.
+ * \returns The number of splitters that are not larger than key.
+ */
+static int isort_bucket(uint64_t *splitters, int nsplit, uint64_t key){
+    int lo = 0, hi = nsplit, mid;
+
+    while(lo < hi){
+        mid = (lo + hi) / 2;
+        if(key < splitters[mid]){
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+} /* isort_bucket */
+
+/**
+ * \brief One SAMPLE sort of the team's keys by one member. Every member must call it; it ends with a barrier.
+ * \param [in] p The member's Plan.
+ * \param [in] d The member's data.
+ * \returns 0 once the whole array is sorted, -1 if the team broke up on the way.
+ */
+static int isort_team_pass(Plan *p, ISORTdata *d){
+    ISORTshared *s = d->s;
+    int P = s->members, r = p->team_rank;
+    int64_t n = d->local_size, i, off, col;
+    int64_t *counts;
+    uint64_t *src = d->source, *sorted, bytes = 0;
+    int b, k;
+
+    /* 1. everyone offers samples, the first member sorts them and picks the splitters */
+    for(k = 0; k < ISORT_OVERSAMPLE; k++){
+        s->samples[r * ISORT_OVERSAMPLE + k] = (n > 0) ? src[(k * n) / ISORT_OVERSAMPLE] : UINT64_MAX;
+    }
+    if(plan_team_barrier(p->team) != 0){
+        return -1;
+    }
+    if(r == 0){
+        isort_msd(s->samples, (int64_t)P * ISORT_OVERSAMPLE, 64 - ISORT_DIGIT_BITS);
+        for(b = 1; b < P; b++){
+            s->splitters[b - 1] = s->samples[b * ISORT_OVERSAMPLE];
+        }
+    }
+    if(plan_team_barrier(p->team) != 0){
+        return -1;
+    }
+
+    /* 2. count the keys this member sends to each bucket */
+    counts = s->counts + (int64_t)r * P;
+    for(b = 0; b < P; b++){
+        counts[b] = 0;
+    }
+    for(i = 0; i < n; i++){
+        counts[isort_bucket(s->splitters, P - 1, src[i])]++;
+    }
+    bytes += sizeof(uint64_t) * n;
+    if(plan_team_barrier(p->team) != 0){
+        return -1;
+    }
+
+    /* 3. bucket b starts after all smaller buckets, and within it this member's keys follow those of lower ranks */
+    off = 0;
+    for(b = 0; b < P; b++){
+        d->offsets[b] = off;
+        col = 0;
+        for(k = 0; k < P; k++){
+            if(k < r){
+                d->offsets[b] += s->counts[(int64_t)k * P + b];
+            }
+            col += s->counts[(int64_t)k * P + b];
+        }
+        if(b == r){
+            d->seg_start = off;
+            d->seg_size = col;
+        }
+        off += col;
+    }
+    for(i = 0; i < n; i++){
+        s->keys[d->offsets[isort_bucket(s->splitters, P - 1, src[i])]++] = src[i];
+    }
+    bytes += 2 * sizeof(uint64_t) * n;
+    if(plan_team_barrier(p->team) != 0){
+        return -1;
+    }
+
+    /* 4. each member sorts its own bucket */
+    if(d->seg_size > 0){
+        bytes += isort_lsd(s->keys + d->seg_start, s->scratch + d->seg_start, d->seg_size, &sorted);
+        if(sorted != s->keys + d->seg_start){
+            memcpy(s->keys + d->seg_start, sorted, sizeof(uint64_t) * d->seg_size);
+            bytes += 2 * sizeof(uint64_t) * d->seg_size;
+        }
+    }
+    __atomic_add_fetch(&(s->pass_bytes), bytes, __ATOMIC_RELAXED);
+    if(plan_team_barrier(p->team) != 0){
+        return -1;
+    }
+    return 0;
+} /* isort_team_pass */
+
+/**
+ * \brief Frees a SAMPLE sort team's array once the last member has been killed.
+ * \param [in] shared The team's ISORTshared.
+ */
+static void ISORT_release(void *shared){
+    ISORTshared *s = (ISORTshared *)shared;
+
+    plan_free(s->keys);
+    plan_free(s->scratch);
+    free(s->samples);
+    free(s->splitters);
+    free(s->counts);
+    free(s);
+} /* ISORT_release */
 
 /**
  * \brief Allocates and returns the data struct for the plan
- * \param i The struct that holds the input data.
- * \return void* Data struct
+ * \param [in] m Holds the input data for the plan.
+ * \return A reference to the created Plan structure.
+ * \sa parseISORTPlan
+ * \sa initISORTPlan
+ * \sa execISORTPlan
+ * \sa perfISORTPlan
+ * \sa killISORTPlan
  */
-void *makeISORTPlan(data *i){
+void *makeISORTPlan(data *m){
     Plan *p;
-    ISORTdata *ip;
-    p = (Plan *) malloc (sizeof (Plan));
-    assert (p);
+    ISORTdata *d;
+    int64_t size, arrays;
+    int k;
+    p = (Plan *)malloc(sizeof(Plan));
+    assert(p);
     if(p){
         p->fptr_initplan = &initISORTPlan;
         p->fptr_execplan = &execISORTPlan;
         p->fptr_killplan = &killISORTPlan;
         p->fptr_perfplan = &perfISORTPlan;
         p->name = ISORT;
-        ip = (ISORTdata *) malloc (sizeof (ISORTdata));
-        assert (ip);
-        if(ip){
-            if(i->isize == 1){
-                ip->array_size = i->i[0] / sizeof (uint64_t);   //
+        d = (ISORTdata *)calloc(1, sizeof(ISORTdata));
+        assert(d);
+        if(d){
+            d->algorithm = ISORT_LSD;
+            for(k = 0; k < sizeof(isort_algorithms) / sizeof(char *); k++){
+                if(plan_has_token(m, isort_algorithms[k])){
+                    d->algorithm = k;
+                }
+            }
+            if(m->isize >= 1){
+                size = m->i[0];
+            } else if(m->dsize >= 1){
+                size = m->d[0];
             } else {
-                ip->array_size = i->d[0] / sizeof (uint64_t);   //
+                size = 3 * 1024 * 1024;
             }
+            /* the keys, their pristine copy and (except for MSD) the scratch array share "size" bytes */
+            arrays = (d->algorithm == ISORT_MSD) ? 2 : 3;
+            d->array_size = size / (arrays * sizeof(uint64_t));
+            if(d->array_size < 1){
+                d->array_size = 1;
+            }
+            d->local_size = d->array_size;
         }
-        (p->vptr) = (void *) ip; // <- Setting the void pointer member of the Plan struct to your data structure. Only change if you change the name of ip earlier in this function.
+        (p->vptr) = (void *)d;
     }
-    return p;                   // <- Returning the Plan pointer. Do not change.
+    return p;
 } /* makeISORTPlan */
 
-/************************
- * This is the place where the memory gets allocated, and data types get initialized to their starting values.
- ***********************/
 /**
- * \brief Creates and initializes the working data for the plan
- * \param plan The Plan struct that holds the plan's data values.
- * \return Error flag value
+ * \brief Creates and initializes the working data for the plan. The keys are drawn here, outside the timed region.
+ * \param [in] plan A pointer to a Plan structure that holds the data and the memory for the plan.
+ * \return int Error flag value
+ * \sa parseISORTPlan
+ * \sa makeISORTPlan
+ * \sa execISORTPlan
+ * \sa perfISORTPlan
+ * \sa killISORTPlan
  */
-int initISORTPlan(void *plan){  // <- Replace ISORT with the name of your module.
-    if(!plan){
-        return make_error (ALLOC, generic_err); // <- This is the error code for one of the malloc fails.
-    }
+int initISORTPlan(void *plan){
     Plan *p;
-    ISORTdata *d;
-    p = (Plan *) plan;
+    ISORTdata *d = NULL;
+    ISORTshared *s;
+    PlanTeam *team;
+    int64_t n;
+    int P;
 
     #ifdef HAVE_PAPI
     int temp_event, i;
@@ -134,217 +418,337 @@ int initISORTPlan(void *plan){  // <- Replace ISORT with the name of your module
     char *PAPI_units[NUM_PAPI_EVENTS] = PAPI_UNITS;
     #endif //HAVE_PAPI
 
-    if(p){
-        d = (ISORTdata *) p->vptr;
-        p->exec_count = 0;      // Initialize the plan execution count to zero.
-
-        if(DO_PERF){
-            perftimer_init (&p->timers, NUM_TIMERS);    // Initialize all performance timers to zero.
-
-            #ifdef HAVE_PAPI
-            /* Initialize plan's PAPI data */
-            p->PAPI_EventSet = PAPI_NULL;
-            p->PAPI_Num_Events = 0;
-
-            TEST_PAPI (PAPI_create_eventset (&p->PAPI_EventSet), PAPI_OK,
-                       MyRank, 9999, PRINT_SOME);
-
-            //Add the desired events to the Event Set; ensure the dsired counters
-            //  are on the system then add, ignore otherwise
-            for(i = 0; i < TOTAL_PAPI_EVENTS && i < NUM_PAPI_EVENTS; i++){
-                temp_event = PAPI_Events[i];
-                if(PAPI_query_event (temp_event) == PAPI_OK){
-                    p->PAPI_Num_Events++;
-                    TEST_PAPI (PAPI_add_event (p->PAPI_EventSet, temp_event),
-                               PAPI_OK, MyRank, 9999, PRINT_SOME);
-                }
+    p = (Plan *)plan;
+    if(!p){
+        return make_error(ALLOC, generic_err);
+    }
+    d = (ISORTdata *)p->vptr;
+    p->exec_count = 0;
+    if(DO_PERF){
+        perftimer_init(&p->timers, NUM_TIMERS);
+
+        #ifdef HAVE_PAPI
+        /* Initialize plan's PAPI data */
+        p->PAPI_EventSet = PAPI_NULL;
+        p->PAPI_Num_Events = 0;
+
+        TEST_PAPI(PAPI_create_eventset(&p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
+
+        //Add the desired events to the Event Set; ensure the dsired counters
+        //  are on the system then add, ignore otherwise
+        for(i = 0; i < TOTAL_PAPI_EVENTS && i < NUM_PAPI_EVENTS; i++){
+            temp_event = PAPI_Events[i];
+            if(PAPI_query_event(temp_event) == PAPI_OK){
+                p->PAPI_Num_Events++;
+                TEST_PAPI(PAPI_add_event(p->PAPI_EventSet, temp_event), PAPI_OK, MyRank, 9999, PRINT_SOME);
+            }
+        }
+
+        PAPIRes_init(p->PAPI_Results, p->PAPI_Times);
+        PAPI_set_units(p->name, PAPI_units, NUM_PAPI_EVENTS);
+
+        TEST_PAPI(PAPI_start(p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
+        #endif //HAVE_PAPI
+    }     //DO_PERF
+    if(!d){
+        return make_error(ALLOC, generic_err);
+    }
+
+    if(d->algorithm == ISORT_SAMPLE){
+        /* a lone SAMPLE plan is a team of one */
+        if(p->team == NULL){
+            p->team = plan_team_new(1);
+            p->team_rank = 0;
+            if(p->team == NULL){
+                return make_error(ALLOC, generic_err);
             }
+        }
+        d->local_size = plan_team_share(p->team, p->team_rank, d->array_size, 1);
+    }
+    n = d->local_size;
+
+    d->source = (uint64_t *)plan_alloc(p, sizeof(uint64_t) * ((n > 0) ? n : 1));
+    if(!d->source){
+        return make_error(ALLOC, generic_err);
+    }
+    d->src_sum = isort_fill(d->source, n, p->team_rank + 1);
 
-            PAPIRes_init (p->PAPI_Results, p->PAPI_Times);
-            PAPI_set_units (p->name, PAPI_units, NUM_PAPI_EVENTS);
+    if(d->algorithm != ISORT_SAMPLE){
+        d->numbers = (uint64_t *)plan_alloc(p, sizeof(uint64_t) * n);
+        if(d->algorithm == ISORT_LSD){
+            d->scratch = (uint64_t *)plan_alloc(p, sizeof(uint64_t) * n);
+        }
+        if(!d->numbers || ((d->algorithm == ISORT_LSD) && !d->scratch)){
+            return make_error(ALLOC, generic_err);
+        }
+        d->sorted = d->numbers;
+        return ERR_CLEAN;
+    }
 
-            TEST_PAPI (PAPI_start (p->PAPI_EventSet), PAPI_OK, MyRank, 9999,
-                       PRINT_SOME);
-            #endif //HAVE_PAPI
-        }                               //DO_PERF
+    team = p->team;
+    P = team->size;
+    d->offsets = (int64_t *)malloc(sizeof(int64_t) * P);
+    if(!d->offsets){
+        return make_error(ALLOC, generic_err);
     }
 
-    if(d){
-        d->numbers = (uint64_t *) malloc (d->array_size * sizeof (uint64_t));
+    pthread_mutex_lock(&(team->lock));
+    s = (ISORTshared *)team->shared;
+    if(s == NULL){
+        s = (ISORTshared *)calloc(1, sizeof(ISORTshared));
+        if(s != NULL){
+            s->total = d->array_size;
+            s->members = P;
+            s->keys = (uint64_t *)plan_alloc(p, sizeof(uint64_t) * s->total);
+            s->scratch = (uint64_t *)plan_alloc(p, sizeof(uint64_t) * s->total);
+            s->samples = (uint64_t *)malloc(sizeof(uint64_t) * P * ISORT_OVERSAMPLE);
+            s->splitters = (uint64_t *)malloc(sizeof(uint64_t) * P);
+            s->counts = (int64_t *)calloc((size_t)P * P, sizeof(int64_t));
+            if(s->keys && s->scratch && s->samples && s->splitters && s->counts){
+                team->shared = s;
+                team->release = ISORT_release;
+            } else {
+                ISORT_release(s);
+                s = NULL;
+            }
+        }
+    }
+    if(s != NULL){
+        s->src_sum += d->src_sum;
     }
-    return ERR_CLEAN;           // <- This indicates a clean run with no errors. Does not need to be changed.
+    pthread_mutex_unlock(&(team->lock));
+
+    d->s = s;
+    return (s != NULL) ? ERR_CLEAN : make_error(ALLOC, generic_err);
 } /* initISORTPlan */
 
-/************************
- * This is where the plan gets executed. Place all operations here.
- ***********************/
 /**
- * \brief <DESCRIPTION of your plan goes here..>
- * \param plan The Plan struct that holds the plan's data values.
+ * \brief Sorts the keys with the plan's algorithm, then optionally checks the result.
+ * \param [in] plan Plan structure holding the data and memory for the plan.
  * \return int Error flag value
+ * \sa parseISORTPlan
+ * \sa makeISORTPlan
+ * \sa initISORTPlan
+ * \sa perfISORTPlan
+ * \sa killISORTPlan
  */
-int execISORTPlan(void *plan){  // <- Replace ISORT with the name of your module.
+int execISORTPlan(void *plan){
     #ifdef HAVE_PAPI
     int k;
     long long start, end;
     #endif //HAVE_PAPI
 
-    int64_t i;
-    ORB_t t1, t2;               // Storage for timestamps, used to accurately find the runtime of the plan execution.
+    int timed;
+    int ret = ERR_CLEAN;
+    int64_t errors;
+    uint64_t bytes = 0, sum;
+    ORB_t t1, t2;
     Plan *p;
     ISORTdata *d;
-    p = (Plan *) plan;
-    d = (ISORTdata *) p->vptr;
-    p->exec_count++;            // Update the execution counter stored in the plan.
-
-    srand48 (0);
-    // seed the array with random numbers
-    for(i = 0; i < d->array_size; i++){
-        d->numbers[i] = lrand48 ();
+    ISORTshared *s;
+    p = (Plan *)plan;
+    d = (ISORTdata *)p->vptr;
+    s = d->s;
+
+    /* a SAMPLE team is timed by its first member, from the start barrier to the end of the sort */
+    timed = DO_PERF && ((s == NULL) || (p->team_rank == 0));
+    if(s == NULL){
+        memcpy(d->numbers, d->source, sizeof(uint64_t) * d->local_size);
+    } else if(plan_team_barrier(p->team) != 0){
+        return ERR_CLEAN;
     }
 
     if(DO_PERF){
         #ifdef HAVE_PAPI
         /* Start PAPI counters and time */
-        TEST_PAPI (PAPI_reset (p->PAPI_EventSet), PAPI_OK, MyRank, 9999,
-                   PRINT_SOME);
-        start = PAPI_get_real_usec ();
+        TEST_PAPI(PAPI_reset(p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
+        start = PAPI_get_real_usec();
         #endif //HAVE_PAPI
-        ORB_read (t1);          // Store the timestamp for the beginning of the execution.
-    }                           //DO_PERF
+    }     //DO_PERF
+    if(timed){
+        ORB_read(t1);
+    }
 
-    isort_quicksort (d->numbers, 0, d->array_size - 1);
+    switch(d->algorithm){
+        case ISORT_LSD:
+            bytes = isort_lsd(d->numbers, d->scratch, d->local_size, &(d->sorted));
+            break;
+        case ISORT_MSD:
+            bytes = isort_msd(d->numbers, d->local_size, 64 - ISORT_DIGIT_BITS);
+            break;
+        case ISORT_SAMPLE:
+            if(isort_team_pass(p, d) != 0){
+                return ERR_CLEAN;       /* a member left, the scheduler is switching plans */
+            }
+            if(p->team_rank == 0){
+                bytes = __atomic_exchange_n(&(s->pass_bytes), 0, __ATOMIC_RELAXED);
+            }
+            break;
+    }
 
+    if(timed){
+        ORB_read(t2);
+        perftimer_accumulate(&p->timers, TIMER0, ORB_cycles_a(t2, t1));
+        perftimer_accumulate(&p->timers, TIMER1, ORB_cycles_a(t2, t1));
+    }
     if(DO_PERF){
-        ORB_read (t2);          // Store timestamp for the end of execution.
-
         #ifdef HAVE_PAPI
-        end = PAPI_get_real_usec ();    //PAPI time
+        end = PAPI_get_real_usec();         //PAPI time
 
         /* Collect PAPI counters and store time elapsed */
-        TEST_PAPI (PAPI_accum (p->PAPI_EventSet, p->PAPI_Results), PAPI_OK,
-                   MyRank, 9999, PRINT_SOME);
+        TEST_PAPI(PAPI_accum(p->PAPI_EventSet, p->PAPI_Results), PAPI_OK, MyRank, 9999, PRINT_SOME);
         for(k = 0; k < p->PAPI_Num_Events && k < TOTAL_PAPI_EVENTS; k++){
             p->PAPI_Times[k] += (end - start);
         }
         #endif //HAVE_PAPI
-        perftimer_accumulate (&p->timers, TIMER0, ORB_cycles_a (t2, t1)); // Store the difference between the timestamps in the plan's timers.
-    }                           //DO_PERF
-
-    if(CHECK_CALC){             // Evaluates to true if the '-t' option is passed on the commandline.
-        if(DO_PERF){
-            ORB_read (t1);
-        }                       //DO_PERF
+    }     //DO_PERF
+    d->bytes += bytes;
+    p->exec_count++;
 
-        // ----------------------------------------------------------------
-        // Optional: Check calculations performed in execution above.
-        // ----------------------------------------------------------------
-
-        if(DO_PERF){
-            ORB_read (t2);
-            perftimer_accumulate (&p->timers, TIMER1, ORB_cycles_a (t2, t1));
-        }                       //DO_PERF
+    if(CHECK_CALC){
+        if(timed){
+            ORB_read(t1);
+        }
+        if(s == NULL){
+            errors = isort_check(d->sorted, d->local_size, &sum);
+            if((errors > 0) || (sum != d->src_sum)){
+                ret = make_error(CALC, generic_err);
+            }
+        } else {
+            /* each member checks its bucket and the boundary with the one before, the first compares the key sums */
+            errors = isort_check(s->keys + d->seg_start, d->seg_size, &sum);
+            if((d->seg_start > 0) && (d->seg_size > 0) && (s->keys[d->seg_start - 1] > s->keys[d->seg_start])){
+                errors++;
+            }
+            __atomic_add_fetch(&(s->out_sum), sum, __ATOMIC_RELAXED);
+            if(plan_team_barrier(p->team) != 0){
+                return ERR_CLEAN;
+            }
+            if(p->team_rank == 0){
+                if(__atomic_exchange_n(&(s->out_sum), 0, __ATOMIC_RELAXED) != s->src_sum){
+                    errors++;
+                }
+            }
+            if(errors > 0){
+                ret = make_error(CALC, generic_err);
+            }
+        }
+        if(timed){
+            ORB_read(t2);
+            perftimer_accumulate(&p->timers, TIMER2, ORB_cycles_a(t2, t1));
+        }
     }
-
-    return ERR_CLEAN;           // <- This inicates a clean run with no errors. Does not need to be changed.
+    return ret;
 } /* execISORTPlan */
 
-/************************
- * This is where everything gets cleaned up. Be sure to free() your data types (free the members first) in addition to the ones included below.
- ***********************/
 /**
- * \brief Frees the memory used in the plan
- * \param plan Holds the information and memory location for the plan.
+ * \brief Frees the memory used in the plan. A SAMPLE team's array is freed by the team once its last member is killed.
+ * \param [in] plan Points to the Plan structure to be freed.
+ * \sa parseISORTPlan
+ * \sa makeISORTPlan
+ * \sa initISORTPlan
+ * \sa execISORTPlan
+ * \sa perfISORTPlan
  */
 void *killISORTPlan(void *plan){
     Plan *p;
     ISORTdata *d;
-    p = (Plan *) plan;
+    p = (Plan *)plan;
+    d = (ISORTdata *)p->vptr;
 
     if(DO_PERF){
         #ifdef HAVE_PAPI
-        TEST_PAPI (PAPI_stop (p->PAPI_EventSet, NULL), PAPI_OK, MyRank, 9999,
-                   PRINT_SOME);
+        TEST_PAPI(PAPI_stop(p->PAPI_EventSet, NULL), PAPI_OK, MyRank, 9999, PRINT_SOME);
         #endif //HAVE_PAPI
-    }                           //DO_PERF
+    }     //DO_PERF
 
-    d = (ISORTdata *) (p->vptr);
-    if(d->numbers){
-        free (d->numbers);
+    plan_free(d->source);
+    plan_free(d->numbers);
+    plan_free(d->scratch);
+    if(d->offsets){
+        free(d->offsets);
     }
-    free ((void *) (p->vptr));
-    free ((void *) (plan));
-
-    return (void *) NULL;
+    free((void *)(d));
+    free((void *)(p));
+    return (void *)NULL;
 } /* killISORTPlan */
 
-/************************
- * This is the parsing function that the program uses to read in your load information from the load file. This lets you have a custom number of int arguments for your module while still maintaining modularity.
- ***********************/
 /**
  * \brief Reads the input file, and pulls out the necessary data for use in the plan
- * \param line The line of input text.
- * \param output The struct that holds the values for the load.
- * \return True if the data was read, false if it wasn't
+ * \param [in] line The input line for the plan.
+ * \param [out] output Holds the data for the load.
+ * \return int True if the data was read, false if it wasn't
+ * \sa makeISORTPlan
+ * \sa initISORTPlan
+ * \sa execISORTPlan
+ * \sa perfISORTPlan
+ * \sa killISORTPlan
  */
-int parseISORTPlan(char *line, LoadPlan *output){ // <- Replace ISORT with the name of your module.
-    output->input_data = get_sizes (line);
-    output->name = ISORT;       // <- Replace ISORT with the name of your module.
-    output->input_data;         // <- Change NUMBER_OF_YOUR_MEMBERS to equal however many int fields your data type holds.
-    return output->input_data->isize + output->input_data->csize + output->input_data->dsize;   // <- Return flag to know whether the parsing succeeded or not. Do not change.
+int parseISORTPlan(char *line, LoadPlan *output){
+    output->input_data = get_sizes(line);
+    output->name = ISORT;
+    return (output->input_data->isize + output->input_data->csize + output->input_data->dsize > 0);
 }
 
 /**
- * \brief Calculate and store performance data for the plan.
- * \param plan The Plan structure that holds the plan's data.
- * \returns Success or failure in calculating the performance.
+ * \brief Stores (and optionally displays) the sort rate in keys per second and the memory traffic of the sorts.
+ * \param [in] plan The Plan structure containing the plan data.
+ * \returns An integer error code.
+ * \sa parseISORTPlan
+ * \sa makeISORTPlan
+ * \sa initISORTPlan
+ * \sa execISORTPlan
+ * \sa killISORTPlan
  */
 int perfISORTPlan(void *plan){
     int ret = ~ERR_CLEAN;
     uint64_t opcounts[NUM_TIMERS];
+    char buffer[MSG_SIZE];
+    double time;
     Plan *p;
     ISORTdata *d;
-    p = (Plan *) plan;
-    d = (ISORTdata *) p->vptr;
-    if(p->exec_count > 0){      // Ensures the plan has been executed at least once...
-        // Assign appropriate plan-specific operation counts to the opcount[] array, such that the
-        // indices correspond with the timers used in the exec function.
-        // FIXME: figure out real operation count, if applicable
-
-        opcounts[TIMER0] = p->exec_count * 1;   // Where operations can be a function of the input size.
+    p = (Plan *)plan;
+    d = (ISORTdata *)p->vptr;
+    /* a SAMPLE sort is reported once, by the member that timed it, for the array of the whole team */
+    if((d->algorithm == ISORT_SAMPLE) && (p->team_rank != 0)){
+        return ERR_CLEAN;
+    }
+    if(p->exec_count > 0){
+        opcounts[TIMER0] = d->array_size * p->exec_count;         // keys sorted
+        opcounts[TIMER1] = d->bytes;                               // bytes read and written by the sorts
+        opcounts[TIMER2] = 0;
 
-        perf_table_update (&p->timers, opcounts, p->name);      // Updates the global table with the performance data.
+        perf_table_update(&p->timers, opcounts, p->name);
         #ifdef HAVE_PAPI
-        PAPI_table_update (p->name, p->PAPI_Results, p->PAPI_Times,
-                           p->PAPI_Num_Events);
+        PAPI_table_update(p->name, p->PAPI_Results, p->PAPI_Times, p->PAPI_Num_Events);
         #endif //HAVE_PAPI
 
-        double flops = ((double) opcounts[TIMER0] / perftimer_gettime (&p->timers, TIMER0)) / 1e6;      // Example for computing MFLOPS
-        EmitLogfs (MyRank, 9999, "YOUR_PLAN plan performance:", flops, "MFLOPS", PRINT_SOME);   // Displays calculated performance when the '-v2' command line option is passed.
-        EmitLog (MyRank, 9999, "YOUR_PLAN execution count :", p->exec_count,
-                 PRINT_SOME);
+        time = perftimer_gettime(&p->timers, TIMER0);
+        snprintf(buffer, MSG_SIZE, "ISORT algorithm         : %s", isort_algorithms[d->algorithm]);
+        EmitLog  (MyRank, 9999, buffer, -1, PRINT_SOME);
+        if((d->algorithm == ISORT_SAMPLE) && (p->team != NULL)){
+            EmitLog(MyRank, 9999, "ISORT team of workers         :", p->team->size, PRINT_SOME);
+        }
+        EmitLogfs(MyRank, 9999, "ISORT plan performance  :", ((double)opcounts[TIMER0] / time) / 1e6, "MKeys/s", PRINT_SOME);
+        EmitLogfs(MyRank, 9999, "ISORT memory traffic    :", ((double)opcounts[TIMER1] / time) / 1e6, "MB/s", PRINT_SOME);
+        EmitLog  (MyRank, 9999, "ISORT execution count   :", p->exec_count, PRINT_SOME);
         ret = ERR_CLEAN;
     }
     return ret;
 } /* perfISORTPlan */
 
 /**
- * \brief Holds the custom error messages for the plan
+ * \brief The data structure for the plan. Holds the input and all used info.
  */
-// This is not necessary; if you do not have any errors other than allocation or computation, remove this and leave its spot NULL in the plan_info stuct below
-char *YOUR_ERRORS[] = {
-    "ERROR message goes here"
-};
-
 plan_info ISORT_info = {
-    "ISORT",                    //ISORT
-    NULL,                       //YOUR_ERRORS (if applicable. If not, leave NULL.)
-    0,                          // Size of ^
+    "ISORT",
+    NULL,
+    0,
     makeISORTPlan,
     parseISORTPlan,
     execISORTPlan,
     initISORTPlan,
     killISORTPlan,
     perfISORTPlan,
-    {NULL, NULL, NULL}          //YOUR_UNITS strings naming the units of each timer value (leave NULL if unneeded)
+    { "Keys/s", "B/s", NULL, NULL, NULL, NULL }
 };
@@ -28,13 +28,55 @@ extern void *killISORTPlan(void *p);
 extern int parseISORTPlan(char *line, LoadPlan *output);
 extern int perfISORTPlan(void *p);
 extern plan_info ISORT_info;
-//If there are other functions to be used by your module, declare the prototypes here. Examples in plan_dstream.h and plan_istream.h
 
-//Below is a sample data structure. This is optional, but your module will probably need some form of input to function.
+/* radix sort digit width; 8 bit digits keep every histogram (and all 8 of them) within L1 */
+#define ISORT_DIGIT_BITS 8
+#define ISORT_RADIX      (1 << ISORT_DIGIT_BITS)
+#define ISORT_DIGITS     (64 / ISORT_DIGIT_BITS)
+/* buckets of at most this many keys are finished with an insertion sort by the MSD radix sort */
+#define ISORT_SMALL      32
+/* samples contributed by each member of a SAMPLE sort team when choosing splitters */
+#define ISORT_OVERSAMPLE 64
 
+/**
+ * \brief Sorting algorithms of the ISORT plan.
+ */
+enum {
+    ISORT_LSD,          /**< Least significant digit first radix sort through a scratch array.     */
+    ISORT_MSD,          /**< In-place most significant digit first radix sort (American flag).     */
+    ISORT_SAMPLE        /**< Sample sort of one array by all copies of the PLAN line together.     */
+};
+
+/**
+ * \brief The array sorted by a SAMPLE sort team, with the splitters and bucket counts the members exchange.
+ */
+typedef struct {
+    int64_t total;              /**< Keys sorted by the team.                                      */
+    int members;
+    uint64_t *keys, *scratch;   /**< The sorted array and the radix sort scratch space for it.     */
+    uint64_t *samples;          /**< ISORT_OVERSAMPLE keys from each member.                       */
+    uint64_t *splitters;        /**< members - 1 bucket boundaries.                                */
+    int64_t *counts;            /**< Keys each member sends to each bucket, members x members.     */
+    uint64_t src_sum, out_sum;  /**< Key sums before and after sorting, for the check.             */
+    uint64_t pass_bytes;        /**< Bytes moved by all members in the current pass.               */
+} ISORTshared;
+
+/**
+ * \brief The data structure for the plan. Holds the input and all used info.
+ */
 typedef struct {
-    int64_t array_size;      // <- Replace YOUR_MEMBER with your member's name. This int field is necessary to be compatable with systemburn.
-    uint64_t *numbers;
-} ISORTdata; // <- Replace YOUR_DATA_STRUCTURE_NAME with the desired name of your data structure.
+    int64_t array_size;         /**< Keys sorted by this plan, or by the whole team for SAMPLE.    */
+    int64_t local_size;         /**< Keys this plan generates.                                     */
+    int algorithm;
+    uint64_t *source;           /**< Random keys, generated once at init.                          */
+    uint64_t *numbers;          /**< Copy of source sorted by LSD and MSD.                         */
+    uint64_t *scratch;          /**< LSD scratch space.                                            */
+    uint64_t *sorted;           /**< Where the last LSD or MSD sort left the keys.                 */
+    uint64_t src_sum;           /**< Sum of the keys in source, for the check.                     */
+    uint64_t bytes;             /**< Bytes read and written by the timed sorts.                    */
+    int64_t *offsets;           /**< SAMPLE scatter position of each bucket.                       */
+    int64_t seg_start, seg_size;/**< The part of the team's array this member sorted last.         */
+    ISORTshared *s;
+} ISORTdata;
 
 #endif /* __PLAN_ISORT_H */
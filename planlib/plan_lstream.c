@@ -21,6 +21,16 @@
 #include <systemheaders.h>
 #include <systemburn.h>
 #include <planheaders.h>
+#ifdef PLAN_X86_SIMD
+  #include <immintrin.h>
+#endif
+
+/* the STREAM scalar; the arrays simply wrap around, and the vector kernels assume it fits in 32 bits */
+#define LSTREAM_SCALAR 3
+
+static char *lstream_kernels[] = {
+    "Copy", "Scale", "Add", "Triad", "Shift"
+};
 
 #ifdef HAVE_PAPI
   #define NUM_PAPI_EVENTS 1
@@ -28,6 +38,215 @@
   #define PAPI_UNITS { "FLOPS" }
 #endif //HAVE_PAPI
 
+/**
+ * \brief Runs one LSTREAM kernel in plain C. The arithmetic is done unsigned, so that it wraps around.
+ * \param k The kernel, STREAM_COPY, STREAM_SCALE, STREAM_ADD, STREAM_TRIAD or STREAM_SHIFT.
+ * \param dst The array written.
+ * \param x The first array read.
+ * \param y The second array read (Add and Triad only).
+ * \param s The scalar.
+ * \param shift The shift count for STREAM_SHIFT.
+ * \param n The number of elements.
+ */
+static void LStreamKernel(int k, long int *dst, long int *x, long int *y, long int s, int shift, size_t n){
+    size_t i;
+    unsigned long *ud = (unsigned long *)dst, *ux = (unsigned long *)x, *uy = (unsigned long *)y;
+    unsigned long us = (unsigned long)s;
+    switch(k){
+    case STREAM_COPY:
+        for(i = 0; i < n; i++){
+            ud[i] = ux[i];
+        }
+        break;
+    case STREAM_SCALE:
+        for(i = 0; i < n; i++){
+            ud[i] = us * ux[i];
+        }
+        break;
+    case STREAM_ADD:
+        for(i = 0; i < n; i++){
+            ud[i] = ux[i] + uy[i];
+        }
+        break;
+    case STREAM_TRIAD:
+        for(i = 0; i < n; i++){
+            ud[i] = ux[i] + us * uy[i];
+        }
+        break;
+    case STREAM_SHIFT:
+        for(i = 0; i < n; i++){
+            ud[i] = ux[i] << shift;
+        }
+        break;
+    }
+} /* LStreamKernel */
+
+#ifdef PLAN_X86_SIMD
+/*
+ * The vector versions run the scalar kernel up to the first element of dst
+ * on a vector boundary (streaming stores need it), then whole vectors, then
+ * the scalar kernel again for the tail. There is no 64 bit multiply below
+ * AVX-512DQ, so it is built from two 32x32->64 bit multiplies.
+ */
+  #define LSTREAM_HEAD(W)                                                     \
+    i = ((W * sizeof(long int)) - ((uintptr_t)dst % (W * sizeof(long int)))) % (W * sizeof(long int)) / sizeof(long int); \
+    if(i > n){                                                                \
+        i = n;                                                                \
+    }                                                                         \
+    LStreamKernel(k, dst, x, y, s, shift, i);
+
+  #define LSTREAM_BODY(W, LOAD, STORE, ADD, MUL, SHL)                         \
+    switch(k){                                                                \
+    case STREAM_COPY:                                                         \
+        for(; i + W <= n; i += W){                                            \
+            STORE(dst + i, LOAD(x + i));                                      \
+        }                                                                     \
+        break;                                                                \
+    case STREAM_SCALE:                                                        \
+        for(; i + W <= n; i += W){                                            \
+            STORE(dst + i, MUL(LOAD(x + i), vs));                             \
+        }                                                                     \
+        break;                                                                \
+    case STREAM_ADD:                                                          \
+        for(; i + W <= n; i += W){                                            \
+            STORE(dst + i, ADD(LOAD(x + i), LOAD(y + i)));                    \
+        }                                                                     \
+        break;                                                                \
+    case STREAM_TRIAD:                                                        \
+        for(; i + W <= n; i += W){                                            \
+            STORE(dst + i, ADD(LOAD(x + i), MUL(LOAD(y + i), vs)));           \
+        }                                                                     \
+        break;                                                                \
+    case STREAM_SHIFT:                                                        \
+        for(; i + W <= n; i += W){                                            \
+            STORE(dst + i, SHL(LOAD(x + i), count));                          \
+        }                                                                     \
+        break;                                                                \
+    }
+
+  #define SSE2_LOAD(p)         _mm_loadu_si128((__m128i *)(p))
+  #define SSE2_STORE(p, v)     _mm_store_si128((__m128i *)(p), (v))
+  #define SSE2_STREAM(p, v)    _mm_stream_si128((__m128i *)(p), (v))
+  #define AVX2_LOAD(p)         _mm256_loadu_si256((__m256i *)(p))
+  #define AVX2_STORE(p, v)     _mm256_store_si256((__m256i *)(p), (v))
+  #define AVX2_STREAM(p, v)    _mm256_stream_si256((__m256i *)(p), (v))
+  #define AVX512_LOAD(p)       _mm512_loadu_si512((void *)(p))
+  #define AVX512_STORE(p, v)   _mm512_store_si512((void *)(p), (v))
+  #define AVX512_STREAM(p, v)  _mm512_stream_si512((void *)(p), (v))
+
+__attribute__((target("sse2")))
+static inline __m128i LStreamMulSSE2(__m128i a, __m128i s){
+    return _mm_add_epi64(_mm_mul_epu32(a, s), _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), s), 32));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i LStreamMulAVX2(__m256i a, __m256i s){
+    return _mm256_add_epi64(_mm256_mul_epu32(a, s), _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), s), 32));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i LStreamMulAVX512(__m512i a, __m512i s){
+    return _mm512_add_epi64(_mm512_mul_epu32(a, s), _mm512_slli_epi64(_mm512_mul_epu32(_mm512_srli_epi64(a, 32), s), 32));
+}
+
+/**
+ * \brief Runs one LSTREAM kernel with SSE2, see LStreamKernel.
+ * \param nt Use streaming stores.
+ */
+__attribute__((target("sse2")))
+static void LStreamKernelSSE2(int k, long int *dst, long int *x, long int *y, long int s, int shift, size_t n, int nt){
+    size_t i;
+    __m128i vs = _mm_set1_epi64x(s), count = _mm_cvtsi32_si128(shift);
+    LSTREAM_HEAD(2);
+    if(nt){
+        LSTREAM_BODY(2, SSE2_LOAD, SSE2_STREAM, _mm_add_epi64, LStreamMulSSE2, _mm_sll_epi64);
+        _mm_sfence();
+    } else {
+        LSTREAM_BODY(2, SSE2_LOAD, SSE2_STORE, _mm_add_epi64, LStreamMulSSE2, _mm_sll_epi64);
+    }
+    LStreamKernel(k, dst + i, x + i, (y != NULL) ? y + i : NULL, s, shift, n - i);
+} /* LStreamKernelSSE2 */
+
+/**
+ * \brief Runs one LSTREAM kernel with AVX2, see LStreamKernel.
+ * \param nt Use streaming stores.
+ */
+__attribute__((target("avx2")))
+static void LStreamKernelAVX2(int k, long int *dst, long int *x, long int *y, long int s, int shift, size_t n, int nt){
+    size_t i;
+    __m256i vs = _mm256_set1_epi64x(s);
+    __m128i count = _mm_cvtsi32_si128(shift);
+    LSTREAM_HEAD(4);
+    if(nt){
+        LSTREAM_BODY(4, AVX2_LOAD, AVX2_STREAM, _mm256_add_epi64, LStreamMulAVX2, _mm256_sll_epi64);
+        _mm_sfence();
+    } else {
+        LSTREAM_BODY(4, AVX2_LOAD, AVX2_STORE, _mm256_add_epi64, LStreamMulAVX2, _mm256_sll_epi64);
+    }
+    LStreamKernel(k, dst + i, x + i, (y != NULL) ? y + i : NULL, s, shift, n - i);
+} /* LStreamKernelAVX2 */
+
+/**
+ * \brief Runs one LSTREAM kernel with AVX-512, see LStreamKernel.
+ * \param nt Use streaming stores.
+ */
+__attribute__((target("avx512f")))
+static void LStreamKernelAVX512(int k, long int *dst, long int *x, long int *y, long int s, int shift, size_t n, int nt){
+    size_t i;
+    __m512i vs = _mm512_set1_epi64(s);
+    __m128i count = _mm_cvtsi32_si128(shift);
+    LSTREAM_HEAD(8);
+    if(nt){
+        LSTREAM_BODY(8, AVX512_LOAD, AVX512_STREAM, _mm512_add_epi64, LStreamMulAVX512, _mm512_sll_epi64);
+        _mm_sfence();
+    } else {
+        LSTREAM_BODY(8, AVX512_LOAD, AVX512_STORE, _mm512_add_epi64, LStreamMulAVX512, _mm512_sll_epi64);
+    }
+    LStreamKernel(k, dst + i, x + i, (y != NULL) ? y + i : NULL, s, shift, n - i);
+} /* LStreamKernelAVX512 */
+#endif /* PLAN_X86_SIMD */
+
+/**
+ * \brief Runs one LSTREAM kernel with the instruction set chosen for the plan.
+ * \param d The plan data.
+ * \param k The kernel, STREAM_COPY through STREAM_SHIFT.
+ */
+static void LStreamRun(LStreamdata *d, int k){
+    long int *dst, *x, *y = NULL;
+
+    switch(k){
+    case STREAM_COPY:
+        dst = d->three; x = d->one;
+        break;
+    case STREAM_SCALE:
+        dst = d->two; x = d->three;
+        break;
+    case STREAM_ADD:
+        dst = d->three; x = d->one; y = d->two;
+        break;
+    case STREAM_TRIAD:
+        dst = d->one; x = d->two; y = d->three;
+        break;
+    default:
+        dst = d->five; x = d->four;
+        break;
+    }
+    #ifdef PLAN_X86_SIMD
+    switch(d->simd){
+    case SIMD_AVX512:
+        LStreamKernelAVX512(k, dst, x, y, d->scalar, d->shift, d->M, d->nt);
+        return;
+    case SIMD_AVX2:
+        LStreamKernelAVX2(k, dst, x, y, d->scalar, d->shift, d->M, d->nt);
+        return;
+    case SIMD_SSE2:
+        LStreamKernelSSE2(k, dst, x, y, d->scalar, d->shift, d->M, d->nt);
+        return;
+    }
+    #endif
+    LStreamKernel(k, dst, x, y, d->scalar, d->shift, d->M);
+} /* LStreamRun */
+
 /**
  * \brief Checks the values calulated in exec to see if there are any errors.
  * \param vptr The data used for the error checking.
@@ -37,35 +256,24 @@
 int LStreamCheck(void *vptr){
     LStreamdata *d;
     d = (LStreamdata *)vptr;
-    long int cutoff,asum,bsum,csum;
-    register int j;
-    long int a = 1, b = 2, c = 0;
+    unsigned long asum,bsum,csum,s;
+    register size_t j;
     int ret = ERR_CLEAN;
-    c = a;
-    b = d->random * c;
-    c = a + b;
-    a = b + d->random * c;
-    a *= d->M;
-    b *= d->M;
-    c *= d->M;
-
-    asum = bsum = csum = 0.0;
+
+    /* after one pass b = s * a0, c = a0 + b and a = b + s * c, for the a0 the pass started from; exact modulo 2^64 */
+    asum = bsum = csum = 0;
     for(j = 0; j < d->M; j++){
-        asum += (long int) d->one[j];
-        bsum += (long int) d->two[j];
-        csum += (long int) d->three[j];
+        asum += (unsigned long) d->one[j];
+        bsum += (unsigned long) d->two[j];
+        csum += (unsigned long) d->three[j];
     }
+    s = (unsigned long) d->scalar;
 
-    #ifndef abs
-  #define abs(a) ((a) >= 0 ? (a) : -(a))
-    #endif
-
-    cutoff = 1.e-8;
-    if(abs(a - asum) / asum > cutoff){
+    if(bsum != s * (csum - bsum)){
         ret = make_error(CALC,generic_err);
-    } else if(abs(b - bsum) / bsum > cutoff){
+    } else if(asum != bsum + s * csum){
         ret = make_error(CALC,generic_err);
-    } else if(abs(c - csum) / csum > cutoff){
+    } else if((d->M > 0) && ((unsigned long)d->five[d->M - 1] != ((unsigned long)d->four[d->M - 1] << d->shift))){
         ret = make_error(CALC,generic_err);
     }
     return ret;
@@ -100,6 +308,12 @@ void *makeLStreamPlan(data *m){
             } else {
                 d->M = m->d[0] / (5 * sizeof(long int));
             }
+            d->scalar = LSTREAM_SCALAR;
+            d->shift = LSTREAM_SCALAR;
+            d->simd = plan_simd_select(m);
+            d->nt = plan_has_token(m, "NT");
+            d->team_mode = plan_has_token(m, "TEAM");
+            d->M_total = d->M;
         }
         (p->vptr) = (void *)d;
     }
@@ -117,7 +331,7 @@ void *makeLStreamPlan(data *m){
  * \sa killLStreamPlan
  */
 int initLStreamPlan(void *plan){
-    size_t M;
+    size_t M, j;
     int ret = make_error(ALLOC,generic_err);
     Plan *p;
     LStreamdata *d = NULL;
@@ -161,18 +375,30 @@ int initLStreamPlan(void *plan){
         }         //DO_PERF
     }
     if(d){
+        /* in TEAM mode each member allocates, and so places, only its own page aligned share of the arrays */
+        if(d->team_mode){
+            d->M = plan_team_share(p->team, p->team_rank, d->M_total, sysconf(_SC_PAGESIZE) / sizeof(long int));
+        }
         M = d->M;
-        d->one = (long int *)  malloc(sizeof(long int) * M);
+        d->one = (long int *)  plan_alloc(p, sizeof(long int) * ((M > 0) ? M : 1));
         assert(d->one);
-        d->two = (long int *)  malloc(sizeof(long int) * M);
+        d->two = (long int *)  plan_alloc(p, sizeof(long int) * ((M > 0) ? M : 1));
         assert(d->two);
-        d->three = (long int *)  malloc(sizeof(long int) * M);
+        d->three = (long int *)  plan_alloc(p, sizeof(long int) * ((M > 0) ? M : 1));
         assert(d->three);
-        d->four = (long int *)  malloc(sizeof(long int) * M);
+        d->four = (long int *)  plan_alloc(p, sizeof(long int) * ((M > 0) ? M : 1));
         assert(d->four);
-        d->five = (long int *)  malloc(sizeof(long int) * M);
+        d->five = (long int *)  plan_alloc(p, sizeof(long int) * ((M > 0) ? M : 1));
         assert(d->five);
         if(d->one && d->two && d->three && d->four && d->five){
+            /* done once; the passes just keep wrapping the values around */
+            for(j = 0; j < M; j++){
+                d->one[j] = 1;
+                d->two[j] = 2;
+                d->three[j] = 0;
+                d->four[j] = 1;
+                d->five[j] = 0;
+            }
             ret = ERR_CLEAN;
         }
     }
@@ -201,19 +427,19 @@ void *killLStreamPlan(void *plan){
     }     //DO_PERF
 
     if(d->one){
-        free(d->one);
+        plan_free(d->one);
     }
     if(d->two){
-        free(d->two);
+        plan_free(d->two);
     }
     if(d->three){
-        free(d->three);
+        plan_free(d->three);
     }
     if(d->four){
-        free(d->four);
+        plan_free(d->four);
     }
     if(d->five){
-        free(d->five);
+        plan_free(d->five);
     }
     free(d);
     free(p);
@@ -232,28 +458,25 @@ void *killLStreamPlan(void *plan){
  */
 int execLStreamPlan(void *plan){
     #ifdef HAVE_PAPI
-    int k;
+    int pk;
     long long start, end;
     #endif //HAVE_PAPI
 
+    int k, timed;
     int ret = ERR_CLEAN;
-    register size_t i;
+    ORB_tick_t ticks[NUM_TIMERS];
+    PlanTeam *team;
     ORB_t t1, t2;
     Plan *p;
     LStreamdata *d;
     p = (Plan *)plan;
     d = (LStreamdata *)p->vptr;
 
-    /* update execution count */
-    p->exec_count++;
-
-    for(i = 0; i < d->M; i++){
-        d->one[i] = 1;
-        d->two[i] = 2;
-        d->three[i] = 0;
-        d->four[i] = 1;
-        d->five[i] = 0;
-        d->random = rand();
+    /* in TEAM mode the members run each kernel together; the first one times the whole team */
+    team = d->team_mode ? p->team : NULL;
+    timed = DO_PERF && ((team == NULL) || (p->team_rank == 0));
+    if(plan_team_barrier(team) != 0){
+        return ERR_CLEAN;
     }
 
     if(DO_PERF){
@@ -262,47 +485,41 @@ int execLStreamPlan(void *plan){
         TEST_PAPI(PAPI_reset(p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
         start = PAPI_get_real_usec();
         #endif //HAVE_PAPI
-        ORB_read(t1);
     }     //DO_PERF
 
-    //Copy
-    for(i = 0; i < d->M; i++){
-        d->three[i] = d->one[i];
-    }
-
-    //Scale
-    for(i = 0; i < d->M; i++){
-        d->two[i] = d->three[i] * d->random;
-    }
-
-    //Add
-    for(i = 0; i < d->M; i++){
-        d->three[i] = d->one[i] + d->two[i];
+    /* Copy, Scale, Add, Triad, Shifting Scale */
+    for(k = STREAM_COPY; k <= STREAM_SHIFT; k++){
+        if(timed){
+            ORB_read(t1);
+        }
+        LStreamRun(d, k);
+        if(plan_team_barrier(team) != 0){
+            return ERR_CLEAN;       /* a member left, the scheduler is switching plans */
+        }
+        if(timed){
+            ORB_read(t2);
+            ticks[k] = ORB_cycles_a(t2, t1);
+        }
     }
-
-    //Triad
-    for(i = 0; i < d->M; i++){
-        d->one[i] = d->two[i] + d->random * d->three[i];
+    if(timed){
+        for(k = STREAM_COPY; k <= STREAM_SHIFT; k++){
+            perftimer_accumulate(&p->timers, (perf_time_index)k, ticks[k]);
+        }
     }
 
-    //Shifting Scale
-    for(i = 0; i < d->M; i++){
-        d->five[i] = d->four[i] << d->random;
-    }
+    /* update execution count */
+    p->exec_count++;
 
     if(DO_PERF){
-        ORB_read(t2);
         #ifdef HAVE_PAPI
         end = PAPI_get_real_usec();         //PAPI time
 
         /* Collect PAPI counters and store time elapsed */
         TEST_PAPI(PAPI_accum(p->PAPI_EventSet, p->PAPI_Results), PAPI_OK, MyRank, 9999, PRINT_SOME);
-        for(k = 0; k < p->PAPI_Num_Events && k < TOTAL_PAPI_EVENTS; k++){
-            p->PAPI_Times[k] += (end - start);
+        for(pk = 0; pk < p->PAPI_Num_Events && pk < TOTAL_PAPI_EVENTS; pk++){
+            p->PAPI_Times[pk] += (end - start);
         }
         #endif //HAVE_PAPI
-        perftimer_accumulate(&p->timers, TIMER0, ORB_cycles_a(t2, t1));
-        perftimer_accumulate(&p->timers, TIMER1, ORB_cycles_a(t2, t1));
     }     //DO PERF
 
     if(CHECK_CALC){
@@ -310,11 +527,13 @@ int execLStreamPlan(void *plan){
             ORB_read(t1);
         }         //DO_PERF
 
-        ret = LStreamCheck(d);
+        if(d->M > 0){
+            ret = LStreamCheck(d);
+        }
 
         if(DO_PERF){
             ORB_read(t2);
-            perftimer_accumulate(&p->timers, TIMER2, ORB_cycles_a(t2, t1));
+            perftimer_accumulate(&p->timers, (perf_time_index)STREAM_CHECK, ORB_cycles_a(t2, t1));
         }         //DO_PERF
     }
     return ret;
@@ -332,26 +551,48 @@ int execLStreamPlan(void *plan){
  */
 int perfLStreamPlan(void *plan){
     int ret = ~ERR_CLEAN;
+    int k;
     uint64_t opcounts[NUM_TIMERS];
+    double time, total = 0.0;
+    size_t M;
+    char buffer[MSG_SIZE];
     Plan *p;
     LStreamdata *d;
     p = (Plan *)plan;
     d = (LStreamdata *)p->vptr;
+    /* a TEAM mode run is reported once, by the member that timed it, for the arrays of the whole team */
+    if(d->team_mode && (p->team != NULL) && (p->team_rank != 0)){
+        return ERR_CLEAN;
+    }
+    M = d->team_mode ? d->M_total : d->M;
     if(p->exec_count > 0){
         // Reference: http://www.cs.virginia.edu/stream/ref.html "Counting Bytes and FLOPS"
-        opcounts[TIMER0] = (0 + 1 + 1 + 2) * d->M * p->exec_count;                            // Count # of integer operations
-        opcounts[TIMER1] = (2 + 2 + 3 + 3) * sizeof(long int) * d->M * p->exec_count;         // Count # of bytes transferred to and from memory
-        opcounts[TIMER2] = (3 * d->M + 7) * p->exec_count;                                    // Count integer operations in checking stage (needs work)
+        opcounts[STREAM_COPY]  = 2 * sizeof(long int) * M * p->exec_count;   // Count # of bytes transferred to and from memory by each kernel
+        opcounts[STREAM_SCALE] = 2 * sizeof(long int) * M * p->exec_count;
+        opcounts[STREAM_ADD]   = 3 * sizeof(long int) * M * p->exec_count;
+        opcounts[STREAM_TRIAD] = 3 * sizeof(long int) * M * p->exec_count;
+        opcounts[STREAM_SHIFT] = 2 * sizeof(long int) * M * p->exec_count;
+        opcounts[STREAM_CHECK] = (3 * d->M + 7) * p->exec_count;               // Count integer operations in checking stage (needs work)
 
         perf_table_update(&p->timers, opcounts, p->name);
         #ifdef HAVE_PAPI
         PAPI_table_update(p->name, p->PAPI_Results, p->PAPI_Times, p->PAPI_Num_Events);
         #endif     //HAVE_PAPI
 
-        double ips = ((double)opcounts[TIMER0] / perftimer_gettime(&p->timers, TIMER0)) / 1e6;
-        double mbps = ((double)opcounts[TIMER1] / perftimer_gettime(&p->timers, TIMER1)) / 1e6;
-        EmitLogfs(MyRank, 9999, "LSTREAM plan performance:", ips, "MI64OPS", PRINT_SOME);
-        EmitLogfs(MyRank, 9999, "LSTREAM plan performance:", mbps, "MB/s", PRINT_SOME);
+        snprintf(buffer, MSG_SIZE, "LSTREAM kernels         : %s%s", plan_simd_name(d->simd), d->nt ? ", streaming stores" : "");
+        EmitLog  (MyRank, 9999, buffer, -1, PRINT_SOME);
+        if(d->team_mode && (p->team != NULL)){
+            EmitLog(MyRank, 9999, "LSTREAM team of workers       :", p->team->size, PRINT_SOME);
+        }
+        for(k = STREAM_COPY; k <= STREAM_SHIFT; k++){
+            time = perftimer_gettime(&p->timers, (perf_time_index)k);
+            if(k <= STREAM_TRIAD){
+                total += time;
+            }
+            snprintf(buffer, MSG_SIZE, "LSTREAM %-5s performance:", lstream_kernels[k]);
+            EmitLogfs(MyRank, 9999, buffer, ((double)opcounts[k] / time) / 1e6, "MB/s", PRINT_SOME);
+        }
+        EmitLogfs(MyRank, 9999, "LSTREAM plan performance:", ((double)((0 + 1 + 1 + 2) * M * p->exec_count) / total) / 1e6, "MI64OPS", PRINT_SOME);
         EmitLog  (MyRank, 9999, "LSTREAM execution count :", p->exec_count, PRINT_SOME);
         ret = ERR_CLEAN;
     }
@@ -388,6 +629,6 @@ plan_info LSTREAM_info = {
     initLStreamPlan,
     killLStreamPlan,
     perfLStreamPlan,
-    { "I64OPS", "B/s", NULL }
+    { "B/s Copy", "B/s Scale", "B/s Add", "B/s Triad", "B/s Shift", "OPS Check" }
 };
 
@@ -42,13 +42,15 @@ void LSet(long int *a, long int *b, int m){
 }
 
 /**
- * \brief Fills the indices of a with random values
+ * \brief Fills the indices of a with random values, pushing the strided arrays out of the caches.
  * \param [out] a Array to be initialized.
+ * \param [in] n Size of a.
  */
-void LFill(long int *a){
-    int i;
-    for(i = 0; i < CACHE; i++){
-        a[i] = rand();
+void LFill(long int *a, size_t n){
+    size_t i;
+    long int seed = rand();
+    for(i = 0; i < n; i++){
+        a[i] = seed + i;
     }
 }
 
@@ -81,6 +83,7 @@ void *makeLStridePlan(data *m){
             } else {
                 d->M = m->d[0] / (2 * sizeof(long int));
             }
+            StrideOptions(m, &d->o, d->M * 2 * sizeof(long int), sizeof(long int));
         }
         (p->vptr) = (void *)d;
     }
@@ -141,18 +144,22 @@ int initLStridePlan(void *plan){
             #endif //HAVE_PAPI
         }         //DO_PERF
     }
-    if(d){
+    if(d && d->o.latency){
+        d->one = d->two = d->three = NULL;
+        ret = StrideChainInit(p, &d->o, d->M * 2 * sizeof(long int));
+    } else if(d){
         M = d->M;
 
         //EmitLog(MyRank,111,"Allocating",sizeof(long int)*(M*2+CACHE),0);
 
-        d->one = (long int *) malloc(sizeof(long int) * M);
+        d->one = (long int *) plan_alloc(p, sizeof(long int) * M);
         assert(d->one);
-        d->two = (long int *) malloc(sizeof(long int) * M);
+        d->two = (long int *) plan_alloc(p, sizeof(long int) * M);
         assert(d->two);
-        d->three = (long int *) malloc(sizeof(long int) * CACHE);
+        d->three = (long int *) plan_alloc(p, sizeof(long int) * (d->o.flush ? d->o.flush : 1));
         assert(d->three);
         if(d->one && d->two && d->three){
+            d->three[0] = 1;
             ret = ERR_CLEAN;
         }
         srand(0);
@@ -183,13 +190,16 @@ void *killLStridePlan(void *plan){
     }     //DO_PERF
 
     if(d->one){
-        free(d->one);
+        plan_free(d->one);
     }
     if(d->two){
-        free(d->two);
+        plan_free(d->two);
     }
     if(d->three){
-        free(d->three);
+        plan_free(d->three);
+    }
+    if(d->o.chain){
+        plan_free(d->o.chain);
     }
     free(d);
     free(p);
@@ -216,55 +226,60 @@ int execLStridePlan(void *plan){
     LStridedata *d;
     p = (Plan *)plan;
     d = (LStridedata *)p->vptr;
-    size_t i,k,r, Inc[] = {
-        1,2,8,64,512,1028,2056,4112,16448,32896
-    };
-    long int sum = 0;
+    size_t i, s;
+    int k, r;
+    long int sum = 0, expected = 0;
     int ret = ERR_CLEAN;
     ORB_t t1, t2;
     /* update execution count */
     p->exec_count++;
 
+    if(d->o.latency){
+        StrideLatency(p, &d->o);
+        return ret;
+    }
+
     LSet(d->one,d->two,d->M);
-    LFill(d->three);
 
-    if(DO_PERF){
-        #ifdef HAVE_PAPI
-        /* Start PAPI counters and time */
-        TEST_PAPI(PAPI_reset(p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
-        start = PAPI_get_real_usec();
-        #endif //HAVE_PAPI
-        ORB_read(t1);
-    }     //DO_PERF
+    /* each stride starts from flushed caches and is timed on its own */
+    for(r = 0; r < d->o.nstrides; r++){
+        s = d->o.stride[r];
+        LFill(d->three, d->o.flush);
+        if(DO_PERF){
+            #ifdef HAVE_PAPI
+            /* Start PAPI counters and time */
+            TEST_PAPI(PAPI_reset(p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
+            start = PAPI_get_real_usec();
+            #endif //HAVE_PAPI
+            ORB_read(t1);
+        }     //DO_PERF
 
-    for(k = 0; k < REPEAT; k++){
-        for(r = 0; r < 10; r++){
-            for(i = 0; i < d->M; i += Inc[r]){
+        for(k = 0; k < d->o.repeat; k++){
+            for(i = 0; i < d->M; i += s){
                 sum += d->one[i] * d->two[i];
             }
             sum += d->three[0];
         }
-        sum++;
-    }
 
-    if(DO_PERF){
-        ORB_read(t2);
+        if(DO_PERF){
+            ORB_read(t2);
 
-        #ifdef HAVE_PAPI
-        end = PAPI_get_real_usec();         //PAPI time
+            #ifdef HAVE_PAPI
+            end = PAPI_get_real_usec();         //PAPI time
 
-        /* Collect PAPI counters and store time elapsed */
-        TEST_PAPI(PAPI_accum(p->PAPI_EventSet, p->PAPI_Results), PAPI_OK, MyRank, 9999, PRINT_SOME);
-        for(j = 0; j < p->PAPI_Num_Events && j < TOTAL_PAPI_EVENTS; j++){
-            p->PAPI_Times[j] += (end - start);
-        }
-        #endif //HAVE_PAPI
-        perftimer_accumulate(&p->timers, TIMER0, ORB_cycles_a(t2, t1));
-        perftimer_accumulate(&p->timers, TIMER1, ORB_cycles_a(t2, t1));
-    }     //DO_PERF
+            /* Collect PAPI counters and store time elapsed */
+            TEST_PAPI(PAPI_accum(p->PAPI_EventSet, p->PAPI_Results), PAPI_OK, MyRank, 9999, PRINT_SOME);
+            for(j = 0; j < p->PAPI_Num_Events && j < TOTAL_PAPI_EVENTS; j++){
+                p->PAPI_Times[j] += (end - start);
+            }
+            #endif //HAVE_PAPI
+            perftimer_accumulate(&p->timers, (perf_time_index)r, ORB_cycles_a(t2, t1));
+        }     //DO_PERF
+        expected += d->o.repeat * d->three[0];
+    }
 
     if(CHECK_CALC){
-        ret = (sum == (REPEAT * (1 + 10 * d->three[0]))) ? ERR_CLEAN : make_error(CALC, generic_err);
+        ret = (sum == expected) ? ERR_CLEAN : make_error(CALC, generic_err);
     }
     return ret;
 } /* execLStridePlan */
@@ -281,33 +296,42 @@ int execLStridePlan(void *plan){
  */
 int perfLStridePlan(void *plan){
     int ret = ~ERR_CLEAN;
-    int i, Inc[] = {
-        1,2,8,64,512,1028,2056,4112,16448,32896
-    };
+    int r;
     uint64_t opcounts[NUM_TIMERS];
+    uint64_t ops = 0;
+    double time = 0;
     Plan *p;
     LStridedata *d;
     p = (Plan *)plan;
     d = (LStridedata *)p->vptr;
     if(p->exec_count > 0){
-        uint64_t count = 0;
-        for(i = 0; i < 10; i++){
-            count += d->M / Inc[i];
+        if(d->o.latency){
+            StrideLatencyPerf(p, &d->o, "LSTRIDE");
+            EmitLog  (MyRank, 9999, "LSTRIDE execution count :", p->exec_count, PRINT_SOME);
+            return ERR_CLEAN;
         }
 
-        opcounts[TIMER0] = (2 * count + 10 + 1) * REPEAT * p->exec_count;             // Count # of integer operations
-        opcounts[TIMER1] = ((2 * count * REPEAT) + (1 * 10 * REPEAT)) * p->exec_count;         // Count memory accesses.
-        opcounts[TIMER2] = 0;
+        /* Count memory accesses for each stride, and integer operations over all of them */
+        memset(opcounts, 0, sizeof(opcounts));
+        for(r = 0; r < d->o.nstrides; r++){
+            uint64_t count = (d->M + d->o.stride[r] - 1) / d->o.stride[r];
+            opcounts[r] = ((2 * count + 1) * sizeof(long int)) * d->o.repeat * p->exec_count;
+            ops += (2 * count + 1) * d->o.repeat * p->exec_count;
+            time += perftimer_gettime(&p->timers, (perf_time_index)r);
+        }
 
         perf_table_update(&p->timers, opcounts, p->name);
         #ifdef HAVE_PAPI
         PAPI_table_update(p->name, p->PAPI_Results, p->PAPI_Times, p->PAPI_Num_Events);
         #endif     //HAVE_PAPI
 
-        double ips = ((double)opcounts[TIMER0] / perftimer_gettime(&p->timers, TIMER0)) / 1e6;
-        double mbps = ((double)opcounts[TIMER1] / perftimer_gettime(&p->timers, TIMER1)) / 1e6;
-        EmitLogfs(MyRank, 9999, "LSTRIDE plan performance:", ips, "MI64OPS", PRINT_SOME);
-        EmitLogfs(MyRank, 9999, "LSTRIDE plan performance:", mbps, "MB/s", PRINT_SOME);
+        for(r = 0; r < d->o.nstrides; r++){
+            char buffer[MSG_SIZE];
+            double mbps = ((double)opcounts[r] / perftimer_gettime(&p->timers, (perf_time_index)r)) / 1e6;
+            snprintf(buffer, MSG_SIZE, "LSTRIDE stride %8zu    :", d->o.stride[r]);
+            EmitLogfs(MyRank, 9999, buffer, mbps, "MB/s", PRINT_SOME);
+        }
+        EmitLogfs(MyRank, 9999, "LSTRIDE plan performance:", ((double)ops / time) / 1e6, "MI64OPS", PRINT_SOME);
         EmitLog  (MyRank, 9999, "LSTRIDE execution count :", p->exec_count, PRINT_SOME);
         ret = ERR_CLEAN;
     }
@@ -344,5 +368,5 @@ plan_info LSTRIDE_info = {
     initLStridePlan,
     killLStridePlan,
     perfLStridePlan,
-    { "I64OPS", "B/s", NULL }
+    { "B/s", "B/s", "B/s", "B/s", "B/s", "B/s" }
 };
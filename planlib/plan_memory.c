@@ -0,0 +1,300 @@
+/*
+   This file is part of SystemBurn.
+
+   Copyright (C) 2012, UT-Battelle, LLC.
+
+   This product includes software produced by UT-Battelle, LLC under Contract No.
+   DE-AC05-00OR22725 with the Department of Energy.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the New BSD 3-clause software license (LICENSE).
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   LICENSE for more details.
+
+   For more information please contact the SystemBurn developers at:
+   systemburn-info@googlegroups.com
+
+ */
+#include <systemburn.h>
+#include <planheaders.h>
+#include <sys/mman.h>
+#ifdef LINUX_PLACEMENT
+  #include <sys/syscall.h>
+#endif
+
+/*
+ * Memory policy constants from <numaif.h>, repeated here so that the
+ * allocator does not depend on libnuma being installed.
+ */
+#define SB_MPOL_PREFERRED   1
+#define SB_MPOL_F_NODE      (1 << 0)
+#define SB_MPOL_F_ADDR      (1 << 1)
+#define SB_MAX_NODES        1024
+
+#define SB_HUGE_2M          (2UL << 20)
+#define SB_HUGE_1G          (1UL << 30)
+#ifndef MAP_HUGE_SHIFT
+  #define MAP_HUGE_SHIFT    26
+#endif
+
+/**
+ * \brief Bookkeeping for one buffer handed out by plan_alloc, so that plan_free can unmap it.
+ * It sits at the end of an ordinary page mapped just below the buffer, so that the buffer keeps its alignment
+ * and plan_free finds it without a search or a lock.
+ */
+typedef struct {
+    void  *addr;                        /**< Start of the mapping, the header page. */
+    size_t len;                         /**< Length of the mapping in bytes.        */
+} plan_mem_block;
+
+/**
+ * \brief Finds the NUMA node of the core the calling thread is running on.
+ * \returns The node number, or PLAN_NODE_UNKNOWN.
+ */
+int plan_current_node(){
+    #if defined(LINUX_PLACEMENT) && defined(SYS_getcpu)
+    unsigned cpu, node;
+    if(syscall(SYS_getcpu, &cpu, &node, NULL) == 0){
+        return (int)node;
+    }
+    #endif
+    return PLAN_NODE_UNKNOWN;
+}
+
+/**
+ * \brief Finds the NUMA node holding the (already touched) page at addr.
+ * \param addr Address within a mapped and touched page.
+ * \returns The node number, or PLAN_NODE_UNKNOWN.
+ */
+int plan_mem_node(void *addr){
+    #if defined(LINUX_PLACEMENT) && defined(SYS_get_mempolicy)
+    int node = PLAN_NODE_UNKNOWN;
+    if(syscall(SYS_get_mempolicy, &node, NULL, 0, addr, SB_MPOL_F_NODE | SB_MPOL_F_ADDR) == 0){
+        return node;
+    }
+    #endif
+    return PLAN_NODE_UNKNOWN;
+}
+
+/**
+ * \brief Reserves address space for a buffer and the page holding its plan_mem_block just below it.
+ * \param len Length of the buffer, a multiple of the base page size.
+ * \param align Alignment of the buffer, a power of 2 multiple of the base page size.
+ * \returns The start of the buffer, which is still inaccessible (the header page is readable and writable), or
+ * MAP_FAILED.
+ */
+static char *plan_reserve(size_t len, size_t align){
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t total = len + align + page;
+    size_t head, tail;
+    char *raw, *addr;
+
+    raw = (char *)mmap(NULL, total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(raw == MAP_FAILED){
+        return raw;
+    }
+    /* trim the over-allocation so that the buffer is aligned, with one page in front of it */
+    addr = (char *)(((uintptr_t)raw + page + align - 1) & ~((uintptr_t)align - 1));
+    head = (addr - page) - raw;
+    if(head > 0){
+        munmap(raw, head);
+    }
+    tail = (raw + total) - (addr + len);
+    if(tail > 0){
+        munmap(addr + len, tail);
+    }
+    if(mprotect(addr - page, page, PROT_READ | PROT_WRITE) != 0){
+        munmap(addr - page, len + page);
+        return (char *)MAP_FAILED;
+    }
+    return addr;
+}
+
+/**
+ * \brief Maps len bytes backed by explicit (hugetlbfs) pages of the given size.
+ * \param len Requested length, rounded up to a whole number of huge pages on return.
+ * \param huge The huge page size, SB_HUGE_2M or SB_HUGE_1G.
+ * \returns The mapping, or MAP_FAILED if no such pages are available.
+ */
+static char *plan_map_hugetlb(size_t *len, size_t huge){
+    #ifdef MAP_HUGETLB
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    int shift = (huge == SB_HUGE_1G) ? 30 : 21;
+    size_t hlen = (*len + huge - 1) & ~(huge - 1);
+    char *addr = plan_reserve(hlen, huge);
+    if(addr == MAP_FAILED){
+        return addr;
+    }
+    if(mmap(addr, hlen, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), -1, 0) == MAP_FAILED){
+        munmap(addr - page, hlen + page);
+        return (char *)MAP_FAILED;
+    }
+    *len = hlen;
+    return addr;
+    #else
+    return (char *)MAP_FAILED;
+    #endif
+}
+
+/**
+ * \brief Maps len bytes of ordinary pages, aligned as given and, for 2MB, marked for transparent huge pages.
+ * \param len Requested length, rounded up to a multiple of align on return.
+ * \param align SB_HUGE_2M, or the base page size.
+ * \returns The mapping, or MAP_FAILED.
+ */
+static char *plan_map_pages(size_t *len, size_t align){
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t hlen = (*len + align - 1) & ~(align - 1);
+    char *addr = plan_reserve(hlen, align);
+    if(addr == MAP_FAILED){
+        return addr;
+    }
+    if(mprotect(addr, hlen, PROT_READ | PROT_WRITE) != 0){
+        munmap(addr - page, hlen + page);
+        return (char *)MAP_FAILED;
+    }
+    #ifdef MADV_HUGEPAGE
+    if(align == SB_HUGE_2M){
+        madvise(addr, hlen, MADV_HUGEPAGE);
+    }
+    #endif
+    *len = hlen;
+    return addr;
+}
+
+/**
+ * \brief Checks whether the kernel actually backed a (touched) mapping with transparent huge pages.
+ * \param addr Start of the mapping.
+ * \param len Length of the mapping.
+ * \returns SB_HUGE_2M if the mapping holding addr is mostly huge pages, the base page size otherwise.
+ */
+static size_t plan_thp_pagesize(char *addr, size_t len){
+    FILE *smaps;
+    char line[ARRAY];
+    unsigned long start, end, kb;
+    int found = 0;
+    size_t ret = (size_t)sysconf(_SC_PAGESIZE);
+
+    smaps = fopen("/proc/self/smaps", "r");
+    if(smaps == NULL){
+        return ret;
+    }
+    while(fgets(line, ARRAY, smaps) != NULL){
+        if(sscanf(line, "%lx-%lx", &start, &end) == 2){
+            found = ((uintptr_t)addr >= start) && ((uintptr_t)addr < end);
+        } else if(found && (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1)){
+            if(kb * 1024 >= len / 2){
+                ret = SB_HUGE_2M;
+            }
+            break;
+        }
+    }
+    fclose(smaps);
+    return ret;
+}
+
+/**
+ * \brief Allocates a plan buffer on the NUMA node of the calling worker.
+ * The buffer is mapped directly, given a preferred-node memory policy for the node the worker is currently
+ * running on, and then touched page by page so that its placement is settled before the plan starts timing.
+ * If the plan asked for huge pages (p->page_req, from a HUGEPAGES modifier on its PLAN line) explicit 1GB or
+ * 2MB pages are tried first, then transparent huge pages, then ordinary pages.
+ * The node the memory landed on and the page size it got are folded into p->mem_node and p->page_size.
+ * Buffers from plan_alloc must be released with plan_free.
+ * \param p The plan the buffer belongs to (may be NULL).
+ * \param size The size of the buffer in bytes.
+ * \returns A page aligned buffer, or NULL on failure.
+ */
+void *plan_alloc(Plan *p, size_t size){
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t len, off, got;
+    char *addr = (char *)MAP_FAILED;
+    int node, req = (p != NULL) ? p->page_req : PAGES_DEFAULT;
+    plan_mem_block *block;
+
+    if(size == 0){
+        return NULL;
+    }
+
+    /* work down from the requested page size to whatever the system can provide */
+    got = page;
+    len = size;
+    if(req == PAGES_1G){
+        addr = plan_map_hugetlb(&len, SB_HUGE_1G);
+        got = SB_HUGE_1G;
+    }
+    if((addr == MAP_FAILED) && ((req == PAGES_1G) || (req == PAGES_2M))){
+        len = size;
+        addr = plan_map_hugetlb(&len, SB_HUGE_2M);
+        got = SB_HUGE_2M;
+    }
+    if((addr == MAP_FAILED) && (req != PAGES_DEFAULT)){
+        len = size;
+        addr = plan_map_pages(&len, SB_HUGE_2M);
+        got = 0;        // decided by the kernel, checked after the first touch
+    }
+    if(addr == MAP_FAILED){
+        len = size;
+        addr = plan_map_pages(&len, page);
+        got = page;
+    }
+    if(addr == MAP_FAILED){
+        return NULL;
+    }
+
+    node = plan_current_node();
+    #if defined(LINUX_PLACEMENT) && defined(SYS_mbind)
+    if((node >= 0) && (node < SB_MAX_NODES)){
+        unsigned long mask[SB_MAX_NODES / (8 * sizeof(unsigned long))];
+        memset(mask, 0, sizeof(mask));
+        mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+        /* Preferred rather than bound, so that an oversized plan spills to another node instead of failing. */
+        syscall(SYS_mbind, addr, len, SB_MPOL_PREFERRED, mask, SB_MAX_NODES + 1, 0);
+    }
+    #endif
+
+    /* first touch from this thread */
+    for(off = 0; off < len; off += page){
+        addr[off] = 0;
+    }
+    if(got == 0){
+        got = plan_thp_pagesize(addr, len);
+    }
+
+    if(p != NULL){
+        node = plan_mem_node(addr);
+        if(p->mem_node == PLAN_NODE_UNKNOWN){
+            p->mem_node = node;
+        } else if(p->mem_node != node){
+            p->mem_node = PLAN_NODE_MIXED;
+        }
+        if((p->page_size == 0) || (got < p->page_size)){
+            p->page_size = got;
+        }
+    }
+
+    block = (plan_mem_block *)addr - 1;
+    block->addr = addr - page;
+    block->len = len + page;
+
+    return (void *)addr;
+} /* plan_alloc */
+
+/**
+ * \brief Releases a buffer allocated with plan_alloc. NULL is ignored.
+ * \param ptr The buffer to release.
+ */
+void plan_free(void *ptr){
+    plan_mem_block *block;
+
+    if(ptr == NULL){
+        return;
+    }
+    block = (plan_mem_block *)ptr - 1;
+    assert(block->addr == (char *)ptr - (size_t)sysconf(_SC_PAGESIZE));
+    munmap(block->addr, block->len);
+} /* plan_free */
@@ -81,19 +81,103 @@ int make_error(int error, int spec){
     return ret;
 }
 
+/**
+ * \brief Calls a plan's make function and sets the Plan fields that the scheduler and the workers rely on.
+ * \param name The plan to make.
+ * \param input The plan's parameters from the load file.
+ * \returns The new plan, or NULL.
+ */
+Plan *plan_make(int name, data *input){
+    Plan *p;
+
+    p = (Plan *)(plan_list[name]->make)(input);
+    if(p != NULL){
+        p->mem_node = PLAN_NODE_UNKNOWN;
+        p->page_req = PAGES_DEFAULT;
+        p->page_size = 0;
+        p->team = NULL;
+        p->team_rank = 0;
+        p->worker = SCHEDULER_THREAD;
+        p->energy_start = 0.0;
+        p->energy_share = 0.0;
+    }
+    return p;
+} /* plan_make */
+
 /**
  * \brief Adds an error to the array that holds a running list of errors encountered during the run
+ * The counters only ever increase, so collectLocalFlags can harvest them without stopping the worker.
  * \param m Points to the calling thread.
  * \param name The name of the plan where the error occured.
  * \param error Index of the error message.
  */
 inline void add_error(void *m, int name, int error){
     ThreadHandle *me = (ThreadHandle *)m;
-    pthread_rwlock_wrlock(&(me->Lock));
-    me->Flag[name + 1][error]++;
-    pthread_rwlock_unlock(&(me->Lock));
+    __atomic_fetch_add(&(me->Flag[name + 1][error]), 1, __ATOMIC_RELAXED);
 }
 
+/**
+ * \brief Reads a size from a PLAN line keyword value, e.g. the "8M" of "FLUSH=8M".
+ * As elsewhere in load files, a K, M, G or T suffix multiplies by a power of 2.
+ * \param text The number, with an optional suffix.
+ * \param end Set to the first character after the size (may be NULL).
+ * \returns The size, 0 if text does not start with a number.
+ */
+uint64_t plan_parse_size(char *text, char **end){
+    char *e;
+    double size = strtod(text, &e);
+
+    switch(*e){
+        case 't': case 'T':
+            size *= 1024.0;
+            /* fall through */
+        case 'g': case 'G':
+            size *= 1024.0;
+            /* fall through */
+        case 'm': case 'M':
+            size *= 1024.0;
+            /* fall through */
+        case 'k': case 'K':
+            size *= 1024.0;
+            e++;
+            /* allow KB, MB, ... */
+            if((*e == 'b') || (*e == 'B')){
+                e++;
+            }
+            break;
+    }
+    if(end != NULL){
+        *end = e;
+    }
+    return (size > 0.0) ? (uint64_t)size : 0;
+} /* plan_parse_size */
+
+/**
+ * \brief Writes a size the way a load file gives it, the inverse of plan_parse_size: with the largest K, M, G or T
+ * suffix that divides it, or in K with a fraction when it is too big for the plain integer a PLAN line reads.
+ * \param size The size in bytes.
+ * \param buffer Receives the text.
+ * \param len The length of buffer.
+ * \returns buffer.
+ */
+char *plan_size_text(uint64_t size, char *buffer, size_t len){
+    char suffixes[] = " KMGT";
+    int k = 0;
+
+    while((size > 0) && (k < 4) && ((size & 1023) == 0)){
+        size >>= 10;
+        k++;
+    }
+    if(k > 0){
+        snprintf(buffer, len, "%" PRIu64 "%c", size, suffixes[k]);
+    } else if(size > INT_MAX){
+        snprintf(buffer, len, "%.17gK", size / 1024.0);
+    } else {
+        snprintf(buffer, len, "%" PRIu64, size);
+    }
+    return buffer;
+} /* plan_size_text */
+
 /**
  * \brief Parses the load file, and pulls the input information for use in the plan
  * \param line The input line to be parsed.
@@ -216,6 +300,44 @@ data *get_sizes(char *line){
     return sizes;
 } /* get_sizes */
 
+/**
+ * \brief Checks whether a PLAN line carries the given keyword.
+ * \param m The parsed PLAN line.
+ * \param token The keyword to look for.
+ * \returns 1 if one of the string arguments matches token exactly, 0 otherwise.
+ */
+int plan_has_token(data *m, char *token){
+    int i;
+    for(i = 0; i < m->csize; i++){
+        if(strcmp(m->c[i], token) == 0){
+            return 1;
+        }
+    }
+    return 0;
+} /* plan_has_token */
+
+/**
+ * \brief Looks for a KEY or KEY=value keyword on a PLAN line.
+ * \param m The parsed PLAN line.
+ * \param key The keyword, without the '='.
+ * \returns The text after "KEY=", an empty string for a bare KEY, or NULL if the line does not carry the keyword.
+ */
+char *plan_token_value(data *m, char *key){
+    int i;
+    size_t len = strlen(key);
+    for(i = 0; i < m->csize; i++){
+        if(strncmp(m->c[i], key, len) == 0){
+            if(m->c[i][len] == '\0'){
+                return &(m->c[i][len]);
+            }
+            if(m->c[i][len] == '='){
+                return &(m->c[i][len + 1]);
+            }
+        }
+    }
+    return NULL;
+} /* plan_token_value */
+
 /**
  * \brief Splits the plan line string into tokens, ready for conversion.
  * \param [in] line The input string to be parsed.
@@ -57,6 +57,10 @@ void *makePV1Plan(data *m){
             } else {
                 d->M = m->d[0] / (4 * sizeof(double));
             }
+            pvfma_setup(&d->fma, m);
+            if(d->fma.on){
+                d->M *= 4;          // the FMA engine streams one array over the whole footprint
+            }
         }
         (p->vptr) = (void *)d;
     }
@@ -121,13 +125,22 @@ int initPV1Plan(void *plan){
     assert(d);
     if(d){
         M = d->M;
-        d->one = (double *)  malloc(sizeof(double) * M);
+        d->one = (double *)  plan_alloc(p, sizeof(double) * M);
         assert(d->one);
-        d->two = (double *)  malloc(sizeof(double) * M);
+        d->two = d->three = d->four = NULL;
+        if(d->fma.on){
+            if(d->one){
+                pvfma_fill(d->one, d->M);
+                d->random = rand();
+                ret = ERR_CLEAN;
+            }
+            return ret;
+        }
+        d->two = (double *)  plan_alloc(p, sizeof(double) * M);
         assert(d->two);
-        d->three = (double *)  malloc(sizeof(double) * M);
+        d->three = (double *)  plan_alloc(p, sizeof(double) * M);
         assert(d->three);
-        d->four = (double *)  malloc(sizeof(double) * M);
+        d->four = (double *)  plan_alloc(p, sizeof(double) * M);
         assert(d->four);
         if(d->one && d->two && d->three && d->four){
             for(i = 0; i < d->M; i++){
@@ -167,16 +180,16 @@ void *killPV1Plan(void *plan){
     }     //DO_PERF
 
     if(d->one){
-        free(d->one);
+        plan_free(d->one);
     }
     if(d->two){
-        free(d->two);
+        plan_free(d->two);
     }
     if(d->three){
-        free(d->three);
+        plan_free(d->three);
     }
     if(d->four){
-        free(d->four);
+        plan_free(d->four);
     }
     free(d);
     free(p);
@@ -218,8 +231,12 @@ int execPV1Plan(void *plan){
         ORB_read(t1);
     }     //DO_PERF
 
-    for(i = 0; i < d->M; i++){
-        d->one[i] = 0.5 + 0.5 * (0.9 * d->one[i] + (1.0 + d->two[(d->random ^ i) & 0xfff]) * d->three[i & 0xff000]);
+    if(d->fma.on){
+        pvfma_run(&d->fma, d->one, d->M);
+    } else {
+        for(i = 0; i < d->M; i++){
+            d->one[i] = 0.5 + 0.5 * (0.9 * d->one[i] + (1.0 + d->two[(d->random ^ i) & 0xfff]) * d->three[i & 0xff000]);
+        }
     }
 
     if(DO_PERF){
@@ -234,6 +251,9 @@ int execPV1Plan(void *plan){
         #endif //HAVE_PAPI
         perftimer_accumulate(&p->timers, TIMER0, ORB_cycles_a(t2, t1));
         perftimer_accumulate(&p->timers, TIMER1, ORB_cycles_a(t2, t1));
+        if(d->fma.on){
+            perftimer_accumulate(&p->timers, TIMER2, ORB_cycles_a(t2, t1));
+        }
     }     //DO_PERF
 
     return ERR_CLEAN;
@@ -277,6 +297,11 @@ int perfPV1Plan(void *plan){
         opcounts[TIMER0] = d->M * p->exec_count;                                // Count # trips through inner loop.
         opcounts[TIMER1] = (d->M * 4 * sizeof(double)) * p->exec_count;         // Count # of bytes of memory transfered (3 r, 1 w)
         opcounts[TIMER2] = d->M * p->exec_count;                                // Count # of floating point operations in checking loop.
+        if(d->fma.on){
+            opcounts[TIMER1] = pvfma_bytes(&d->fma, d->M) * p->exec_count;
+            opcounts[TIMER2] = pvfma_flops(&d->fma, d->M) * p->exec_count;
+            pvfma_log(&d->fma, "PV1");
+        }
 
         perf_table_update(&p->timers, opcounts, p->name);
         #ifdef HAVE_PAPI
@@ -323,6 +348,6 @@ plan_info PV1_info = {
     initPV1Plan,
     killPV1Plan,
     perfPV1Plan,
-    { "Trips/s", "B/s", NULL }
+    { "Trips/s", "B/s", "FLOPS", NULL }
 };
 
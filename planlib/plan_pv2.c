@@ -57,6 +57,7 @@ void *makePV2Plan(data *m){
             } else {
                 d->M = m->d[0] / sizeof(double);
             }
+            pvfma_setup(&d->fma, m);
         }
         (p->vptr) = (void *)d;
     }
@@ -123,13 +124,13 @@ int initPV2Plan(void *plan){
     assert(d);
     if(d){
         M = d->M;
-        d->one = (double *)  malloc(sizeof(double) * M);
+        d->one = (double *)  plan_alloc(p, sizeof(double) * M);
         assert(d->one);
-        d->two = (double *)  malloc(sizeof(double) * (MASKA + 2));
+        d->two = (double *)  plan_alloc(p, sizeof(double) * (MASKA + 2));
         assert(d->two);
-        d->three = (double *)  malloc(sizeof(double) * 2);
+        d->three = (double *)  plan_alloc(p, sizeof(double) * 2);
         assert(d->three);
-        d->four = (double *)  malloc(sizeof(double) * 2);
+        d->four = (double *)  plan_alloc(p, sizeof(double) * 2);
         assert(d->four);
         //if(d->one && d->two) {
         if(d->one && d->two && d->three && d->four){
@@ -141,6 +142,9 @@ int initPV2Plan(void *plan){
             }
             d->three[0] = MASKA;
             d->four[0] = MASKB;
+            if(d->fma.on){
+                pvfma_fill(d->one, d->M);
+            }
             d->random = rand();
             ret = ERR_CLEAN;
         }
@@ -172,16 +176,16 @@ void *killPV2Plan(void *plan){
     }     //DO_PERF
 
     if(d->one){
-        free(d->one);
+        plan_free(d->one);
     }
     if(d->two){
-        free(d->two);
+        plan_free(d->two);
     }
     if(d->three){
-        free(d->three);
+        plan_free(d->three);
     }
     if(d->four){
-        free(d->four);
+        plan_free(d->four);
     }
     free(d);
     free(p);
@@ -235,25 +239,29 @@ int execPV2Plan(void *plan){
         ORB_read(t1);
     }     //DO_PERF
 
-    for(i = 0; i < M; i += 1){
-        ia = i;
-        Ai = A[ia];
-        Bi = B[ib];
-        ib = (i + 1) & MA;
-        S = ((U * U) + X)   + ((V * V) + U)   + ((W * W) + V)     + ((X * X) + W)   + ((U + U) * V)   + ((V + V) * W)     + ((W + W) * X);
-        T = ((U + V) * W)   * ((V + W) * X)   * ((W + X) * U)     * ((X + U) * V)   * ((U * V) + W)   * ((V * W) + X)     * ((W * X) + U);
-        j = ((j ^ PY) >> 4) | ((k ^ PY) << 7) | ((l ^ PY) >> 8)   | ((j | PY) << 4) | ((k | PY) << 9) | ((l | PY) << 3)   | ((j & PY) >> 5) | ((k & PY) >> 8) | ((l & PY) >> 2)  | (~j ^ PY)   | (~k & PY)   | (~l | PY);
-        k = ((k ^ MA) >> 8) | ((l ^ MA) << 3) | ((j ^ MA) >> 2)   | ((k | MA) << 8) | ((l | MA) << 5) | ((j | MA) << 5)   | ((k & MA) >> 7) | ((l & MA) >> 9) | ((j & MA) >> 3)  | (~k ^ MA)   | (~l & MA)   | (~j | MA);
-        l = ((l ^ MB) >> 2) | ((j ^ MB) << 5) | ((k ^ MB) >> 4)   | ((l | MB) << 2) | ((j | MB) << 1) | ((k | MB) << 7)   | ((l & MB) >> 3) | ((j & MB) >> 4) | ((k & MB) >> 1)  | (~l ^ MB)   | (~j & MB)   | (~k | MB);
-        A[ia] = Ai * S;
-        U = S;
-        V = W;
-        W = X;
-        X = Y;
-        Y = Z;
-        Z = T;
-        B[ib] = Bi & j;
-        j = k + 1;
+    if(d->fma.on){
+        pvfma_run(&d->fma, d->one, d->M);
+    } else {
+        for(i = 0; i < M; i += 1){
+            ia = i;
+            Ai = A[ia];
+            Bi = B[ib];
+            ib = (i + 1) & MA;
+            S = ((U * U) + X)   + ((V * V) + U)   + ((W * W) + V)     + ((X * X) + W)   + ((U + U) * V)   + ((V + V) * W)     + ((W + W) * X);
+            T = ((U + V) * W)   * ((V + W) * X)   * ((W + X) * U)     * ((X + U) * V)   * ((U * V) + W)   * ((V * W) + X)     * ((W * X) + U);
+            j = ((j ^ PY) >> 4) | ((k ^ PY) << 7) | ((l ^ PY) >> 8)   | ((j | PY) << 4) | ((k | PY) << 9) | ((l | PY) << 3)   | ((j & PY) >> 5) | ((k & PY) >> 8) | ((l & PY) >> 2)  | (~j ^ PY)   | (~k & PY)   | (~l | PY);
+            k = ((k ^ MA) >> 8) | ((l ^ MA) << 3) | ((j ^ MA) >> 2)   | ((k | MA) << 8) | ((l | MA) << 5) | ((j | MA) << 5)   | ((k & MA) >> 7) | ((l & MA) >> 9) | ((j & MA) >> 3)  | (~k ^ MA)   | (~l & MA)   | (~j | MA);
+            l = ((l ^ MB) >> 2) | ((j ^ MB) << 5) | ((k ^ MB) >> 4)   | ((l | MB) << 2) | ((j | MB) << 1) | ((k | MB) << 7)   | ((l & MB) >> 3) | ((j & MB) >> 4) | ((k & MB) >> 1)  | (~l ^ MB)   | (~j & MB)   | (~k | MB);
+            A[ia] = Ai * S;
+            U = S;
+            V = W;
+            W = X;
+            X = Y;
+            Y = Z;
+            Z = T;
+            B[ib] = Bi & j;
+            j = k + 1;
+        }
     }
 
     if(DO_PERF){
@@ -269,6 +277,9 @@ int execPV2Plan(void *plan){
         #endif //HAVE_PAPI
         perftimer_accumulate(&p->timers, TIMER0, ORB_cycles_a(t2, t1));
         perftimer_accumulate(&p->timers, TIMER1, ORB_cycles_a(t2, t1));
+        if(d->fma.on){
+            perftimer_accumulate(&p->timers, TIMER2, ORB_cycles_a(t2, t1));
+        }
     }     //DO_PERF
 
     return ERR_CLEAN;
@@ -295,6 +306,11 @@ int perfPV2Plan(void *plan){
         opcounts[TIMER0] = d->M * p->exec_count;                                                     // Count # of trips through inner loop
         opcounts[TIMER1] = (d->M * (2 * sizeof(double) + 2 * sizeof(long))) * p->exec_count;         // Count # of bytes of memory transfered (2 r, 2 w)
         opcounts[TIMER2] = 0;
+        if(d->fma.on){
+            opcounts[TIMER1] = pvfma_bytes(&d->fma, d->M) * p->exec_count;
+            opcounts[TIMER2] = pvfma_flops(&d->fma, d->M) * p->exec_count;
+            pvfma_log(&d->fma, "PV2");
+        }
 
         perf_table_update(&p->timers, opcounts, p->name);
         #ifdef HAVE_PAPI
@@ -341,6 +357,6 @@ plan_info PV2_info = {
     initPV2Plan,
     killPV2Plan,
     perfPV2Plan,
-    { "Trips/s", "B/s", NULL }
+    { "Trips/s", "B/s", "FLOPS", NULL }
 };
 
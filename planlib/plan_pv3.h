@@ -24,6 +24,7 @@
 #include <float.h>
 #include <limits.h>
 #include <loadstruct.h>
+#include <plan_pvfma.h>
 
 extern void *makePV3Plan(data *i);          /* creates a plan struct              */
 extern int initPV3Plan(void *p);            /* inits plan's vptr                  */
@@ -43,6 +44,7 @@ typedef struct {
     size_t M;
     double *one, *two, *three, *four;
     int random;
+    PVFMA fma;                  /**< FMA engine settings, used instead of the loop below with FMA. */
 } PV3data;
 
 #endif /* __PLAN_PV3_H */
@@ -57,6 +57,10 @@ void *makePV4Plan(data *m){
             } else {
                 d->M = m->d[0] / (4 * sizeof(double));
             }
+            pvfma_setup(&d->fma, m);
+            if(d->fma.on){
+                d->M *= 4;          // the FMA engine streams one array over the whole footprint
+            }
         }
         (p->vptr) = (void *)d;
     }
@@ -127,13 +131,22 @@ int initPV4Plan(void *plan){
 
         //EmitLog(MyRank,1,"Allocating",sizeof(double)*4*M,0);
 
-        d->one = (double *)  malloc(sizeof(double) * M);
+        d->one = (double *)  plan_alloc(p, sizeof(double) * M);
         assert(d->one);
-        d->two = (double *)  malloc(sizeof(double) * M);
+        d->two = d->three = d->four = NULL;
+        if(d->fma.on){
+            if(d->one){
+                pvfma_fill(d->one, d->M);
+                d->random = rand();
+                ret = ERR_CLEAN;
+            }
+            return ret;
+        }
+        d->two = (double *)  plan_alloc(p, sizeof(double) * M);
         assert(d->two);
-        d->three = (double *)  malloc(sizeof(double) * M);
+        d->three = (double *)  plan_alloc(p, sizeof(double) * M);
         assert(d->three);
-        d->four = (double *)  malloc(sizeof(double) * M);
+        d->four = (double *)  plan_alloc(p, sizeof(double) * M);
         assert(d->four);
         //if(d->one && d->two) {
         if(d->one && d->two && d->three && d->four){
@@ -175,16 +188,16 @@ void *killPV4Plan(void *plan){
     }
 
     if(d->one){
-        free(d->one);
+        plan_free(d->one);
     }
     if(d->two){
-        free(d->two);
+        plan_free(d->two);
     }
     if(d->three){
-        free(d->three);
+        plan_free(d->three);
     }
     if(d->four){
-        free(d->four);
+        plan_free(d->four);
     }
     free(d);
     free(p);
@@ -236,29 +249,33 @@ int execPV4Plan(void *plan){
         ORB_read(t1);
     }     //DO_PERF
 
-    for(j = 0; j < 10000; j++){
-        for(i = 0; i < M; i += 1){
-            for(k = 0; k < 8; k++){
-                a[i] = ( (((a[i] * b[i]) + c[i]) * ((a[i] * c[i]) + d[i])) + ((a[i] * d[i]) + b[i]) )
-                       * ( (((d[i] * c[i]) + d[i]) * ((b[i] * d[i]) + a[i])) + ((c[i] + d[i]) * a[i]) )
-                       + ( (((c[i] * d[i]) + a[i]) * ((b[i] + d[i]) * a[i])) + ((b[i] + c[i]) * d[i]) );
+    if(data->fma.on){
+        pvfma_run(&data->fma, a, M);
+    } else {
+        for(j = 0; j < 10000; j++){
+            for(i = 0; i < M; i += 1){
+                for(k = 0; k < 8; k++){
+                    a[i] = ( (((a[i] * b[i]) + c[i]) * ((a[i] * c[i]) + d[i])) + ((a[i] * d[i]) + b[i]) )
+                           * ( (((d[i] * c[i]) + d[i]) * ((b[i] * d[i]) + a[i])) + ((c[i] + d[i]) * a[i]) )
+                           + ( (((c[i] * d[i]) + a[i]) * ((b[i] + d[i]) * a[i])) + ((b[i] + c[i]) * d[i]) );
+                }
+                // accum answers into scalar temps for more work per loop
+                // ta   = ( (((a[i]*b[i])+c[i])*((a[i]*c[i])+d[i])) + ((a[i]*d[i])+b[i]) )
+                //      * ( (((d[i]*c[i])+d[i])*((b[i]*d[i])+a[i])) + ((c[i]+d[i])*a[i]) )
+                //      + ( (((c[i]*d[i])+a[i])*((b[i]+d[i])*a[i])) + ((b[i]+c[i])*d[i]) );
+                // tb   = ( (((ta*b[i])+c[i])*((ta*c[i])+d[i])) + ((ta*d[i])+b[i]) )
+                //      * ( (((d[i]*c[i])+d[i])*((b[i]*d[i])+ta)) + ((c[i]+d[i])*ta) )
+                //      + ( (((c[i]*d[i])+ta)*((b[i]+d[i])*ta)) + ((b[i]+c[i])*d[i]) );
+                // tc   = ( (((ta*tb)+c[i])*((ta*c[i])+d[i])) + ((ta*d[i])+tb) )
+                //      * ( (((d[i]*c[i])+d[i])*((tb*d[i])+ta)) + ((c[i]+d[i])*ta) )
+                //      + ( (((c[i]*d[i])+ta)*((tb+d[i])*ta)) + ((tb+c[i])*d[i]) );
+                // td   = ( (((ta*tb)+tc)*((ta*tc)+d[i])) + ((ta*d[i])+tb) )
+                //      * ( (((d[i]*tc)+d[i])*((tb*d[i])+ta)) + ((tc+d[i])*ta) )
+                //      + ( (((tc*d[i])+ta)*((tb+d[i])*ta)) + ((tb+tc)*d[i]) );
+                // a[i] = ( (((ta*tb)+tc)*((ta*tc)+td)) + ((ta*td)+tb) )
+                //      * ( (((td*tc)+td)*((tb*td)+ta)) + ((tc+td)*ta) )
+                //      + ( (((tc*td)+ta)*((tb+td)*ta)) + ((tb+tc)*td) );
             }
-            // accum answers into scalar temps for more work per loop
-            // ta   = ( (((a[i]*b[i])+c[i])*((a[i]*c[i])+d[i])) + ((a[i]*d[i])+b[i]) )
-            //      * ( (((d[i]*c[i])+d[i])*((b[i]*d[i])+a[i])) + ((c[i]+d[i])*a[i]) )
-            //      + ( (((c[i]*d[i])+a[i])*((b[i]+d[i])*a[i])) + ((b[i]+c[i])*d[i]) );
-            // tb   = ( (((ta*b[i])+c[i])*((ta*c[i])+d[i])) + ((ta*d[i])+b[i]) )
-            //      * ( (((d[i]*c[i])+d[i])*((b[i]*d[i])+ta)) + ((c[i]+d[i])*ta) )
-            //      + ( (((c[i]*d[i])+ta)*((b[i]+d[i])*ta)) + ((b[i]+c[i])*d[i]) );
-            // tc   = ( (((ta*tb)+c[i])*((ta*c[i])+d[i])) + ((ta*d[i])+tb) )
-            //      * ( (((d[i]*c[i])+d[i])*((tb*d[i])+ta)) + ((c[i]+d[i])*ta) )
-            //      + ( (((c[i]*d[i])+ta)*((tb+d[i])*ta)) + ((tb+c[i])*d[i]) );
-            // td   = ( (((ta*tb)+tc)*((ta*tc)+d[i])) + ((ta*d[i])+tb) )
-            //      * ( (((d[i]*tc)+d[i])*((tb*d[i])+ta)) + ((tc+d[i])*ta) )
-            //      + ( (((tc*d[i])+ta)*((tb+d[i])*ta)) + ((tb+tc)*d[i]) );
-            // a[i] = ( (((ta*tb)+tc)*((ta*tc)+td)) + ((ta*td)+tb) )
-            //      * ( (((td*tc)+td)*((tb*td)+ta)) + ((tc+td)*ta) )
-            //      + ( (((tc*td)+ta)*((tb+td)*ta)) + ((tb+tc)*td) );
         }
     }
 
@@ -275,6 +292,9 @@ int execPV4Plan(void *plan){
         #endif //HAVE_PAPI
         perftimer_accumulate(&p->timers, TIMER0, ORB_cycles_a(t2, t1));
         perftimer_accumulate(&p->timers, TIMER1, ORB_cycles_a(t2, t1));
+        if(data->fma.on){
+            perftimer_accumulate(&p->timers, TIMER2, ORB_cycles_a(t2, t1));
+        }
     }    // DO_PERF
 
     return ERR_CLEAN;
@@ -302,6 +322,12 @@ int perfPV4Plan(void *plan){
         opcounts[TIMER0] = times * p->exec_count;                                // Count # of trips through inner loop
         opcounts[TIMER1] = (times * 5 * sizeof(double)) * p->exec_count;         // Count # of bytes of memory transfered (4 r, 1 w)
         opcounts[TIMER2] = 0;
+        if(d->fma.on){
+            opcounts[TIMER0] = d->M * p->exec_count;                                // one trip per element
+            opcounts[TIMER1] = pvfma_bytes(&d->fma, d->M) * p->exec_count;
+            opcounts[TIMER2] = pvfma_flops(&d->fma, d->M) * p->exec_count;
+            pvfma_log(&d->fma, "PV4");
+        }
 
         perf_table_update(&p->timers, opcounts, p->name);
         #ifdef HAVE_PAPI
@@ -348,5 +374,5 @@ plan_info PV4_info = {
     initPV4Plan,
     killPV4Plan,
     perfPV4Plan,
-    { "Trips/s", "B/s", NULL }
+    { "Trips/s", "B/s", "FLOPS", NULL }
 };
@@ -0,0 +1,317 @@
+/*
+   This file is part of SystemBurn.
+
+   Copyright (C) 2012, UT-Battelle, LLC.
+
+   This product includes software produced by UT-Battelle, LLC under Contract No.
+   DE-AC05-00OR22725 with the Department of Energy.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the New BSD 3-clause software license (LICENSE).
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   LICENSE for more details.
+
+   For more information please contact the SystemBurn developers at:
+   systemburn-info@googlegroups.com
+
+ */
+#include <systemheaders.h>
+#include <systemburn.h>
+#include <planheaders.h>
+#ifdef PLAN_X86_SIMD
+  #include <immintrin.h>
+#endif
+
+/*
+ * Every vector of the array is loaded once and then multiplied into a set of
+ * independent accumulators, acc = acc * x + y, REPS times over. With enough
+ * accumulators to cover the FMA latency on every FMA port, the core retires
+ * one full width FMA per port per cycle, which is as hot as it runs. The
+ * addend y is a second load from a random index of MASK bits, so the mask
+ * decides whether it comes from L1 or further out, and one vector in 2^STORE
+ * is written back as 1.5 - x. The array holds values in [0.55, 0.95], which
+ * the write back keeps, so the accumulators settle below 0.95 / 0.05 and
+ * never overflow.
+ */
+
+#define PVFMA_FLIP  1.5         /* stores write PVFMA_FLIP - x */
+
+/* accumulator counts the kernels are built for, and the most each instruction set keeps in registers */
+#define PVFMA_STEP  4
+#define PVFMA_UNROLLS (PVFMA_MAX_UNROLL / PVFMA_STEP)
+static int pvfma_max_unroll[] = { 12, 12, 12, 24 };
+static int pvfma_default_unroll[] = { 8, 8, 12, 16 };
+
+typedef double (*pvfma_kernel)(double *a, size_t n, int reps, size_t mask, size_t smask, size_t seed);
+
+/**
+ * \brief Portable engine kernel.
+ * \param a The array, n doubles.
+ * \param n Number of doubles, a multiple of PVFMA_ALIGN.
+ * \param reps FMAs per accumulator per element.
+ * \param mask Addend index mask, a multiple of PVFMA_ALIGN less one, below n.
+ * \param smask An element is stored when its index & smask is 0.
+ * \param seed Scrambles the addend index.
+ * \param U Number of accumulators, a constant in each caller.
+ * \returns The sum of the accumulators.
+ */
+static inline __attribute__((always_inline)) double pvfma_scalar(double *a, size_t n, int reps, size_t mask, size_t smask, size_t seed, const int U){
+    double acc[PVFMA_MAX_UNROLL], x, y, sum = 0.0;
+    size_t i;
+    int r, j;
+
+    for(j = 0; j < U; j++){
+        acc[j] = j;
+    }
+    for(i = 0; i < n; i++){
+        x = a[i];
+        y = a[(i ^ seed) & mask];
+        for(r = 0; r < reps; r++){
+            #pragma GCC unroll 24
+            for(j = 0; j < U; j++){
+                acc[j] = acc[j] * x + y;
+            }
+        }
+        if((i & smask) == 0){
+            a[i] = PVFMA_FLIP - x;
+        }
+    }
+    for(j = 0; j < U; j++){
+        sum += acc[j];
+    }
+    return sum;
+} /* pvfma_scalar */
+
+#ifdef PLAN_X86_SIMD
+/**
+ * \brief AVX2 engine kernel, see pvfma_scalar.
+ */
+static inline __attribute__((always_inline, target("avx2,fma"))) double pvfma_avx2(double *a, size_t n, int reps, size_t mask, size_t smask, size_t seed, const int U){
+    __m256d acc[PVFMA_MAX_UNROLL], x, y;
+    __m256d flip = _mm256_set1_pd(PVFMA_FLIP);
+    double sum[4];
+    size_t i;
+    int r, j;
+
+    mask &= ~(size_t)3;
+    for(j = 0; j < U; j++){
+        acc[j] = _mm256_set1_pd(j);
+    }
+    for(i = 0; i < n; i += 4){
+        x = _mm256_loadu_pd(a + i);
+        y = _mm256_loadu_pd(a + ((i ^ seed) & mask));
+        for(r = 0; r < reps; r++){
+            #pragma GCC unroll 24
+            for(j = 0; j < U; j++){
+                acc[j] = _mm256_fmadd_pd(acc[j], x, y);
+            }
+        }
+        if((i & smask) == 0){
+            _mm256_storeu_pd(a + i, _mm256_sub_pd(flip, x));
+        }
+    }
+    for(j = 1; j < U; j++){
+        acc[0] = _mm256_add_pd(acc[0], acc[j]);
+    }
+    _mm256_storeu_pd(sum, acc[0]);
+    return sum[0] + sum[1] + sum[2] + sum[3];
+} /* pvfma_avx2 */
+
+/**
+ * \brief AVX-512 engine kernel, see pvfma_scalar.
+ */
+static inline __attribute__((always_inline, target("avx512f"))) double pvfma_avx512(double *a, size_t n, int reps, size_t mask, size_t smask, size_t seed, const int U){
+    __m512d acc[PVFMA_MAX_UNROLL], x, y;
+    __m512d flip = _mm512_set1_pd(PVFMA_FLIP);
+    size_t i;
+    int r, j;
+
+    mask &= ~(size_t)7;
+    for(j = 0; j < U; j++){
+        acc[j] = _mm512_set1_pd(j);
+    }
+    for(i = 0; i < n; i += 8){
+        x = _mm512_loadu_pd(a + i);
+        y = _mm512_loadu_pd(a + ((i ^ seed) & mask));
+        for(r = 0; r < reps; r++){
+            #pragma GCC unroll 24
+            for(j = 0; j < U; j++){
+                acc[j] = _mm512_fmadd_pd(acc[j], x, y);
+            }
+        }
+        if((i & smask) == 0){
+            _mm512_storeu_pd(a + i, _mm512_sub_pd(flip, x));
+        }
+    }
+    for(j = 1; j < U; j++){
+        acc[0] = _mm512_add_pd(acc[0], acc[j]);
+    }
+    return _mm512_reduce_add_pd(acc[0]);
+} /* pvfma_avx512 */
+#endif /* PLAN_X86_SIMD */
+
+/* One function per accumulator count, so each kernel's accumulators are fixed and live in registers. */
+#define PVFMA_KERNEL(ISA, U, ...)                                                                          \
+    __VA_ARGS__ static double pvfma_##ISA##_##U(double *a, size_t n, int reps, size_t mask, size_t smask, size_t seed){ \
+        return pvfma_##ISA(a, n, reps, mask, smask, seed, U);                                              \
+    }
+
+PVFMA_KERNEL(scalar, 4)
+PVFMA_KERNEL(scalar, 8)
+PVFMA_KERNEL(scalar, 12)
+#ifdef PLAN_X86_SIMD
+PVFMA_KERNEL(avx2, 4, __attribute__((target("avx2,fma"))))
+PVFMA_KERNEL(avx2, 8, __attribute__((target("avx2,fma"))))
+PVFMA_KERNEL(avx2, 12, __attribute__((target("avx2,fma"))))
+PVFMA_KERNEL(avx512, 4, __attribute__((target("avx512f"))))
+PVFMA_KERNEL(avx512, 8, __attribute__((target("avx512f"))))
+PVFMA_KERNEL(avx512, 12, __attribute__((target("avx512f"))))
+PVFMA_KERNEL(avx512, 16, __attribute__((target("avx512f"))))
+PVFMA_KERNEL(avx512, 20, __attribute__((target("avx512f"))))
+PVFMA_KERNEL(avx512, 24, __attribute__((target("avx512f"))))
+#endif
+
+/**
+ * \brief The kernels, by instruction set level and accumulator count / PVFMA_STEP - 1.
+ */
+static pvfma_kernel pvfma_kernels[][PVFMA_UNROLLS] = {
+    { pvfma_scalar_4, pvfma_scalar_8, pvfma_scalar_12 },
+    { pvfma_scalar_4, pvfma_scalar_8, pvfma_scalar_12 },
+    #ifdef PLAN_X86_SIMD
+    { pvfma_avx2_4, pvfma_avx2_8, pvfma_avx2_12 },
+    { pvfma_avx512_4, pvfma_avx512_8, pvfma_avx512_12, pvfma_avx512_16, pvfma_avx512_20, pvfma_avx512_24 }
+    #endif
+};
+
+/* doubles per vector at each instruction set level */
+static int pvfma_width[] = { 1, 1, 4, 8 };
+
+/**
+ * \brief Rounds the engine settings to ones there are kernels for.
+ * \param e The settings.
+ */
+void pvfma_fit(PVFMA *e){
+    e->unroll = ((e->unroll + PVFMA_STEP / 2) / PVFMA_STEP) * PVFMA_STEP;
+    if(e->unroll < PVFMA_STEP){
+        e->unroll = PVFMA_STEP;
+    }
+    if(e->unroll > pvfma_max_unroll[e->simd]){
+        e->unroll = pvfma_max_unroll[e->simd];
+    }
+    if(e->reps < 1){
+        e->reps = 1;
+    }
+    e->mask = (e->mask < 0) ? 0 : (e->mask > PVFMA_MAX_MASK) ? PVFMA_MAX_MASK : e->mask;
+    e->store = (e->store < 0) ? 0 : (e->store > PVFMA_MAX_STORE) ? PVFMA_MAX_STORE : e->store;
+} /* pvfma_fit */
+
+/**
+ * \brief Reads the FMA engine keywords from a PV PLAN line: FMA[=accumulators], REPS=n, MASK=bits, STORE=n
+ * and the SIMD level names.
+ * \param e Receives the settings.
+ * \param m The parsed PLAN line.
+ */
+void pvfma_setup(PVFMA *e, data *m){
+    char *value;
+
+    memset(e, 0, sizeof(PVFMA));
+    value = plan_token_value(m, "FMA");
+    e->on = (value != NULL);
+    e->simd = plan_simd_select(m);
+    e->unroll = pvfma_default_unroll[e->simd];
+    if(value != NULL && atoi(value) > 0){
+        e->unroll = atoi(value);
+    }
+    e->reps = PVFMA_REPS;
+    if((value = plan_token_value(m, "REPS")) != NULL && atoi(value) > 0){
+        e->reps = atoi(value);
+    }
+    if((value = plan_token_value(m, "MASK")) != NULL){
+        e->mask = atoi(value);
+    }
+    if((value = plan_token_value(m, "STORE")) != NULL){
+        e->store = atoi(value);
+    }
+    e->seed = 0x5bd1e995;
+    pvfma_fit(e);
+} /* pvfma_setup */
+
+/**
+ * \brief Fills an array with the values the engine expects.
+ * \param a The array.
+ * \param n Number of doubles in a.
+ */
+void pvfma_fill(double *a, size_t n){
+    size_t i;
+    for(i = 0; i < n; i++){
+        a[i] = 0.55 + 0.4 * (double)(i % 1024) / 1024.0;
+    }
+} /* pvfma_fill */
+
+/**
+ * \brief Makes one pass of the engine over an array.
+ * \param e The settings from pvfma_setup.
+ * \param a The array, filled by pvfma_fill.
+ * \param n Number of doubles in a; the last n % PVFMA_ALIGN are left alone.
+ */
+void pvfma_run(PVFMA *e, double *a, size_t n){
+    pvfma_kernel k = pvfma_kernels[e->simd][e->unroll / PVFMA_STEP - 1];
+    size_t mask = ((size_t)1 << e->mask) - 1;
+    size_t smask = ((size_t)pvfma_width[e->simd] << e->store) - 1;
+
+    n &= ~((size_t)PVFMA_ALIGN - 1);
+    while((mask >= n) && (mask > 0)){
+        mask >>= 1;
+    }
+    mask &= ~((size_t)PVFMA_ALIGN - 1);
+    e->sink += k(a, n, e->reps, mask, smask, e->seed);
+} /* pvfma_run */
+
+/**
+ * \brief Counts the floating point operations in one pass of the engine.
+ * \param e The settings from pvfma_setup.
+ * \param n Number of doubles in the array.
+ * \returns Two per FMA, plus the write backs.
+ */
+uint64_t pvfma_flops(PVFMA *e, size_t n){
+    n &= ~((size_t)PVFMA_ALIGN - 1);
+    return n * 2 * (uint64_t)e->unroll * e->reps + (n >> e->store);
+} /* pvfma_flops */
+
+/**
+ * \brief Counts the bytes one pass of the engine streams through the array.
+ * \param e The settings from pvfma_setup.
+ * \param n Number of doubles in the array.
+ * \returns The bytes read and written back, not counting the addend loads.
+ */
+uint64_t pvfma_bytes(PVFMA *e, size_t n){
+    n &= ~((size_t)PVFMA_ALIGN - 1);
+    return (n + (n >> e->store)) * sizeof(double);
+} /* pvfma_bytes */
+
+/**
+ * \brief Writes the engine settings as PV PLAN line keywords.
+ * \param e The settings.
+ * \param buffer Receives the keywords.
+ * \param len Size of buffer.
+ * \returns buffer.
+ */
+char *pvfma_line(PVFMA *e, char *buffer, size_t len){
+    snprintf(buffer, len, "FMA=%d REPS=%d MASK=%d STORE=%d %s", e->unroll, e->reps, e->mask, e->store,
+             plan_simd_name((e->simd == SIMD_SSE2) ? SIMD_SCALAR : e->simd));
+    return buffer;
+} /* pvfma_line */
+
+/**
+ * \brief Logs which engine kernel a plan runs.
+ * \param e The settings from pvfma_setup.
+ * \param name The plan name.
+ */
+void pvfma_log(PVFMA *e, char *name){
+    char buffer[MSG_SIZE], line[MSG_SIZE];
+    snprintf(buffer, MSG_SIZE, "%s FMA kernel       : %s", name, pvfma_line(e, line, MSG_SIZE));
+    EmitLog(MyRank, 9999, buffer, -1, PRINT_SOME);
+} /* pvfma_log */
@@ -0,0 +1,61 @@
+/*
+   This file is part of SystemBurn.
+
+   Copyright (C) 2012, UT-Battelle, LLC.
+
+   This product includes software produced by UT-Battelle, LLC under Contract No.
+   DE-AC05-00OR22725 with the Department of Energy.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the New BSD 3-clause software license (LICENSE).
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   LICENSE for more details.
+
+   For more information please contact the SystemBurn developers at:
+   systemburn-info@googlegroups.com
+
+ */
+#ifndef __PLAN_PVFMA_H
+#define __PLAN_PVFMA_H
+
+#include <loadstruct.h>
+
+/*
+ * FMA engine shared by the PV plans. With the FMA keyword on a PV PLAN line
+ * the plan streams through its first array with explicit AVX2 or AVX-512 FMA
+ * kernels instead of its own scalar loop.
+ */
+
+#define PVFMA_REPS        16    /* default FMAs per accumulator per vector loaded (REPS=)   */
+#define PVFMA_MAX_UNROLL  24    /* most independent accumulators (FMA=n)                     */
+#define PVFMA_ALIGN       8     /* the engine works on a multiple of this many doubles       */
+#define PVFMA_MAX_MASK    30    /* widest addend index (MASK=bits)                           */
+#define PVFMA_MAX_STORE   6     /* fewest stores, one per 2^6 vectors (STORE=n)              */
+
+/**
+ * \brief The FMA engine settings of one PV plan.
+ */
+typedef struct {
+    int on;                     /**< Run the engine instead of the plan's own loop (FMA).               */
+    int simd;                   /**< SIMD_SCALAR, SIMD_AVX2 or SIMD_AVX512 (SSE2 runs the scalar kernel). */
+    int unroll;                 /**< Independent accumulators, i.e. FMA chains in flight (FMA=n).       */
+    int reps;                   /**< FMAs on each accumulator for every vector loaded (REPS=n).         */
+    int mask;                   /**< The addend is loaded from a random index of this many bits (MASK=n). */
+    int store;                  /**< One vector in 2^store is written back (STORE=n).                   */
+    size_t seed;                /**< Scrambles the addend index.                                        */
+    double sink;                /**< Sum of the accumulators, so the work cannot be optimized away.     */
+} PVFMA;
+
+extern void pvfma_setup(PVFMA *e, data *m);
+extern void pvfma_fit(PVFMA *e);
+extern void pvfma_fill(double *a, size_t n);
+extern void pvfma_run(PVFMA *e, double *a, size_t n);
+extern uint64_t pvfma_flops(PVFMA *e, size_t n);
+extern uint64_t pvfma_bytes(PVFMA *e, size_t n);
+extern char *pvfma_line(PVFMA *e, char *buffer, size_t len);
+extern void pvfma_log(PVFMA *e, char *name);
+
+#endif /* __PLAN_PVFMA_H */
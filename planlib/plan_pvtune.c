@@ -0,0 +1,568 @@
+/*
+   This file is part of SystemBurn.
+
+   Copyright (C) 2012, UT-Battelle, LLC.
+
+   This product includes software produced by UT-Battelle, LLC under Contract No.
+   DE-AC05-00OR22725 with the Department of Energy.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the New BSD 3-clause software license (LICENSE).
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   LICENSE for more details.
+
+   For more information please contact the SystemBurn developers at:
+   systemburn-info@googlegroups.com
+
+ */
+#include <systemheaders.h>
+#include <systemburn.h>
+#include <initialization.h>
+#include <planheaders.h>
+
+/*
+ * PVTUNE searches the FMA engine's settings (see plan_pvfma.c) for the
+ * hottest load a node will sustain, so a power virus need not be tuned by hand
+ * for every new processor. Each candidate runs for a window of WINDOW
+ * seconds and is scored over the second half of it, by package power when
+ * the monitor thread can read the RAPL energy counters (power follows the
+ * load within milliseconds, so PowerEnergy reads them at the window's marks
+ * rather than waiting for the monitor's interval), else by the hottest
+ * temperature the monitor thread reads, else by its FLOP rate. A candidate whose second half scores well below its
+ * first (throttling) is unstable and cannot win.
+ *
+ * The search changes one setting at a time, keeping the best value before
+ * moving on to the next: SIMD width, accumulators (FMA chains in flight), FMAs
+ * per chain per load, the width of the addend index mask, and the store
+ * ratio. The team then runs the winner, and the winning settings are logged
+ * as a PV2 PLAN line of the same size, ready to paste into a load file.
+ */
+
+#ifdef HAVE_PAPI
+  #define NUM_PAPI_EVENTS 1
+  #define PAPI_COUNTERS { PAPI_FP_OPS }
+  #define PAPI_UNITS { "FLOPS" }
+#endif //HAVE_PAPI
+
+/* settings tried in each dimension, ending with -1 */
+static const int pvtune_values[PVTUNE_DIMS][PVTUNE_VALUES] = {
+    { SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512, -1 },
+    { 4, 8, 12, 16, 20, 24, -1 },
+    { 4, 8, 16, 32, 64, -1 },
+    { 0, 12, 16, 20, 24, -1 },
+    { 0, 1, 2, 3, 6, -1 }
+};
+static char *pvtune_sources[] = { "W", "C", "GFLOPS" };
+
+/**
+ * \brief Reads the wall clock.
+ * \returns Seconds.
+ */
+static double pvtune_now(){
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+} /* pvtune_now */
+
+/**
+ * \brief Picks what candidates are scored by, from what the monitor thread can read.
+ * \param s The team's search state.
+ */
+static void pvtune_source(PVTUNEshared *s){
+    if(PowerFound(POWER_PACKAGE) > 0){
+        s->source = PVTUNE_POWER;
+    } else if(TemperatureHottest() >= ABSOLUTE_ZERO){
+        s->source = PVTUNE_TEMP;
+        /* see a few monitor readings in each half window */
+        if(s->window < 4 * monitor_frequency){
+            s->window = 4 * monitor_frequency;
+        }
+    } else {
+        s->source = PVTUNE_RATE;
+    }
+} /* pvtune_source */
+
+/**
+ * \brief Sets one search dimension of the engine settings.
+ * \param e The settings.
+ * \param dim The dimension.
+ * \param value The value.
+ */
+static void pvtune_set(PVFMA *e, int dim, int value){
+    switch(dim){
+    case 0:
+        e->simd = value;
+        break;
+    case 1:
+        e->unroll = value;
+        break;
+    case 2:
+        e->reps = value;
+        break;
+    case 3:
+        e->mask = value;
+        break;
+    default:
+        e->store = value;
+        break;
+    }
+} /* pvtune_set */
+
+/**
+ * \brief Moves the search on to the next candidate worth running, or ends it.
+ * Values the processor or the array cannot hold, and the best settings themselves (already scored), are skipped.
+ * \param s The team's search state.
+ * \param n Doubles in each member's array.
+ */
+static void pvtune_next(PVTUNEshared *s, size_t n){
+    PVFMA c;
+    int v;
+
+    while(s->dim < PVTUNE_DIMS){
+        s->value++;
+        v = pvtune_values[s->dim][s->value];
+        if(v < 0){
+            s->dim++;
+            s->value = -1;
+            continue;
+        }
+        c = s->best;
+        pvtune_set(&c, s->dim, v);
+        pvfma_fit(&c);
+        if((s->dim == 0) && (v > plan_simd_level())){
+            continue;
+        }
+        if((s->dim == 3) && (v > 0) && ((size_t)1 << v) > n){
+            continue;
+        }
+        if((c.simd == s->best.simd) && (c.unroll == s->best.unroll) && (c.reps == s->best.reps) &&
+           (c.mask == s->best.mask) && (c.store == s->best.store)){
+            continue;
+        }
+        s->current = c;
+        __atomic_fetch_add(&s->generation, 1, __ATOMIC_RELEASE);
+        return;
+    }
+    s->done = 1;
+    s->current = s->best;
+    __atomic_fetch_add(&s->generation, 1, __ATOMIC_RELEASE);
+} /* pvtune_next */
+
+/**
+ * \brief Starts a new scoring window.
+ * \param s The team's search state.
+ * \param now The time.
+ */
+static void pvtune_window(PVTUNEshared *s, double now){
+    s->start = s->mark[0] = s->last_sample = now;
+    s->mark[1] = s->mark[2] = 0.0;
+    s->sum[0] = s->sum[1] = 0.0;
+    s->samples[0] = s->samples[1] = 0;
+    if(s->source == PVTUNE_POWER){
+        s->joules[0] = PowerEnergy(POWER_PACKAGE);
+    }
+} /* pvtune_window */
+
+/**
+ * \brief Scores one half of the window just finished.
+ * \param s The team's search state.
+ * \param h The half, 0 or 1.
+ * \returns Watts, degrees C or GFLOPS.
+ */
+static double pvtune_half(PVTUNEshared *s, int h){
+    double t = s->mark[h + 1] - s->mark[h];
+    switch(s->source){
+    case PVTUNE_POWER:
+        return (t > 0.0) ? (s->joules[h + 1] - s->joules[h]) / t : 0.0;
+    case PVTUNE_TEMP:
+        return (s->samples[h] > 0) ? s->sum[h] / s->samples[h] : 0.0;
+    default:
+        return (t > 0.0) ? s->sum[h] / t / 1e9 : 0.0;
+    }
+} /* pvtune_half */
+
+/**
+ * \brief Accounts for one exec of member 0, and when its window is over scores the candidate and moves on.
+ * \param s The team's search state.
+ * \param flops Floating point operations in the exec.
+ * \param n Doubles in each member's array.
+ */
+static void pvtune_step(PVTUNEshared *s, uint64_t flops, size_t n){
+    char buffer[MSG_SIZE], line[MSG_SIZE], size[32];
+    double now = pvtune_now(), score, first;
+    int h = (now - s->start >= s->window / 2);
+    int stable;
+
+    if(h && (s->mark[1] == 0.0)){
+        s->mark[1] = now;
+        if(s->source == PVTUNE_POWER){
+            s->joules[1] = PowerEnergy(POWER_PACKAGE);
+        }
+    }
+    if(s->source == PVTUNE_RATE){
+        s->sum[h] += flops;
+    } else if((s->source == PVTUNE_TEMP) && (now - s->last_sample >= 1.0)){
+        s->sum[h] += TemperatureHottest();
+        s->samples[h]++;
+        s->last_sample = now;
+    }
+    if(now - s->start < s->window){
+        return;
+    }
+
+    s->mark[2] = now;
+    if(s->source == PVTUNE_POWER){
+        s->joules[2] = PowerEnergy(POWER_PACKAGE);
+    }
+    first = pvtune_half(s, 0);
+    score = pvtune_half(s, 1);
+    stable = (score >= first * (1.0 - PVTUNE_SAG));
+    s->tried++;
+    snprintf(buffer, MSG_SIZE, "PVTUNE %s%s :", pvfma_line(&s->current, line, MSG_SIZE), stable ? "" : " (unstable)");
+    EmitLogfs(MyRank, 9999, buffer, score, pvtune_sources[s->source], PRINT_SOME);
+    if(stable && ((s->tried == 1) || (score > s->best_score))){
+        s->best = s->current;
+        s->best_score = score;
+    }
+
+    pvtune_next(s, n);
+    if(s->done){
+        snprintf(buffer, MSG_SIZE, "PVTUNE result: PLAN 1 PV2 %s %s", plan_size_text(n * sizeof(double), size, sizeof(size)),
+                 pvfma_line(&s->best, line, MSG_SIZE));
+        EmitLog(MyRank, 9999, buffer, -1, PRINT_ALWAYS);
+    }
+    pvtune_window(s, now);
+} /* pvtune_step */
+
+/**
+ * \brief Frees the search state once the last member of the team is killed.
+ * \param shared The PVTUNEshared of the team.
+ */
+static void pvtune_release(void *shared){
+    free(shared);
+} /* pvtune_release */
+
+/**
+ * \brief Allocates and returns the data struct for the plan
+ * \param [in] m Holds the input data for the plan.
+ * \return void* Data struct
+ * \sa parsePVTUNEPlan
+ * \sa initPVTUNEPlan
+ * \sa execPVTUNEPlan
+ * \sa perfPVTUNEPlan
+ * \sa killPVTUNEPlan
+ */
+void *makePVTUNEPlan(data *m){
+    Plan *p;
+    PVTUNEdata *d;
+    char *value;
+    p = (Plan *)malloc(sizeof(Plan));
+    assert(p);
+    if(p){
+        p->fptr_initplan = &initPVTUNEPlan;
+        p->fptr_execplan = &execPVTUNEPlan;
+        p->fptr_killplan = &killPVTUNEPlan;
+        p->fptr_perfplan = &perfPVTUNEPlan;
+        p->name = PVTUNE;
+        d = (PVTUNEdata *)calloc(1, sizeof(PVTUNEdata));
+        assert(d);
+        if(d){
+            if(m->isize == 1){
+                d->M = m->i[0] / sizeof(double);
+            } else {
+                d->M = m->d[0] / sizeof(double);
+            }
+            /* the starting point of the search; FMA and the other engine keywords may move it */
+            pvfma_setup(&d->fma, m);
+            d->fma.on = 1;
+            d->window = PVTUNE_WINDOW;
+            if((value = plan_token_value(m, "WINDOW")) != NULL && atof(value) > 0.0){
+                d->window = atof(value);
+            }
+        }
+        (p->vptr) = (void *)d;
+    }
+    return p;
+} /* makePVTUNEPlan */
+
+/**
+ * \brief Creates and initializes the working data for the plan, and joins the team's search.
+ * \param [in] plan Holds the data and memory for the plan.
+ * \return int Error flag value
+ * \sa parsePVTUNEPlan
+ * \sa makePVTUNEPlan
+ * \sa execPVTUNEPlan
+ * \sa perfPVTUNEPlan
+ * \sa killPVTUNEPlan
+ */
+int initPVTUNEPlan(void *plan){
+    Plan *p;
+    PVTUNEdata *d = NULL;
+    PVTUNEshared *s;
+    PlanTeam *team;
+
+    #ifdef HAVE_PAPI
+    int temp_event, k;
+    int PAPI_Events [NUM_PAPI_EVENTS] = PAPI_COUNTERS;
+    char *PAPI_units [NUM_PAPI_EVENTS] = PAPI_UNITS;
+    #endif //HAVE_PAPI
+
+    p = (Plan *)plan;
+    if(!p){
+        return make_error(ALLOC, generic_err);
+    }
+    d = (PVTUNEdata *)p->vptr;
+    p->exec_count = 0;
+    if(DO_PERF){
+        perftimer_init(&p->timers, NUM_TIMERS);
+
+        #ifdef HAVE_PAPI
+        /* Initialize plan's PAPI data */
+        p->PAPI_EventSet = PAPI_NULL;
+        p->PAPI_Num_Events = 0;
+
+        TEST_PAPI(PAPI_create_eventset(&p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
+
+        //Add the desired events to the Event Set; ensure the dsired counters
+        //  are on the system then add, ignore otherwise
+        for(k = 0; k < TOTAL_PAPI_EVENTS && k < NUM_PAPI_EVENTS; k++){
+            temp_event = PAPI_Events[k];
+            if(PAPI_query_event(temp_event) == PAPI_OK){
+                p->PAPI_Num_Events++;
+                TEST_PAPI(PAPI_add_event(p->PAPI_EventSet, temp_event), PAPI_OK, MyRank, 9999, PRINT_SOME);
+            }
+        }
+
+        PAPIRes_init(p->PAPI_Results, p->PAPI_Times);
+        PAPI_set_units(p->name, PAPI_units, NUM_PAPI_EVENTS);
+
+        TEST_PAPI(PAPI_start(p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
+        #endif //HAVE_PAPI
+    }     //DO_PERF
+    if(!d){
+        return make_error(ALLOC, generic_err);
+    }
+
+    d->one = (double *)plan_alloc(p, sizeof(double) * d->M);
+    if(d->one == NULL){
+        return make_error(ALLOC, generic_err);
+    }
+    pvfma_fill(d->one, d->M);
+
+    /* a lone PVTUNE plan is a team of one */
+    if(p->team == NULL){
+        p->team = plan_team_new(1);
+        p->team_rank = 0;
+        if(p->team == NULL){
+            return make_error(ALLOC, generic_err);
+        }
+    }
+    team = p->team;
+
+    pthread_mutex_lock(&(team->lock));
+    s = (PVTUNEshared *)team->shared;
+    if(s == NULL){
+        s = (PVTUNEshared *)calloc(1, sizeof(PVTUNEshared));
+        if(s != NULL){
+            s->window = d->window;
+            s->best = s->current = d->fma;
+            s->dim = 0;
+            s->value = -1;
+            pvtune_source(s);
+            pvtune_window(s, pvtune_now());
+            team->shared = s;
+            team->release = pvtune_release;
+        }
+    }
+    if(s != NULL){
+        d->fma = s->current;
+        d->generation = s->generation;
+    }
+    pthread_mutex_unlock(&(team->lock));
+
+    d->s = s;
+    return (s != NULL) ? ERR_CLEAN : make_error(ALLOC, generic_err);
+} /* initPVTUNEPlan */
+
+/**
+ * \brief Frees the memory used in the plan. The search state is freed by the team once its last member is killed.
+ * \param [in] plan Points to the memory to be free'd.
+ * \sa parsePVTUNEPlan
+ * \sa makePVTUNEPlan
+ * \sa initPVTUNEPlan
+ * \sa execPVTUNEPlan
+ * \sa perfPVTUNEPlan
+ */
+void *killPVTUNEPlan(void *plan){
+    Plan *p;
+    PVTUNEdata *d;
+    p = (Plan *)plan;
+    assert(p);
+    d = (PVTUNEdata *)p->vptr;
+    assert(d);
+
+    if(DO_PERF){
+        #ifdef HAVE_PAPI
+        TEST_PAPI(PAPI_stop(p->PAPI_EventSet, NULL), PAPI_OK, MyRank, 9999, PRINT_SOME);
+        #endif //HAVE_PAPI
+    }     //DO_PERF
+
+    if(d->one){
+        plan_free(d->one);
+    }
+    free(d);
+    free(p);
+    return (void *)NULL;
+} /* killPVTUNEPlan */
+
+/**
+ * \brief Runs one pass of the team's current candidate; member 0 also advances the search.
+ * \param [in] plan Holds the data and the memory for the plan.
+ * \return int Error flag value
+ * \sa parsePVTUNEPlan
+ * \sa makePVTUNEPlan
+ * \sa initPVTUNEPlan
+ * \sa perfPVTUNEPlan
+ * \sa killPVTUNEPlan
+ */
+int execPVTUNEPlan(void *plan){
+    #ifdef HAVE_PAPI
+    int k;
+    long long start, end;
+    #endif //HAVE_PAPI
+
+    ORB_t t1, t2;
+    Plan *p;
+    PVTUNEdata *d;
+    PVTUNEshared *s;
+    uint64_t flops;
+    p = (Plan *)plan;
+    d = (PVTUNEdata *)p->vptr;
+    assert(d);
+    s = d->s;
+    /* update execution count */
+    p->exec_count++;
+
+    if(__atomic_load_n(&s->generation, __ATOMIC_ACQUIRE) != d->generation){
+        pthread_mutex_lock(&(p->team->lock));
+        d->fma = s->current;
+        d->generation = s->generation;
+        pthread_mutex_unlock(&(p->team->lock));
+    }
+
+    if(DO_PERF){
+        #ifdef HAVE_PAPI
+        /* Start PAPI counters and time */
+        TEST_PAPI(PAPI_reset(p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
+        start = PAPI_get_real_usec();
+        #endif //HAVE_PAPI
+        ORB_read(t1);
+    }     //DO_PERF
+
+    pvfma_run(&d->fma, d->one, d->M);
+
+    if(DO_PERF){
+        ORB_read(t2);
+        #ifdef HAVE_PAPI
+        end = PAPI_get_real_usec();         //PAPI time
+        /* Collect PAPI counters and store time elapsed */
+        TEST_PAPI(PAPI_accum(p->PAPI_EventSet, p->PAPI_Results), PAPI_OK, MyRank, 9999, PRINT_SOME);
+        for(k = 0; k < p->PAPI_Num_Events && k < TOTAL_PAPI_EVENTS; k++){
+            p->PAPI_Times[k] += (end - start);
+        }
+        #endif //HAVE_PAPI
+        perftimer_accumulate(&p->timers, TIMER0, ORB_cycles_a(t2, t1));
+        perftimer_accumulate(&p->timers, TIMER1, ORB_cycles_a(t2, t1));
+    }     //DO_PERF
+
+    flops = pvfma_flops(&d->fma, d->M);
+    d->flops += flops;
+    d->bytes += pvfma_bytes(&d->fma, d->M);
+
+    if((p->team_rank == 0) && !s->done){
+        pthread_mutex_lock(&(p->team->lock));
+        pvtune_step(s, flops, d->M);
+        pthread_mutex_unlock(&(p->team->lock));
+    }
+    return ERR_CLEAN;
+} /* execPVTUNEPlan */
+
+/**
+ * \brief Calculates (and optionally displays) performance data for the plan, and the state of the search.
+ * \param [in] plan The Plan structure that contains all the plan data.
+ * \returns An integer error code.
+ * \sa parsePVTUNEPlan
+ * \sa makePVTUNEPlan
+ * \sa initPVTUNEPlan
+ * \sa execPVTUNEPlan
+ * \sa killPVTUNEPlan
+ */
+int perfPVTUNEPlan(void *plan){
+    int ret = ~ERR_CLEAN;
+    uint64_t opcounts[NUM_TIMERS];
+    char buffer[MSG_SIZE], line[MSG_SIZE], size[32];
+    Plan *p;
+    PVTUNEdata *d;
+    p = (Plan *)plan;
+    d = (PVTUNEdata *)p->vptr;
+    if(p->exec_count > 0){
+        memset(opcounts, 0, sizeof(opcounts));
+        opcounts[TIMER0] = d->flops;            // floating point operations of whichever candidates ran
+        opcounts[TIMER1] = d->bytes;            // bytes streamed through the array
+
+        perf_table_update(&p->timers, opcounts, p->name);
+        #ifdef HAVE_PAPI
+        PAPI_table_update(p->name, p->PAPI_Results, p->PAPI_Times, p->PAPI_Num_Events);
+        #endif     //HAVE_PAPI
+
+        double gflops = ((double)opcounts[TIMER0] / perftimer_gettime(&p->timers, TIMER0)) / 1e9;
+        EmitLogfs(MyRank, 9999, "PVTUNE plan performance:", gflops, "GFLOPS", PRINT_SOME);
+        if(p->team_rank == 0){
+            pthread_mutex_lock(&(p->team->lock));
+            EmitLog(MyRank, 9999, "PVTUNE candidates scored:", d->s->tried, PRINT_SOME);
+            snprintf(buffer, MSG_SIZE, "PVTUNE %s: PLAN 1 PV2 %s %s", d->s->done ? "result" : "best so far",
+                     plan_size_text(d->M * sizeof(double), size, sizeof(size)), pvfma_line(&d->s->best, line, MSG_SIZE));
+            pthread_mutex_unlock(&(p->team->lock));
+            EmitLog(MyRank, 9999, buffer, -1, PRINT_SOME);
+        }
+        EmitLog  (MyRank, 9999, "PVTUNE execution count :", p->exec_count, PRINT_SOME);
+        ret = ERR_CLEAN;
+    }
+    return ret;
+} /* perfPVTUNEPlan */
+
+/**
+ * \brief Reads the input file, and pulls out the necessary data for use in the plan
+ * \param [in] line The input line for the plan.
+ * \param [out] output Holds the information for the load.
+ * \return int True if the data was read, false if it wasn't
+ * \sa makePVTUNEPlan
+ * \sa initPVTUNEPlan
+ * \sa execPVTUNEPlan
+ * \sa perfPVTUNEPlan
+ * \sa killPVTUNEPlan
+ */
+int parsePVTUNEPlan(char *line, LoadPlan *output){
+    output->input_data = get_sizes(line);
+    output->name = PVTUNE;
+    return (output->input_data->isize + output->input_data->csize + output->input_data->dsize > 0);
+}
+
+/**
+ * \brief The data structure for the plan. Holds the input and all used info.
+ */
+plan_info PVTUNE_info = {
+    "PVTUNE",
+    NULL,
+    0,
+    makePVTUNEPlan,
+    parsePVTUNEPlan,
+    execPVTUNEPlan,
+    initPVTUNEPlan,
+    killPVTUNEPlan,
+    perfPVTUNEPlan,
+    { "FLOPS", "B/s", NULL }
+};
@@ -0,0 +1,85 @@
+/*
+   This file is part of SystemBurn.
+
+   Copyright (C) 2012, UT-Battelle, LLC.
+
+   This product includes software produced by UT-Battelle, LLC under Contract No.
+   DE-AC05-00OR22725 with the Department of Energy.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the New BSD 3-clause software license (LICENSE).
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   LICENSE for more details.
+
+   For more information please contact the SystemBurn developers at:
+   systemburn-info@googlegroups.com
+
+ */
+#ifndef __PLAN_PVTUNE_H
+#define __PLAN_PVTUNE_H
+
+#include <loadstruct.h>
+#include <plan_pvfma.h>
+
+extern void *makePVTUNEPlan(data *m);
+extern int initPVTUNEPlan(void *p);
+extern int execPVTUNEPlan(void *p);
+extern int perfPVTUNEPlan(void *p);
+extern void *killPVTUNEPlan(void *p);
+extern int parsePVTUNEPlan(char *line, LoadPlan *output);
+extern plan_info PVTUNE_info;
+
+#define PVTUNE_WINDOW    15     /* default seconds each candidate runs (WINDOW=)                     */
+#define PVTUNE_SAG       0.05   /* a candidate whose second half scores this much below its first is unstable */
+#define PVTUNE_DIMS      5      /* SIMD width, accumulators, chain depth, mask width, store ratio    */
+#define PVTUNE_VALUES    8      /* most values tried in one dimension                                */
+
+/**
+ * \brief What a PVTUNE team scores its candidates by, best first.
+ */
+enum {
+    PVTUNE_POWER,               /**< Package power from the RAPL energy counters.                      */
+    PVTUNE_TEMP,                /**< The hottest sensor the monitor thread reads.                      */
+    PVTUNE_RATE                 /**< The FLOP rate, when neither can be read.                          */
+};
+
+/**
+ * \brief The search state shared by a PVTUNE team. Member 0 runs the search, every member runs the current candidate.
+ */
+typedef struct {
+    int source;                 /**< PVTUNE_POWER, PVTUNE_TEMP or PVTUNE_RATE.                         */
+    double window;              /**< Seconds per candidate.                                            */
+    PVFMA best;                 /**< The best stable candidate so far.                                 */
+    double best_score;
+    PVFMA current;              /**< The candidate the team is running.                                */
+    unsigned int generation;    /**< Bumped whenever current changes.                                  */
+    int dim, value;             /**< Position in the search: which setting, and which of its values.   */
+    int done;                   /**< The search is over and the team runs best.                        */
+    int tried;                  /**< Candidates scored.                                                */
+
+    /* the window in progress, split in two halves */
+    double start;               /**< When the window started (seconds).                                */
+    double mark[3];             /**< Times the halves started and the window ended.                    */
+    double joules[3];           /**< Energy counter at the same times.                                 */
+    double sum[2];              /**< Temperatures or FLOPs gathered in each half.                      */
+    int samples[2];
+    double last_sample;
+} PVTUNEshared;
+
+/**
+ * \brief The data structure for the plan. Holds the input and all used info.
+ */
+typedef struct {
+    size_t M;
+    double *one;
+    double window;              /**< Seconds per candidate (WINDOW=).                                  */
+    PVFMA fma;                  /**< This member's copy of the team's current candidate.               */
+    unsigned int generation;    /**< The generation fma was copied at.                                 */
+    PVTUNEshared *s;
+    uint64_t flops, bytes;      /**< Work done, for the performance table.                             */
+} PVTUNEdata;
+
+#endif /* __PLAN_PVTUNE_H */
@@ -125,11 +125,11 @@ int initRDGEMMPlan(void *plan){
     if(d){
         M = d->M;
         N = d->N;
-        d->A = (double *)malloc(sizeof(double) * M * N);
+        d->A = (double *)plan_alloc(p, sizeof(double) * M * N);
         assert(d->A);
-        d->B = (double *)malloc(sizeof(double) * N * N);
+        d->B = (double *)plan_alloc(p, sizeof(double) * N * N);
         assert(d->B);
-        d->C = (double *)malloc(sizeof(double) * M * N);
+        d->C = (double *)plan_alloc(p, sizeof(double) * M * N);
         assert(d->C);
         if(d->A && d->B && d->C){
             for(i = 0; i < N * M; i++){
@@ -167,13 +167,13 @@ void *killRDGEMMPlan(void *plan){
     }     //DO_PERF
 
     if(d->C){
-        free((void *)(d->C));
+        plan_free((void *)(d->C));
     }
     if(d->B){
-        free((void *)(d->B));
+        plan_free((void *)(d->B));
     }
     if(d->A){
-        free((void *)(d->A));
+        plan_free((void *)(d->A));
     }
     free((void *)(d));
     free((void *)(p));
@@ -0,0 +1,559 @@
+/*
+   This file is part of SystemBurn.
+
+   Copyright (C) 2012, UT-Battelle, LLC.
+
+   This product includes software produced by UT-Battelle, LLC under Contract No.
+   DE-AC05-00OR22725 with the Department of Energy.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the New BSD 3-clause software license (LICENSE).
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   LICENSE for more details.
+
+   For more information please contact the SystemBurn developers at:
+   systemburn-info@googlegroups.com
+
+ */
+#include <systemburn.h>
+#include <planheaders.h>
+
+/*
+ * SGUPS - shared table GUPS.
+ *
+ * All copies of an SGUPS PLAN line within a subload (a plan team) update one
+ * table, sized from the load file. The HPCC update stream is split between the
+ * members, so one pass of every member applies each update of the stream once.
+ *
+ *   PLAN <n> SGUPS <table size> [RACY | ATOMIC | BUCKET]
+ */
+
+#define RSIZE GUPS_RSIZE
+#define POLY GUPS_POLY
+
+/* SGUPS_BUCKET: updates staged per batch, and the number of table regions they are sorted into */
+#define SGUPS_BATCH   (8 * RSIZE)
+#define SGUPS_LOG_BKT 6
+#define SGUPS_BUCKETS (1 << SGUPS_LOG_BKT)
+
+#ifdef HAVE_PAPI
+  #define NUM_PAPI_EVENTS 2
+  #define PAPI_COUNTERS { PAPI_FP_OPS, PAPI_TOT_CYC }
+  #define PAPI_UNITS { "FLOPS", "CYCS" }
+#endif //HAVE_PAPI
+
+/**
+ * \brief Names of the SGUPS update modes, as given on the PLAN line.
+ */
+static char *sgups_modes[] = {
+    "RACY", "ATOMIC", "BUCKET"
+};
+
+/**
+ * \brief SGUPS specific error messages.
+ */
+char *sgups_errs[] = {
+    " lost updates above the HPCC tolerance (1%):"
+};
+
+/**
+ * \brief Binary logarithm (n=2^i), rounding down.
+ * \param [in] n Target for solving the logarithm.
+ * \return i
+ */
+static int SGUPSlog2(uint64_t n){
+    int i = 0;
+    while(n >>= 1){
+        i++;
+    }
+    return i;
+}
+
+/**
+ * \brief Starts the LFSR lanes of one team member at its share of the update stream.
+ * \param [out] ran The RSIZE lanes.
+ * \param [in] s The shared table.
+ * \param [in] rank The member's rank in the team.
+ */
+static void SGUPS_startLanes(uint64_t *ran, SGUPSshared *s, int rank){
+    int j;
+    uint64_t per_lane = s->member_updates / RSIZE;
+    for(j = 0; j < RSIZE; j++){
+        ran[j] = GUPS_startRNG((int64_t)(per_lane * ((uint64_t)rank * RSIZE + j)));
+    }
+}
+
+/**
+ * \brief Applies one member's share of the update stream to the shared table.
+ * \param [in] s The shared table.
+ * \param [in,out] ran The member's LFSR lanes, already started.
+ * \param [in] mode One of SGUPS_RACY, SGUPS_ATOMIC or SGUPS_BUCKET.
+ * \param bidx Staging buffer of SGUPS_BATCH indices (SGUPS_BUCKET only).
+ * \param bval Staging buffer of SGUPS_BATCH values (SGUPS_BUCKET only).
+ */
+static void SGUPS_update(SGUPSshared *s, uint64_t *ran, int mode, uint64_t *bidx, uint64_t *bval){
+    uint64_t i, j, b, n, idx, v;
+    uint64_t *tbl = s->tbl;
+    uint64_t *sub = s->sub;
+    uint64_t mask = s->tbl_size - 1;
+    int lsubsize = s->sub_log_size;
+    int bshift = (s->tbl_log_size > SGUPS_LOG_BKT) ? (s->tbl_log_size - SGUPS_LOG_BKT) : 0;
+    uint64_t rounds = s->member_updates / RSIZE;
+    uint64_t count[SGUPS_BUCKETS + 1];
+
+    switch(mode){
+    case SGUPS_ATOMIC:
+        for(i = 0; i < rounds; i++){
+            for(j = 0; j < RSIZE; j++){
+                ran[j] = (ran[j] << 1) ^ ((int64_t)ran[j] < 0 ? POLY : 0);
+                __atomic_fetch_xor(&(tbl[ran[j] & mask]), sub[ran[j] >> (64 - lsubsize)], __ATOMIC_RELAXED);
+            }
+        }
+        break;
+    case SGUPS_BUCKET:
+        for(i = 0; i < rounds; i += SGUPS_BATCH / RSIZE){
+            n = ((rounds - i) < SGUPS_BATCH / RSIZE) ? (rounds - i) : SGUPS_BATCH / RSIZE;
+            /* count the updates of this batch per table region */
+            memset(count, 0, sizeof(count));
+            for(b = 0; b < n; b++){
+                for(j = 0; j < RSIZE; j++){
+                    ran[j] = (ran[j] << 1) ^ ((int64_t)ran[j] < 0 ? POLY : 0);
+                    bidx[b * RSIZE + j] = ran[j];
+                    count[((ran[j] & mask) >> bshift) + 1]++;
+                }
+            }
+            for(b = 1; b <= SGUPS_BUCKETS; b++){
+                count[b] += count[b - 1];
+            }
+            /* scatter into region order, then apply region by region */
+            for(b = 0; b < n * RSIZE; b++){
+                idx = bidx[b] & mask;
+                bval[count[idx >> bshift]++] = bidx[b];
+            }
+            for(b = 0; b < n * RSIZE; b++){
+                v = bval[b];
+                __atomic_fetch_xor(&(tbl[v & mask]), sub[v >> (64 - lsubsize)], __ATOMIC_RELAXED);
+            }
+        }
+        break;
+    default:    /* SGUPS_RACY */
+        for(i = 0; i < rounds; i++){
+            for(j = 0; j < RSIZE; j++){
+                ran[j] = (ran[j] << 1) ^ ((int64_t)ran[j] < 0 ? POLY : 0);
+                idx = ran[j] & mask;
+                /* deliberately unsynchronized read-xor-write, as in HPCC RandomAccess */
+                v = __atomic_load_n(&(tbl[idx]), __ATOMIC_RELAXED);
+                __atomic_store_n(&(tbl[idx]), v ^ sub[ran[j] >> (64 - lsubsize)], __ATOMIC_RELAXED);
+            }
+        }
+        break;
+    }
+} /* SGUPS_update */
+
+/**
+ * \brief Verifies the shared table once every member has stopped, then frees it. Used as the team's release function.
+ * Every member stream applied an even number of times leaves the table unchanged; the odd ones are replayed once
+ * more, after which every entry that is not back to its index marks a lost update.
+ * \param [in] shared The SGUPSshared of the team.
+ */
+static void SGUPS_release(void *shared){
+    SGUPSshared *s = (SGUPSshared *)shared;
+    uint64_t ran[RSIZE];
+    uint64_t i, errors = 0, total = 0;
+    int r;
+
+    if(CHECK_CALC){
+        for(r = 0; r < s->members; r++){
+            total += s->passes[r] * s->member_updates;
+            if(s->passes[r] & 1){
+                SGUPS_startLanes(ran, s, r);
+                SGUPS_update(s, ran, SGUPS_ATOMIC, NULL, NULL);
+            }
+        }
+        for(i = 0; i < s->tbl_size; i++){
+            if(s->tbl[i] != i){
+                errors++;
+            }
+        }
+        if(total > 0){
+            EmitLogfs(MyRank, 9999, "SGUPS table entries with lost updates:", 100.0 * (double)errors / (double)s->tbl_size, "%", PRINT_SOME);
+            if(errors * 100 > s->tbl_size){          // the HPCC RandomAccess rule: at most 1% of the table may be wrong
+                EmitLog(MyRank, 9999, "SGUPS Errors: table entries with lost updates exceed 1%, count:", (int)errors, PRINT_ALWAYS);
+            }
+        }
+    }
+
+    plan_free(s->tbl);
+    plan_free(s->sub);
+    free(s->passes);
+    free(s);
+} /* SGUPS_release */
+
+/**
+ * \brief Allocates and returns the data struct for the plan
+ * \param [in] m Holds the input data for the plan.
+ * \return A reference to the created Plan structure.
+ * \sa parseSGUPSPlan
+ * \sa initSGUPSPlan
+ * \sa execSGUPSPlan
+ * \sa perfSGUPSPlan
+ * \sa killSGUPSPlan
+ */
+void *makeSGUPSPlan(data *m){
+    Plan *p;
+    SGUPSdata *d;
+    int i;
+    p = (Plan *)malloc(sizeof(Plan));
+    assert(p);
+    if(p){
+        p->fptr_initplan = &initSGUPSPlan;
+        p->fptr_execplan = &execSGUPSPlan;
+        p->fptr_killplan = &killSGUPSPlan;
+        p->fptr_perfplan = &perfSGUPSPlan;
+        p->name = SGUPS;
+        d = (SGUPSdata *)malloc(sizeof(SGUPSdata));
+        assert(d);
+        if(d){
+            if(m->isize >= 1){
+                d->tbl_log_size = SGUPSlog2((uint64_t)(m->i[0]) / sizeof(uint64_t));
+            } else if(m->dsize >= 1){
+                d->tbl_log_size = SGUPSlog2((uint64_t)(m->d[0]) / sizeof(uint64_t));
+            } else {
+                d->tbl_log_size = 20;
+            }
+            d->mode = SGUPS_RACY;
+            if(m->csize >= 1){
+                for(i = 0; i < sizeof(sgups_modes) / sizeof(char *); i++){
+                    if(strcmp(m->c[0], sgups_modes[i]) == 0){
+                        d->mode = i;
+                    }
+                }
+            }
+            d->s = NULL;
+            d->random = d->bidx = d->bval = NULL;
+        }
+        (p->vptr) = (void *)d;
+    }
+    return p;
+} /* makeSGUPSPlan */
+
+/**
+ * \brief Joins the team's shared table, creating it if this is the first member to arrive.
+ * \param [in] plan A pointer to a Plan structure that holds the data and the memory for the plan.
+ * \return int Error flag value
+ * \sa parseSGUPSPlan
+ * \sa makeSGUPSPlan
+ * \sa execSGUPSPlan
+ * \sa perfSGUPSPlan
+ * \sa killSGUPSPlan
+ */
+int initSGUPSPlan(void *plan){
+    uint64_t i;
+    Plan *p;
+    SGUPSdata *d = NULL;
+    SGUPSshared *s;
+    PlanTeam *team;
+
+    #ifdef HAVE_PAPI
+    int temp_event, k;
+    int PAPI_Events [NUM_PAPI_EVENTS] = PAPI_COUNTERS;
+    char *PAPI_units [NUM_PAPI_EVENTS] = PAPI_UNITS;
+    #endif //HAVE_PAPI
+
+    p = (Plan *)plan;
+    if(!p){
+        return make_error(ALLOC, generic_err);
+    }
+    d = (SGUPSdata *)p->vptr;
+    p->exec_count = 0;
+    if(DO_PERF){
+        perftimer_init(&p->timers, NUM_TIMERS);
+
+        #ifdef HAVE_PAPI
+        /* Initialize plan's PAPI data */
+        p->PAPI_EventSet = PAPI_NULL;
+        p->PAPI_Num_Events = 0;
+
+        TEST_PAPI(PAPI_create_eventset(&p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
+
+        //Add the desired events to the Event Set; ensure the dsired counters
+        //  are on the system then add, ignore otherwise
+        for(k = 0; k < TOTAL_PAPI_EVENTS && k < NUM_PAPI_EVENTS; k++){
+            temp_event = PAPI_Events[k];
+            if(PAPI_query_event(temp_event) == PAPI_OK){
+                p->PAPI_Num_Events++;
+                TEST_PAPI(PAPI_add_event(p->PAPI_EventSet, temp_event), PAPI_OK, MyRank, 9999, PRINT_SOME);
+            }
+        }
+
+        PAPIRes_init(p->PAPI_Results, p->PAPI_Times);
+        PAPI_set_units(p->name, PAPI_units, NUM_PAPI_EVENTS);
+
+        TEST_PAPI(PAPI_start(p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
+        #endif //HAVE_PAPI
+    }     //DO_PERF
+    if(!d){
+        return make_error(ALLOC, generic_err);
+    }
+
+    /* a lone SGUPS plan is a team of one */
+    if(p->team == NULL){
+        p->team = plan_team_new(1);
+        p->team_rank = 0;
+        if(p->team == NULL){
+            return make_error(ALLOC, generic_err);
+        }
+    }
+    team = p->team;
+
+    d->random = (uint64_t *)malloc(sizeof(uint64_t) * RSIZE);
+    if(d->mode == SGUPS_BUCKET){
+        d->bidx = (uint64_t *)malloc(sizeof(uint64_t) * SGUPS_BATCH);
+        d->bval = (uint64_t *)malloc(sizeof(uint64_t) * SGUPS_BATCH);
+        if(!d->bidx || !d->bval){
+            return make_error(ALLOC, generic_err);
+        }
+    }
+    if(!d->random){
+        return make_error(ALLOC, generic_err);
+    }
+
+    pthread_mutex_lock(&(team->lock));
+    s = (SGUPSshared *)team->shared;
+    if(s == NULL){
+        s = (SGUPSshared *)calloc(1, sizeof(SGUPSshared));
+        if(s != NULL){
+            s->tbl_log_size = d->tbl_log_size;
+            s->tbl_size = (1ULL << s->tbl_log_size);
+            s->sub_log_size = (s->tbl_log_size / 3);
+            if(s->sub_log_size < 1){
+                s->sub_log_size = 1;            // the kernels shift by 64 - sub_log_size
+            }
+            s->sub_size = (1ULL << s->sub_log_size);
+            s->members = team->size;
+            s->member_updates = ((4 * s->tbl_size) / (s->members * RSIZE)) * RSIZE;
+            if(s->member_updates == 0){
+                s->member_updates = RSIZE;
+            }
+            s->tbl = (uint64_t *)plan_alloc(p, sizeof(uint64_t) * s->tbl_size);
+            s->sub = (uint64_t *)plan_alloc(p, sizeof(uint64_t) * s->sub_size);
+            s->passes = (uint64_t *)calloc(s->members, sizeof(uint64_t));
+            if(s->tbl && s->sub && s->passes){
+                /* initialize substitution table */
+                s->sub[0] = 0;
+                for(i = 1; i < s->sub_size; i++){
+                    s->sub[i] = s->sub[i - 1] + 0x0123456789abcdefULL;
+                }
+                /* initialize main table */
+                for(i = 0; i < s->tbl_size; i++){
+                    s->tbl[i] = i;
+                }
+                team->shared = s;
+                team->release = SGUPS_release;
+            } else {
+                plan_free(s->tbl);
+                plan_free(s->sub);
+                free(s->passes);
+                free(s);
+                s = NULL;
+            }
+        }
+    }
+    if(s != NULL){
+        s->joined++;
+    }
+    pthread_mutex_unlock(&(team->lock));
+
+    d->s = s;
+    return (s != NULL) ? ERR_CLEAN : make_error(ALLOC, generic_err);
+} /* initSGUPSPlan */
+
+/**
+ * \brief Frees the memory used in the plan. The shared table is freed by the team once its last member is killed.
+ * \param [in] plan Points to the Plan structure to be freed.
+ * \sa parseSGUPSPlan
+ * \sa makeSGUPSPlan
+ * \sa initSGUPSPlan
+ * \sa execSGUPSPlan
+ * \sa perfSGUPSPlan
+ */
+void *killSGUPSPlan(void *plan){
+    Plan *p;
+    SGUPSdata *d;
+    p = (Plan *)plan;
+    d = (SGUPSdata *)p->vptr;
+
+    if(d->random){
+        free(d->random);
+    }
+    if(d->bidx){
+        free(d->bidx);
+    }
+    if(d->bval){
+        free(d->bval);
+    }
+
+    if(DO_PERF){
+        #ifdef HAVE_PAPI
+        TEST_PAPI(PAPI_stop(p->PAPI_EventSet, NULL), PAPI_OK, MyRank, 9999, PRINT_SOME);
+        #endif //HAVE_PAPI
+    }     //DO_PERF
+
+    free((void *)(d));
+    free((void *)(p));
+    return (void *)NULL;
+} /* killSGUPSPlan */
+
+/**
+ * \brief Applies this member's share of the HPCC update stream to the team's shared table.
+ * \param [in] plan Plan structure holding the data and memory for the plan.
+ * \return int Error flag value
+ * \sa parseSGUPSPlan
+ * \sa makeSGUPSPlan
+ * \sa initSGUPSPlan
+ * \sa perfSGUPSPlan
+ * \sa killSGUPSPlan
+ */
+int execSGUPSPlan(void *plan){
+    #ifdef HAVE_PAPI
+    /* PAPI vars */
+    int k;
+    long long start, end;
+    #endif //HAVE_PAPI
+
+    Plan *p;
+    SGUPSdata *d;
+    SGUPSshared *s;
+    /* execution timers */
+    ORB_t t1, t2;
+
+    p = (Plan *)plan;
+    d = (SGUPSdata *)p->vptr;
+    s = d->s;
+
+    /* increment execution count */
+    p->exec_count++;
+
+    SGUPS_startLanes(d->random, s, p->team_rank);
+
+    if(DO_PERF){
+        #ifdef HAVE_PAPI
+        /* Start PAPI counters and time */
+        TEST_PAPI(PAPI_reset(p->PAPI_EventSet), PAPI_OK, MyRank, 9999, PRINT_SOME);
+        start = PAPI_get_real_usec();
+        #endif //HAVE_PAPI
+        ORB_read(t1);
+    }     //DO_PERF
+
+    SGUPS_update(s, d->random, d->mode, d->bidx, d->bval);
+
+    if(DO_PERF){
+        ORB_read(t2);
+
+        #ifdef HAVE_PAPI
+        end = PAPI_get_real_usec();         //PAPI time
+
+        /* Collect PAPI counters and store time elapsed */
+        TEST_PAPI(PAPI_accum(p->PAPI_EventSet, p->PAPI_Results), PAPI_OK, MyRank, 9999, PRINT_SOME);
+        for(k = 0; k < p->PAPI_Num_Events && k < TOTAL_PAPI_EVENTS; k++){
+            p->PAPI_Times[k] += (end - start);
+        }
+        #endif //HAVE_PAPI
+        perftimer_accumulate(&p->timers, TIMER0, ORB_cycles_a(t2, t1));
+    }     //DO_PERF
+
+    /* the pass count is only read by the last member to leave, after everyone has stopped */
+    s->passes[p->team_rank]++;
+
+    return ERR_CLEAN;
+} /* execSGUPSPlan */
+
+/**
+ * \brief Stores (and optionally displays) performance data for the plan. The last member of the team to report
+ *        also prints the combined update rate of the whole table.
+ * \param [in] plan The Plan structure containing the plan data.
+ * \returns An integer error code.
+ * \sa parseSGUPSPlan
+ * \sa makeSGUPSPlan
+ * \sa initSGUPSPlan
+ * \sa execSGUPSPlan
+ * \sa killSGUPSPlan
+ */
+int perfSGUPSPlan(void *plan){
+    int ret = ~ERR_CLEAN;
+    uint64_t opcounts[NUM_TIMERS];
+    double gups, team_gups = 0.0;
+    int last = 0, members = 0;
+    Plan *p;
+    SGUPSdata *d;
+    SGUPSshared *s;
+    p = (Plan *)plan;
+    d = (SGUPSdata *)p->vptr;
+    s = d->s;
+    if((p->exec_count > 0) && (s != NULL)){
+        opcounts[TIMER0] = s->member_updates * p->exec_count;
+        opcounts[TIMER1] = 0;
+        opcounts[TIMER2] = 0;
+
+        perf_table_update(&p->timers, opcounts, p->name);
+        #ifdef HAVE_PAPI
+        PAPI_table_update(p->name, p->PAPI_Results, p->PAPI_Times, NUM_PAPI_EVENTS);
+        #endif     //HAVE_PAPI
+
+        gups = ((double)opcounts[TIMER0] / perftimer_gettime(&p->timers, TIMER0)) / (1e9);
+        EmitLogfs(MyRank, 9999, "SGUPS plan performance:", gups, "GUPS", PRINT_SOME);
+        EmitLog  (MyRank, 9999, "SGUPS execution count :", p->exec_count, PRINT_SOME);
+
+        pthread_mutex_lock(&(p->team->lock));
+        s->rate += gups;
+        s->reported++;
+        if(s->reported == s->joined){
+            last = 1;
+            team_gups = s->rate;
+            members = s->joined;
+        }
+        pthread_mutex_unlock(&(p->team->lock));
+        if(last){
+            EmitLogfs(MyRank, 9999, "SGUPS table performance:", team_gups, "GUPS", PRINT_SOME);
+            EmitLog  (MyRank, 9999, "SGUPS table shared by workers:", members, PRINT_SOME);
+        }
+        ret = ERR_CLEAN;
+    }
+    return ret;
+} /* perfSGUPSPlan */
+
+/**
+ * \brief Reads the input file, and pulls out the necessary data for use in the plan
+ * \param [in] line The input line for the plan.
+ * \param [out] output Holds the data for the load.
+ * \return int True if the data was read, false if it wasn't
+ * \sa makeSGUPSPlan
+ * \sa initSGUPSPlan
+ * \sa execSGUPSPlan
+ * \sa perfSGUPSPlan
+ * \sa killSGUPSPlan
+ */
+int parseSGUPSPlan(char *line, LoadPlan *output){
+    output->input_data = get_sizes(line);
+    output->name = SGUPS;
+    return (output->input_data->isize + output->input_data->csize + output->input_data->dsize > 0);
+}
+
+/**
+ * \brief The data structure for the plan. Holds the input and all used info.
+ */
+plan_info SGUPS_info = {
+    "SGUPS",
+    sgups_errs,
+    1,
+    makeSGUPSPlan,
+    parseSGUPSPlan,
+    execSGUPSPlan,
+    initSGUPSPlan,
+    killSGUPSPlan,
+    perfSGUPSPlan,
+    { "UPS", NULL, NULL }
+};
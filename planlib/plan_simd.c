@@ -0,0 +1,87 @@
+/*
+   This file is part of SystemBurn.
+
+   Copyright (C) 2012, UT-Battelle, LLC.
+
+   This product includes software produced by UT-Battelle, LLC under Contract No.
+   DE-AC05-00OR22725 with the Department of Energy.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the New BSD 3-clause software license (LICENSE).
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   LICENSE for more details.
+
+   For more information please contact the SystemBurn developers at:
+   systemburn-info@googlegroups.com
+
+ */
+#include <systemburn.h>
+#include <planheaders.h>
+
+/*
+ * Plans with hand vectorized kernels build one version per instruction set
+ * (using GCC target attributes, so the rest of the tree keeps its baseline
+ * flags) and pick one at init time. By default they take the best level the
+ * CPU supports; a PLAN line may name a lower one (SCALAR, SSE2, AVX2, AVX512)
+ * to compare them.
+ */
+
+static char *simd_names[] = {
+    "SCALAR", "SSE2", "AVX2", "AVX512"
+};
+
+/**
+ * \brief Finds the best instruction set level supported by the CPU we are running on.
+ * \returns One of SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 or SIMD_AVX512.
+ */
+int plan_simd_level(){
+    static int level = -1;
+
+    if(level < 0){
+        int found = SIMD_SCALAR;
+        #ifdef PLAN_X86_SIMD
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("sse2")){
+            found = SIMD_SSE2;
+        }
+        if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+            found = SIMD_AVX2;
+        }
+        if(__builtin_cpu_supports("avx512f")){
+            found = SIMD_AVX512;
+        }
+        #endif
+        __atomic_store_n(&level, found, __ATOMIC_RELAXED);
+    }
+    return level;
+} /* plan_simd_level */
+
+/**
+ * \brief Picks the instruction set level for a plan's kernels.
+ * \param m The parsed PLAN line, which may name a level.
+ * \returns The level named on the line, or the best supported one if none was named or the CPU lacks the named one.
+ */
+int plan_simd_select(data *m){
+    int i, level = plan_simd_level();
+    for(i = SIMD_SCALAR; i <= SIMD_AVX512; i++){
+        if(plan_has_token(m, simd_names[i])){
+            return (i < level) ? i : level;
+        }
+    }
+    return level;
+} /* plan_simd_select */
+
+/**
+ * \brief Gives the PLAN line keyword for an instruction set level.
+ * \param level One of the SIMD_* levels.
+ * \returns A constant string.
+ */
+char *plan_simd_name(int level){
+    if((level < SIMD_SCALAR) || (level > SIMD_AVX512)){
+        return "UNKNOWN";
+    }
+    return simd_names[level];
+} /* plan_simd_name */
@@ -36,13 +36,29 @@ extern plan_info DSTREAM_info;
 
 #define ROTATION 50
 
+/**
+ * \brief The STREAM kernels, in the order they run. Each is timed separately, in the timer of the same index.
+ */
+enum {
+    STREAM_COPY,                /* c = a          */
+    STREAM_SCALE,               /* b = s * c      */
+    STREAM_ADD,                 /* c = a + b      */
+    STREAM_TRIAD,               /* a = b + s * c  */
+    STREAM_SHIFT,               /* LSTREAM only   */
+    STREAM_CHECK                /* result check   */
+};
+
 /* DStream caller data structure */
 /**
  * \brief The data structure for the plan. Holds the input and all used info.
  */
 typedef struct {
     size_t M;
-    int random;
+    double scalar;
+    int simd;                   /**< SIMD_* level of the kernels.              */
+    int nt;                     /**< Use non-temporal (streaming) stores.      */
+    int team_mode;              /**< Split the arrays across the plan's team.  */
+    size_t M_total;             /**< Array length of the whole team.           */
     double *one, *two, *three, *four, *five;
 } DStreamdata;
 
@@ -63,7 +79,12 @@ extern plan_info LSTREAM_info;
  */
 typedef struct {
     size_t M;
-    int random;
+    long int scalar;
+    int shift;
+    int simd;                   /**< SIMD_* level of the kernels.              */
+    int nt;                     /**< Use non-temporal (streaming) stores.      */
+    int team_mode;              /**< Split the arrays across the plan's team.  */
+    size_t M_total;             /**< Array length of the whole team.           */
     long int *one, *two, *three, *four, *five;
 } LStreamdata;
 
@@ -22,6 +22,7 @@
 #define __PLAN_STRIDE_H
 
 #include <loadstruct.h>
+#include <performance.h>
 
 extern void *makeDStridePlan(data *i);              /* creates a plan struct       */
 extern int initDStridePlan(void *p);              /* inits plan's vptr           */
@@ -29,14 +30,40 @@ extern int execDStridePlan(void *p);              /* run the sleep plan
 extern int perfDStridePlan(void *p);
 extern void *killDStridePlan(void *p);            /* clean up & free plan & vptr */
 extern void Set(double *a, double *b,int m);      /* initialize the arrays       */
-extern void Fill(double *a);                      /* fill the cache memory       */
+extern void Fill(double *a, size_t n);            /* fill the cache memory       */
 extern int parseDStridePlan(char *line, LoadPlan *output);
 extern plan_info DSTRIDE_info;
 
-#define REPEAT   10
-#define CACHE    7500000
+#define REPEAT   10                 /* default passes per stride (REPEAT=)                 */
+#define CACHE    7500000            /* default cache flush buffer, in elements             */
 #define TEST     100
 
+#define STRIDE_MAX       NUM_TIMERS /* strides or footprints per plan, one timer each      */
+#define STRIDE_LINE      64         /* bytes per cache line, one chained load per line     */
+#define STRIDE_LAT_LOADS (1 << 20)  /* fewest dependent loads timed per footprint          */
+#define STRIDE_MIN_FOOT  4096       /* smallest LATENCY footprint                           */
+
+/**
+ * \brief The PLAN line options shared by DSTRIDE and LSTRIDE, and the LATENCY mode pointer chain.
+ */
+typedef struct {
+    int nstrides;
+    size_t stride[STRIDE_MAX];      /**< Strides in elements (STRIDES=a,b,...).                     */
+    int repeat;                     /**< Passes per stride or laps per footprint (REPEAT=).         */
+    size_t flush;                   /**< Elements in the cache flush buffer, 0 for none (FLUSH=bytes). */
+    int latency;                    /**< Chase pointers instead of striding (LATENCY).              */
+    int nfoot;
+    size_t footprint[STRIDE_MAX];   /**< LATENCY footprints in bytes (FOOTPRINTS=a,b,...).          */
+    uint64_t loads[STRIDE_MAX];     /**< Dependent loads timed per footprint per exec.              */
+    uint64_t *chain;                /**< One random cycle per footprint, in its own word of each line. */
+    uint64_t sink;                  /**< Where each chase ends, so it cannot be optimized away.     */
+} StrideOpts;
+
+extern void StrideOptions(data *m, StrideOpts *o, size_t bytes, size_t elem);
+extern int StrideChainInit(void *plan, StrideOpts *o, size_t bytes);
+extern void StrideLatency(void *plan, StrideOpts *o);
+extern void StrideLatencyPerf(void *plan, StrideOpts *o, char *name);
+
 /* DStride caller data structure */
 /**
  * \brief The data structure for the plan. Holds the input and all used info.
@@ -44,6 +71,7 @@ extern plan_info DSTRIDE_info;
 typedef struct {
     size_t M;
     double *one, *two, *three;    //, *four, *five;
+    StrideOpts o;
 } DStridedata;
 
 /*LStride stuff. */
@@ -54,7 +82,7 @@ extern int execLStridePlan(void *p);              /* run the sleep plan
 extern int perfLStridePlan(void *p);
 extern void *killLStridePlan(void *p);            /* clean up & free plan & vptr */
 extern void LSet(long int *a, long int *b,int m);         /* initialize the arrays       */
-extern void LFill(long int *a);                           /* fill the cache memory       */
+extern void LFill(long int *a, size_t n);                 /* fill the cache memory       */
 extern int parseLStridePlan(char *line, LoadPlan *output);
 extern plan_info LSTRIDE_info;
 
@@ -65,6 +93,7 @@ extern plan_info LSTRIDE_info;
 typedef struct {
     size_t M;
     long int *one, *two, *three;    //, *four, *five;
+    StrideOpts o;
 } LStridedata;
 
 #endif /* __PLAN_STRIDE_H */
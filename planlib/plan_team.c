@@ -0,0 +1,142 @@
+/*
+   This file is part of SystemBurn.
+
+   Copyright (C) 2012, UT-Battelle, LLC.
+
+   This product includes software produced by UT-Battelle, LLC under Contract No.
+   DE-AC05-00OR22725 with the Department of Energy.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the New BSD 3-clause software license (LICENSE).
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   LICENSE for more details.
+
+   For more information please contact the SystemBurn developers at:
+   systemburn-info@googlegroups.com
+
+ */
+#include <systemburn.h>
+#include <planheaders.h>
+
+/*
+ * Plan teams.
+ *
+ * All copies of one PLAN line within one copy of a subload form a team. The
+ * scheduler creates the team and hands a reference to every member plan;
+ * plans that want to cooperate (share a table, split an array, ...) hang their
+ * shared data off the team, everyone else simply ignores it. The team lives
+ * until the last member plan has been killed.
+ *
+ * Members may also synchronize with plan_team_barrier. A worker only looks at
+ * its mailbox between exec calls, so when the scheduler moves on the members
+ * leave one at a time; the first one to be killed breaks the team and every
+ * barrier after that returns at once instead of waiting for it.
+ */
+
+/* spins in a barrier before a waiting member starts yielding its core */
+#define TEAM_SPINS 1000
+
+/**
+ * \brief Creates a team for the given number of member plans.
+ * \param size The number of plans that will hold a reference to the team.
+ * \returns The new team, or NULL if it could not be allocated.
+ */
+PlanTeam *plan_team_new(int size){
+    PlanTeam *team;
+
+    team = (PlanTeam *)malloc(sizeof(PlanTeam));
+    if(team != NULL){
+        team->size = size;
+        team->refs = size;
+        team->shared = NULL;
+        team->release = NULL;
+        team->arrived = 0;
+        team->phase = 0;
+        team->broken = 0;
+        pthread_mutex_init(&(team->lock), NULL);
+    }
+    return team;
+} /* plan_team_new */
+
+/**
+ * \brief Drops one member's reference to a team. The last reference frees the team's shared data and the team.
+ * \param team The team, may be NULL.
+ */
+void plan_team_release(PlanTeam *team){
+    if(team == NULL){
+        return;
+    }
+    /* the team can no longer meet in full, so let anyone waiting in a barrier go */
+    __atomic_store_n(&(team->broken), 1, __ATOMIC_RELEASE);
+    if(__atomic_sub_fetch(&(team->refs), 1, __ATOMIC_ACQ_REL) == 0){
+        if((team->shared != NULL) && (team->release != NULL)){
+            (team->release)(team->shared);
+        }
+        pthread_mutex_destroy(&(team->lock));
+        free(team);
+    }
+} /* plan_team_release */
+
+/**
+ * \brief Waits until every member of the team has reached the barrier.
+ * \param team The team, NULL for a plan scheduled alone (returns at once).
+ * \returns 0 once all members have arrived, -1 if the team was broken and the caller should give up on this pass.
+ */
+int plan_team_barrier(PlanTeam *team){
+    unsigned int phase;
+    int spins = 0;
+
+    if(team == NULL){
+        return 0;
+    }
+    if(__atomic_load_n(&(team->broken), __ATOMIC_ACQUIRE)){
+        return -1;
+    }
+    phase = __atomic_load_n(&(team->phase), __ATOMIC_ACQUIRE);
+    if(__atomic_add_fetch(&(team->arrived), 1, __ATOMIC_ACQ_REL) == team->size){
+        __atomic_store_n(&(team->arrived), 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&(team->phase), phase + 1, __ATOMIC_RELEASE);
+        return 0;
+    }
+    while(__atomic_load_n(&(team->phase), __ATOMIC_ACQUIRE) == phase){
+        if(__atomic_load_n(&(team->broken), __ATOMIC_ACQUIRE)){
+            return -1;
+        }
+        if(++spins >= TEAM_SPINS){
+            sched_yield();
+            spins = 0;
+        }
+    }
+    return 0;
+} /* plan_team_barrier */
+
+/**
+ * \brief Splits n elements statically between the members of a team.
+ * Every member but the last gets the same share, rounded up to a multiple of unit, so that with a page sized unit
+ * each member's part of an array starts on its own page and can be placed on that member's NUMA node.
+ * \param team The team, NULL for a plan scheduled alone (which gets everything).
+ * \param rank The member's rank in the team.
+ * \param n The number of elements to split.
+ * \param unit The granularity of the split, in elements.
+ * \returns The number of elements for this member, possibly 0.
+ */
+size_t plan_team_share(PlanTeam *team, int rank, size_t n, size_t unit){
+    size_t share, start;
+
+    if((team == NULL) || (team->size <= 1)){
+        return n;
+    }
+    if(unit < 1){
+        unit = 1;
+    }
+    share = (n + team->size - 1) / team->size;
+    share = ((share + unit - 1) / unit) * unit;
+    start = share * rank;
+    if(start >= n){
+        return 0;
+    }
+    return (n - start < share) ? (n - start) : share;
+} /* plan_team_share */
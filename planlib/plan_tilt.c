@@ -22,6 +22,9 @@
 #include <systemburn.h>
 #include <planheaders.h>
 #include <inttypes.h>
+#ifdef PLAN_X86_SIMD
+  #include <immintrin.h>
+#endif
 
 #ifdef HAVE_PAPI
   #define NUM_PAPI_EVENTS 1
@@ -46,7 +49,7 @@
  * \param [in] p Array of values to run through Tilt
  */
 void tilt(uint64_t p[]){
-    static uint64_t tmp[64];
+    uint64_t tmp[64];
     uint64_t *q;
 
     for(q = &tmp[0]; q < &tmp[64]; p++, q += 8){
@@ -122,6 +125,161 @@ void tilt(uint64_t p[]){
     }
 } /* tilt */
 
+#ifdef PLAN_X86_SIMD
+/*
+ * The vector kernels run the same two networks as tilt(). In each network
+ * the eight words of one row of 64 bit words are independent, so a row is
+ * one vector and every TILTM step works on all of it with vector shifts and
+ * masks. Between the networks (and after the second) the 8x8 matrix of words
+ * is transposed with shuffles, which is what tilt() does through tmp[].
+ */
+
+/* the 12 TILTM steps of one network on rows a..h, with shifts S0 < S1 < S2 */
+  #define TILT_NET(a, b, c, d, e, f, g, h, S0, K0, S1, K1, S2, K2, STEP)       \
+    STEP(a, b, S0, K0); STEP(c, d, S0, K0); STEP(a, c, S1, K1); STEP(b, d, S1, K1); \
+    STEP(e, f, S0, K0); STEP(g, h, S0, K0); STEP(e, g, S1, K1); STEP(f, h, S1, K1); \
+    STEP(a, e, S2, K2); STEP(b, f, S2, K2); STEP(c, g, S2, K2); STEP(d, h, S2, K2);
+
+  #define TILT_STEP256(A, B, S, K) {                                           \
+        __m256i z = _mm256_and_si256(_mm256_xor_si256((A), _mm256_srli_epi64((B), (S))), (K)); \
+        (A) = _mm256_xor_si256((A), z);                                       \
+        (B) = _mm256_xor_si256((B), _mm256_slli_epi64(z, (S)));               \
+}
+
+  #define TILT_STEP512(A, B, S, K) {                                           \
+        __m512i z = _mm512_and_si512(_mm512_xor_si512((A), _mm512_srli_epi64((B), (S))), (K)); \
+        (A) = _mm512_xor_si512((A), z);                                       \
+        (B) = _mm512_xor_si512((B), _mm512_slli_epi64(z, (S)));               \
+}
+
+/**
+ * \brief Transposes a 4x4 matrix of 64 bit words held in four vectors.
+ */
+__attribute__((target("avx2")))
+static inline void tilt_transpose4(__m256i *a, __m256i *b, __m256i *c, __m256i *d){
+    __m256i t0 = _mm256_unpacklo_epi64(*a, *b);
+    __m256i t1 = _mm256_unpackhi_epi64(*a, *b);
+    __m256i t2 = _mm256_unpacklo_epi64(*c, *d);
+    __m256i t3 = _mm256_unpackhi_epi64(*c, *d);
+    *a = _mm256_permute2x128_si256(t0, t2, 0x20);
+    *b = _mm256_permute2x128_si256(t1, t3, 0x20);
+    *c = _mm256_permute2x128_si256(t0, t2, 0x31);
+    *d = _mm256_permute2x128_si256(t1, t3, 0x31);
+} /* tilt_transpose4 */
+
+/**
+ * \brief Transposes an 8x8 matrix of 64 bit words, row i held as lo[i] (words 0-3) and hi[i] (words 4-7).
+ */
+__attribute__((target("avx2")))
+static inline void tilt_transpose8_avx2(__m256i lo[8], __m256i hi[8]){
+    __m256i t;
+    int i;
+
+    tilt_transpose4(&lo[0], &lo[1], &lo[2], &lo[3]);
+    tilt_transpose4(&lo[4], &lo[5], &lo[6], &lo[7]);
+    tilt_transpose4(&hi[0], &hi[1], &hi[2], &hi[3]);
+    tilt_transpose4(&hi[4], &hi[5], &hi[6], &hi[7]);
+    /* the off-diagonal 4x4 blocks trade places */
+    for(i = 0; i < 4; i++){
+        t = hi[i];
+        hi[i] = lo[i + 4];
+        lo[i + 4] = t;
+    }
+} /* tilt_transpose8_avx2 */
+
+/**
+ * \brief tilt() for AVX2, each row of eight words in two 256 bit vectors.
+ * \param [in] p The 64 words of the matrix, transposed in place.
+ */
+__attribute__((target("avx2")))
+static void tilt_avx2(uint64_t p[]){
+    const __m256i k0 = _mm256_set1_epi64x(M0), k1 = _mm256_set1_epi64x(M1), k2 = _mm256_set1_epi64x(M2);
+    const __m256i k3 = _mm256_set1_epi64x(M3), k4 = _mm256_set1_epi64x(M4), k5 = _mm256_set1_epi64x(M5);
+    __m256i lo[8], hi[8];
+    int i;
+
+    for(i = 0; i < 8; i++){
+        lo[i] = _mm256_loadu_si256((__m256i *)&p[8 * i]);
+        hi[i] = _mm256_loadu_si256((__m256i *)&p[8 * i + 4]);
+    }
+    TILT_NET(lo[0], lo[1], lo[2], lo[3], lo[4], lo[5], lo[6], lo[7], 8, k3, 16, k4, 32, k5, TILT_STEP256);
+    TILT_NET(hi[0], hi[1], hi[2], hi[3], hi[4], hi[5], hi[6], hi[7], 8, k3, 16, k4, 32, k5, TILT_STEP256);
+    tilt_transpose8_avx2(lo, hi);
+    TILT_NET(lo[0], lo[1], lo[2], lo[3], lo[4], lo[5], lo[6], lo[7], 1, k0, 2, k1, 4, k2, TILT_STEP256);
+    TILT_NET(hi[0], hi[1], hi[2], hi[3], hi[4], hi[5], hi[6], hi[7], 1, k0, 2, k1, 4, k2, TILT_STEP256);
+    tilt_transpose8_avx2(lo, hi);
+    for(i = 0; i < 8; i++){
+        _mm256_storeu_si256((__m256i *)&p[8 * i], lo[i]);
+        _mm256_storeu_si256((__m256i *)&p[8 * i + 4], hi[i]);
+    }
+} /* tilt_avx2 */
+
+/**
+ * \brief Transposes an 8x8 matrix of 64 bit words, one row per vector.
+ */
+__attribute__((target("avx512f")))
+static inline void tilt_transpose8_avx512(__m512i r[8]){
+    const __m512i pair_lo = _mm512_setr_epi64(0, 1, 8, 9, 4, 5, 12, 13);
+    const __m512i pair_hi = _mm512_setr_epi64(2, 3, 10, 11, 6, 7, 14, 15);
+    const __m512i half_lo = _mm512_setr_epi64(0, 1, 2, 3, 8, 9, 10, 11);
+    const __m512i half_hi = _mm512_setr_epi64(4, 5, 6, 7, 12, 13, 14, 15);
+    __m512i t[8], u[8];
+    int i;
+
+    /* pairs of rows: t[2i] holds the even words of rows 2i and 2i+1 interleaved, t[2i+1] the odd ones */
+    for(i = 0; i < 4; i++){
+        t[2 * i] = _mm512_unpacklo_epi64(r[2 * i], r[2 * i + 1]);
+        t[2 * i + 1] = _mm512_unpackhi_epi64(r[2 * i], r[2 * i + 1]);
+    }
+    /* quads of rows: words j and j+4 of rows 0-3 (u[0..3]) and of rows 4-7 (u[4..7]) */
+    for(i = 0; i < 2; i++){
+        u[4 * i + 0] = _mm512_permutex2var_epi64(t[4 * i + 0], pair_lo, t[4 * i + 2]);       // words 0, 4
+        u[4 * i + 1] = _mm512_permutex2var_epi64(t[4 * i + 1], pair_lo, t[4 * i + 3]);       // words 1, 5
+        u[4 * i + 2] = _mm512_permutex2var_epi64(t[4 * i + 0], pair_hi, t[4 * i + 2]);       // words 2, 6
+        u[4 * i + 3] = _mm512_permutex2var_epi64(t[4 * i + 1], pair_hi, t[4 * i + 3]);       // words 3, 7
+    }
+    for(i = 0; i < 4; i++){
+        r[i] = _mm512_permutex2var_epi64(u[i], half_lo, u[i + 4]);
+        r[i + 4] = _mm512_permutex2var_epi64(u[i], half_hi, u[i + 4]);
+    }
+} /* tilt_transpose8_avx512 */
+
+/**
+ * \brief tilt() for AVX-512, each row of eight words in one 512 bit vector.
+ * \param [in] p The 64 words of the matrix, transposed in place.
+ */
+__attribute__((target("avx512f")))
+static void tilt_avx512(uint64_t p[]){
+    const __m512i k0 = _mm512_set1_epi64(M0), k1 = _mm512_set1_epi64(M1), k2 = _mm512_set1_epi64(M2);
+    const __m512i k3 = _mm512_set1_epi64(M3), k4 = _mm512_set1_epi64(M4), k5 = _mm512_set1_epi64(M5);
+    __m512i r[8];
+    int i;
+
+    for(i = 0; i < 8; i++){
+        r[i] = _mm512_loadu_si512((void *)&p[8 * i]);
+    }
+    TILT_NET(r[0], r[1], r[2], r[3], r[4], r[5], r[6], r[7], 8, k3, 16, k4, 32, k5, TILT_STEP512);
+    tilt_transpose8_avx512(r);
+    TILT_NET(r[0], r[1], r[2], r[3], r[4], r[5], r[6], r[7], 1, k0, 2, k1, 4, k2, TILT_STEP512);
+    tilt_transpose8_avx512(r);
+    for(i = 0; i < 8; i++){
+        _mm512_storeu_si512((void *)&p[8 * i], r[i]);
+    }
+} /* tilt_avx512 */
+#endif /* PLAN_X86_SIMD */
+
+/**
+ * \brief Gives the timer (and kernel name) of a plan's instruction set level.
+ * \param [in] simd The level the plan runs at.
+ * \returns TIMER0 for the scalar kernel, TIMER1 for AVX2, TIMER2 for AVX-512.
+ */
+static int tilt_timer(int simd){
+    if(simd >= SIMD_AVX512){
+        return TIMER2;
+    }
+    return (simd >= SIMD_AVX2) ? TIMER1 : TIMER0;
+} /* tilt_timer */
+
 /**
  * \brief Allocates and returns the data struct for the plan
  * \param [in] i Holds the input data for the plan.
@@ -148,6 +306,23 @@ void *makeTiltPlan(data *i){
         if(ip){
             ip->niter = i->i[0];
             ip->seed = i->i[1];
+            /* there is no SSE2 kernel, SSE2 runs the scalar one */
+            ip->simd = plan_simd_select(i);
+            if(ip->simd == SIMD_SSE2){
+                ip->simd = SIMD_SCALAR;
+            }
+            /* an optional buffer size makes each exec transpose a stream of matrices from it */
+            if(i->dsize >= 1){
+                ip->nmat = (uint64_t)i->d[0] / (TILT_WORDS * sizeof(uint64_t));
+            } else if(i->isize >= 3){
+                ip->nmat = (uint64_t)i->i[2] / (TILT_WORDS * sizeof(uint64_t));
+            } else {
+                ip->nmat = 1;
+            }
+            if(ip->nmat < 1){
+                ip->nmat = 1;
+            }
+            ip->next = 0;
         }
         (p->vptr) = (void *)ip;
     }
@@ -169,7 +344,7 @@ void *makeTiltPlan(data *i){
  */
 int initTiltPlan(void *plan){
     int ret = make_error(ALLOC,generic_err);
-    int i;
+    uint64_t i;
     brand_t br;
     Plan *p;
     TILT_data *ti = NULL;
@@ -212,13 +387,14 @@ int initTiltPlan(void *plan){
         }         //DO_PERF
     }
     if(ti){
-        ti->arr = (uint64_t *)malloc(64 * sizeof(uint64_t));
-        assert(ti->arr);
-        brand_init(&br, ti->seed);
-        for(i = 0; i < 64; i++){
-            ti->arr[i] = brand(&br);
+        ti->arr = (uint64_t *)plan_alloc(p, ti->nmat * TILT_WORDS * sizeof(uint64_t));
+        if(ti->arr){
+            brand_init(&br, ti->seed);
+            for(i = 0; i < ti->nmat * TILT_WORDS; i++){
+                ti->arr[i] = brand(&br);
+            }
+            ret = ERR_CLEAN;
         }
-        ret = ERR_CLEAN;
     }
     return ret;
 } /* initTiltPlan */
@@ -228,6 +404,7 @@ int initTiltPlan(void *plan){
  ***********************/
 /**
  * \brief A bit-twiddling load with a small memory footprint, "niter" iterations at a time.
+ * With a buffer of several matrices, successive iterations walk through the buffer, wrapping around at its end.
  * \param [in] plan Holds the data for the plan.
  * \return int Error flag value
  * \sa parseTiltPlan
@@ -246,11 +423,20 @@ int execTiltPlan(void *plan){
     ORB_t t1, t2;
     Plan *p;
     TILT_data *ti;
+    void (*kernel)(uint64_t *) = tilt;
     p = (Plan *)plan;
     ti = (TILT_data *)p->vptr;
     /* update execution count */
     p->exec_count++;
 
+    #ifdef PLAN_X86_SIMD
+    if(ti->simd == SIMD_AVX512){
+        kernel = tilt_avx512;
+    } else if(ti->simd == SIMD_AVX2){
+        kernel = tilt_avx2;
+    }
+    #endif
+
     if(DO_PERF){
         #ifdef HAVE_PAPI
         /* Start PAPI counters and time */
@@ -261,7 +447,10 @@ int execTiltPlan(void *plan){
     }     //DO_PERF
 
     for(i = 0; i < ti->niter; i++){
-        tilt(ti->arr);
+        kernel(&(ti->arr[ti->next * TILT_WORDS]));
+        if(++(ti->next) == ti->nmat){
+            ti->next = 0;
+        }
     }
 
     if(DO_PERF){
@@ -276,7 +465,7 @@ int execTiltPlan(void *plan){
             p->PAPI_Times[k] += (end - start);
         }
         #endif //HAVE_PAPI
-        perftimer_accumulate(&p->timers, TIMER0, ORB_cycles_a(t2, t1));
+        perftimer_accumulate(&p->timers, tilt_timer(ti->simd), ORB_cycles_a(t2, t1));
     }     //DO_PERF
 
     return ERR_CLEAN;
@@ -295,21 +484,31 @@ int execTiltPlan(void *plan){
 int perfTiltPlan(void *plan){
     int ret = ~ERR_CLEAN;
     uint64_t opcounts[NUM_TIMERS];
+    char buffer[MSG_SIZE];
+    int t, timer;
     Plan *p;
     TILT_data *d;
     p = (Plan *)plan;
     d = (TILT_data *)p->vptr;
     if(p->exec_count > 0){
-        opcounts[TIMER0] = (uint64_t)d->niter * p->exec_count;         // Count # of calls to tilt()
-        opcounts[TIMER1] = 0;
-        opcounts[TIMER2] = 0;
+        /* each kernel has its own timer, so the table keeps the variants apart */
+        timer = tilt_timer(d->simd);
+        for(t = 0; t < NUM_TIMERS; t++){
+            opcounts[t] = 0;
+        }
+        opcounts[timer] = (uint64_t)d->niter * p->exec_count;         // Count # of calls to tilt()
 
         perf_table_update(&p->timers, opcounts, p->name);
         #ifdef HAVE_PAPI
         PAPI_table_update(p->name, p->PAPI_Results, p->PAPI_Times, p->PAPI_Num_Events);
         #endif     //HAVE_PAPI
 
-        double ips = ((double)opcounts[TIMER0] / perftimer_gettime(&p->timers, TIMER0)) / 1e6;
+        snprintf(buffer, MSG_SIZE, "TILT kernel          : %s", plan_simd_name(d->simd));
+        EmitLog  (MyRank, 9999, buffer, -1, PRINT_SOME);
+        if(d->nmat > 1){
+            EmitLog(MyRank, 9999, "TILT matrices in buffer:", d->nmat, PRINT_SOME);
+        }
+        double ips = ((double)opcounts[timer] / perftimer_gettime(&p->timers, timer)) / 1e6;
         EmitLogfs(MyRank, 9999, "TILT plan performance:", ips, "Million Trips/s", PRINT_SOME);
         EmitLog  (MyRank, 9999, "TILT execution count :", p->exec_count, PRINT_SOME);
         ret = ERR_CLEAN;
@@ -341,7 +540,7 @@ void *killTiltPlan(void *plan){
     }     //DO_PERF
 
     ti = (TILT_data *)p->vptr;
-    free((void *)(ti->arr));
+    plan_free((void *)(ti->arr));
     free((void *)(p->vptr));
     free((void *)(plan));
     return (void *)NULL;
@@ -380,5 +579,5 @@ plan_info TILT_info = {
     initTiltPlan,
     killTiltPlan,
     perfTiltPlan,
-    { "Trips/s", NULL, NULL }
+    { "Trips/s", "Trips AVX2", "Trips AVX512", NULL, NULL, NULL }
 };
@@ -37,7 +37,13 @@ extern plan_info TILT_info;
 typedef struct {
     int niter;
     int seed;
+    int simd;                   /**< SIMD_SCALAR, SIMD_AVX2 or SIMD_AVX512 (SSE2 runs the scalar kernel).   */
+    uint64_t nmat;              /**< 64x64 bit matrices in arr, 1 unless a buffer size was given.           */
+    uint64_t next;              /**< The matrix the next transpose works on.                                */
     uint64_t *arr;
 } TILT_data;
 
+/* words in one 64x64 bit matrix */
+#define TILT_WORDS 64
+
 #endif /* __PLAN_TILT_H */
@@ -31,10 +31,12 @@
 #include <plan_stream.h>
 #include <plan_stride.h>
 #include <plan_gups.h>
+#include <plan_pvfma.h>
 #include <plan_pv1.h>
 #include <plan_pv2.h>
 #include <plan_pv3.h>
 #include <plan_pv4.h>
+#include <plan_pvtune.h>
 #include <plan_comm.h>
 #include <plan_write.h>
 #include <plan_cba.h>
@@ -71,6 +73,21 @@
 #define CHECK_CALC (plancheck_flag == 1)
 #define DO_PERF (planperf_flag == 1)
 
+/**
+ * \brief A group of plans (the copies of one PLAN line in one subload) that may cooperate through shared data.
+ * \sa plan_team_new
+ */
+typedef struct {
+    int   size;                          /**< Number of member plans the scheduler created.            */
+    int   refs;                          /**< Member plans that have not been killed yet.              */
+    pthread_mutex_t lock;                /**< Guards creation of the shared data.                      */
+    void *shared;                        /**< Plan specific data shared by the members.                */
+    void  (*release)(void *shared);      /**< Frees the shared data once the last member is killed.    */
+    int   arrived;                       /**< Members waiting in the current barrier.                  */
+    unsigned int phase;                  /**< Number of barriers completed.                            */
+    int   broken;                        /**< Set once any member has been killed.                     */
+} PlanTeam;
+
 /**
  * \brief This structure contains the "plan" information for a thread.
  * Specifically, the plan contains pointers to the interface functions
@@ -86,6 +103,14 @@ typedef struct {                         /* Plan struct allocated/initialized by
     int   name;                          /**< Stores the plan ID number for reference.                 */
     PerfTimers timers;                   /**< Contains pairs of time stamps for measuring performance. */
     uint64_t exec_count;                 /**< Stores the number of times the exec function is called.  */
+    int   mem_node;                      /**< NUMA node of the buffers from plan_alloc, or PLAN_NODE_*. */
+    int   page_req;                      /**< Page size requested for plan_alloc buffers (PAGES_*).    */
+    size_t page_size;                    /**< Smallest page size plan_alloc actually got, 0 if none.   */
+    PlanTeam *team;                      /**< The plan's team, NULL if it was scheduled alone.         */
+    int   team_rank;                     /**< This plan's position within its team.                    */
+    int   worker;                        /**< Worker running the plan (the same on every rank), or SCHEDULER_THREAD. */
+    double energy_start;                 /**< When the worker started the plan (seconds), 0 if not busy. */
+    double energy_share;                 /**< PowerShare() when the worker started the plan.           */
 
     #ifdef HAVE_PAPI
     int PAPI_EventSet;                              /* Holds the PAPI event set for this plan            */
@@ -136,10 +161,12 @@ typedef enum {
     LSTREAM,
     LSTRIDE,
     GUPS,
+    SGUPS,
     PV1,
     PV2,
     PV3,
     PV4,
+    PVTUNE,
     SBCOMM,
     WRITE,
     CBA,
@@ -188,10 +215,12 @@ plan_info *plan_list[] = {
     &(LSTREAM_info),
     &(LSTRIDE_info),
     &(GUPS_info),
+    &(SGUPS_info),
     &(PV1_info),
     &(PV2_info),
     &(PV3_info),
     &(PV4_info),
+    &(PVTUNE_info),
     &(COMM_info),
     &(WRITE_info),
     &(CBA_info),
@@ -217,6 +246,7 @@ extern char *generic_errors[]; // Initialized in planlib/plan_misc.c
 extern char *system_error[];
 #define SYS_ERR_SIZE 3
 extern void add_error(void *m, int name, int error);
+extern Plan *plan_make(int name, data *input);
 extern int make_error(int i, int j);
 
 #define MAX_GEN_VAL ((1 << WIDTH) - GEN_SIZE)
@@ -265,5 +295,55 @@ extern data *get_sizes(char *line);
 extern int key_gen(int a, int b);
 extern int *key_conv(int a);
 extern void tokenize_line(char *line, char ***tokens, int *count);
+extern uint64_t plan_parse_size(char *text, char **end);
+extern char *plan_size_text(uint64_t size, char *buffer, size_t len);
+extern int plan_has_token(data *m, char *token);
+extern char *plan_token_value(data *m, char *key);
+
+/*
+ * NUMA-local buffer allocation for plans. In planlib/plan_memory.c
+ */
+#define PLAN_NODE_UNKNOWN -1            // No plan_alloc buffers yet, or placement not known.
+#define PLAN_NODE_MIXED   -2            // The plan's buffers ended up on more than one node.
+/**
+ * \brief Page sizes a PLAN line can ask for with its HUGEPAGES modifier.
+ */
+enum {
+    PAGES_DEFAULT,                      // ordinary pages
+    PAGES_THP,                          // HUGEPAGES=THP : transparent huge pages only
+    PAGES_2M,                           // HUGEPAGES or HUGEPAGES=2M : explicit 2MB pages, falling back to THP
+    PAGES_1G                            // HUGEPAGES=1G : explicit 1GB pages, falling back to 2MB and THP
+};
+extern void *plan_alloc(Plan *p, size_t size);
+extern void plan_free(void *ptr);
+extern int plan_current_node();
+extern int plan_mem_node(void *addr);
+
+/*
+ * Plan teams. In planlib/plan_team.c
+ */
+extern PlanTeam *plan_team_new(int size);
+extern void plan_team_release(PlanTeam *team);
+extern int plan_team_barrier(PlanTeam *team);
+extern size_t plan_team_share(PlanTeam *team, int rank, size_t n, size_t unit);
+
+/*
+ * Run time selection of SIMD kernels. In planlib/plan_simd.c
+ */
+#if defined(__GNUC__) && defined(__x86_64__)
+  #define PLAN_X86_SIMD                 // x86-64 kernels can be built with target attributes.
+#endif
+/**
+ * \brief Instruction set levels a plan may choose its kernels from, in increasing order.
+ */
+enum {
+    SIMD_SCALAR,                        // plain C
+    SIMD_SSE2,                          // 128 bit
+    SIMD_AVX2,                          // 256 bit, with FMA
+    SIMD_AVX512                         // 512 bit (AVX-512F)
+};
+extern int plan_simd_level();
+extern int plan_simd_select(data *m);
+extern char *plan_simd_name(int level);
 
 #endif /* __PLANHEADERS_H */
@@ -33,6 +33,8 @@ CPU_LOADS = ["PV1", "PV2", "PV3", "PV4", "FFT1D", "FFT2D", "RDGEMM", "DSTREAM",
 OTHER_LOADS = ["GUPS"]
 EXTRA_SLOTS = 4
 test_runtime = 300
+# systemburn logs the package power summed over its nodes every MONITOR_OUT seconds
+POWER_LINE = re.compile(r"package/core/DRAM power summed over all nodes \(W\)\s+([0-9.]+)")
 
 class SBload:
     def __init__(self):
@@ -90,7 +92,7 @@ def main():
     parser = OptionParser()
     parser.add_option("-c", "--check-command",
                       dest="cmnd", 
-                      help="command to check power/temp usage")
+                      help="command to check power/temp usage, instead of the package power systemburn logs")
     parser.add_option("-l", "--l2-cachesize",
                       dest="l2_cachesize",
                       help="L2 cache size")
@@ -105,15 +107,9 @@ def main():
 
 #    print args 
 
-    if not options.cmnd:
-        print "Error: -c flag must be specified"
-        parser.print_help()
-        sys.exit(1)
-
     cmnd = options.cmnd
     l2_cachesize = options.l2_cachesize
 
-    cmnd_args = shlex.split(cmnd)
     averages = {}
     maximums = {}
 
@@ -132,10 +128,23 @@ def main():
         f = load.filename
         readings = []
         print "Running on load: "+f
-        burn = subprocess.Popen(["./systemburn.wrapper", f])
-        while burn.poll() != 0:
-            readings.append(float(check_output(cmnd)))
-            sleep(MON_FREQ)
+        if cmnd:
+            burn = subprocess.Popen(["./systemburn.wrapper", f])
+            while burn.poll() is None:
+                readings.append(float(check_output(shlex.split(cmnd))))
+                sleep(MON_FREQ)
+        else:
+            burn = subprocess.Popen(["./systemburn.wrapper", f], stdout=subprocess.PIPE)
+            for line in iter(burn.stdout.readline, ""):
+                sys.stdout.write(line)
+                m = POWER_LINE.search(line)
+                if m and float(m.group(1)) > 0.0:
+                    readings.append(float(m.group(1)))
+            burn.wait()
+
+        if not readings:
+            print "Error: no power readings for load "+str(f)+", use -c where RAPL cannot be read"
+            sys.exit(1)
 
         print "Done running load: "+str(f)
 
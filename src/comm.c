@@ -21,7 +21,6 @@
 #include <systemburn.h>
 #include <initialization.h>
 #include <planheaders.h>
-#include <comm.h>
 
 #ifdef HAVE_SHMEM
   #include <mpp/shmem.h>
@@ -29,6 +28,8 @@
   #include <mpi.h>
 #endif
 
+#include <comm.h>
+
 #ifdef HAVE_SHMEM
   #ifdef SLU       /* Cray-like implementation */
     #  define   SHMEM_NUM_PES  num_pes()
@@ -43,6 +44,12 @@
   #define MAX(A,B) ( ((A) > (B)) ? (A) : (B) )
 #endif
 
+#if !defined(HAVE_SHMEM) && (MPI_VERSION < 3)
+  /* no nonblocking collectives before MPI-3: reduce at once, the request is then already complete */
+  #define MPI_Ireduce(S, R, N, T, O, ROOTRANK, C, REQ) ( *(REQ) = MPI_REQUEST_NULL, MPI_Reduce(S, R, N, T, O, ROOTRANK, C) )
+  #define MPI_Iallreduce(S, R, N, T, O, C, REQ) ( *(REQ) = MPI_REQUEST_NULL, MPI_Allreduce(S, R, N, T, O, C) )
+#endif
+
 /*
  * Abstractions of SPMD network communication functions to
  * facilitate the inclusion of multiple libraries.
@@ -59,8 +66,7 @@
  *  - main
  *  - bcastConfig (in initialization.c)
  *  - bcastLoad (in load.c)
- *  - reduceTemps (in monitor.c)
- *  - reduceFlags (in worker.c)
+ *  - reduceTemps and reduceStatus (in monitor.c)
  *	- perf_reduce (in performance.c)
  *  - comm test plan
  */
@@ -72,10 +78,123 @@ static long   qSync[SHMEM_REDUCE_SYNC_SIZE];
 static long   rSync[SHMEM_REDUCE_SYNC_SIZE];
 static float  pWrkFloat[SHMEM_REDUCE_MIN_WRKDATA_SIZE];
 static int    bint1, bint2;
-static float  tmin, tavg, tmax;
-static float  lmin, lavg, lmax;
 #endif
 
+#ifndef HAVE_SHMEM
+/*
+ * The scheduler's own traffic (broadcasts of the configuration and loads, the
+ * pflag, and the reductions) goes over sched_comm, a duplicate of
+ * MPI_COMM_WORLD, so it never matches messages of COMM plans. Each COMM plan
+ * gets a communicator of its own: every worker has a lane, and so does the
+ * scheduler's -c plan. The scheduler creates a lane the first time a COMM plan
+ * is scheduled on it (comm_lane_setup), which it does in the same order on
+ * every rank, and the plan picks it up with comm_lane_open.
+ *
+ * MPI is asked for MPI_THREAD_MULTIPLE. When it is granted, COMM plans on
+ * workers call MPI from their own threads, and the monitor thread runs the
+ * status reductions (comm_status_serve). Otherwise only the scheduler thread
+ * calls MPI: the status is reduced by the scheduler, and COMM plans on workers
+ * are "funnelled" - they queue their operations with comm_funnel_post, the
+ * scheduler starts and tests them whenever it waits (comm_sleep), and the plans
+ * pick up the completions with comm_funnel_waitsome.
+ */
+static MPI_Comm  sched_comm = MPI_COMM_NULL;
+static CommLane *lanes      = NULL;             /* num_workers + 1 lanes, the last one the scheduler's */
+static int       comm_thread_level = MPI_THREAD_SINGLE;
+
+#define COMM_FUNNEL_POLL 50                     /* microseconds between tests of funnelled operations */
+enum {
+    COMM_OP_IDLE,
+    COMM_OP_QUEUED,                             /* waiting for the scheduler to start it           */
+    COMM_OP_POSTED,                             /* started, on funnel_posted                       */
+    COMM_OP_DONE                                /* complete, to be reported to the plan            */
+};
+static pthread_mutex_t funnel_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  funnel_wake = PTHREAD_COND_INITIALIZER;  /* an operation was queued         */
+static pthread_cond_t  funnel_done = PTHREAD_COND_INITIALIZER;  /* some operations completed       */
+static CommOp *funnel_queue = NULL, *funnel_tail = NULL;
+static CommOp *funnel_posted = NULL;
+static int     funnel_lanes = 0;                /* funnelled lanes set up, read by the scheduler only  */
+static int     funnel_users = 0;                /* funnelled plans between open and close          */
+
+/*
+ * Reductions to ROOT run up a two level tree, so that ROOT does not combine the
+ * contributions of every rank itself on large runs: the ranks of a node (from
+ * MPI_Comm_split_type) first reduce to the node's first rank, and those group
+ * leaders then reduce to ROOT. When every node holds a single rank, as the
+ * documentation recommends, groups of COMM_GROUP_RANKS consecutive ranks are
+ * used instead, which usually sit on the same switch.
+ */
+#define COMM_GROUP_RANKS 32
+static MPI_Comm group_comm  = MPI_COMM_NULL;    /* the ranks of this node or group                  */
+static MPI_Comm leader_comm = MPI_COMM_NULL;    /* the group leaders, MPI_COMM_NULL on other ranks  */
+static int      group_rank  = 0;                /* rank in group_comm, 0 on a leader                */
+static int      group_leaders = 1;              /* size of leader_comm, known on ROOT               */
+
+/**
+ * \brief Builds the communicators of the reduction tree. ROOT leads its group and is rank 0 of both communicators.
+ */
+static void setupGroups(){
+    int rank, key, size = 0;
+
+    MPI_Comm_rank(sched_comm, &rank);
+    key = (rank == ROOT) ? -1 : rank;
+    #if MPI_VERSION >= 3
+    MPI_Comm_split_type(sched_comm, MPI_COMM_TYPE_SHARED, key, MPI_INFO_NULL, &group_comm);
+    MPI_Comm_size(group_comm, &size);
+    MPI_Allreduce(MPI_IN_PLACE, &size, SINGLE, MPI_INT, MPI_MAX, sched_comm);
+    if(size < 2){
+        MPI_Comm_free(&group_comm);
+    }
+    #endif
+    if(group_comm == MPI_COMM_NULL){
+        MPI_Comm_split(sched_comm, rank / COMM_GROUP_RANKS, key, &group_comm);
+    }
+    MPI_Comm_rank(group_comm, &group_rank);
+    MPI_Comm_split(sched_comm, (group_rank == 0) ? 0 : MPI_UNDEFINED, key, &leader_comm);
+    if(leader_comm != MPI_COMM_NULL){
+        MPI_Comm_size(leader_comm, &group_leaders);
+    }
+} /* setupGroups */
+#endif /* ifndef HAVE_SHMEM */
+
+/**
+ * \brief Logs the node and total power after reduceStatus_MPI or reduceStatus_SHMEM have reduced it.
+ * \param total Power of each domain summed over all nodes, followed by the number of nodes with package counters.
+ * \param pmin Lowest node package power.
+ * \param pmax Highest node package power.
+ */
+static void reportPower(float *total, float pmin, float pmax){
+    if(total[POWER_DOMAINS] > 0.0){
+        EmitLog3f(MyRank, SCHEDULER_THREAD, "The minimum/average/maximum package power of the nodes (W) ", pmin, total[POWER_PACKAGE] / total[POWER_DOMAINS], pmax, PRINT_ALWAYS);
+        EmitLog3f(MyRank, SCHEDULER_THREAD, "The package/core/DRAM power summed over all nodes (W) ", total[POWER_PACKAGE], total[POWER_CORE], total[POWER_DRAM], PRINT_ALWAYS);
+    } else {
+        EmitLog(MyRank, SCHEDULER_THREAD, "No readable RAPL energy counters on this platform.", -1, PRINT_SOME);
+    }
+} /* reportPower */
+
+/**
+ * \brief Fills the send buffers of the power reductions from local_power.
+ * \param watts Set to the power of each domain, followed by 1 if the node has package counters.
+ * \param pmin Set to the package power, or a large value if there are no counters.
+ * \param pmax Set to the package power, or -1 if there are no counters.
+ */
+static void localPower(float *watts, float *pmin, float *pmax){
+    int i;
+    for(i = 0; i < POWER_DOMAINS; i++){
+        watts[i] = local_power.found[i] ? local_power.watts[i] : 0.0;
+    }
+    if(local_power.found[POWER_PACKAGE]){
+        watts[POWER_DOMAINS] = 1.0;
+        *pmin = local_power.watts[POWER_PACKAGE];
+        *pmax = local_power.watts[POWER_PACKAGE];
+    } else {
+        watts[POWER_DOMAINS] = 0.0;
+        *pmin = 1.0e30;
+        *pmax = -1.0;
+    }
+} /* localPower */
+
 /**
  * \brief Sets up the communication systems for SystemBurn
  * \param argc Typical C variable: number of arguments in the command line
@@ -93,10 +212,265 @@ void comm_setup(int *argc, char ***argv){
         qSync[i] = SHMEM_SYNC_VALUE;
     }
     #else
-    MPI_Init(argc, argv);
+    int rank;
+    MPI_Init_thread(argc, argv, MPI_THREAD_MULTIPLE, &comm_thread_level);
+    MPI_Comm_dup(MPI_COMM_WORLD, &sched_comm);
+    MPI_Comm_rank(sched_comm, &rank);
+    if((rank == ROOT) && (comm_thread_level < MPI_THREAD_FUNNELED)){
+        EmitLog(rank, SCHEDULER_THREAD, "Warning: MPI does not support threads, it provides thread level", comm_thread_level, PRINT_ALWAYS);
+    }
+    setupGroups();
+    #endif
+}
+
+/**
+ * \brief Tells whether every thread may call MPI, which decides how the status is reduced and how COMM plans on workers
+ * communicate (see comm_lane_setup).
+ * \returns Nonzero if MPI granted MPI_THREAD_MULTIPLE, always 0 with SHMEM.
+ */
+int comm_thread_multiple(){
+    #ifndef HAVE_SHMEM
+    return comm_thread_level == MPI_THREAD_MULTIPLE;
+    #else
+    return 0;
     #endif
 }
 
+/**
+ * \brief Creates the communicator of a COMM plan's lane, if it does not exist yet. Called by the scheduler, in the
+ * same order on every rank, before it hands the plan over. A worker's lane is funnelled through the scheduler unless
+ * MPI granted MPI_THREAD_MULTIPLE.
+ * \param lane The worker the plan is scheduled on, or SCHEDULER_THREAD for the -c plan.
+ */
+void comm_lane_setup(int lane){
+    #ifndef HAVE_SHMEM
+    int i, k = (lane == SCHEDULER_THREAD) ? num_workers : lane;
+    if(lanes == NULL){
+        lanes = (CommLane *)calloc(num_workers + 1, sizeof(CommLane));
+        assert(lanes);
+        for(i = 0; i <= num_workers; i++){
+            lanes[i].comm = MPI_COMM_NULL;
+        }
+    }
+    if((k < 0) || (k > num_workers) || (lanes[k].comm != MPI_COMM_NULL)){
+        return;
+    }
+    if((lane != SCHEDULER_THREAD) && (comm_thread_level < MPI_THREAD_MULTIPLE)){
+        #if MPI_VERSION >= 3
+        lanes[k].funnel = 1;
+        if(funnel_lanes++ == 0){
+            EmitLog(MyRank, SCHEDULER_THREAD, "COMM plans on workers are funnelled through the scheduler, MPI provides thread level", comm_thread_level, PRINT_SOME);
+        }
+        #else
+        EmitLog(MyRank, SCHEDULER_THREAD, "COMM plans can only run on workers with MPI_THREAD_MULTIPLE or MPI-3, MPI provides thread level", comm_thread_level, PRINT_ALWAYS);
+        return;
+        #endif
+    }
+    MPI_Comm_dup(MPI_COMM_WORLD, &(lanes[k].comm));
+    MPI_Comm_size(lanes[k].comm, &(lanes[k].size));
+    MPI_Comm_rank(lanes[k].comm, &(lanes[k].rank));
+    #endif
+} /* comm_lane_setup */
+
+/**
+ * \brief Gives a COMM plan the lane it communicates over. Every successful call must be matched by comm_lane_close,
+ * once the plan has finished communicating.
+ * \param lane The worker running the plan, or SCHEDULER_THREAD for the -c plan.
+ * \returns A pointer to the CommLane, or NULL if the lane has none (always with SHMEM).
+ */
+void *comm_lane_open(int lane){
+    #ifndef HAVE_SHMEM
+    int k = (lane == SCHEDULER_THREAD) ? num_workers : lane;
+    if((lanes != NULL) && (k >= 0) && (k <= num_workers) && (lanes[k].comm != MPI_COMM_NULL)){
+        if(lanes[k].funnel){
+            pthread_mutex_lock(&funnel_lock);
+            funnel_users++;
+            pthread_mutex_unlock(&funnel_lock);
+        }
+        return &(lanes[k]);
+    }
+    #endif
+    return NULL;
+} /* comm_lane_open */
+
+/**
+ * \brief Releases a lane opened by comm_lane_open.
+ * \param lane The CommLane returned by comm_lane_open.
+ */
+void comm_lane_close(void *lane){
+    #ifndef HAVE_SHMEM
+    if(((CommLane *)lane)->funnel){
+        pthread_mutex_lock(&funnel_lock);
+        funnel_users--;
+        pthread_mutex_unlock(&funnel_lock);
+    }
+    #endif
+} /* comm_lane_close */
+
+#ifndef HAVE_SHMEM
+/**
+ * \brief Hands an operation of a funnelled COMM plan to the scheduler, which starts it the next time it waits.
+ * The operation must stay in place until comm_funnel_waitsome reports it.
+ * \param op The operation, with all fields but state, req and next filled in.
+ */
+void comm_funnel_post(CommOp *op){
+    pthread_mutex_lock(&funnel_lock);
+    op->state = COMM_OP_QUEUED;
+    op->next = NULL;
+    if(funnel_tail != NULL){
+        funnel_tail->next = op;
+    } else {
+        funnel_queue = op;
+    }
+    funnel_tail = op;
+    pthread_cond_signal(&funnel_wake);
+    pthread_mutex_unlock(&funnel_lock);
+} /* comm_funnel_post */
+
+/**
+ * \brief Waits until some of a funnelled COMM plan's operations are complete, like MPI_Waitsome.
+ * \param ops The plan's operations; those not posted since they were last reported are ignored.
+ * \param n Number of operations in ops.
+ * \param index Receives the indices of the completed operations.
+ * \returns The number of operations completed, or MPI_UNDEFINED if none of them was pending.
+ */
+int comm_funnel_waitsome(CommOp *ops, int n, int *index){
+    int i, done, pending;
+    pthread_mutex_lock(&funnel_lock);
+    do {
+        done = pending = 0;
+        for(i = 0; i < n; i++){
+            if(ops[i].state == COMM_OP_DONE){
+                ops[i].state = COMM_OP_IDLE;
+                index[done++] = i;
+            } else if(ops[i].state != COMM_OP_IDLE){
+                pending++;
+            }
+        }
+        if((done == 0) && (pending > 0)){
+            pthread_cond_wait(&funnel_done, &funnel_lock);
+        }
+    } while((done == 0) && (pending > 0));
+    pthread_mutex_unlock(&funnel_lock);
+    return (done > 0) ? done : MPI_UNDEFINED;
+} /* comm_funnel_waitsome */
+
+/**
+ * \brief Starts the queued operations of funnelled COMM plans and tests the ones in flight. Scheduler only, with
+ * funnel_lock held.
+ * \returns The number of operations still in flight.
+ */
+static int funnelProgress(){
+    int flag, done = 0, posted = 0;
+    CommOp *op, **prev;
+    while(funnel_queue != NULL){
+        op = funnel_queue;
+        funnel_queue = op->next;
+        switch(op->kind){
+        case COMM_OP_SEND:
+            MPI_Isend(op->buf, op->count, MPI_BYTE, op->peer, op->tag, op->lane->comm, &(op->req));
+            break;
+        case COMM_OP_RECV:
+            MPI_Irecv(op->buf, op->count, MPI_BYTE, op->peer, op->tag, op->lane->comm, &(op->req));
+            break;
+        default:
+            MPI_Iallreduce(op->buf, op->result, op->count, MPI_INT, MPI_SUM, op->lane->comm, &(op->req));
+            break;
+        }
+        op->state = COMM_OP_POSTED;
+        op->next = funnel_posted;
+        funnel_posted = op;
+    }
+    funnel_tail = NULL;
+    prev = &funnel_posted;
+    while(*prev != NULL){
+        op = *prev;
+        MPI_Test(&(op->req), &flag, MPI_STATUS_IGNORE);
+        if(flag){
+            op->state = COMM_OP_DONE;
+            *prev = op->next;
+            done++;
+        } else {
+            prev = &(op->next);
+            posted++;
+        }
+    }
+    if(done > 0){
+        pthread_cond_broadcast(&funnel_done);
+    }
+    return posted;
+} /* funnelProgress */
+#endif /* ifndef HAVE_SHMEM */
+
+/**
+ * \brief Idles the scheduler thread. While funnelled COMM plans may be running, it carries their operations on
+ * instead of sleeping.
+ * \param seconds Time to idle.
+ */
+void comm_sleep(int seconds){
+    #ifndef HAVE_SHMEM
+    struct timespec now, until;
+    if(funnel_lanes > 0){
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += seconds;
+        pthread_mutex_lock(&funnel_lock);
+        for(;; ){
+            if(funnelProgress() > 0){
+                pthread_mutex_unlock(&funnel_lock);
+                usleep(COMM_FUNNEL_POLL);
+                pthread_mutex_lock(&funnel_lock);
+            } else if(pthread_cond_timedwait(&funnel_wake, &funnel_lock, &until) == ETIMEDOUT){
+                break;
+            }
+            clock_gettime(CLOCK_REALTIME, &now);
+            if((now.tv_sec > until.tv_sec) || ((now.tv_sec == until.tv_sec) && (now.tv_nsec >= until.tv_nsec))){
+                break;
+            }
+        }
+        funnelProgress();
+        pthread_mutex_unlock(&funnel_lock);
+        return;
+    }
+    #endif
+    if(seconds > 0){
+        sleep(seconds);
+    }
+} /* comm_sleep */
+
+/**
+ * \brief Carries the operations of funnelled COMM plans one step on without waiting, for a scheduler that is busy
+ * running the -c COMM plan rather than idling in comm_sleep. Scheduler only.
+ * \returns 1 if there are funnelled lanes to carry on, 0 if there is nothing to do.
+ */
+int comm_funnel_poll(){
+    #ifndef HAVE_SHMEM
+    if(funnel_lanes > 0){
+        pthread_mutex_lock(&funnel_lock);
+        funnelProgress();
+        pthread_mutex_unlock(&funnel_lock);
+        return 1;
+    }
+    #endif
+    return 0;
+} /* comm_funnel_poll */
+
+/**
+ * \brief Carries on the operations of funnelled COMM plans until they have all been closed, so that workers being
+ * stopped can finish their plans. Scheduler only.
+ */
+void comm_funnel_drain(){
+    #ifndef HAVE_SHMEM
+    pthread_mutex_lock(&funnel_lock);
+    while(funnel_users > 0){
+        funnelProgress();
+        pthread_mutex_unlock(&funnel_lock);
+        usleep(COMM_FUNNEL_POLL);
+        pthread_mutex_lock(&funnel_lock);
+    }
+    pthread_mutex_unlock(&funnel_lock);
+    #endif
+} /* comm_funnel_drain */
+
 /**
  * \brief Retrieves the rank of the calling process
  * \return rank
@@ -129,7 +503,7 @@ void comm_broadcast_int(int *value){
     *value = bint1;
     debug++;
     #else
-    MPI_Bcast((void *)value, SINGLE, MPI_INT, ROOT, MPI_COMM_WORLD);
+    MPI_Bcast((void *)value, SINGLE, MPI_INT, ROOT, sched_comm);
     #endif
 } /* comm_broadcast_int */
 
@@ -153,190 +527,317 @@ void comm_finalize(){
     shmem_finalize();
     #  endif
     #else
+    int i;
+    if(lanes != NULL){
+        for(i = 0; i <= num_workers; i++){
+            if(lanes[i].comm != MPI_COMM_NULL){
+                MPI_Comm_free(&(lanes[i].comm));
+            }
+        }
+        free(lanes);
+    }
+    if(leader_comm != MPI_COMM_NULL){
+        MPI_Comm_free(&leader_comm);
+    }
+    MPI_Comm_free(&group_comm);
+    MPI_Comm_free(&sched_comm);
     MPI_Finalize();
     #endif
 }
 
+/*
+ * The periodic status of the run (temperature map, power, progress and error counters) is packed into one
+ * StatusRecord per rank and combined in a single reduction. The record has a fixed size for the run, so its
+ * buffers (and, with MPI, its datatype and operation) are created by the first reduction and kept.
+ * With MPI the reduction is nonblocking: reduceStatus_MPI starts it up the group tree and the scheduler
+ * carries it on with comm_status_progress between iterations of the COMM plan. When MPI grants
+ * MPI_THREAD_MULTIPLE, the scheduler only fills the record and queues it, and the monitor thread reduces and
+ * prints it in comm_status_serve; the scheduler then waits for it before it reuses the record or group_comm.
+ */
+static int    status_nflags = 0;        /* error counters in a record                      */
+static size_t status_bytes = 0;         /* size of a record                                */
+static StatusRecord *status_local;      /* this rank's record (symmetric with SHMEM)       */
+static StatusRecord *status_total;      /* the reduced record, on ROOT                     */
+static int  **status_rows;              /* rows of status_total->flags, for printFlags     */
+static uint64_t status_last_runs;       /* runs at the last report, on ROOT                */
+
+#ifndef HAVE_SHMEM
+enum {
+    STATUS_IDLE,                        /* no reduction in flight                          */
+    STATUS_QUEUED,                      /* waiting for the monitor thread                  */
+    STATUS_GROUP,                       /* reducing to the group leaders                   */
+    STATUS_LEADERS                      /* reducing from the group leaders to ROOT         */
+};
+static int  status_stage = STATUS_IDLE;
+static int  status_direct = 0;          /* whether the monitor thread does the reductions  */
+static pthread_mutex_t status_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  status_cond = PTHREAD_COND_INITIALIZER;  /* status_stage changed (direct only) */
+static int  status_flags;               /* whether the record in flight has error counters */
+static StatusRecord *status_group;      /* the group's record, on its leader               */
+static MPI_Request  status_request;
+static MPI_Datatype status_type = MPI_DATATYPE_NULL;
+static MPI_Op       status_op;
+#endif
+
 /**
- * \brief Gather the values of the temperatures from the various nodes to check if any are overheating - MPI
+ * \brief Combines two status records, as the reduction operation of reduceStatus.
+ * \param in The record of some ranks.
+ * \param inout The record of other ranks, which receives the record of both.
  */
-void reduceTemps_MPI(){
-    #ifndef HAVE_SHMEM
-    int commsize;
-    float tmin, tavg, tmax;
-    MPI_Reduce(&local_temp.min, &tmin, 1, MPI_FLOAT, MPI_MIN, ROOT, MPI_COMM_WORLD);
-    MPI_Reduce(&local_temp.avg, &tavg, 1, MPI_FLOAT, MPI_SUM, ROOT, MPI_COMM_WORLD);
-    MPI_Reduce(&local_temp.max, &tmax, 1, MPI_FLOAT, MPI_MAX, ROOT, MPI_COMM_WORLD);
-    if(MyRank == ROOT){
-        MPI_Comm_size(MPI_COMM_WORLD,&commsize);
-        tavg = tavg / commsize;
-        if(tmin <= tmax){
-            EmitLog3f(MyRank, SCHEDULER_THREAD, "The minimum/average/maximum temperature across all cores (C) ", tmin, tavg, tmax, PRINT_ALWAYS);
-        } else {
-            EmitLog(MyRank, SCHEDULER_THREAD, "No valid temperature monitoring interface on this platform.", -1, PRINT_ALWAYS);
-        }
+static void mergeStatus(StatusRecord *in, StatusRecord *inout){
+    int i;
+    MergeTempSummary(&(in->temps), &(inout->temps));
+    for(i = 0; i <= POWER_DOMAINS; i++){
+        inout->watts[i] += in->watts[i];
     }
-    #endif
-} /* reduceTemps_MPI */
+    inout->pmin = (in->pmin < inout->pmin) ? in->pmin : inout->pmin;
+    inout->pmax = (in->pmax > inout->pmax) ? in->pmax : inout->pmax;
+    inout->busy += in->busy;
+    inout->runs += in->runs;
+    for(i = 0; i < status_nflags; i++){
+        inout->flags[i] += in->flags[i];
+    }
+} /* mergeStatus */
 
+#ifndef HAVE_SHMEM
 /**
- * \brief Gather the values of the temperatures from the various nodes to check if any are overheating - SHMEM
+ * \brief MPI reduction operation for status records, see mergeStatus.
  */
-void reduceTemps_SHMEM(){
-    #ifdef HAVE_SHMEM
-    int commsize;
-    // int i;
-    // assert(pWrkFloat != NULL);
-    // long *pSync = (long *)shmalloc(_SHMEM_REDUCE_SYNC_SIZE * sizeof(long));
-    // assert(pSync != NULL);
-    // for (i = 0; i < _SHMEM_REDUCE_SYNC_SIZE; i++) pSync[i] = _SHMEM_SYNC_VALUE;
-
-    // Can use pWrkFloat with length = SHMEM_REDUCE_MIN_WRKDATA_SIZE, because none of these
-    // reductions will ever be longer than length 1.
-
-    lmin = local_temp.min;
-    lavg = local_temp.avg;
-    lmax = local_temp.max;
-    commsize = SHMEM_NUM_PES;
-    shmem_barrier_all();
-    shmem_float_min_to_all(&tmin, &lmin, 1, 0, 0, commsize, pWrkFloat, rSync);
-    shmem_barrier_all();
-    shmem_float_sum_to_all(&tavg, &lavg, 1, 0, 0, commsize, pWrkFloat, rSync);
-    shmem_barrier_all();
-    shmem_float_max_to_all(&tmax, &lmax, 1, 0, 0, commsize, pWrkFloat, rSync);
-    shmem_barrier_all();
-
-    if(MyRank == ROOT){
-        tavg = tavg / commsize;
-        if(tmin <= tmax){
-            EmitLog3f(MyRank, SCHEDULER_THREAD, "The minimum/average/maximum temperature across all cores (C) ", tmin, tavg, tmax, PRINT_ALWAYS);
-        } else {
-            EmitLog(MyRank, SCHEDULER_THREAD, "No valid temperature monitoring interface on this platform.", -1, PRINT_ALWAYS);
-        }
+static void mergeStatusRecords(void *in, void *inout, int *len, MPI_Datatype *type){
+    int i;
+    for(i = 0; i < *len; i++){
+        mergeStatus((StatusRecord *)((char *)in + i * status_bytes), (StatusRecord *)((char *)inout + i * status_bytes));
     }
+}
+#endif
 
-    // shfree(pWrkFloat);
-    // shfree(pSync);
-    #endif /* ifdef HAVE_SHMEM */
-} /* reduceTemps_SHMEM */
+/**
+ * \brief Sizes the status record and allocates its buffers, on the first reduction.
+ */
+static void initStatus(){
+    int i;
+    int *row;
+
+    status_nflags = SYS_ERR_SIZE;
+    for(i = 1; i < ERR_FLAG_SIZE; i++){
+        status_nflags += plan_list[i - 1]->esize + GEN_SIZE;
+    }
+    status_bytes = sizeof(StatusRecord) + status_nflags * sizeof(int);
+    status_bytes = (status_bytes + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+    #ifdef HAVE_SHMEM
+    status_local = (StatusRecord *)shmalloc(status_bytes);
+    #else
+    status_local = (StatusRecord *)malloc(status_bytes);
+    #endif
+    status_total = (StatusRecord *)malloc(status_bytes);
+    status_rows = (int **)malloc(ERR_FLAG_SIZE * sizeof(int *));
+    assert(status_local && status_total && status_rows);
+    row = status_total->flags;
+    status_rows[0] = row;
+    row += SYS_ERR_SIZE;
+    for(i = 1; i < ERR_FLAG_SIZE; i++){
+        status_rows[i] = row;
+        row += plan_list[i - 1]->esize + GEN_SIZE;
+    }
+    status_last_runs = 0;
+} /* initStatus */
 
 /**
- * \brief Gather the error flags from the threads to report - MPI
- * \param local_flag 2D array of ints that holds the flag counters for the plans' errors. Keeps count of how many times an error was encountered.
+ * \brief Fills this rank's status record.
+ * \param local_flag The node's error counters, or NULL to send none.
  */
-void reduceFlags_MPI(int **local_flag){
-    #ifndef HAVE_SHMEM
+static void fillStatus(int **local_flag){
     int i, j, k;
-    int **sum = NULL;
-
-    sum = (int **)malloc(ERR_FLAG_SIZE * sizeof(int *));
-    assert(sum);
-    // Allocate space for system flags first.
-    sum[0] = (int *)calloc((SYS_ERR_SIZE), sizeof(int));
-    assert(sum[0]);
-    // Allocate space for plan flags.
-    for(j = 1; j < ERR_FLAG_SIZE; j++){
-        sum[j] = (int *)calloc((plan_list[j - 1]->esize + GEN_SIZE), sizeof(int));
-        assert(sum[j]);
+    StatusRecord *r = status_local;
+
+    BuildTempSummary(&(r->temps));
+    localPower(r->watts, &(r->pmin), &(r->pmax));
+    r->busy = __atomic_load_n(&busy_workers, __ATOMIC_RELAXED);
+    r->runs = WorkerRuns();
+    k = 0;
+    for(j = 0; j < SYS_ERR_SIZE; j++){
+        r->flags[k++] = local_flag ? local_flag[0][j] : 0;
     }
-
-    // Reduce system flags.
-    MPI_Reduce(local_flag[0], sum[0], (SYS_ERR_SIZE), MPI_INT, MPI_SUM, ROOT, MPI_COMM_WORLD);
-    // Reduce Plan flags.
     for(i = 1; i < ERR_FLAG_SIZE; i++){
-        MPI_Reduce(local_flag[i], sum[i], (plan_list[i - 1]->esize + GEN_SIZE), MPI_INT, MPI_SUM, ROOT, MPI_COMM_WORLD);
+        for(j = 0; j < plan_list[i - 1]->esize + GEN_SIZE; j++){
+            r->flags[k++] = local_flag ? local_flag[i][j] : 0;
+        }
     }
+} /* fillStatus */
 
-    if(MyRank == ROOT){
-        printFlags(sum);
+/**
+ * \brief Prints the reduced status record, on ROOT.
+ * \param flags Whether the record carries error counters.
+ */
+static void reportStatus(int flags){
+    char text[ARRAY];
+    StatusRecord *r = status_total;
+    ReportTempSummary(&(r->temps));
+    reportPower(r->watts, r->pmin, r->pmax);
+    EmitLog(MyRank, SCHEDULER_THREAD, "Workers running plans across all ranks:", r->busy, PRINT_SOME);
+    if(r->runs > status_last_runs){
+        snprintf(text, ARRAY, "Plan executions since the last report across all ranks: %llu", (unsigned long long)(r->runs - status_last_runs));
+        EmitLog(MyRank, SCHEDULER_THREAD, text, -1, PRINT_SOME);
     }
-
-    for(i = 0; i < ERR_FLAG_SIZE; i++){
-        free(sum[i]);
+    status_last_runs = r->runs;
+    if(flags){
+        printFlags(status_rows);
     }
-    free(sum);
-    #endif /* ifndef HAVE_SHMEM */
-} /* reduceFlags_MPI */
+} /* reportStatus */
 
 /**
- * \brief Gather the error flags from the threads to report - SHMEM
- * \param local_flag 2D array of ints that holds the flag counters for the plans' errors. Keeps count of how many times an error was encountered.
+ * \brief Starts reducing the status of all ranks to ROOT, which prints it once comm_status_progress completes the reduction - MPI
+ * A reduction still in flight from the last call is completed first.
+ * \param local_flag The node's error counters, or NULL to reduce and print only the temperatures, power and progress.
  */
-void reduceFlags_SHMEM(int **local_flag){
-    #ifdef HAVE_SHMEM
-    int i, j, k, commsize;
-    int **sum, *temp;
-    int largest = 0;
-
-    // dangerous crap here.....
-    sum = (int **)shmalloc(ERR_FLAG_SIZE * sizeof(int *));
-    assert(sum);
-    // Allocate space for system flags.
-    sum[0] = (int *)shmalloc((SYS_ERR_SIZE) *sizeof(int));
-    assert(sum[0]);
-    largest = SYS_ERR_SIZE;
-    // Allocate space for plan flags.
-    for(j = 1; j < ERR_FLAG_SIZE; j++){
-        sum[j] = (int *)shmalloc((plan_list[j - 1]->esize + GEN_SIZE) * sizeof(int));
-
-        largest = (plan_list[j - 1]->esize > largest) ? plan_list[j - 1]->esize : largest;
+void reduceStatus_MPI(int **local_flag){
+    #ifndef HAVE_SHMEM
+    if(status_type == MPI_DATATYPE_NULL){
+        initStatus();
+        status_group = (StatusRecord *)malloc(status_bytes);
+        assert(status_group);
+        MPI_Type_contiguous(status_bytes, MPI_BYTE, &status_type);
+        MPI_Type_commit(&status_type);
+        MPI_Op_create(mergeStatusRecords, 1, &status_op);
+        status_direct = comm_thread_multiple();
+        if(MyRank == ROOT){
+            EmitLog(MyRank, SCHEDULER_THREAD, "Status reductions go through group leaders:", group_leaders, PRINT_RARELY);
+            if(status_direct){
+                EmitLog(MyRank, SCHEDULER_THREAD, "Status reductions are run by the monitor threads.", -1, PRINT_RARELY);
+            }
+        }
     }
+    comm_status_progress(1);
+    fillStatus(local_flag);
+    status_flags = (local_flag != NULL);
+    if(status_direct){
+        pthread_mutex_lock(&status_lock);
+        status_stage = STATUS_QUEUED;
+        pthread_cond_broadcast(&status_cond);
+        pthread_mutex_unlock(&status_lock);
+        return;
+    }
+    MPI_Ireduce(status_local, status_group, 1, status_type, status_op, 0, group_comm, &status_request);
+    status_stage = STATUS_GROUP;
+    comm_status_progress(0);
+    #endif
+} /* reduceStatus_MPI */
 
-    temp = (int *)shmalloc((largest + GEN_SIZE) * sizeof(int));
-    assert(temp);
-
-    // assert(pWrkInt != NULL);
-    // long *pSync = (long *)shmalloc(_SHMEM_REDUCE_SYNC_SIZE * sizeof(long));
-    // assert(pSync != NULL);
-    // for (i = 0; i < _SHMEM_REDUCE_SYNC_SIZE; i++) pSync[i] = _SHMEM_SYNC_VALUE;
-    commsize = SHMEM_NUM_PES;
-
-    // Allocate a work array of appropriate size:
-    int pWrkLength = MAX(largest / 2 + 1, SHMEM_REDUCE_MIN_WRKDATA_SIZE);
-    int *pWrk = (int *)shmalloc(pWrkLength * sizeof(int));
-    assert(pWrk);
-
-    for(i = 0; i < SYS_ERR_SIZE; i++){
-        sum[0][i] = local_flag[0][i];
+/**
+ * \brief Carries on the status reduction started by reduceStatus_MPI: once a group has reduced to its leader, the
+ * leader passes the group's record on to ROOT, which prints the total. Every rank must call this until the reduction
+ * is complete, which a call with wait set guarantees. Does nothing with SHMEM, whose reduction is done at once.
+ * When the monitor thread runs the reductions, this only waits for it.
+ * \param wait Nonzero to block until the reduction in flight, if any, is complete.
+ */
+void comm_status_progress(int wait){
+    #ifndef HAVE_SHMEM
+    int done;
+    if(status_direct){
+        if(wait){
+            pthread_mutex_lock(&status_lock);
+            while(status_stage != STATUS_IDLE){
+                pthread_cond_wait(&status_cond, &status_lock);
+            }
+            pthread_mutex_unlock(&status_lock);
+        }
+        return;
     }
-    for(j = 1; j < ERR_FLAG_SIZE; j++){
-        for(k = 0; k < plan_list[j - 1]->esize + GEN_SIZE; k++){
-            sum[j][k] = local_flag[j][k];
+    while(status_stage != STATUS_IDLE){
+        if(wait){
+            MPI_Wait(&status_request, MPI_STATUS_IGNORE);
+            done = 1;
+        } else {
+            MPI_Test(&status_request, &done, MPI_STATUS_IGNORE);
+        }
+        if(!done){
+            return;
+        }
+        if((status_stage == STATUS_GROUP) && (leader_comm != MPI_COMM_NULL)){
+            MPI_Ireduce(status_group, status_total, 1, status_type, status_op, 0, leader_comm, &status_request);
+            status_stage = STATUS_LEADERS;
+        } else {
+            if((status_stage == STATUS_LEADERS) && (MyRank == ROOT)){
+                reportStatus(status_flags);
+            }
+            status_stage = STATUS_IDLE;
         }
     }
+    #endif
+} /* comm_status_progress */
 
-    // Reduce system flags.
-    shmem_barrier_all();
-    shmem_int_sum_to_all(temp, sum[0], (SYS_ERR_SIZE), 0, 0, commsize, pWrk, rSync);
-    shmem_barrier_all();
-    for(j = 0; j < (SYS_ERR_SIZE); j++){
-        sum[0][j] = temp[j];
-    }
-    // Reduce plan flags.
-    for(i = 1; i < ERR_FLAG_SIZE; i++){
-        shmem_int_sum_to_all(temp, sum[i], plan_list[i - 1]->esize + GEN_SIZE, 0, 0, commsize, pWrk, rSync);
-        shmem_barrier_all();
-        for(j = 0; j < (plan_list[i - 1]->esize + GEN_SIZE); j++){
-            sum[i][j] = temp[j];
+/**
+ * \brief Idles the monitor thread. When MPI grants MPI_THREAD_MULTIPLE, the monitor runs the status reductions the
+ * scheduler queues meanwhile, blocking in MPI rather than leaving the scheduler to carry them on.
+ * \param seconds Time to idle.
+ */
+void comm_status_serve(int seconds){
+    #ifndef HAVE_SHMEM
+    struct timespec until;
+    if(comm_thread_multiple()){
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += seconds;
+        pthread_mutex_lock(&status_lock);
+        for(;; ){
+            if(status_stage == STATUS_QUEUED){
+                pthread_mutex_unlock(&status_lock);
+                MPI_Reduce(status_local, status_group, 1, status_type, status_op, 0, group_comm);
+                if(leader_comm != MPI_COMM_NULL){
+                    MPI_Reduce(status_group, status_total, 1, status_type, status_op, 0, leader_comm);
+                    if(MyRank == ROOT){
+                        reportStatus(status_flags);
+                    }
+                }
+                pthread_mutex_lock(&status_lock);
+                status_stage = STATUS_IDLE;
+                pthread_cond_broadcast(&status_cond);
+            } else if(pthread_cond_timedwait(&status_cond, &status_lock, &until) == ETIMEDOUT){
+                break;
+            }
         }
+        pthread_mutex_unlock(&status_lock);
+        return;
     }
+    #endif
+    sleep(seconds);
+} /* comm_status_serve */
 
+/**
+ * \brief Reduces the status of all ranks to ROOT, and prints it there - SHMEM
+ * SHMEM has no user defined reductions, so ROOT fetches each PE's record and merges them.
+ * \param local_flag The node's error counters, or NULL to reduce and print only the temperatures, power and progress.
+ */
+void reduceStatus_SHMEM(int **local_flag){
+    #ifdef HAVE_SHMEM
+    static StatusRecord *remote = NULL;
+    int pe, commsize;
+    if(status_local == NULL){
+        initStatus();
+        remote = (StatusRecord *)malloc(status_bytes);
+        assert(remote);
+    }
+    fillStatus(local_flag);
+    commsize = SHMEM_NUM_PES;
+    shmem_barrier_all();
     if(MyRank == ROOT){
-        printFlags(sum);
+        memcpy(status_total, status_local, status_bytes);
+        for(pe = 0; pe < commsize; pe++){
+            if(pe != ROOT){
+                shmem_getmem(remote, status_local, status_bytes, pe);
+                mergeStatus(remote, status_total);
+            }
+        }
     }
-
-    for(i = 0; i < ERR_FLAG_SIZE; i++){
-        shfree(sum[i]);
+    shmem_barrier_all();
+    if(MyRank == ROOT){
+        reportStatus(local_flag != NULL);
     }
-    shfree(sum);
-    shfree(temp);
-    shfree(pWrk);
-    // shfree(pSync);
     #endif /* ifdef HAVE_SHMEM */
-} /* reduceFlags_SHMEM */
+} /* reduceStatus_SHMEM */
 
 /**
  * \brief Reduces a table of data from each node to a single table on the root node by performing the specified operation. MPI implementation.
+ * The table is reduced within each group first, then across the group leaders.
  *
  * \param [in,out] table The table of data to be reduced. The resulting table is then copied into it as output.
  * \param [in] nrows The number of rows in the table.
@@ -345,9 +846,11 @@ void reduceFlags_SHMEM(int **local_flag){
  */
 void comm_table_reduce_MPI(void *table, int nrows, int ncols, reduction_op op){
     #ifndef HAVE_SHMEM
+    double *group_buffer = NULL;
     double *receive_buffer = NULL;
     MPI_Op operation;
 
+    comm_status_progress(1);                // group_comm and leader_comm are free once the status is reduced
     switch(op){
     case REDUCE_SUM:
         operation = MPI_SUM;
@@ -362,12 +865,20 @@ void comm_table_reduce_MPI(void *table, int nrows, int ncols, reduction_op op){
         operation = MPI_SUM;
     }
 
+    if(group_rank == 0){
+        group_buffer = (double *)malloc(nrows * ncols * sizeof(double));
+        assert(group_buffer);
+    }
     if(MyRank == ROOT){
         receive_buffer = (double *)malloc(nrows * ncols * sizeof(double));
         assert(receive_buffer);
     }
 
-    MPI_Reduce(table, receive_buffer, nrows * ncols, MPI_DOUBLE, operation, ROOT, MPI_COMM_WORLD);
+    MPI_Reduce(table, group_buffer, nrows * ncols, MPI_DOUBLE, operation, 0, group_comm);
+    if(leader_comm != MPI_COMM_NULL){
+        MPI_Reduce(group_buffer, receive_buffer, nrows * ncols, MPI_DOUBLE, operation, 0, leader_comm);
+        free(group_buffer);
+    }
 
     if(MyRank == ROOT){
         memcpy(table, receive_buffer, nrows * ncols * sizeof(double));
@@ -435,7 +946,7 @@ void comm_table_reduce_SHMEM(void *table, int nrows, int ncols, reduction_op op)
 int comm_broadcast_buffer_MPI(void *buffer, int buffer_size){
     int error = 0;
     #ifndef HAVE_SHMEM
-    error = MPI_Bcast(buffer, buffer_size, MPI_CHAR, ROOT, MPI_COMM_WORLD);
+    error = MPI_Bcast(buffer, buffer_size, MPI_CHAR, ROOT, sched_comm);
     #endif
     return error;
 }
@@ -515,14 +1026,14 @@ int comm_broadcast_buffer_SHMEM(void *buffer, int buffer_size){
         assert(char_buffer);
 
         if (MyRank == ROOT) {
-                MPI_Pack(&num_workers,              SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                MPI_Pack(&num_loads,                SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                MPI_Pack(&thermal_panic,            SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                MPI_Pack(&thermal_relaxation_time,  SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                MPI_Pack(&monitor_frequency,        SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                MPI_Pack(&monitor_output_frequency, SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                MPI_Pack(&verbose_flag,             SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                MPI_Pack(&comm_flag,                SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
+                MPI_Pack(&num_workers,              SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                MPI_Pack(&num_loads,                SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                MPI_Pack(&thermal_panic,            SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                MPI_Pack(&thermal_relaxation_time,  SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                MPI_Pack(&monitor_frequency,        SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                MPI_Pack(&monitor_output_frequency, SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                MPI_Pack(&verbose_flag,             SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                MPI_Pack(&comm_flag,                SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
         }
    #endif
         return (void *)char_buffer;
@@ -569,14 +1080,14 @@ int comm_broadcast_buffer_SHMEM(void *buffer, int buffer_size){
         char *char_buffer = (char *)buffer;
 
         if (MyRank != ROOT) {
-                MPI_Unpack(char_buffer, buffer_size, &buff_index, &num_workers,              SINGLE, MPI_INT,  MPI_COMM_WORLD);
-                MPI_Unpack(char_buffer, buffer_size, &buff_index, num_loads,                 SINGLE, MPI_INT,  MPI_COMM_WORLD);
-                MPI_Unpack(char_buffer, buffer_size, &buff_index, &thermal_panic,            SINGLE, MPI_INT,  MPI_COMM_WORLD);
-                MPI_Unpack(char_buffer, buffer_size, &buff_index, &thermal_relaxation_time,  SINGLE, MPI_INT,  MPI_COMM_WORLD);
-                MPI_Unpack(char_buffer, buffer_size, &buff_index, &monitor_frequency,        SINGLE, MPI_INT,  MPI_COMM_WORLD);
-                MPI_Unpack(char_buffer, buffer_size, &buff_index, &monitor_output_frequency, SINGLE, MPI_INT,  MPI_COMM_WORLD);
-                MPI_Unpack(char_buffer, buffer_size, &buff_index, &verbose_flag,             SINGLE, MPI_INT,  MPI_COMM_WORLD);
-                MPI_Unpack(char_buffer, buffer_size, &buff_index, &comm_flag,                SINGLE, MPI_INT,  MPI_COMM_WORLD);
+                MPI_Unpack(char_buffer, buffer_size, &buff_index, &num_workers,              SINGLE, MPI_INT,  sched_comm);
+                MPI_Unpack(char_buffer, buffer_size, &buff_index, num_loads,                 SINGLE, MPI_INT,  sched_comm);
+                MPI_Unpack(char_buffer, buffer_size, &buff_index, &thermal_panic,            SINGLE, MPI_INT,  sched_comm);
+                MPI_Unpack(char_buffer, buffer_size, &buff_index, &thermal_relaxation_time,  SINGLE, MPI_INT,  sched_comm);
+                MPI_Unpack(char_buffer, buffer_size, &buff_index, &monitor_frequency,        SINGLE, MPI_INT,  sched_comm);
+                MPI_Unpack(char_buffer, buffer_size, &buff_index, &monitor_output_frequency, SINGLE, MPI_INT,  sched_comm);
+                MPI_Unpack(char_buffer, buffer_size, &buff_index, &verbose_flag,             SINGLE, MPI_INT,  sched_comm);
+                MPI_Unpack(char_buffer, buffer_size, &buff_index, &comm_flag,                SINGLE, MPI_INT,  sched_comm);
         }
 
         free(buffer);
@@ -606,8 +1117,8 @@ int comm_broadcast_buffer_SHMEM(void *buffer, int buffer_size){
         buffer = (char *)config_buffer_create(buff_sz, load_num);
 
         // Call MPI broadcast routine.
-        MPI_Bcast(buffer,           buff_sz, MPI_PACKED, ROOT, MPI_COMM_WORLD);
-        MPI_Bcast(temperature_path, ARRAY,   MPI_CHAR,   ROOT, MPI_COMM_WORLD);
+        MPI_Bcast(buffer,           buff_sz, MPI_PACKED, ROOT, sched_comm);
+        MPI_Bcast(temperature_path, ARRAY,   MPI_CHAR,   ROOT, sched_comm);
 
         // All nonzero processes: receive broadcast and unpack from the buffer into global variables.
         config_buffer_destroy((void *)buffer, buff_sz, &load_num);
@@ -781,31 +1292,31 @@ int comm_broadcast_buffer_SHMEM(void *buffer, int buffer_size){
 
         if (MyRank == ROOT) {
                 // Pack the load structure into a buffer, so that it can be passed as a single message.
-                MPI_Pack(&(load->num_threads), SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                MPI_Pack(&(load->num_cpusets), SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                MPI_Pack(&(load->runtime),     SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                MPI_Pack(&(load->scheduling),  SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
+                MPI_Pack(&(load->num_threads), SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                MPI_Pack(&(load->num_cpusets), SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                MPI_Pack(&(load->runtime),     SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                MPI_Pack(&(load->scheduling),  SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
                 // add nsubloads to allow correct unpacking on other side
-                MPI_Pack(&num_subloads, SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
+                MPI_Pack(&num_subloads, SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
 
                 subload_ptr = load->front;
                 while (subload_ptr != NULL) {
-                        MPI_Pack(&(subload_ptr->num_plans),  SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                        MPI_Pack(&(subload_ptr->cpuset_len), SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                        MPI_Pack(subload_ptr->cpuset, subload_ptr->cpuset_len, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
+                        MPI_Pack(&(subload_ptr->num_plans),  SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                        MPI_Pack(&(subload_ptr->cpuset_len), SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                        MPI_Pack(subload_ptr->cpuset, subload_ptr->cpuset_len, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
                         plan_ptr = subload_ptr->first;
                         while (plan_ptr != NULL) {
-                                MPI_Pack(&(plan_ptr->name),      SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                                MPI_Pack(&(plan_ptr->input_data->isize), SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                                MPI_Pack(&(plan_ptr->input_data->csize), SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                                MPI_Pack(&(plan_ptr->input_data->dsize), SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                                MPI_Pack(plan_ptr->input_data->i, plan_ptr->input_data->isize,  MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
+                                MPI_Pack(&(plan_ptr->name),      SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                                MPI_Pack(&(plan_ptr->input_data->isize), SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                                MPI_Pack(&(plan_ptr->input_data->csize), SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                                MPI_Pack(&(plan_ptr->input_data->dsize), SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                                MPI_Pack(plan_ptr->input_data->i, plan_ptr->input_data->isize,  MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
                                 for(i = 0; i < plan_ptr->input_data->csize; i++) {
                                         string_len = strlen(plan_ptr->input_data->c[i])+1;
-                                        MPI_Pack(&string_len, SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
-                                        MPI_Pack(plan_ptr->input_data->c, string_len, MPI_CHAR, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
+                                        MPI_Pack(&string_len, SINGLE, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
+                                        MPI_Pack(plan_ptr->input_data->c, string_len, MPI_CHAR, char_buffer, buffer_size, &buff_index, sched_comm);
                                 }
-                                MPI_Pack(plan_ptr->input_data->d, plan_ptr->input_data->dsize, MPI_INT, char_buffer, buffer_size, &buff_index, MPI_COMM_WORLD);
+                                MPI_Pack(plan_ptr->input_data->d, plan_ptr->input_data->dsize, MPI_INT, char_buffer, buffer_size, &buff_index, sched_comm);
 
                                 plan_ptr = plan_ptr->next;
                         }
@@ -932,12 +1443,12 @@ int comm_broadcast_buffer_SHMEM(void *buffer, int buffer_size){
 
         if (MyRank != ROOT) {
                 // Unpack the buffer into a newly allocated Load structure.
-                MPI_Unpack(buffer, buffer_size, &buff_index, &(load->num_threads), SINGLE, MPI_INT, MPI_COMM_WORLD);
-                MPI_Unpack(buffer, buffer_size, &buff_index, &(load->num_cpusets), SINGLE, MPI_INT, MPI_COMM_WORLD);
-                MPI_Unpack(buffer, buffer_size, &buff_index, &(load->runtime),     SINGLE, MPI_INT, MPI_COMM_WORLD);
-                MPI_Unpack(buffer, buffer_size, &buff_index, &(load->scheduling),  SINGLE, MPI_INT, MPI_COMM_WORLD);
+                MPI_Unpack(buffer, buffer_size, &buff_index, &(load->num_threads), SINGLE, MPI_INT, sched_comm);
+                MPI_Unpack(buffer, buffer_size, &buff_index, &(load->num_cpusets), SINGLE, MPI_INT, sched_comm);
+                MPI_Unpack(buffer, buffer_size, &buff_index, &(load->runtime),     SINGLE, MPI_INT, sched_comm);
+                MPI_Unpack(buffer, buffer_size, &buff_index, &(load->scheduling),  SINGLE, MPI_INT, sched_comm);
                 // get number of subloads
-                MPI_Unpack(buffer, buffer_size, &buff_index, &nsubloads,  SINGLE, MPI_INT, MPI_COMM_WORLD);
+                MPI_Unpack(buffer, buffer_size, &buff_index, &nsubloads,  SINGLE, MPI_INT, sched_comm);
 
                 // Allocate memory for, error check, unpack, and initialize the Load structure.
                 load->front = (SubLoad *)malloc(sizeof(SubLoad));
@@ -945,13 +1456,13 @@ int comm_broadcast_buffer_SHMEM(void *buffer, int buffer_size){
                 subload_ptr = load->front;
                 // unpack subloads for this load
                 for (i = 0; (i < nsubloads) && (subload_ptr != NULL) && (alloc_err != BAD); i++) {
-                        MPI_Unpack(buffer, buffer_size, &buff_index, &(subload_ptr->num_plans),  SINGLE, MPI_INT, MPI_COMM_WORLD);
-                        MPI_Unpack(buffer, buffer_size, &buff_index, &(subload_ptr->cpuset_len), SINGLE, MPI_INT, MPI_COMM_WORLD);
+                        MPI_Unpack(buffer, buffer_size, &buff_index, &(subload_ptr->num_plans),  SINGLE, MPI_INT, sched_comm);
+                        MPI_Unpack(buffer, buffer_size, &buff_index, &(subload_ptr->cpuset_len), SINGLE, MPI_INT, sched_comm);
                         // get cpusets
                         subload_ptr->cpuset = (int *)malloc(subload_ptr->cpuset_len * sizeof(int));
                         assert(subload_ptr->cpuset);
                         if (subload_ptr->cpuset != NULL)
-                                MPI_Unpack(buffer, buffer_size, &buff_index, subload_ptr->cpuset, subload_ptr->cpuset_len, MPI_INT, MPI_COMM_WORLD);
+                                MPI_Unpack(buffer, buffer_size, &buff_index, subload_ptr->cpuset, subload_ptr->cpuset_len, MPI_INT, sched_comm);
                         else
                                 alloc_err = BAD;
 
@@ -961,25 +1472,25 @@ int comm_broadcast_buffer_SHMEM(void *buffer, int buffer_size){
                         plan_ptr = subload_ptr->first;
                         // unpack loadplans for this subload
                         for (j = 0; (j < subload_ptr->num_plans) && (plan_ptr != NULL) && (alloc_err != BAD); j++) {
-                                MPI_Unpack(buffer, buffer_size, &buff_index, &(plan_ptr->name), SINGLE, MPI_INT, MPI_COMM_WORLD);
+                                MPI_Unpack(buffer, buffer_size, &buff_index, &(plan_ptr->name), SINGLE, MPI_INT, sched_comm);
                                 // unpack plan input data
                                 plan_ptr->input_data = (data *)malloc(sizeof(data));
                                 assert(plan_ptr->input_data);
                                 if (plan_ptr->input_data != NULL) {
-                                        MPI_Unpack(buffer, buffer_size, &buff_index, &(plan_ptr->input_data->isize), SINGLE, MPI_INT, MPI_COMM_WORLD);
-                                        MPI_Unpack(buffer, buffer_size, &buff_index, &(plan_ptr->input_data->csize), SINGLE, MPI_INT, MPI_COMM_WORLD);
-                                        MPI_Unpack(buffer, buffer_size, &buff_index, &(plan_ptr->input_data->dsize), SINGLE, MPI_INT, MPI_COMM_WORLD);
+                                        MPI_Unpack(buffer, buffer_size, &buff_index, &(plan_ptr->input_data->isize), SINGLE, MPI_INT, sched_comm);
+                                        MPI_Unpack(buffer, buffer_size, &buff_index, &(plan_ptr->input_data->csize), SINGLE, MPI_INT, sched_comm);
+                                        MPI_Unpack(buffer, buffer_size, &buff_index, &(plan_ptr->input_data->dsize), SINGLE, MPI_INT, sched_comm);
                                         plan_ptr->input_data->i = (int*)    malloc(plan_ptr->input_data->isize * sizeof(int));
                                         plan_ptr->input_data->c = (char**)  malloc(plan_ptr->input_data->csize * sizeof(char*));
                                         plan_ptr->input_data->d = (double*) malloc(plan_ptr->input_data->dsize * sizeof(double));
-                                        MPI_Unpack(buffer, buffer_size, &buff_index, plan_ptr->input_data->i, plan_ptr->input_data->isize, MPI_INT, MPI_COMM_WORLD);
+                                        MPI_Unpack(buffer, buffer_size, &buff_index, plan_ptr->input_data->i, plan_ptr->input_data->isize, MPI_INT, sched_comm);
                                         for(k = 0; k < plan_ptr->input_data->csize; k++) {
-                                                MPI_Unpack(buffer, buffer_size, &buff_index, &string_len, SINGLE, MPI_INT, MPI_COMM_WORLD);
+                                                MPI_Unpack(buffer, buffer_size, &buff_index, &string_len, SINGLE, MPI_INT, sched_comm);
                                                 plan_ptr->input_data->c[k] = (char *)malloc(string_len * sizeof(char));
                                                 assert(plan_ptr->input_data->c[k]);
-                                                MPI_Unpack(buffer, buffer_size, &buff_index, plan_ptr->input_data->c[k], string_len, MPI_CHAR, MPI_COMM_WORLD);
+                                                MPI_Unpack(buffer, buffer_size, &buff_index, plan_ptr->input_data->c[k], string_len, MPI_CHAR, sched_comm);
                                         }
-                                        MPI_Unpack(buffer, buffer_size, &buff_index, plan_ptr->input_data->d, plan_ptr->input_data->dsize, MPI_INT, MPI_COMM_WORLD);
+                                        MPI_Unpack(buffer, buffer_size, &buff_index, plan_ptr->input_data->d, plan_ptr->input_data->dsize, MPI_INT, sched_comm);
                                 } else {
                                         alloc_err = BAD;
                                 }
@@ -1040,12 +1551,12 @@ int comm_broadcast_buffer_SHMEM(void *buffer, int buffer_size){
         buffer_size = load_buffer_size(load, &nsubloads);
 
         // create the buffer to distribute the load
-        MPI_Bcast(&buffer_size, SINGLE, MPI_INT, ROOT, MPI_COMM_WORLD);
+        MPI_Bcast(&buffer_size, SINGLE, MPI_INT, ROOT, sched_comm);
 
         buffer = (char *)load_buffer_create(load, nsubloads, buffer_size);
         assert(buffer);
 
-        flag = MPI_Bcast(buffer, buffer_size, MPI_PACKED, ROOT, MPI_COMM_WORLD);
+        flag = MPI_Bcast(buffer, buffer_size, MPI_PACKED, ROOT, sched_comm);
 
         alloc_err = load_buffer_destroy((void *)buffer, buffer_size, load);
 
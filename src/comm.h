@@ -27,6 +27,54 @@ typedef enum {
     REDUCE_MAX
 } reduction_op;
 
+/**
+ * \brief The periodic status of one rank, or of several once reduced. See reduceStatus.
+ */
+typedef struct {
+    TempSummary temps;                  /**< Summary of the temperature map.                           */
+    float    watts[POWER_DOMAINS + 1];  /**< Power of each RAPL domain, then nodes with package counters. */
+    float    pmin, pmax;                /**< Lowest and highest node package power.                    */
+    int      busy;                      /**< Workers running a plan other than SLEEP.                  */
+    uint64_t runs;                      /**< Plan executions since the start of the run.               */
+    int      flags[];                   /**< Every row of the error counters, back to back.            */
+} StatusRecord;
+
+#if !defined(HAVE_SHMEM) && defined(MPI_VERSION)
+/**
+ * \brief The communicator of a COMM plan, see comm_lane_setup.
+ */
+typedef struct {
+    MPI_Comm comm;                      /**< A duplicate of MPI_COMM_WORLD.                            */
+    int      size, rank;                /**< Size of comm and our rank in it.                          */
+    int      funnel;                    /**< Nonzero if the plan may not call MPI itself, so it hands its operations to the scheduler. */
+} CommLane;
+
+/**
+ * \brief The operations a COMM plan can hand to the scheduler.
+ */
+enum {
+    COMM_OP_SEND,                       /**< Send count bytes from buf to peer.                        */
+    COMM_OP_RECV,                       /**< Receive count bytes into buf from peer.                   */
+    COMM_OP_SUM                         /**< Sum count ints of buf over the lane, into result.         */
+};
+
+/**
+ * \brief One operation handed to the scheduler with comm_funnel_post, the counterpart of an MPI request.
+ */
+typedef struct CommOp {
+    int      kind;                      /**< COMM_OP_SEND, COMM_OP_RECV or COMM_OP_SUM.                */
+    void    *buf, *result;
+    int      count, peer, tag;
+    CommLane *lane;
+    int      state;                     /**< 0 until comm_funnel_post, and again once comm_funnel_waitsome reports it. */
+    MPI_Request req;
+    struct CommOp *next;
+} CommOp;
+
+extern void comm_funnel_post(CommOp *op);
+extern int comm_funnel_waitsome(CommOp *ops, int n, int *index);
+#endif
+
 extern void *config_buffer_create(int buffer_size, int num_loads);
 extern void *config_buffer_create_SHMEM(int buffer_size, int num_loads);
 extern void *config_buffer_create_MPI(int buffer_size, int num_loads);
@@ -48,13 +96,20 @@ extern int bcastLoad_MPI(Load *load);
 extern int bcastLoad_SHMEM(Load *load);
 extern int comm_broadcast_buffer_MPI(void *buffer, int buffer_size);
 extern int comm_broadcast_buffer_SHMEM(void *buffer, int buffer_size);
-extern void reduceTemps_MPI();
-extern void reduceTemps_SHMEM();
-extern void reduceFlags_MPI(int **local_flag);
-extern void reduceFlags_SHMEM(int **local_flag);
+extern void reduceStatus_MPI(int **local_flag);
+extern void reduceStatus_SHMEM(int **local_flag);
+extern void comm_status_progress(int wait);
 extern void comm_table_reduce_MPI(void *table, int nrows, int ncols, reduction_op op);
 extern void comm_table_reduce_SHMEM(void *table, int nrows, int ncols, reduction_op op);
 extern void comm_setup(int *argc, char ***argv);
+extern int comm_thread_multiple();
+extern void comm_lane_setup(int lane);
+extern void *comm_lane_open(int lane);
+extern void comm_lane_close(void *lane);
+extern void comm_sleep(int seconds);
+extern int comm_funnel_poll();
+extern void comm_funnel_drain();
+extern void comm_status_serve(int seconds);
 extern int comm_getrank();
 extern void comm_broadcast_int(int *value);
 extern void comm_abort(int e_code);
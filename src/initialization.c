@@ -26,6 +26,7 @@
 #include <systemburn.h>
 #include <initialization.h>
 #include <comm.h>
+#include <planheaders.h>
 
 /**
    \brief	This function serves as a primary initialization phase for the systemburn benchmark.
@@ -73,8 +74,9 @@ int initialize(int argc, char *argv[], char **log_file, char **config_file, char
     /* Using commandline options and arguments, determine filenames of files to open. */
     while((c = getopt(argc, argv, options)) != -1){
         switch(c){
-        case 'c':                       /* Input - comm_flag */
-            buflen = atoi(optarg);
+        case 'c':                       /* Input - comm_flag, the message size, then any other COMM options */
+            buflen = (int)plan_parse_size(optarg, NULL);
+            strncpy(comm_options, optarg, ARRAY - 1);
             break;
         case 'f':                       /* Input - configuration file with system information. */
             config = optarg;
@@ -243,7 +245,9 @@ void printHelpText(){
     printf("                          is not specified, the default file opened is systemburn.config.\n");
     printf("  -l <log file>      Allows the user to specify a filename to store program log info in.\n");
     printf("                          the default file is systemburn.log. (This option is currently unavailable)\n");
-    printf("  -c <comm msgsize>  Runs a communication load with specific message sizes.\n");
+    printf("  -c <comm msgsize>  Runs a communication load with specific message sizes. The size may be\n");
+    printf("                          followed by the COMM plan options, e.g. -c \"64K HALO WINDOW=32 SWEEP\",\n");
+    printf("                          and PUT or GET for one-sided transfers.\n");
     printf("  -n <# load files>  The number of files specifed as non-option arguments to systemburn.\n");
     printf("  -v <output level>  Determines the amount of output, with 0 the default and 3 the most.\n");
     printf("  -p                 Disable calculation and output of performance statistics.\n");
@@ -401,6 +401,47 @@ int allocSubload(SubLoad ***output, int *subloads){
     return flag;
 } /* allocSubload */
 
+/** \brief Finds and removes a HUGEPAGES modifier from a PLAN line, so the plan's own parser never sees it.
+   The modifier may appear anywhere after the plan name as HUGEPAGES (2MB pages), HUGEPAGES=2M, HUGEPAGES=1G
+   or HUGEPAGES=THP (transparent huge pages only).
+   \param line PLAN line to be read. The modifier is blanked out in place.
+   \return The requested page size, PAGES_DEFAULT if there is no modifier.
+ */
+int hugePagesModifier(char *line){
+    char *mod = line;
+    char *end;
+    int pages = PAGES_DEFAULT;
+
+    while((mod = strstr(mod, "HUGEPAGES")) != NULL){
+        end = mod + strlen("HUGEPAGES");
+        if(((mod == line) || isspace(mod[-1])) && ((*end == '\0') || (*end == '=') || isspace(*end))){
+            break;
+        }
+        mod = end;
+    }
+    if(mod == NULL){
+        return pages;
+    }
+
+    pages = PAGES_2M;
+    if(*end == '='){
+        end++;
+        if(strncmp(end, "1G", 2) == 0){
+            pages = PAGES_1G;
+        } else if(strncmp(end, "THP", 3) == 0){
+            pages = PAGES_THP;
+        } else if(strncmp(end, "2M", 2) != 0){
+            EmitLog(MyRank, SCHEDULER_THREAD, "Unrecognized HUGEPAGES size, using 2MB pages.", -1, PRINT_ALWAYS);
+        }
+        while((*end != '\0') && !isspace(*end)){
+            end++;
+        }
+    }
+    memset(mod, ' ', end - mod);
+
+    return pages;
+} /* hugePagesModifier */
+
 /** \brief Parse a PLAN line.
    \param line PLAN line to be read.
    \param output Struct that holds the information for the plan listed
@@ -411,6 +452,7 @@ int planLine(char *line, LoadPlan *output, int *plans){
     char plan_name[ARRAY];
     plan_choice temp = UNKN_PLAN;
     int flag = 0;
+    int pages = hugePagesModifier(line);
     flag = sscanf(line, " PLAN %d%s", &plan_copies, plan_name);
     if(flag == 2){
         flag = GOOD;
@@ -423,6 +465,9 @@ int planLine(char *line, LoadPlan *output, int *plans){
         output->name = UNKN_PLAN;
         output->input_data = NULL;
 //	output->isize = output->csize = output->dsize = 0;
+        output->pages = pages;
+        output->team_size = 1;
+        output->team_rank = 0;
         output->next = NULL;
         /* Uses an array of function pointers to call the parsing function for each plan. */
         (*plan_list[temp]->parse)(line, output);
@@ -453,6 +498,8 @@ int assignPlan(SubLoad **output, int subloads, LoadPlan *input, int plans){
                 output[i]->last = plan_ptr->next;
             }
             if(output[i]->last != NULL){
+                output[i]->last->team_size = plans;
+                output[i]->last->team_rank = j;
                 output[i]->num_plans++;
             } else {
                 output[i]->last = plan_ptr;
@@ -584,6 +631,9 @@ LoadPlan *planCopy(LoadPlan *input){
     assert(temp);
     if((temp != NULL) && (input != NULL) ){
         temp->name = input->name;
+        temp->pages = input->pages;
+        temp->team_size = input->team_size;
+        temp->team_rank = input->team_rank;
         temp->next = NULL;
         if(input->input_data != NULL){
             temp->input_data = (data *)malloc(sizeof(data));
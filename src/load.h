@@ -74,6 +74,7 @@ extern int runtimeLine(char *line, int *runtime);
 extern int scheduleLine(char *line, schedules *schedule);
 extern int subloadLine(char *line, int *subloads);
 extern int allocSubload(SubLoad ***output, int *subloads);
+extern int hugePagesModifier(char *line);
 extern int planLine(char *line, LoadPlan *output, int *plans);
 extern int assignPlan(SubLoad **output, int subloads, LoadPlan *input, int plans);
 extern int assignSubLoad(Load *load, int *index, SubLoad ***temp_subload, int subloads);
@@ -21,6 +21,8 @@
 #ifndef __LOADSTRUCT_H
 #define __LOADSTRUCT_H
 
+#include <performance.h>
+
 /** \brief This struct allows the user to input various forms of data, be they ints, doubles or strings.	*/
 
 typedef struct data {
@@ -39,6 +41,9 @@ typedef struct data {
 typedef struct LoadPlan {
     int name;                   /* The name enum for this LoadPlan, indicates the load module to be run.	*/
     data *input_data;           /* Pointer to the size parameter(s) of the load module indicated by name.	*/
+    int pages;                  /* Page size requested with a HUGEPAGES modifier (PAGES_* in planheaders.h).	*/
+    int team_size;              /* Number of copies made from this LoadPlan's PLAN line.			*/
+    int team_rank;              /* Which of those copies this is.						*/
     struct LoadPlan *next;      /* Pointer to the next LoadPlan in the linked list.				*/
 } LoadPlan;
 
@@ -53,7 +58,7 @@ typedef struct {
     int   (*init)(void *p);
     void * (*kill)(void *p);
     int   (*perf)(void *p);
-    char *perf_units[];
+    char *perf_units[NUM_TIMERS];
 } plan_info;
 
 /** \brief Struct that holds the information for a given SubLoad. */
@@ -22,104 +22,324 @@
 #include <initialization.h>
 #include <comm.h>
 #include <fcntl.h>
+#include <dirent.h>
 
 /*******************************************************************************
 * This is a simple example of a typical activity for the monitor thread:
-* checking the temperature. This particular implementation is specific
-* to Linux systems with ACPI * enabled. If ACPI is not enabled, the check
-* returns an approximation to absolute zero.  * The calling code should be
-* smart enough to recognize this indicates a problem.
+* checking the temperature. The sensors are found once, on the first check,
+* by listing the temperature chips under /sys/class/hwmon: CPU chips
+* (coretemp, k10temp, ...), memory modules and GPUs. Without a CPU chip, the
+* ACPI thermal zones under /sys/class/thermal and then the old /proc/acpi
+* interface stand in for it. The input files are kept open and reread with
+* pread every monitor interval, so a large allocation does not hit a shared
+* sysfs with thousands of failed opens at startup.
+*
+* Every sensor's last reading is kept in a labelled map, which reduceTemps
+* summarizes (see BuildTempSummary) so that ROOT can name the hottest sensors
+* of the whole allocation. The node's min/avg/max, and the thermal panic,
+* only take the CPU sensors. If there are none, the check returns min > max.
+* The calling code should be smart enough to recognize this indicates a
+* problem.
 *******************************************************************************/
 
-#define MAX_ID           0x0010
-#define MAX_BUS          0x0100
 #define BUFLEN           0x0400
 #define NOT_YET          (-1)
-#define MAX_CORES        0x0040
-int MAX_HARDWARE_SENSORS = MAX_CORES * 4;
-int CoreTemp[MAX_CORES * 8];
+#define MAX_SENSORS      0x0400
+#define SENSOR_NAME      0x0020
+#define HOST_NAME        0x0020
+#define HWMON_ROOT       "/sys/class/hwmon"
+#define THERMAL_ROOT     "/sys/class/thermal"
+
+/**
+ * \brief A temperature sensor found by FindTemperatureSensors.
+ */
+typedef struct {
+    int  fd;                    /**< The open input file, in millidegrees C.         */
+    int  kind;                  /**< SENSOR_SOCKET, SENSOR_CORE, ...                 */
+    char name[SENSOR_NAME];     /**< Chip or zone type, e.g. coretemp.               */
+    char label[SENSOR_NAME];    /**< The sensor's label, e.g. Core 3, or its file.   */
+    float temp;                 /**< Last reading in C, below absolute zero if none. */
+} TempSensor;
+
+/**
+ * \brief The hwmon drivers the monitor watches, and what kind of sensor they have.
+ */
+static struct {
+    char *name;
+    int   kind;
+} HwmonChips[] = {
+    { "coretemp",    SENSOR_CORE   },       /* except its Package id N sensors */
+    { "k10temp",     SENSOR_SOCKET },
+    { "zenpower",    SENSOR_SOCKET },
+    { "cpu_thermal", SENSOR_SOCKET },
+    { "jc42",        SENSOR_DIMM   },
+    { "spd5118",     SENSOR_DIMM   },
+    { "amdgpu",      SENSOR_GPU    },
+    { "nouveau",     SENSOR_GPU    },
+    { "radeon",      SENSOR_GPU    },
+    { NULL,          SENSOR_OTHER  }
+};
+
+/**
+ * \brief The thermal zone types taken for processor sensors when no hwmon chip has any, matched as prefixes so that
+ * e.g. cpu0-thermal and cpu_thermal both count. Other zones (acpitz, pch, wifi, battery, ...) are left alone.
+ */
+static struct {
+    char *type;
+    int   kind;
+} ThermalZones[] = {
+    { "x86_pkg_temp", SENSOR_SOCKET },
+    { "cpu",          SENSOR_SOCKET },     /* cpu-thermal, cpu_thermal, cpu0-thermal, ... */
+    { "soc",          SENSOR_SOCKET },     /* soc_thermal, soc-thermal on ARM boards */
+    { NULL,           SENSOR_OTHER  }
+};
+
+static char *KindNames[SENSOR_KINDS] = {
+    "socket", "core", "DIMM", "GPU", "other"
+};
+
+TempSensor Sensors[MAX_SENSORS];
+char SensorBuf[BUFLEN];
+char HostName[HOST_NAME];
+int nCpuTemps = 0;
 int ProcSensor;
-int FILES_OPENED = NOT_YET;
 int ProcTemp = 0;
-int nTemps = 0;
+int nTemps = NOT_YET;
 
 /**
- * \brief Checks the temperatures of the nodes in the computer
+ * \brief Reads a short sysfs text file, such as a chip name or a sensor label, without its newline.
  *
- * \param T Holds the data for the temperatures on a node: min, max, and avg
+ * \param path The file.
+ * \param buf Receives the text.
+ * \param len Size of buf.
+ * \returns 1 if something was read, 0 otherwise.
  */
-void CheckTemperatureRange(TemperatureRange *T){
-    char filename[BUFLEN],rdbuf[BUFLEN];
-    float t;
-    int count,core,sensor,bus,id,fd,sen;
-    count = 0;
-    T->max = 0.0;
-    T->avg = 0.0;
-    T->min = 1000.0;
-    if(FILES_OPENED == NOT_YET){
-        FILES_OPENED = 0;
-// #ifndef USE_PROC_TEMP
-        // look for thermal sensors on Intel cores -- new style
-        // these are under /sys/devices/platform/coretemp.*/temp1_input
-        for(core = 0; core < MAX_HARDWARE_SENSORS; core++){
-            for(sen = 0; sen < 5; sen++){
-                snprintf(filename, BUFLEN, "/sys/bus/platform/devices/coretemp.%d/temp%1d_input", core,sen);
-                fd = open(filename, 0, O_RDONLY);
-                if(fd != -1){
-                    CoreTemp[nTemps++] = fd;
-                    FILES_OPENED++;
-                }
-            }
+static int ReadText(char *path, char *buf, int len){
+    int fd;
+    ssize_t n;
+    fd = open(path, O_RDONLY);
+    if(fd == -1){
+        return 0;
+    }
+    n = read(fd, buf, len - 1);
+    close(fd);
+    if(n <= 0){
+        return 0;
+    }
+    buf[n] = '\0';
+    buf[strcspn(buf, "\n")] = '\0';
+    return 1;
+} /* ReadText */
+
+/**
+ * \brief Opens a sensor's input file and adds it to the list, if it can be read.
+ *
+ * \param input The input file.
+ * \param name Chip or zone type.
+ * \param label The sensor's label.
+ * \param kind SENSOR_SOCKET, SENSOR_CORE, ...
+ */
+static void AddSensor(char *input, char *name, char *label, int kind){
+    int fd;
+    if(nTemps >= MAX_SENSORS){
+        return;
+    }
+    fd = open(input, O_RDONLY);
+    if(fd == -1){
+        return;
+    }
+    if(pread(fd, SensorBuf, BUFLEN - 1, 0) <= 0){
+        close(fd);
+        return;
+    }
+    Sensors[nTemps].fd = fd;
+    Sensors[nTemps].kind = kind;
+    Sensors[nTemps].temp = ABSOLUTE_ZERO - 1;
+    snprintf(Sensors[nTemps].name, SENSOR_NAME, "%s", name);
+    snprintf(Sensors[nTemps].label, SENSOR_NAME, "%s", label);
+    nTemps++;
+} /* AddSensor */
+
+static const char *ScanPrefix;     /* for ScanFilter, set by ScanDir */
+
+/**
+ * \brief scandir filter keeping the entries that start with ScanPrefix.
+ */
+static int ScanFilter(const struct dirent *d){
+    return strncmp(d->d_name, ScanPrefix, strlen(ScanPrefix)) == 0;
+}
+
+/**
+ * \brief Lists the entries of a directory that start with prefix, in order.
+ *
+ * \param dir The directory.
+ * \param prefix e.g. "hwmon".
+ * \param list Receives the entries, to be freed by the caller.
+ * \returns The number of entries, 0 if the directory cannot be read.
+ */
+static int ScanDir(char *dir, const char *prefix, struct dirent ***list){
+    int n;
+    ScanPrefix = prefix;
+    n = scandir(dir, list, ScanFilter, alphasort);
+    return (n > 0) ? n : 0;
+} /* ScanDir */
+
+/**
+ * \brief Adds the temperature inputs of one hwmon chip, if it is one the monitor watches.
+ *
+ * \param chip The chip's directory, e.g. /sys/class/hwmon/hwmon2
+ */
+static void AddHwmonChip(char *chip){
+    char dir[BUFLEN],path[BUFLEN],name[SENSOR_NAME],label[SENSOR_NAME];
+    struct dirent **list;
+    int i,k,n,idx,end,kind;
+
+    /* older kernels keep the attributes under device/ */
+    snprintf(dir, BUFLEN, "%s", chip);
+    snprintf(path, BUFLEN, "%s/name", dir);
+    if(!ReadText(path, name, SENSOR_NAME)){
+        snprintf(dir, BUFLEN, "%s/device", chip);
+        snprintf(path, BUFLEN, "%s/name", dir);
+        if(!ReadText(path, name, SENSOR_NAME)){
+            return;
         }
-        // look for thermal sensors on Intel cores -- old style
-        // these are under /sys/devices/platform/coretemp.*/temp1_input
-        for(core = 0; core < MAX_HARDWARE_SENSORS; core++){
-            for(sen = 0; sen < 5; sen++){
-                snprintf(filename, BUFLEN, "/sys/devices/platform/coretemp.%d/temp%1d_input", core,sen);
-                fd = open(filename, 0, O_RDONLY);
-                if(fd != -1){
-                    CoreTemp[nTemps++] = fd;
-                    FILES_OPENED++;
-                }
+    }
+    for(k = 0; HwmonChips[k].name != NULL; k++){
+        if(strcmp(name, HwmonChips[k].name) == 0){
+            break;
+        }
+    }
+    if(HwmonChips[k].name == NULL){
+        return;
+    }
+    n = ScanDir(dir, "temp", &list);
+    for(i = 0; i < n; i++){
+        end = 0;
+        if((sscanf(list[i]->d_name, "temp%d_input%n", &idx, &end) == 1) && (list[i]->d_name[end] == '\0') && (end > 0)){
+            snprintf(path, BUFLEN, "%s/temp%d_label", dir, idx);
+            if(!ReadText(path, label, SENSOR_NAME)){
+                snprintf(label, SENSOR_NAME, "temp%d", idx);
             }
+            kind = HwmonChips[k].kind;
+            if((kind == SENSOR_CORE) && (strncmp(label, "Package", 7) == 0)){
+                kind = SENSOR_SOCKET;
+            }
+            snprintf(path, BUFLEN, "%s/%s", dir, list[i]->d_name);
+            AddSensor(path, name, label, kind);
         }
-        // look for thermal sensors on AMD cores
-        // these are under /sys/devices/pci0000:00/0000:00:*.*/temp1_input
-        for(bus = 0; bus < MAX_BUS; bus++){
-            for(id = 0; id < MAX_ID; id++){
-                for(sen = 0; sen < 5; sen++){
-                    snprintf(filename, BUFLEN, "/sys/devices/pci0000:00/0000:00:%2x.%1x/temp%1d_input",bus,id,sen);
-                    fd = open(filename, 0, O_RDONLY);
-                    if(fd != -1){
-                        CoreTemp[nTemps++] = fd;
-                        FILES_OPENED++;
+        free(list[i]);
+    }
+    if(n > 0){
+        free(list);
+    }
+} /* AddHwmonChip */
+
+/**
+ * \brief Finds the node's temperature sensors, once.
+ */
+static void FindTemperatureSensors(){
+    char path[BUFLEN],name[SENSOR_NAME];
+    struct dirent **list;
+    int i,k,n,n_before;
+
+    nTemps = 0;
+    if(gethostname(HostName, HOST_NAME) != 0){
+        snprintf(HostName, HOST_NAME, "rank%d", MyRank);
+    }
+    HostName[HOST_NAME - 1] = '\0';
+    n = ScanDir(HWMON_ROOT, "hwmon", &list);
+    for(i = 0; i < n; i++){
+        snprintf(path, BUFLEN, "%s/%s", HWMON_ROOT, list[i]->d_name);
+        AddHwmonChip(path);
+        free(list[i]);
+    }
+    if(n > 0){
+        free(list);
+    }
+    for(i = 0; i < nTemps; i++){
+        if((Sensors[i].kind == SENSOR_SOCKET) || (Sensors[i].kind == SENSOR_CORE)){
+            nCpuTemps++;
+        }
+    }
+    // no CPU chips, try the processor thermal zones
+    if(nCpuTemps == 0){
+        n = ScanDir(THERMAL_ROOT, "thermal_zone", &list);
+        for(i = 0; i < n; i++){
+            snprintf(path, BUFLEN, "%s/%s/type", THERMAL_ROOT, list[i]->d_name);
+            if(ReadText(path, name, SENSOR_NAME)){
+                for(k = 0; ThermalZones[k].type != NULL; k++){
+                    if(strncmp(name, ThermalZones[k].type, strlen(ThermalZones[k].type)) == 0){
+                        break;
                     }
                 }
+                if(ThermalZones[k].type != NULL){
+                    snprintf(path, BUFLEN, "%s/%s/temp", THERMAL_ROOT, list[i]->d_name);
+                    n_before = nTemps;
+                    AddSensor(path, name, list[i]->d_name, ThermalZones[k].kind);
+                    nCpuTemps += nTemps - n_before;
+                }
             }
+            free(list[i]);
         }
-// #endif // USE_PROC_TEMP
-        // if NOTHING else is available, try falling back to the old /proc interface for older kernels
-        if(FILES_OPENED == 0){
-            ProcSensor = open("/proc/acpi/thermal_zone/THM/temperature", 0, O_RDONLY);
-            if(ProcSensor != -1){
-                ProcTemp = 1;
-            }
+        if(n > 0){
+            free(list);
+        }
+    }
+    // if NOTHING else is available, try falling back to the old /proc interface for older kernels
+    if(nCpuTemps == 0){
+        ProcSensor = open("/proc/acpi/thermal_zone/THM/temperature", O_RDONLY);
+        if(ProcSensor != -1){
+            ProcTemp = 1;
         }
     }
-    if(FILES_OPENED > 0){
-        for(sensor = 0; sensor < FILES_OPENED; sensor++){
-            lseek(CoreTemp[sensor],0,SEEK_SET);
-            read(CoreTemp[sensor],rdbuf,BUFLEN);
-            t = ((double)atoi(rdbuf)) / 1000.0;
-            T->min = (T->min < t) ? T->min : t;
-            T->max = (T->max > t) ? T->max : t;
-            T->avg += t;
+    EmitLog(MyRank, MONITOR_THREAD, "Temperature sensors found:", nTemps, PRINT_RARELY);
+    if(PRINT_RARELY <= verbose_flag){
+        char text[BUFLEN];
+        for(i = 0; i < nTemps; i++){
+            snprintf(text, BUFLEN, "Temperature sensor (%s) %s %s, number", KindNames[Sensors[i].kind], Sensors[i].name, Sensors[i].label);
+            EmitLog(MyRank, MONITOR_THREAD, text, i, PRINT_RARELY);
         }
-        T->avg = (T->avg) / FILES_OPENED;
+    }
+} /* FindTemperatureSensors */
+
+/**
+ * \brief Checks the temperatures of the nodes in the computer
+ *
+ * \param T Holds the data for the temperatures on a node: min, max, and avg
+ */
+void CheckTemperatureRange(TemperatureRange *T){
+    float t;
+    int sensor,count;
+    ssize_t len;
+    T->max = 0.0;
+    T->avg = 0.0;
+    T->min = 1000.0;
+    if(nTemps == NOT_YET){
+        FindTemperatureSensors();
+    }
+    for(sensor = 0, count = 0; sensor < nTemps; sensor++){
+        len = pread(Sensors[sensor].fd,SensorBuf,BUFLEN - 1,0);
+        if(len <= 0){
+            Sensors[sensor].temp = ABSOLUTE_ZERO - 1;
+            continue;
+        }
+        SensorBuf[len] = '\0';
+        t = ((double)atoi(SensorBuf)) / 1000.0;
+        Sensors[sensor].temp = t;
+        if((Sensors[sensor].kind == SENSOR_DIMM) || (Sensors[sensor].kind == SENSOR_GPU)){
+            continue;
+        }
+        T->min = (T->min < t) ? T->min : t;
+        T->max = (T->max > t) ? T->max : t;
+        T->avg += t;
+        count++;
+    }
+    if(count > 0){
+        T->avg = (T->avg) / count;
     } else if(ProcTemp == 1){
-        lseek(ProcSensor,0,SEEK_SET);
-        read(ProcSensor,rdbuf,BUFLEN);
-        t = ((double)atof(rdbuf + 13));
+        len = pread(ProcSensor,SensorBuf,BUFLEN - 1,0);
+        SensorBuf[(len > 0) ? len : 0] = '\0';
+        t = (len > 13) ? ((double)atof(SensorBuf + 13)) : 0.0;
         T->min = t;
         T->max = t;
         T->avg = t;
@@ -130,20 +350,425 @@ void CheckTemperatureRange(TemperatureRange *T){
     }
 } /* CheckTemperatureRange */
 
+
+/**
+ * \brief Records a reading in a summary spot, if it is hotter (or cooler) than the one already there.
+ *
+ * \param spot The spot.
+ * \param t The reading.
+ * \param sensor The sensor's number on this rank.
+ * \param chip Chip or zone type.
+ * \param label The sensor's label.
+ * \param hotter 1 to keep the hottest reading, 0 to keep the coolest.
+ */
+static void TempSpotUpdate(TempSpot *spot, float t, int sensor, char *chip, char *label, int hotter){
+    if((spot->rank < 0) || (hotter && (t > spot->temp)) || (!hotter && (t < spot->temp))){
+        spot->temp = t;
+        spot->rank = MyRank;
+        spot->sensor = sensor;
+        snprintf(spot->where, TEMP_WHERE, "%s %s %s", HostName, chip, label);
+    }
+} /* TempSpotUpdate */
+
+/**
+ * \brief Summarizes the node's temperature map from the monitor's last readings, for reduceTemps.
+ *
+ * \param S Receives the coolest CPU sensor, the hottest sensor of each kind, the sum and number of CPU readings,
+ * and a histogram of every reading.
+ */
+void BuildTempSummary(TempSummary *S){
+    int i,k,bin;
+    float t;
+
+    memset(S, 0, sizeof(TempSummary));
+    S->coolest.rank = -1;
+    for(k = 0; k < SENSOR_KINDS; k++){
+        S->hottest[k].rank = -1;
+    }
+    for(i = 0; i <= nTemps; i++){
+        if(i < nTemps){
+            t = Sensors[i].temp;
+            k = Sensors[i].kind;
+            if(t < ABSOLUTE_ZERO){
+                continue;
+            }
+        } else if((ProcTemp == 1) && (local_temp.min <= local_temp.max)){
+            t = local_temp.max;         /* the /proc/acpi fallback has a single reading */
+            k = SENSOR_OTHER;
+        } else {
+            break;
+        }
+        TempSpotUpdate(&(S->hottest[k]), t, i, (i < nTemps) ? Sensors[i].name : "acpi", (i < nTemps) ? Sensors[i].label : "THM", 1);
+        if((k != SENSOR_DIMM) && (k != SENSOR_GPU)){
+            TempSpotUpdate(&(S->coolest), t, i, (i < nTemps) ? Sensors[i].name : "acpi", (i < nTemps) ? Sensors[i].label : "THM", 0);
+            S->sum += t;
+            S->count++;
+        }
+        bin = ((int)t - TEMP_BIN_LOW) / TEMP_BIN_WIDTH;
+        bin = (t < TEMP_BIN_LOW) ? 0 : ((bin >= TEMP_BINS) ? TEMP_BINS - 1 : bin);
+        S->hist[bin]++;
+    }
+} /* BuildTempSummary */
+
+/**
+ * \brief Picks the hotter (or cooler) of two spots, ties going to the lower rank so that the result does not depend on the order of the reduction.
+ *
+ * \param in A spot from another rank.
+ * \param inout The spot to keep the result in.
+ * \param hotter 1 to keep the hotter spot, 0 the cooler one.
+ */
+static void TempSpotMerge(TempSpot *in, TempSpot *inout, int hotter){
+    if(in->rank < 0){
+        return;
+    }
+    if((inout->rank < 0) || (hotter && (in->temp > inout->temp)) || (!hotter && (in->temp < inout->temp))
+       || ((in->temp == inout->temp) && (in->rank < inout->rank))){
+        *inout = *in;
+    }
+} /* TempSpotMerge */
+
+/**
+ * \brief Combines two temperature summaries, as the reduction operation of reduceTemps.
+ *
+ * \param in The summary of some ranks.
+ * \param inout The summary of other ranks, which receives the summary of both.
+ */
+void MergeTempSummary(TempSummary *in, TempSummary *inout){
+    int k;
+    TempSpotMerge(&(in->coolest), &(inout->coolest), 0);
+    for(k = 0; k < SENSOR_KINDS; k++){
+        TempSpotMerge(&(in->hottest[k]), &(inout->hottest[k]), 1);
+    }
+    inout->sum += in->sum;
+    inout->count += in->count;
+    for(k = 0; k < TEMP_BINS; k++){
+        inout->hist[k] += in->hist[k];
+    }
+} /* MergeTempSummary */
+
+/**
+ * \brief Prints the temperature map summary of the whole allocation, on ROOT.
+ *
+ * \param S The summary reduced over all ranks.
+ */
+void ReportTempSummary(TempSummary *S){
+    char text[BUFLEN];
+    int k,len;
+    TempSpot *hot = NULL;
+
+    if(S->count == 0){
+        EmitLog(MyRank, SCHEDULER_THREAD, "No valid temperature monitoring interface on this platform.", -1, PRINT_ALWAYS);
+        return;
+    }
+    for(k = 0; k < SENSOR_KINDS; k++){
+        if((k == SENSOR_DIMM) || (k == SENSOR_GPU) || (S->hottest[k].rank < 0)){
+            continue;
+        }
+        if((hot == NULL) || (S->hottest[k].temp > hot->temp)){
+            hot = &(S->hottest[k]);
+        }
+    }
+    EmitLog3f(MyRank, SCHEDULER_THREAD, "The minimum/average/maximum temperature across all cores (C) ", S->coolest.temp, S->sum / S->count, hot->temp, PRINT_ALWAYS);
+    snprintf(text, BUFLEN, "Hottest CPU sensor: %.1f C on rank %d, %s", hot->temp, hot->rank, hot->where);
+    EmitLog(MyRank, SCHEDULER_THREAD, text, -1, PRINT_ALWAYS);
+    snprintf(text, BUFLEN, "Coolest CPU sensor: %.1f C on rank %d, %s", S->coolest.temp, S->coolest.rank, S->coolest.where);
+    EmitLog(MyRank, SCHEDULER_THREAD, text, -1, PRINT_SOME);
+    for(k = 0; k < SENSOR_KINDS; k++){
+        if(S->hottest[k].rank >= 0){
+            snprintf(text, BUFLEN, "Hottest %s sensor: %.1f C on rank %d, %s", KindNames[k], S->hottest[k].temp, S->hottest[k].rank, S->hottest[k].where);
+            EmitLog(MyRank, SCHEDULER_THREAD, text, -1, PRINT_SOME);
+        }
+    }
+    len = snprintf(text, BUFLEN, "Sensors per %d C from %d C:", TEMP_BIN_WIDTH, TEMP_BIN_LOW);
+    for(k = 0; k < TEMP_BINS; k++){
+        len += snprintf(text + len, BUFLEN - len, " %d", S->hist[k]);
+    }
+    EmitLog(MyRank, SCHEDULER_THREAD, text, -1, PRINT_SOME);
+} /* ReportTempSummary */
+
+/*******************************************************************************
+* Power is read from the RAPL energy counters the Linux powercap interface
+* exposes under /sys/class/powercap: a zone intel-rapl:N for each package,
+* with subzones intel-rapl:N:M for the domains inside it (core, uncore, dram).
+* Each zone names its domain in its name file. The counters are in
+* microjoules and wrap around at max_energy_range_uj.
+*******************************************************************************/
+
+#define MAX_RAPL         0x0020
+#define MAX_RAPL_SUB     0x0008
+int RaplFd[MAX_RAPL];
+int RaplDomain[MAX_RAPL];
+uint64_t RaplRange[MAX_RAPL];
+uint64_t RaplLast[MAX_RAPL];
+int nRapl = NOT_YET;
+struct timeval RaplTime;
+pthread_mutex_t RaplLock = PTHREAD_MUTEX_INITIALIZER;
+static float HottestTemp = ABSOLUTE_ZERO - 1;   /* local_temp.max once a reading is complete, see TemperatureHottest */
+
+/**
+ * \brief Reads one of the RAPL files as an integer.
+ *
+ * \param fd The open file.
+ * \param value Set to the number read.
+ * \returns 1 if a number was read, 0 otherwise.
+ */
+static int ReadRapl(int fd, uint64_t *value){
+    char rdbuf[BUFLEN];
+    ssize_t len;
+    len = pread(fd,rdbuf,BUFLEN - 1,0);     /* plans read the counters too, see PowerEnergy */
+    if(len <= 0){
+        return 0;
+    }
+    rdbuf[len] = '\0';
+    *value = strtoull(rdbuf, NULL, 10);
+    return 1;
+} /* ReadRapl */
+
+/**
+ * \brief Opens the energy counter of a powercap zone, if its domain is one we sample.
+ *
+ * \param zone The zone's directory, e.g. /sys/class/powercap/intel-rapl:0:1
+ * \returns 1 if the zone exists, 0 otherwise.
+ */
+static int OpenRaplZone(char *zone){
+    char filename[BUFLEN],rdbuf[BUFLEN];
+    int fd,domain;
+    ssize_t len;
+    uint64_t range;
+
+    snprintf(filename, BUFLEN, "%s/name", zone);
+    fd = open(filename, O_RDONLY);
+    if(fd == -1){
+        return 0;
+    }
+    len = read(fd,rdbuf,BUFLEN - 1);
+    close(fd);
+    rdbuf[(len > 0) ? len : 0] = '\0';
+    if(strncmp(rdbuf, "package", 7) == 0){
+        domain = POWER_PACKAGE;
+    } else if(strncmp(rdbuf, "core", 4) == 0){
+        domain = POWER_CORE;
+    } else if(strncmp(rdbuf, "dram", 4) == 0){
+        domain = POWER_DRAM;
+    } else {
+        return 1;       /* uncore, psys, ... */
+    }
+    if(nRapl >= MAX_RAPL){
+        return 1;
+    }
+    snprintf(filename, BUFLEN, "%s/max_energy_range_uj", zone);
+    fd = open(filename, O_RDONLY);
+    if(fd == -1){
+        return 1;
+    }
+    if(!ReadRapl(fd, &range)){
+        range = 0;
+    }
+    close(fd);
+    snprintf(filename, BUFLEN, "%s/energy_uj", zone);
+    fd = open(filename, O_RDONLY);
+    if(fd == -1){
+        return 1;       /* the counters are root only on recent kernels */
+    }
+    if(!ReadRapl(fd, &RaplLast[nRapl])){
+        close(fd);
+        return 1;
+    }
+    RaplFd[nRapl] = fd;
+    RaplDomain[nRapl] = domain;
+    RaplRange[nRapl] = range;
+    nRapl++;
+    return 1;
+} /* OpenRaplZone */
+
+/**
+ * \brief Works out how much a counter has counted since the last sample.
+ *
+ * \param i Index of the counter.
+ * \param now The counter's current value.
+ * \returns Joules.
+ */
+static double RaplDelta(int i, uint64_t now){
+    if(now >= RaplLast[i]){
+        return (now - RaplLast[i]) * 1e-6;
+    }
+    return (now + RaplRange[i] - RaplLast[i]) * 1e-6;
+} /* RaplDelta */
+
+/**
+ * \brief Samples the RAPL energy counters of the node and works out the mean power of each domain since the last call.
+ * The first call finds the counters, and only sets up the baseline.
+ *
+ * \param P Holds the power data for the node. Domains without counters have found set to 0 and read 0 W.
+ */
+void CheckPowerRange(PowerRange *P){
+    char zone[BUFLEN];
+    int pkg,sub,i,busy;
+    uint64_t now;
+    double delta[POWER_DOMAINS],dt,share;
+    struct timeval t;
+
+    pthread_mutex_lock(&RaplLock);
+    if(nRapl == NOT_YET){
+        nRapl = 0;
+        for(pkg = 0; pkg < MAX_RAPL; pkg++){
+            snprintf(zone, BUFLEN, "/sys/class/powercap/intel-rapl:%d", pkg);
+            if(!OpenRaplZone(zone)){
+                break;
+            }
+            for(sub = 0; sub < MAX_RAPL_SUB; sub++){
+                snprintf(zone, BUFLEN, "/sys/class/powercap/intel-rapl:%d:%d", pkg, sub);
+                if(!OpenRaplZone(zone)){
+                    break;
+                }
+            }
+        }
+        for(i = 0; i < POWER_DOMAINS; i++){
+            P->found[i] = 0;
+            P->joules[i] = 0.0;
+            P->watts[i] = 0.0;
+        }
+        for(i = 0; i < nRapl; i++){
+            P->found[RaplDomain[i]]++;
+        }
+        P->share = 0.0;
+        gettimeofday(&RaplTime, NULL);
+        pthread_mutex_unlock(&RaplLock);
+        return;
+    }
+    if(nRapl == 0){
+        pthread_mutex_unlock(&RaplLock);
+        return;
+    }
+
+    for(i = 0; i < POWER_DOMAINS; i++){
+        delta[i] = 0.0;
+    }
+    for(i = 0; i < nRapl; i++){
+        if(ReadRapl(RaplFd[i], &now)){
+            delta[RaplDomain[i]] += RaplDelta(i, now);
+            RaplLast[i] = now;
+        }
+    }
+    gettimeofday(&t, NULL);
+    dt = (t.tv_sec - RaplTime.tv_sec) + (t.tv_usec - RaplTime.tv_usec) * 1e-6;
+    RaplTime = t;
+    for(i = 0; i < POWER_DOMAINS; i++){
+        P->joules[i] += delta[i];
+        P->watts[i] = (dt > 0.0) ? delta[i] / dt : 0.0;
+    }
+
+    /* the core domain is part of the package, DRAM is not */
+    busy = __atomic_load_n(&busy_workers, __ATOMIC_RELAXED);
+    if(busy > 0){
+        share = P->share + (delta[POWER_PACKAGE] + delta[POWER_DRAM]) / busy;
+        __atomic_store(&(P->share), &share, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&RaplLock);
+} /* CheckPowerRange */
+
+/**
+ * \brief Reads the energy a domain has used up to now, for plans that need finer timing than the monitor interval.
+ *
+ * \param domain One of POWER_PACKAGE, POWER_CORE or POWER_DRAM.
+ * \returns Joules counted since the monitor started, 0 if the node has no counters for the domain.
+ */
+double PowerEnergy(int domain){
+    int i;
+    uint64_t now;
+    double joules;
+
+    pthread_mutex_lock(&RaplLock);
+    joules = local_power.joules[domain];
+    for(i = 0; i < nRapl; i++){
+        if((RaplDomain[i] == domain) && ReadRapl(RaplFd[i], &now)){
+            joules += RaplDelta(i, now);
+        }
+    }
+    pthread_mutex_unlock(&RaplLock);
+    return joules;
+} /* PowerEnergy */
+
+/**
+ * \brief Gives the energy attributed to each busy worker so far.
+ * Every monitor interval, the node's package and DRAM energy is divided evenly among the workers running
+ * a plan other than SLEEP, so the increase of this value over the life of a plan is that plan's share.
+ *
+ * \returns Joules, 0 if the node has no readable energy counters.
+ */
+double PowerShare(){
+    double share;
+    __atomic_load(&(local_power.share), &share, __ATOMIC_RELAXED);
+    return share;
+}
+
+/**
+ * \brief Tells whether the monitor found energy counters for a domain, for plans running on the workers.
+ *
+ * \param domain One of POWER_PACKAGE, POWER_CORE or POWER_DRAM.
+ * \returns The number of counters read for the domain, 0 if there are none or the monitor has not looked yet.
+ */
+int PowerFound(int domain){
+    int found;
+    pthread_mutex_lock(&RaplLock);
+    found = local_power.found[domain];
+    pthread_mutex_unlock(&RaplLock);
+    return found;
+}
+
+/**
+ * \brief Gives the hottest core temperature of the monitor's last reading, for plans running on the workers.
+ * The monitor rewrites local_temp while it reads the sensors, so it publishes the result here once it is done.
+ *
+ * \returns Degrees C, below ABSOLUTE_ZERO if no temperature has been read.
+ */
+float TemperatureHottest(){
+    float t;
+    __atomic_load(&HottestTemp, &t, __ATOMIC_RELAXED);
+    return t;
+}
+
+/**
+ * \brief Publishes the hottest temperature of a complete reading for TemperatureHottest.
+ *
+ * \param T The reading.
+ */
+static void PublishHottest(TemperatureRange *T){
+    float t = (T->min <= T->max) ? T->max : ABSOLUTE_ZERO - 1;
+    __atomic_store(&HottestTemp, &t, __ATOMIC_RELAXED);
+}
+
 /**
  * \brief The monitor thread sleeps in a loop periodically waking up to update the thermal state of it's node.
- * If there's a problem, it can call the emergency stop routine.
+ * If there's a problem, it can call the emergency stop routine. When MPI allows every thread to call it, the
+ * monitor also runs the status reductions while it waits (see comm_status_serve), and so keeps running even
+ * without sensors to read.
  */
 void *MonitorThread(void *vptr){
+    int sensing = 1;
     CheckTemperatureRange(&local_temp);
-    if(local_temp.min > local_temp.max){
-        EmitLog(MyRank, MONITOR_THREAD, "Cannot access core temperatures. Monitor exiting.", -1, PRINT_RARELY);
-        pthread_exit((void *)NULL);
+    PublishHottest(&local_temp);
+    CheckPowerRange(&local_power);
+    if(nRapl > 0){
+        EmitLog(MyRank, MONITOR_THREAD, "RAPL energy counters found:", nRapl, PRINT_RARELY);
+    }
+    if((local_temp.min > local_temp.max) && (nRapl == 0)){
+        if(!comm_thread_multiple()){
+            EmitLog(MyRank, MONITOR_THREAD, "Cannot access core temperatures or energy counters. Monitor exiting.", -1, PRINT_RARELY);
+            pthread_exit((void *)NULL);
+        }
+        EmitLog(MyRank, MONITOR_THREAD, "Cannot access core temperatures or energy counters. Monitor only reduces the status.", -1, PRINT_RARELY);
+        sensing = 0;
     }
     for(;; ){     /* monitor loop */
-        sleep(monitor_frequency);
+        comm_status_serve(monitor_frequency);
+        if(!sensing){
+            continue;
+        }
         /* various system state monitiors */
         CheckTemperatureRange(&local_temp);
+        PublishHottest(&local_temp);
+        CheckPowerRange(&local_power);
         if(local_temp.max >= thermal_panic){
             EmergencyStop(1);
         }
@@ -156,7 +781,6 @@ void *MonitorThread(void *vptr){
  */
 void StartMonitorThread(){
     /* construct monitor thread's control structure and launch */
-    pthread_rwlock_init(&(MonitorHandle.Lock),0);
     MonitorHandle.Num = -1;
     MonitorHandle.Plan = NULL;
     pthread_create(&(MonitorHandle.ID), NULL, MonitorThread, &(MonitorHandle));
@@ -167,28 +791,44 @@ void StartMonitorThread(){
 }
 
 /**
- * \brief reduceTemps() uses a reduction to compute the min/avg/max of core temperatures observed on all nodes.
- * Unfortunately, the use of MPI and issues with some MPI libraries not playing
- * well with pthreads means that this is called by the scheduler thread.
+ * \brief reduceTemps() uses a reduction to compute the min/avg/max of core temperatures observed on all nodes,
+ * and the node power and total power of each RAPL domain.
+ * This is called by the scheduler thread, which waits for the reduction; unless MPI grants MPI_THREAD_MULTIPLE
+ * (see comm_status_serve), it also runs it, as some MPI libraries do not play well with pthreads.
  */
 void reduceTemps(){
+    reduceStatus(NULL);
+    comm_status_progress(1);
+}
+
+/**
+ * \brief reduceStatus() reports the periodic status of the run: the temperatures and power as reduceTemps() does,
+ * the workers' progress and, given the error counters, the errors flagged on all nodes. Everything is packed into
+ * one record per rank, so this takes a single reduction. With MPI the reduction is only started here; the
+ * scheduler completes it with comm_status_progress(), or the monitor thread with comm_status_serve().
+ * \param local_flag The node's error counters, which are first brought up to date from the workers, or NULL.
+ */
+void reduceStatus(int **local_flag){
 /* uses either of two communication libraries, functions located in comm.c */
+    if(local_flag != NULL){
+        collectLocalFlags(local_flag);
+    }
     #ifdef HAVE_SHMEM
-    reduceTemps_SHMEM();
+    reduceStatus_SHMEM(local_flag);
     #else
-    reduceTemps_MPI();
+    reduceStatus_MPI(local_flag);
     #endif
 }
 
 /**
  * \brief If the monitor thread is running, it can issue an emergency stop, if the system state exceeds operating parameters.
  * We aren't worrying about graceful shutdown here...
- * The intent is to kill everything immediately to preserve the system
+ * The intent is to kill everything immediately to preserve the system. The workers are not stopped first: their
+ * mailboxes belong to the scheduler, and a worker blocked in a COMM plan might never be joined.
  *
  * \param errorcode Tells the user why SystemBurn is exiting unexpectedly.
  */
 void EmergencyStop(int errorcode){
-    StopWorkerThreads();
     comm_abort(errorcode);
     exit(errorcode);
     return;     /* not bloody likely :-) */
@@ -139,6 +139,11 @@ char *perf_data_unit [NUM_PLANS][NUM_TIMERS];
  * \brief A locking data structure that allows multiple worker threads to update the table without creating conflicts.
  */
 pthread_rwlock_t perf_data_lock [NUM_PLANS];
+/**
+ * \brief Stores the energy attributed to each plan (joules) and the worker seconds it was attributed over.
+ * \sa PowerShare
+ */
+double           perf_data_energy [NUM_PLANS][2];
 
 #ifdef HAVE_PAPI
 /* PAPI data structure */
@@ -187,6 +192,8 @@ void perf_table_init(){
         for(j = 0; j < NUM_TIMERS; j++){
             perf_data_unit[i][j] = plan_list[i]->perf_units[j];
         }
+        perf_data_energy[i][0] = 0.0;
+        perf_data_energy[i][1] = 0.0;
         #ifdef HAVE_PAPI
         /* Initialize PAPI data structure */
         for(j = 0; j < TOTAL_PAPI_EVENTS; j++){
@@ -207,8 +214,8 @@ void perf_table_init(){
 /* Need PAPI here, to diplay - keep it simple stupid */
 void perf_table_print(int scope_flag, int print_priority){
     if(print_priority <= verbose_flag){
-        int i, j, k;
-        char line[150], temp[128], prefixes[] = " kMGTPE";
+        int i, j, k, valid;
+        char line[NUM_TIMERS * 48], temp[128], prefixes[] = " kMGTPE";
         double timer, opcount, max, min;
 
         #ifdef HAVE_PAPI
@@ -224,19 +231,19 @@ void perf_table_print(int scope_flag, int print_priority){
             printf("\nPERF:\tAll Node Performance Summary:\n");
             printf("PERF:\t%10s", " ");
             for(i = 0; i < NUM_TIMERS; i++){
-                printf("%12c Timer %-2d %12c", ' ', i, ' ');
+                printf("%14c Timer %-2d %14c", ' ', i, ' ');
             }
             printf("\n");
             printf("PERF:\t %-8s ", "Plan");
             for(i = 0; i < NUM_TIMERS; i++){
-                printf("%6s / %6s / %6s %-9s", "Min ", "Ave ", "Max ", "Units");
+                printf("%6s / %6s / %6s %-13s", "Min ", "Ave ", "Max ", "Units");
             }
             printf("\n");
         }
 
         // Print the performance data table.
         for(i = 0; i < NUM_PLANS; i++){
-            k = -1;
+            valid = 0;
             line[0] = '\0';
             for(j = 0; j < NUM_TIMERS; j++){
                 if(scope_flag == LOCAL){
@@ -253,7 +260,7 @@ void perf_table_print(int scope_flag, int print_priority){
                     pthread_rwlock_unlock(&perf_data_lock[i]);
                 }
 
-                // If we have a valid time, print something, otherwise, skip.
+                // If we have a valid time, print something, otherwise pad the column so the later ones stay under their headers.
                 if(timer > 0.0){
                     k = 0;
                     // Get the number of seconds recorded.
@@ -267,19 +274,32 @@ void perf_table_print(int scope_flag, int print_priority){
                         }
                     }
                     if(scope_flag == LOCAL){
-                        snprintf(temp, 127, "%-6.2f %c%-8s", perf, prefixes[k], perf_data_unit[i][j]);
+                        snprintf(temp, 127, "%-6.2f %c%-12s", perf, prefixes[k], perf_data_unit[i][j]);
                     } else {
                         max = max / pow(1.0e3, k);
                         min = min / pow(1.0e3, k);
-                        snprintf(temp, 127, "%6.2f / %6.2f / %6.2f %c%-8s", min, perf, max, prefixes[k], perf_data_unit[i][j]);
+                        snprintf(temp, 127, "%6.2f / %6.2f / %6.2f %c%-12s", min, perf, max, prefixes[k], perf_data_unit[i][j]);
                     }
-                    strncat(line, temp, 150 - strlen(line) - 1);
+                    strncat(line, temp, sizeof(line) - strlen(line) - 1);
+                    valid = 1;
+                } else {
+                    snprintf(temp, 127, "%*s", (scope_flag == LOCAL) ? 20 : 38, "");
+                    strncat(line, temp, sizeof(line) - strlen(line) - 1);
                 }
             }
-            if(k >= 0){
+            if(valid){
                 printf("PERF:\t %-8s %s\n", plan_list[i]->name, line);
             }
 
+            /* energy attributed from the RAPL counters, if the nodes had any */
+            pthread_rwlock_rdlock(&perf_data_lock[i]);
+            timer = perf_data_energy[i][1];
+            opcount = perf_data_energy[i][0];
+            pthread_rwlock_unlock(&perf_data_lock[i]);
+            if((timer > 0.0) && (opcount > 0.0)){
+                printf("ENERGY:\t %-8s %-10.1f J over %-10.1f worker seconds, %-6.2f W per worker\n", plan_list[i]->name, opcount, timer, opcount / timer);
+            }
+
             #ifdef HAVE_PAPI
             /* Simple PAPI results print - add to main print loop */
             for(j = 0; j < TOTAL_PAPI_EVENTS; j++){
@@ -312,8 +332,10 @@ void perf_table_print(int scope_flag, int print_priority){
 void perf_table_reduce(){
     #ifdef HAVE_SHMEM
     comm_table_reduce_SHMEM(perf_data_dbl, NUM_PLANS, 2 * NUM_TIMERS, REDUCE_SUM);
+    comm_table_reduce_SHMEM(perf_data_energy, NUM_PLANS, 2, REDUCE_SUM);
     #else // MPI
     comm_table_reduce_MPI(perf_data_dbl, NUM_PLANS, 2 * NUM_TIMERS, REDUCE_SUM);
+    comm_table_reduce_MPI(perf_data_energy, NUM_PLANS, 2, REDUCE_SUM);
     #endif
 }
 
@@ -391,9 +413,9 @@ void perf_table_minmax_populate(void *table, int nrows, int ncols){
  */
 void perf_table_minmax_print(void *table, int nrows, int ncols, int is_minimum){
     char prefixes[] = " kMGTPE";
-    char  line[120], temp[30], label[4];
+    char  line[NUM_TIMERS * 40], temp[40], label[4];
     double *ptable = (double *)table;
-    int i, j, k;
+    int i, j, k, valid;
 
     if(is_minimum){
         strcpy(label, "Min");
@@ -403,21 +425,24 @@ void perf_table_minmax_print(void *table, int nrows, int ncols, int is_minimum){
 
     printf("  %-10s %-s %-s\n", "Plan", label, "Performance");
     for(i = 0; i < nrows; i++){
-        k = -1;
+        valid = 0;
         line[0] = '\0';
         for(j = 0; j < ncols; j++){
             double perf = ptable[i * ncols + j];
             if(perf > 0.0){
+                valid = 1;
                 k = 0;
                 while(perf >= 1.0e3 && k < strlen(prefixes)){
                     perf /= 1.0e3;
                     k++;
                 }
-                snprintf(temp, 30, "%-9.4f %c%-10s", perf, prefixes[k], perf_data_unit[i][j]);
-                strncat(line, temp, 120 - strlen(line) - 1);
+                snprintf(temp, sizeof(temp), "%-9.4f %c%-12s", perf, prefixes[k], perf_data_unit[i][j]);
+            } else {
+                snprintf(temp, sizeof(temp), "%*s", 23, "");      // keep the later columns in place
             }
+            strncat(line, temp, sizeof(line) - strlen(line) - 1);
         }
-        if(k >= 0){
+        if(valid){
             printf("  %-10s %s\n", plan_list[i]->name, line);
         }
     }
@@ -437,7 +462,8 @@ void perf_table_update(PerfTimers *timers, uint64_t *opcounts, int plan_id){
 
     for(i = 0; i < NUM_TIMERS; i++){
         perf_count[2 * i] = perftimer_getcount(timers, i);
-        perf_count[2 * i + 1] = opcounts[i];
+        /* most plans only fill in the timers they use */
+        perf_count[2 * i + 1] = (perf_count[2 * i] > 0) ? opcounts[i] : 0;
     }
     pthread_rwlock_wrlock(&perf_data_lock[plan_id]);
     for(i = 0; i < 2 * NUM_TIMERS; i++){
@@ -448,6 +474,20 @@ void perf_table_update(PerfTimers *timers, uint64_t *opcounts, int plan_id){
     pthread_rwlock_unlock(&perf_data_lock[plan_id]);
 }
 
+/**
+ * \brief Adds the energy attributed to one run of a plan to the node's table.
+ *
+ * \param [in] plan_id Identifies the plan whose table entry should be updated.
+ * \param [in] joules The plan's share of the node's energy, see PowerShare.
+ * \param [in] seconds How long the plan ran.
+ */
+void perf_table_energy(int plan_id, double joules, double seconds){
+    pthread_rwlock_wrlock(&perf_data_lock[plan_id]);
+    perf_data_energy[plan_id][0] += joules;
+    perf_data_energy[plan_id][1] += seconds;
+    pthread_rwlock_unlock(&perf_data_lock[plan_id]);
+}
+
 #ifdef HAVE_PAPI
 void PAPI_table_update(int plan_id, long long *results, long long *timers, int PAPI_num){
     int i;
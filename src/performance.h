@@ -42,6 +42,9 @@ typedef enum {
     TIMER0 = 0,
     TIMER1,
     TIMER2,
+    TIMER3,
+    TIMER4,
+    TIMER5,
     NUM_TIMERS      /**< The last element in the enum, evaluates to the total number of timers available to a plan. */
 } perf_time_index;
 
@@ -75,6 +78,7 @@ extern uint64_t         perf_data_int  [][2 * NUM_TIMERS];
 extern double           perf_data_dbl  [][2 * NUM_TIMERS];
 extern char *perf_data_unit [][NUM_TIMERS];
 extern pthread_rwlock_t perf_data_lock [];
+extern double           perf_data_energy [][2];
 
 #ifdef HAVE_PAPI
 /* PAPI specific functions and variables */
@@ -110,5 +114,6 @@ extern void perf_table_minreduce();
 extern void perf_table_minmax_populate(void *table, int nrows, int ncols);
 extern void perf_table_minmax_print(void *table, int nrows, int ncols, int is_minimum);
 extern void perf_table_update(PerfTimers *timers, uint64_t *opcounts, int plan_id);
+extern void perf_table_energy(int plan_id, double joules, double seconds);
 
 #endif /* __PERFORMANCE_H */
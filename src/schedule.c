@@ -25,6 +25,7 @@
 #include <load.h>
 #include <initialization.h>
 #include <planheaders.h>
+#include <comm.h>
 
 /****************************************
  *  Basic scheduling functions	*
@@ -44,11 +45,12 @@ int WorkerSched(Load *load){
     int one = 1;
     int ret = ERR_CLEAN;
     Plan *p = NULL;
+    PlanTeam *team = NULL;
+    int team_size;
     SubLoad *subload_ptr = NULL;
     LoadPlan *plan_ptr = NULL;
 
     #ifdef LINUX_PLACEMENT
-    int affin_err = 0;
     int cores = sysconf(_SC_NPROCESSORS_ONLN);
     cpu_set_t *cpuset;
     cpuset = (cpu_set_t *)malloc(load->num_cpusets * sizeof(cpu_set_t));
@@ -77,24 +79,41 @@ int WorkerSched(Load *load){
                 EmitLog(MyRank, SCHEDULER_THREAD, plan_name, plan_ptr->input_data->d[0], PRINT_OFTEN);
             }
 
+            /* Copies of one PLAN line form a team, sized by how many of them actually get a worker. */
+            if(plan_ptr->team_rank == 0){
+                team = NULL;
+                if(plan_ptr->team_size > 1){
+                    team_size = plan_ptr->team_size;
+                    if(team_size > num_workers - k){
+                        team_size = num_workers - k;
+                    }
+                    team = plan_team_new(team_size);
+                }
+            }
+
+            /* A COMM plan talks to the COMM plans of the same worker on the other ranks, over that worker's lane. */
+            if(plan_ptr->name == SBCOMM){
+                comm_lane_setup(k);
+            }
+
             /* Function switch */
-            p = (*plan_list[ plan_ptr->name ]->make)(plan_ptr->input_data);
+            p = plan_make(plan_ptr->name, plan_ptr->input_data);
             assert(p);
             if(p == NULL){
                 add_error(&WorkerHandle[k],SYSTEM,0);
+            } else {
+                p->page_req = plan_ptr->pages;
+                p->team = team;
+                p->team_rank = plan_ptr->team_rank;
+                p->worker = k;
             }
 //			p->name=plan_ptr->name;		// Moved into individual plan make functions
 
-            pthread_rwlock_wrlock(&(WorkerHandle[k].Lock));
-            WorkerHandle[k].Plan = p;
-            pthread_rwlock_unlock(&(WorkerHandle[k].Lock));
+            /* The worker applies the cpuset itself, before it initializes the plan. */
             #ifdef LINUX_PLACEMENT
-            if(cpuset != NULL){
-                affin_err = pthread_setaffinity_np((WorkerHandle[k].ID), sizeof(cpu_set_t), &(cpuset[i]));
-                if(affin_err != 0){
-                    add_error(&WorkerHandle[k],SYSTEM,2);
-                }
-            }
+            publishPlanOn(&(WorkerHandle[k]), p, (cpuset != NULL) ? &(cpuset[i]) : NULL);
+            #else
+            publishPlan(&(WorkerHandle[k]), p);
             #endif
             k++;
             plan_ptr = plan_ptr->next;
@@ -107,11 +126,9 @@ int WorkerSched(Load *load){
         for(i = k; i < num_workers; i++){
             data pass[1];
             pass->i = &one;
-            p = (*plan_list[SLEEP]->make)(pass);
+            p = plan_make(SLEEP, pass);
 
-            pthread_rwlock_wrlock(&(WorkerHandle[i].Lock));
-            WorkerHandle[i].Plan = p;
-            pthread_rwlock_unlock(&(WorkerHandle[i].Lock));
+            publishPlan(&(WorkerHandle[i]), p);
         }
     }
 
@@ -45,8 +45,11 @@ int MyRank;
 ThreadHandle *WorkerHandle;
 ThreadHandle MonitorHandle;
 TemperatureRange local_temp;
+PowerRange local_power;
+int busy_workers;
 
 int comm_flag;
+char comm_options[ARRAY];
 int verbose_flag;
 int plancheck_flag;
 int planperf_flag = 1;
@@ -137,10 +140,13 @@ int main(int argc, char **argv, char **envp){
 
     /* Initialize the communication load if it is to be run */
     if(comm_flag != 0){
-        data pass;
-        pass.isize = 1;
-        pass.i = &comm_flag;
-        CommPlan = makeCommPlan(&pass);
+        LoadPlan comm_line;
+        char line[ARRAY + 16];
+        snprintf(line, sizeof(line), "PLAN 1 COMM %s", comm_options);        // -c takes the arguments of a COMM PLAN line
+        parseCommPlan(line, &comm_line);
+        comm_lane_setup(SCHEDULER_THREAD);
+        CommPlan = plan_make(SBCOMM, comm_line.input_data);
+        freePlan(&comm_line);
     } else {
         CommPlan = 0;
     }
@@ -149,7 +155,9 @@ int main(int argc, char **argv, char **envp){
     }
 
     /* Initialize the array of ThreadHandle structures for the workers. */
-    WorkerHandle = (ThreadHandle *)malloc(num_workers * sizeof(ThreadHandle));
+    if(posix_memalign((void **)&WorkerHandle, CACHE_LINE_SIZE, num_workers * sizeof(ThreadHandle)) != 0){
+        WorkerHandle = NULL;
+    }
     if(WorkerHandle == NULL){
         EmitLog(MyRank, SCHEDULER_THREAD, "Aborting run - Insufficient memory for the WorkerHandle struct", -1, PRINT_ALWAYS);
         comm_finalize();
@@ -222,21 +230,23 @@ int main(int argc, char **argv, char **envp){
 #define SB_CONTINUE      0x0
 #define SB_LAST_TRIP     0x1
 #define SB_DO_REDUCTIONS 0x2
-        if(MyRank == ROOT){                                             // ROOT notes when we start this load
-            gettimeofday(&StartTime, NULL);
+        gettimeofday(&StartTime, NULL);                                 // every rank paces its naps from here, ROOT's clock ends the load
+        if(MyRank == ROOT){
             last = StartTime.tv_sec;
         }
         do {            // DELAY WHILE LOAD RUNS: loop while the load executes until ROOT's clock says stop.  Sleep if CommPlan isn't valid.
             if((comm_flag != 0) && (CommPlan) && (CommPlan->fptr_execplan) && (CommPlan->vptr)){
                 iflag = (CommPlan->fptr_execplan)(CommPlan);                             // run an iteration of the comm plan if enabled
+                comm_funnel_poll();                                                     // workers' funnelled COMM plans only move when the scheduler does
             } else {
                 gettimeofday(&CurrentTime, NULL);
                 if(nap + CurrentTime.tv_sec < StartTime.tv_sec + load_data.runtime){
-                    sleep(nap);
-                } else {
-                    sleep((StartTime.tv_sec + load_data.runtime) - CurrentTime.tv_sec);
+                    comm_sleep(nap);
+                } else if(CurrentTime.tv_sec < StartTime.tv_sec + load_data.runtime){
+                    comm_sleep((StartTime.tv_sec + load_data.runtime) - CurrentTime.tv_sec);
                 }
             }
+            comm_status_progress(0);                                                    // move the last status reduction along
             if(MyRank == ROOT){
                 gettimeofday(&CurrentTime, NULL);
                 pflag = ((CurrentTime.tv_sec > last + monitor_output_frequency) << 1) | (CurrentTime.tv_sec < StartTime.tv_sec + load_data.runtime);
@@ -244,20 +254,20 @@ int main(int argc, char **argv, char **envp){
             comm_broadcast_int(&pflag);
             if(pflag & SB_DO_REDUCTIONS){
                 assert(errorFlags);
-                reduceFlags(errorFlags);
-                reduceTemps();
+                reduceStatus(errorFlags);
                 if(MyRank == ROOT){
                     last = CurrentTime.tv_sec;
                 }
             }
         } while(pflag & SB_LAST_TRIP);
+        comm_status_progress(1);
         // LOAD COMPLETE
         if(MyRank == ROOT){
             EmitLog(MyRank, SCHEDULER_THREAD, "Elapsed time for this load:", CurrentTime.tv_sec - StartTime.tv_sec, PRINT_ALWAYS);
         }
         freeLoad(&load_data);
     }
-    sleep(thermal_relaxation_time);
+    comm_sleep(thermal_relaxation_time);
     reduceTemps();
     StopWorkerThreads();                        // tell them all to finish
 
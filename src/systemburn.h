@@ -38,6 +38,8 @@
 #define PRINT_SOME                  2
 #define PRINT_RARELY                3
 
+#define CACHE_LINE_SIZE            64
+
 /* typedefs */
 
 /** \brief Temperature struct used by the monitor thread */
@@ -45,6 +47,54 @@ typedef struct {
     float min,max,avg;
 } TemperatureRange;
 
+/** \brief Kinds of temperature sensor the monitor thread maps */
+enum {
+    SENSOR_SOCKET,              /* package or die temperature                          */
+    SENSOR_CORE,                /* a single core                                       */
+    SENSOR_DIMM,                /* memory module (jc42, spd5118)                       */
+    SENSOR_GPU,                 /* amdgpu, nouveau, radeon                             */
+    SENSOR_OTHER,               /* thermal zones and /proc/acpi, taken as CPU readings */
+    SENSOR_KINDS
+};
+
+#define TEMP_BINS                  16   /* histogram bins of the temperature map             */
+#define TEMP_BIN_LOW               20   /* C, the first bin also counts anything colder      */
+#define TEMP_BIN_WIDTH              5   /* C, the last bin also counts anything hotter       */
+#define TEMP_WHERE                 80   /* room for "host chip label"                        */
+
+/** \brief One reading of the temperature map, and where it was taken */
+typedef struct {
+    float temp;                 /**< C, only meaningful if rank >= 0                   */
+    int   rank;                 /**< Rank that read it, -1 if there is no reading      */
+    int   sensor;               /**< The sensor's number on that rank                  */
+    char  where[TEMP_WHERE];    /**< Host name, chip and label of the sensor           */
+} TempSpot;
+
+/** \brief Fixed size summary of the temperature map, reduced across ranks by MergeTempSummary */
+typedef struct {
+    TempSpot coolest;                   /**< Coolest CPU sensor (socket, core or other)        */
+    TempSpot hottest[SENSOR_KINDS];     /**< Hottest sensor of each kind                       */
+    double   sum;                       /**< Sum of the CPU sensor readings ...                */
+    int      count;                     /**< ... and how many there were                       */
+    int      hist[TEMP_BINS];           /**< Every sensor, by TEMP_BIN_WIDTH C bins            */
+} TempSummary;
+
+/** \brief RAPL energy domains sampled by the monitor thread */
+enum {
+    POWER_PACKAGE,
+    POWER_CORE,
+    POWER_DRAM,
+    POWER_DOMAINS
+};
+
+/** \brief Power struct used by the monitor thread, each domain summed over the node's sockets */
+typedef struct {
+    int    found[POWER_DOMAINS];    /**< Energy counters read for each domain, 0 if the node has none     */
+    double joules[POWER_DOMAINS];   /**< Energy counted since the monitor started                          */
+    float  watts[POWER_DOMAINS];    /**< Mean power over the last monitor interval                         */
+    double share;                   /**< Package and DRAM energy divided among the busy workers, see PowerShare */
+} PowerRange;
+
 /*
  * Plan struct used to be here. Moved to planlib/planheaders.h
  *
@@ -55,24 +105,37 @@ typedef struct {
 
 /**
  * \brief This structure contains the "identity" information for the thread and a pointer to the next Plan it should execute.
+ *
+ * Handles are cache line aligned so that neighbouring entries of the WorkerHandle array never share a line. The
+ * mailbox (Plan, Gen and, with LINUX_PLACEMENT, the plan's cpuset) is written only by the scheduler, and the
+ * counters behind Flag only by the worker itself. Gen is odd while the scheduler is filling the mailbox.
  */
 typedef struct {
     pthread_t        ID;         /**< Thread ID                                               */
     pthread_attr_t   Attr;       /**< Thread attributes for this thread                       */
-    pthread_rwlock_t Lock;       /**< Read-write lock for this structure                      */
     int              Num;        /**< Thread number on this MPI task                          */
-    void *Plan;                  /**< Pointer to Plan. NULL means terminate worker            */
-    int **Flag;                  /**< Error flags for individual workers                      */
     int              Status;     /**< Determines if the thread has run a plan it's been given */
-} ThreadHandle;
+    void *Plan;                  /**< Pointer to Plan. NULL means terminate worker            */
+    unsigned long    Gen;        /**< Mailbox generation, bumped each time Plan is published  */
+    #ifdef LINUX_PLACEMENT
+    cpu_set_t        CpuSet;     /**< Cores the worker should move to before running Plan     */
+    int              CpuSetValid; /**< Nonzero if CpuSet applies, zero to keep the current set */
+    #endif
+    int **Flag;                  /**< Error counters, allocated and owned by the worker       */
+    int **Seen;                  /**< Counter values already harvested by collectLocalFlags   */
+    uint64_t *Runs;              /**< Plan executions, on a line allocated and owned by the worker */
+} __attribute__((aligned(CACHE_LINE_SIZE))) ThreadHandle;
 
 /* global data */
 
 extern TemperatureRange local_temp;
+extern PowerRange   local_power;
+extern int          busy_workers;
 extern ThreadHandle MonitorHandle;
 extern ThreadHandle *WorkerHandle;
 extern int          MyRank;
 extern int          comm_flag;
+extern char         comm_options[];
 extern int          verbose_flag;
 extern int          plancheck_flag;
 extern int          planperf_flag;
@@ -91,15 +154,29 @@ enum {
 extern void *MonitorThread(void *vptr);
 extern void StartMonitorThread();
 extern void CheckTemperatureRange(TemperatureRange *T);
+extern void CheckPowerRange(PowerRange *P);
+extern void BuildTempSummary(TempSummary *S);
+extern void MergeTempSummary(TempSummary *in, TempSummary *inout);
+extern void ReportTempSummary(TempSummary *S);
+extern double PowerShare();
+extern double PowerEnergy(int domain);
+extern int PowerFound(int domain);
+extern float TemperatureHottest();
 extern void EmergencyStop(int errorcode);
 extern void reduceTemps();
+extern void reduceStatus(int **local_flags);
 
 /* Worker thread functions. In worker.c */
 extern void *WorkerThread(void *threadarg);
 extern void StopWorkerThreads();
 extern void StartWorkerThreads();
+extern void publishPlan(ThreadHandle *h, void *plan);
+#ifdef LINUX_PLACEMENT
+extern void publishPlanOn(ThreadHandle *h, void *plan, cpu_set_t *cpuset);
+#endif
 extern void initWorkerFlags();
-extern void reduceFlags(int **local_flags);
+extern int **allocFlagBlock();
+extern uint64_t WorkerRuns();
 extern void collectLocalFlags(int **local_flag);
 extern void printFlags(int **all_flags);
 extern int **initErrorFlags();
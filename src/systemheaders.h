@@ -36,9 +36,9 @@
 #include <sys/types.h>
 #include <inttypes.h>
 #include <time.h>
+#include <sched.h>
 #ifdef LINUX_PLACEMENT
   #include <utmpx.h>     /* for sched_getcpu */
-  #include <sched.h>
 #endif
 
 #endif /* __SYSTEMHEADERS_H */
@@ -33,6 +33,10 @@
  * the controller/boss thread is responsible for initializing the Plan into a sane state before handing it off.
  * The worker thread is responsible for periodically checking to see if his plan has been updated.
  * If the worker thread's plan has been updated, the worker should close-out his previous plan and start the new one
+ *   - The check is made against the generation counter of the worker's mailbox (ThreadHandle::Gen), which the
+ *     controller bumps after storing a new Plan pointer. The worker only reads Plan when the generation changes.
+ *   - The worker moves itself onto the cpuset delivered with the plan before initializing it, so the new
+ *     plan's memory is first touched where the plan will run.
  *   - Closing out a previous plan includes freeing any resources which have been allocated for the plan.
  *   - Beginning a new plan includes an resource allocation and initialization required for the new plan.
  */
@@ -40,7 +44,7 @@
 /** \brief Initializes the plan using the plan's init_Plan function.
    \param p Pointer to the plan being run by the worker.
  */
-inline int InitPlan(Plan *p){
+static inline int InitPlan(Plan *p){
     if( p != NULL){
         return ((p->fptr_initplan)((void *)p));
     }
@@ -50,33 +54,109 @@ inline int InitPlan(Plan *p){
 /** \brief Executes the plan using the plan's exec_Plan function.
    \param p Pointer to the plan being run by the worker.
  */
-inline int runPlan(Plan *p){
+static inline int runPlan(Plan *p){
     if( p != NULL){
         return ((p->fptr_execplan)((void *)p));
     }
     return BAD;
 }
 
+/** \brief Gives the wall clock time in seconds, for attributing energy to plans.
+ */
+static double workerTime(){
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec + t.tv_usec * 1e-6;
+}
+
+/** \brief Counts the worker as busy while it runs a plan other than SLEEP, so the monitor thread gives the
+ *  plan a share of the node's energy from now on.
+   \param p Pointer to the plan being run by the worker.
+ */
+static inline void startEnergy(Plan *p){
+    if((p != NULL) && (p->name != SLEEP) ){
+        __atomic_add_fetch(&busy_workers, 1, __ATOMIC_RELAXED);
+        p->energy_share = PowerShare();
+        p->energy_start = workerTime();
+    }
+}
+
 /** \brief Stores and displays performance data for the plan with the plan's perf function.
  *  \param p Pointer to the plan being run by the worker.
  */
-inline int perfPlan(Plan *p){
+static inline int perfPlan(Plan *p){
+    int ret = BAD;
+    char text[ARRAY];
+    double joules;
     if((p != NULL) && (p->fptr_perfplan != NULL) ){
-        return ((p->fptr_perfplan)((void *)p));
+        ret = (p->fptr_perfplan)((void *)p);
+        if(p->page_size > 0){
+            snprintf(text, ARRAY, "%s plan page size:", plan_list[p->name]->name);
+            EmitLogfs(MyRank, 9999, text, (double)p->page_size / 1024.0, "kB", PRINT_SOME);
+        }
+        if(p->energy_start > 0.0){
+            joules = PowerShare() - p->energy_share;
+            if(joules > 0.0){
+                perf_table_energy(p->name, joules, workerTime() - p->energy_start);
+                snprintf(text, ARRAY, "%s plan energy share:", plan_list[p->name]->name);
+                EmitLogfs(MyRank, 9999, text, joules, "J", PRINT_SOME);
+            }
+        }
     }
-    return BAD;
+    return ret;
 }
 
 /** \brief Kills the plan using the plan's kill_Plan function.
    \param p Pointer to the plan being run by the worker.
  */
-inline void *killPlan(Plan *p){
+static inline void *killPlan(Plan *p){
+    PlanTeam *team;
     if( p != NULL){
+        if(p->energy_start > 0.0){
+            __atomic_sub_fetch(&busy_workers, 1, __ATOMIC_RELAXED);
+        }
+        team = p->team;
         (p->fptr_killplan)((void *)p);
+        plan_team_release(team);
     }
     return (void *)NULL;
 }
 
+/** \brief Hands a new plan, and the cores it should run on, to a worker through its mailbox.
+ *  The generation is made odd while the mailbox is filled and even again (with release semantics) once it is
+ *  complete, so a worker that reads the same even generation before and after copying the mailbox is guaranteed
+ *  a consistent plan and cpuset. Only the scheduler thread writes to a worker's mailbox.
+   \param h Handle of the worker receiving the plan.
+   \param plan The new plan. NULL tells the worker to terminate.
+   \param cpuset Cores the worker should move to before initializing the plan, or NULL to stay where it is.
+ */
+#ifdef LINUX_PLACEMENT
+void publishPlanOn(ThreadHandle *h, void *plan, cpu_set_t *cpuset){
+#else
+static void publishPlanOn(ThreadHandle *h, void *plan, void *cpuset){
+#endif
+    __atomic_add_fetch(&(h->Gen), 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    #ifdef LINUX_PLACEMENT
+    if(cpuset != NULL){
+        h->CpuSet = *cpuset;
+        h->CpuSetValid = 1;
+    } else {
+        h->CpuSetValid = 0;
+    }
+    #endif
+    __atomic_store_n(&(h->Plan), plan, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&(h->Gen), 1, __ATOMIC_RELEASE);
+}
+
+/** \brief Hands a new plan to a worker through its mailbox, leaving the worker's cpu affinity unchanged.
+   \param h Handle of the worker receiving the plan.
+   \param plan The new plan. NULL tells the worker to terminate.
+ */
+void publishPlan(ThreadHandle *h, void *plan){
+    publishPlanOn(h, plan, NULL);
+}
+
 /** \brief Start up the worker threads that run the plans that compose the workforce of SystemBurn */
 void StartWorkerThreads(){
     int i, one = 1;
@@ -85,32 +165,43 @@ void StartWorkerThreads(){
 
     /* construct worker thread's control structure start them with sleep */
     for(i = 0; i < num_workers; i++){
-        pthread_rwlock_init(&(WorkerHandle[i].Lock),0);
         pthread_attr_init(&(WorkerHandle[i].Attr));
         WorkerHandle[i].Num = i;
-        WorkerHandle[i].Plan = (plan_list[SLEEP]->make)(p);
+        WorkerHandle[i].Gen = 0;
+        #ifdef LINUX_PLACEMENT
+        WorkerHandle[i].CpuSetValid = 0;
+        #endif
+        publishPlan(&(WorkerHandle[i]), plan_make(SLEEP, p));
         pthread_create(&(WorkerHandle[i].ID), &(WorkerHandle[i].Attr), WorkerThread, &(WorkerHandle[i]));
         EmitLog(MyRank, SCHEDULER_THREAD, "Starting Worker Thread",WorkerHandle[i].Num, PRINT_OFTEN);
         #ifdef ASYNC_WORKERS
         pthread_detach(WorkerHandle[i].ID);
         #endif
     }
+    /* wait for every worker to allocate its error counters before anyone can record or collect errors */
+    for(i = 0; i < num_workers; i++){
+        while(__atomic_load_n(&(WorkerHandle[i].Flag), __ATOMIC_ACQUIRE) == NULL){
+            sched_yield();
+        }
+    }
     return;
 } /* StartWorkerThreads */
 
-/** \brief Stop the workers */
+/** \brief Stop the workers, at the end of a normal run. Scheduler only. */
 void StopWorkerThreads(){
     int i;
     /* tell them all to finish */
     for(i = 0; i < num_workers; i++){
         EmitLog(MyRank, SCHEDULER_THREAD, "Stopping Worker Thread",WorkerHandle[i].Num, PRINT_OFTEN);
-        pthread_rwlock_wrlock(&(WorkerHandle[i].Lock));
-        WorkerHandle[i].Plan = NULL;
-        pthread_rwlock_unlock(&(WorkerHandle[i].Lock));
-        #ifndef ASYNC_WORKERS
+        publishPlan(&(WorkerHandle[i]), NULL);
+    }
+    /* workers killing a funnelled COMM plan need the scheduler to run its last operations */
+    comm_funnel_drain();
+    #ifndef ASYNC_WORKERS
+    for(i = 0; i < num_workers; i++){
         pthread_join(WorkerHandle[i].ID, NULL);
-        #endif
     }
+    #endif
     return;
 }
 
@@ -128,6 +219,19 @@ void *WorkerThread(void *p){
     sleep_pass->i = &one;
     ThreadHandle *MyHandle = (ThreadHandle *)p;
     Plan *WorkerPlan, *BossPlan;
+    unsigned long WorkerGen, BossGen;
+    int **flags;
+    uint64_t *runs, nruns = 0;
+
+    /* error and progress counters are private to this thread, so allocate them here where they are first touched */
+    runs = (uint64_t *)aligned_alloc(CACHE_LINE_SIZE, CACHE_LINE_SIZE);
+    assert(runs);
+    *runs = 0;
+    MyHandle->Runs = runs;
+    flags = allocFlagBlock();
+    assert(flags);
+    __atomic_store_n(&(MyHandle->Flag), flags, __ATOMIC_RELEASE);
+
     #ifdef LINUX_PLACEMENT
     int affin_flag;
     cpucoreid = sched_getcpu();
@@ -140,10 +244,40 @@ void *WorkerThread(void *p){
     EmitLog(MyRank, MyHandle->Num, "Starting...", -1, PRINT_SOME);
     #endif
     WorkerPlan = NULL;
+    WorkerGen = 0;
     for(;; ){
-        pthread_rwlock_rdlock( &(MyHandle->Lock) );
-        BossPlan = MyHandle->Plan;
-        pthread_rwlock_unlock( &(MyHandle->Lock) );
+        /* Fast path: a relaxed load of the mailbox generation. The mailbox line stays shared in this core's cache
+         * until the scheduler publishes a new plan, so an unchanged generation costs no coherence traffic. */
+        BossGen = __atomic_load_n(&(MyHandle->Gen), __ATOMIC_RELAXED);
+        if(BossGen == WorkerGen){
+            run_flag = runPlan(WorkerPlan);
+            __atomic_store_n(runs, ++nruns, __ATOMIC_RELAXED);
+            if(run_flag != ERR_CLEAN){
+                add_error(MyHandle, WorkerPlan->name,run_flag);
+                EmitLog(MyRank, MyHandle->Num, "Runtime error flag triggered, error number:", run_flag, PRINT_ALWAYS);
+            }
+            continue;
+        }
+
+        /* Slow path: the generation changed, so pick up the plan (and cpuset) that goes with it. If the scheduler
+         * is in the middle of filling the mailbox, go around again. */
+        BossGen = __atomic_load_n(&(MyHandle->Gen), __ATOMIC_ACQUIRE);
+        if(BossGen & 1){
+            continue;
+        }
+        BossPlan = __atomic_load_n(&(MyHandle->Plan), __ATOMIC_RELAXED);
+        #ifdef LINUX_PLACEMENT
+        cpu_set_t cpuset;
+        int new_cpuset = MyHandle->CpuSetValid;
+        if(new_cpuset){
+            cpuset = MyHandle->CpuSet;
+        }
+        #endif
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&(MyHandle->Gen), __ATOMIC_RELAXED) != BossGen){
+            continue;
+        }
+        WorkerGen = BossGen;
         if(BossPlan == NULL){
             if(DO_PERF){
                 EmitLog(MyRank, MyHandle->Num, "Printing performance data.", -1, PRINT_SOME);
@@ -168,14 +302,20 @@ void *WorkerThread(void *p){
                 }
                 #ifdef LINUX_PLACEMENT
                 numcpucores = sysconf(_SC_NPROCESSORS_ONLN);
-                cpucoreid = sched_getcpu();
-                //syscall(__NR_getcpu(&cpucoreid, NULL, NULL));
 
-                cpu_set_t cpuset;
-                affin_flag = pthread_getaffinity_np(MyHandle->ID, sizeof(cpu_set_t), &cpuset);
+                /* move onto the plan's cores first, so that InitPlan allocates and touches memory there */
+                if(new_cpuset){
+                    affin_flag = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+                    if(affin_flag != 0){
+                        add_error(MyHandle,SYSTEM,2);
+                    }
+                }
+                affin_flag = pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
                 if(affin_flag != 0){
                     add_error(MyHandle,SYSTEM,2);
                 }
+                cpucoreid = sched_getcpu();
+                //syscall(__NR_getcpu(&cpucoreid, NULL, NULL));
 
                 EmitLog(MyRank, MyHandle->Num, "New plan detected. Switching plans on core", cpucoreid, PRINT_SOME);
                 if(PRINT_RARELY <= verbose_flag){
@@ -195,42 +335,76 @@ void *WorkerThread(void *p){
                 WorkerPlan = killPlan(WorkerPlan);                              /*     clean up old plan   */
                 WorkerPlan = BossPlan;                                          /*     switch plans        */
 
+                WorkerPlan->mem_node = PLAN_NODE_UNKNOWN;
+                WorkerPlan->page_size = 0;
                 init_flag = InitPlan(WorkerPlan);                               /*     initialize new plan */
+                if(WorkerPlan->mem_node >= 0){
+                    EmitLog(MyRank, MyHandle->Num, "Plan memory placed on NUMA node", WorkerPlan->mem_node, PRINT_SOME);
+                } else if(WorkerPlan->mem_node == PLAN_NODE_MIXED){
+                    EmitLog(MyRank, MyHandle->Num, "Plan memory spread over several NUMA nodes, worker is on node", plan_current_node(), PRINT_SOME);
+                }
                 if(init_flag != ERR_CLEAN){
                     add_error(MyHandle, WorkerPlan->name,init_flag);
                     EmitLog(MyRank, MyHandle->Num, "Initialization error flag triggered, error number:", init_flag, PRINT_ALWAYS);
-                    MyHandle->Plan = (plan_list[SLEEP]->make)(sleep_pass);
-                    continue;
+                    /* Sleep until the scheduler publishes the next plan. The mailbox is left alone so that
+                     * the scheduler remains its only writer. */
+                    WorkerPlan = killPlan(WorkerPlan);
+                    WorkerPlan = plan_make(SLEEP, sleep_pass);
+                    InitPlan(WorkerPlan);
+                } else {
+                    startEnergy(WorkerPlan);
                 }
             }
-            run_flag = runPlan(WorkerPlan);
-            if(run_flag != ERR_CLEAN){
-                add_error(MyHandle, WorkerPlan->name,run_flag);
-                //MyHandle->Plan = (plan_list[SLEEP]->make)(sleep_pass);
-                EmitLog(MyRank, MyHandle->Num, "Runtime error flag triggered, error number:", run_flag, PRINT_ALWAYS);
-            }
         }
     }
     return((void *)0);     /* not reached */
 } /* WorkerThread */
 
-/** \brief This function initializes the WorkerHandle structure's flags to zero. */
+/** \brief Allocates one set of error counters as a single cache line aligned, zeroed block.
+ *  The row pointers and the counters share the block, and its size is rounded up to whole cache lines so that
+ *  no other allocation shares its last line. The block is zeroed by the calling thread, which first touches its
+ *  pages and so places them on that thread's NUMA node.
+ *  \return Error counters indexed as [plan name + 1][error], with row 0 holding the SYSTEM errors.
+ */
+int **allocFlagBlock(){
+    int i;
+    size_t count, bytes;
+    int **rows = NULL;
+    int *cell;
+
+    count = SYS_ERR_SIZE;
+    for(i = 1; i < ERR_FLAG_SIZE; i++){
+        count += plan_list[i - 1]->esize + GEN_SIZE;
+    }
+    bytes = sizeof(int *) * ERR_FLAG_SIZE + sizeof(int) * count;
+    bytes = (bytes + CACHE_LINE_SIZE - 1) & ~((size_t)CACHE_LINE_SIZE - 1);
+
+    if(posix_memalign((void **)&rows, CACHE_LINE_SIZE, bytes) != 0){
+        return NULL;
+    }
+    memset(rows, 0, bytes);
+
+    cell = (int *)(rows + ERR_FLAG_SIZE);
+    rows[0] = cell;
+    cell += SYS_ERR_SIZE;
+    for(i = 1; i < ERR_FLAG_SIZE; i++){
+        rows[i] = cell;
+        cell += plan_list[i - 1]->esize + GEN_SIZE;
+    }
+    return rows;
+} /* allocFlagBlock */
+
+/** \brief Sets up the scheduler's bookkeeping for the workers' error counters.
+ *  The counters themselves are allocated by each worker when it starts (see WorkerThread), here we only zero
+ *  the snapshots that collectLocalFlags compares them against.
+ */
 void initWorkerFlags(){
-    int i, j, k;
+    int i;
     for(i = 0; i < num_workers; i++){
-        WorkerHandle[i].Flag = (int **)malloc(sizeof(int *) * ERR_FLAG_SIZE);
-        assert(WorkerHandle[i].Flag);
-        // Allocate storage for "System" (worker thread management) errors.
-        WorkerHandle[i].Flag[0] = (int *)calloc((SYS_ERR_SIZE), sizeof(int));
-        assert(WorkerHandle[i].Flag[0]);
-        // Allocate storage for Plan errors.
-        for(j = 1; j < ERR_FLAG_SIZE; j++){
-            WorkerHandle[i].Flag[j] = (int *)malloc(sizeof(int) * (plan_list[j - 1]->esize + GEN_SIZE));
-            assert(WorkerHandle[i].Flag[j]);
-            for(k = 0; k < plan_list[j - 1]->esize + GEN_SIZE; k++){
-                WorkerHandle[i].Flag[j][k] = 0;
-            }
-        }
+        WorkerHandle[i].Flag = NULL;
+        WorkerHandle[i].Runs = NULL;
+        WorkerHandle[i].Seen = allocFlagBlock();
+        assert(WorkerHandle[i].Seen);
     }
 } /* initWorkerFlags */
 
@@ -256,42 +430,47 @@ int **initErrorFlags(){
 } /* initErrorFlags */
 
 /**
- * \brief This function uses a reduction routine to gather and summarize error flags from all SPMD processes.
- * \param local_flag The array of error flags that each worker holds, telling SystemBurn which errors were encountered and how often
+ * \brief Adds up the plan executions of the node's workers.
+ * \returns Executions since the workers started.
  */
-void reduceFlags(int **local_flag){
-    /* uses either of two comm libraries, functions located in comm.c */
-    collectLocalFlags(local_flag);
-    #ifdef HAVE_SHMEM
-    reduceFlags_SHMEM(local_flag);
-    #else
-    reduceFlags_MPI(local_flag);
-    #endif
-}
+uint64_t WorkerRuns(){
+    int i;
+    uint64_t total = 0;
+    for(i = 0; i < num_workers; i++){
+        if(WorkerHandle[i].Runs != NULL){
+            total += __atomic_load_n(WorkerHandle[i].Runs, __ATOMIC_RELAXED);
+        }
+    }
+    return total;
+} /* WorkerRuns */
 
 /**
  * \brief Collects all error flags from the worker threads within a node.
  * \param [out] local_flag A 2D array of error flags to which is added new flags collected from the workers.
  */
 void collectLocalFlags(int **local_flag){
-    int i, j, k;
+    int i, j, k, now;
+    int **flag, **seen;
 
+    /* The workers' counters only ever increase; harvest what was added since the last collection. */
     for(i = 0; i < num_workers; i++){
-        pthread_rwlock_wrlock(&(WorkerHandle[i].Lock));
+        flag = WorkerHandle[i].Flag;
+        seen = WorkerHandle[i].Seen;
         // Collect System flags first
         j = 0;
         for(k = 0; k < SYS_ERR_SIZE; k++){
-            local_flag[j][k] += WorkerHandle[i].Flag[j][k];
-            WorkerHandle[i].Flag[j][k] = 0;
+            now = __atomic_load_n(&(flag[j][k]), __ATOMIC_RELAXED);
+            local_flag[j][k] += now - seen[j][k];
+            seen[j][k] = now;
         }
         // Collect Plan flags
         for(j = 1; j < ERR_FLAG_SIZE; j++){
             for(k = 0; k < plan_list[j - 1]->esize + GEN_SIZE; k++){
-                local_flag[j][k] += WorkerHandle[i].Flag[j][k];
-                WorkerHandle[i].Flag[j][k] = 0;
+                now = __atomic_load_n(&(flag[j][k]), __ATOMIC_RELAXED);
+                local_flag[j][k] += now - seen[j][k];
+                seen[j][k] = now;
             }
         }
-        pthread_rwlock_unlock(&(WorkerHandle[i].Lock));
     }
 } /* collectLocalFlags */
 